@@ -0,0 +1,133 @@
+// Access Log Ring
+// Fixed-size binary records in a ring file on the SD card. An event is one
+// 64-byte record write - O(1) however long the history - and the file never
+// grows beyond header + capacity records.
+// Every event gets a sequence number; its slot is (sequence - 1) % capacity,
+// so any event is one seek away and sequences double as stable cursors.
+// CRC per record and per header copy; a torn write costs at most the record
+// being written.
+// Uses stdio on top of the ESP-IDF VFS ("/sdcard/..."), so it also builds on a host.
+#ifndef ACCESS_LOG_H
+#define ACCESS_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#else
+#include <mutex>
+#endif
+
+#define ACCESS_LOG_VERSION 1
+#define ACCESS_LOG_CAPACITY 262144 // Events kept (16 MB of records)
+#define ACCESS_LOG_USER_LEN 32
+#define ACCESS_LOG_PATH_LEN 48
+#define ACCESS_LOG_IO_BUFFER 4096 // stdio buffer: a batch of up to 64 records is one card write
+#define ACCESS_LOG_HEADER_INTERVAL 64 // Appends between header updates (recovery re-scans at most this many)
+
+enum AccessAction : uint8_t
+{
+    ACCESS_ACTION_OTHER = 0,
+    ACCESS_ACTION_GRANTED,
+    ACCESS_ACTION_DENIED_LOW_CONFIDENCE,
+    ACCESS_ACTION_DENIED_LIVENESS_FAIL,
+    ACCESS_ACTION_DENIED_NOT_ENROLLED,
+    ACCESS_ACTION_FACE_IN_VIEW,
+    ACCESS_ACTION_TAILGATING_SUSPECTED,
+    ACCESS_ACTION_COUNT
+};
+
+// "ACCESS_GRANTED" <-> ACCESS_ACTION_GRANTED; unknown names map to OTHER
+AccessAction accessActionCode(const char *name);
+// Strict variant for query input: false when the name is not an action
+bool accessActionLookup(const char *name, AccessAction &action);
+const char *accessActionName(uint8_t code);
+
+struct AccessLogRecord
+{
+    uint32_t sequence;  // 1-based, assigned by append()
+    uint32_t timestamp; // Milliseconds since boot, as logged
+    float confidence;
+    bool success;
+    uint8_t action;     // AccessAction
+    char user[ACCESS_LOG_USER_LEN];
+};
+
+// Notified under the log's lock, e.g. to keep an index (see log_index.h)
+class AccessLogObserver
+{
+public:
+    virtual ~AccessLogObserver() {}
+    virtual void appended(const AccessLogRecord *records, size_t count) = 0;
+    virtual void synced() = 0;
+};
+
+class AccessLog
+{
+public:
+    explicit AccessLog(uint32_t capacity = ACCESS_LOG_CAPACITY);
+    ~AccessLog();
+
+    // Opens or creates the ring at path. An existing ring keeps its own
+    // capacity. Records written after the last header update are recovered.
+    bool begin(const char *path);
+    void end();
+    bool ready() const { return file_ != nullptr; }
+
+    // Appends and assigns record.sequence. Flushed to the file, not fsync'd.
+    bool append(AccessLogRecord &record);
+    bool append(AccessLogRecord *records, size_t count); // Batch: one card write
+    bool sync(); // fsync: everything appended so far survives power loss
+
+    // Forget every event (sequences keep counting up)
+    bool clear();
+
+    // Any retained event by sequence; false if overwritten, cleared or corrupt
+    bool read(uint32_t sequence, AccessLogRecord &record);
+
+    // count consecutive slots starting at first, one seek: out[i] is the
+    // event first + i, or has sequence 0 when that slot holds no valid event.
+    // The range must not cross the end of the ring.
+    size_t readRange(uint32_t first, size_t count, AccessLogRecord *out);
+
+    void setObserver(AccessLogObserver *observer) { observer_ = observer; }
+
+    uint32_t firstSequence(); // Oldest retained event
+    uint32_t nextSequence();  // One past the newest
+    uint32_t count();
+    uint32_t capacity() const { return capacity_; }
+    uint32_t corruptRecords() const { return corruptRecords_; }
+
+private:
+    bool writeHeader();
+    bool readHeader();
+    bool writeRecords(const AccessLogRecord *records, size_t count);
+    long slotOffset(uint32_t sequence) const;
+    bool readRecord(uint32_t sequence, AccessLogRecord &record);
+    bool decodeRecord(const uint8_t *slot, uint32_t sequence, AccessLogRecord &record);
+    bool syncLocked();
+    uint32_t oldestLocked() const;
+    void lock();
+    void unlock();
+
+    char path_[ACCESS_LOG_PATH_LEN];
+    FILE *file_;
+    uint32_t capacity_;
+    uint32_t firstSequence_; // Raised by clear()
+    uint32_t nextSequence_;
+    uint32_t headerGeneration_; // Picks the newer of the two header copies
+    uint32_t appendsSinceHeader_;
+    uint32_t corruptRecords_;
+    AccessLogObserver *observer_;
+
+#ifdef ESP_PLATFORM
+    SemaphoreHandle_t mutex_;
+#else
+    std::mutex mutex_;
+#endif
+};
+
+#endif // ACCESS_LOG_H
@@ -0,0 +1,12 @@
+// CRC-32 (IEEE 802.3, reflected) for on-flash / on-SD record integrity
+// ESP32: ROM implementation, host builds: table-driven fallback
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Incremental: crc32Update(crc32Update(0, a, n), b, m) == crc32 of a||b
+uint32_t crc32Update(uint32_t crc, const void *data, size_t len);
+
+#endif // CRC32_H
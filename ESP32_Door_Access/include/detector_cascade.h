@@ -0,0 +1,52 @@
+// Face Detector Cascade Counters
+// With nobody in view, presence is checked with the proposal stage of the
+// two-stage detector alone; only when it proposes a face does the refinement
+// stage run on its candidates (same decoded frame, no second pass). Per-stage latency and hit/miss counters (plus how often a
+// fast hit was confirmed) are kept here so the hand-off can be tuned on the
+// real hardware.
+// No Arduino dependency: builds on the host as well.
+#ifndef DETECTOR_CASCADE_H
+#define DETECTOR_CASCADE_H
+
+#include <stdint.h>
+
+enum DetectorStage
+{
+    DETECT_STAGE_FAST = 0, // Presence check, full frame, proposal stage only
+    DETECT_STAGE_ACCURATE, // Full frame, refinement (landmarks for the recognizer); both stages when no presence check ran
+    DETECT_STAGE_ROI,      // Two stages on the ROI window only
+    DETECT_STAGE_COUNT
+};
+
+const char *detectorStageName(DetectorStage stage);
+
+struct DetectorStageStats
+{
+    uint32_t runs;
+    uint32_t hits;
+    uint32_t lastUs;
+    uint64_t totalUs;
+};
+
+class DetectorCascade
+{
+public:
+    DetectorCascade();
+
+    void record(DetectorStage stage, bool hit, uint32_t elapsedUs);
+
+    // Fast stage fired and the accurate stage confirmed (or rejected) it
+    void handoff(bool confirmed);
+
+    const DetectorStageStats &stats(DetectorStage stage) const { return stages_[stage]; }
+    uint32_t averageUs(DetectorStage stage) const;
+    uint32_t handoffs() const { return handoffs_; }
+    uint32_t confirmed() const { return confirmed_; }
+
+private:
+    DetectorStageStats stages_[DETECT_STAGE_COUNT];
+    uint32_t handoffs_;
+    uint32_t confirmed_;
+};
+
+#endif // DETECTOR_CASCADE_H
@@ -0,0 +1,169 @@
+// Door / LED Actuator State Machine
+// Relay hold time, LED blink patterns and the pause between enrollment steps
+// are deadlines in one small state machine instead of delay() calls in the
+// code that triggers them: unlock() switches the relay and returns, and the
+// relock, every LED edge and the end of an enrollment pause happen later on
+// a one-shot timer. Nothing on the recognition or HTTP paths ever sleeps.
+// The timer sits behind ActuatorClock: esp_timer on the ESP32, a virtual
+// clock on the host that fires each deadline at its exact millisecond.
+// No Arduino dependency: builds on the host as well.
+#ifndef DOOR_ACTUATOR_H
+#define DOOR_ACTUATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#else
+#include <mutex>
+#endif
+
+#define ACTUATOR_BLINK_MS 100      // LED half period (on or off time) of a blink
+#define ACTUATOR_UNLOCK_BLINKS 3   // Blinks when the door opens
+#define ACTUATOR_CUE_BLINKS 1      // Blinks when the next enrollment step can start
+#define ACTUATOR_NO_DEADLINE 0xFFFFFFFFu
+
+enum ActuatorEvent
+{
+    ACTUATOR_DOOR_LOCKED = 0,    // Relay released after the unlock duration
+    ACTUATOR_ENROLLMENT_READY    // Enrollment pause over
+};
+
+// Output hooks. They run with the actuator lock held: set a pin or log, but
+// never call back into the DoorActuator.
+struct ActuatorOutputs
+{
+    void (*relay)(bool on, void *context);
+    void (*led)(bool on, void *context);
+    void (*event)(ActuatorEvent event, void *context); // Optional
+    void *context;
+};
+
+class DoorActuator;
+
+// One-shot timer plus the time base. schedule() replaces any pending
+// deadline; when it expires the clock calls fire(), which runs the state
+// machine and schedules the next deadline.
+class ActuatorClock
+{
+public:
+    ActuatorClock() : actuator_(nullptr) {}
+    virtual ~ActuatorClock() {}
+
+    virtual bool begin() { return true; }
+    virtual uint32_t nowMs() = 0;
+    virtual void schedule(uint32_t delayMs) = 0;
+    virtual void cancel() = 0;
+
+    void attach(DoorActuator *actuator) { actuator_ = actuator; }
+
+protected:
+    void fire();
+
+private:
+    DoorActuator *actuator_;
+};
+
+class DoorActuator
+{
+public:
+    DoorActuator(ActuatorClock &clock, const ActuatorOutputs &outputs);
+
+    bool begin(bool ledIdle); // Creates the lock and timer, drives both outputs to rest
+
+    // Relay on for durationMs (a repeat unlock extends the hold) and the
+    // unlock blink pattern
+    void unlock(uint32_t durationMs);
+    void lock(); // Release the relay now, no event
+
+    void blink(uint8_t count);       // Pattern on top of the idle level
+    void setLedIdle(bool on);        // Level between patterns
+
+    // Enrollment steps are refused until the pause is over; the LED cues the
+    // user when the next step can start
+    void holdEnrollment(uint32_t pauseMs);
+    void releaseEnrollment();
+    bool enrollmentHeld();
+
+    bool doorUnlocked();
+    uint32_t unlockedAtMs(); // Time of the last unlock (0 = never)
+    uint32_t relockInMs();   // 0 when locked
+
+    // Timer entry point: applies every transition due now
+    void onTimer();
+
+private:
+    void lockState();
+    void unlockState();
+    uint32_t advanceLocked(uint32_t now); // Ms to the next deadline
+    void rescheduleLocked(uint32_t now);
+    void setLed(bool on);
+
+    ActuatorClock &clock_;
+    ActuatorOutputs outputs_;
+
+    bool relayOn_;
+    uint32_t unlockedAt_;
+    uint32_t relockAt_;
+
+    bool ledIdle_;
+    bool ledOn_;
+    uint8_t ledEdgesLeft_; // Pending toggles of the current pattern
+    uint32_t ledNextAt_;
+
+    bool enrollmentHeld_;
+    uint32_t enrollmentReleaseAt_;
+
+#ifdef ESP_PLATFORM
+    SemaphoreHandle_t mutex_;
+#else
+    std::mutex mutex_;
+#endif
+};
+
+#ifdef ESP_PLATFORM
+
+// esp_timer one-shot; callbacks run on the esp_timer task, never in an ISR
+class EspTimerClock : public ActuatorClock
+{
+public:
+    EspTimerClock() : timer_(nullptr) {}
+
+    bool begin() override;
+    uint32_t nowMs() override { return (uint32_t)(esp_timer_get_time() / 1000); }
+    void schedule(uint32_t delayMs) override;
+    void cancel() override;
+
+private:
+    static void callback(void *arg);
+    esp_timer_handle_t timer_;
+};
+
+#endif
+
+// Host time base: time only moves when advance()/advanceTo() is called, and
+// a pending deadline fires with nowMs() equal to the deadline itself
+class VirtualClock : public ActuatorClock
+{
+public:
+    explicit VirtualClock(uint32_t startMs = 0) : now_(startMs), deadline_(0), armed_(false) {}
+
+    uint32_t nowMs() override { return now_; }
+    void schedule(uint32_t delayMs) override;
+    void cancel() override { armed_ = false; }
+
+    void advance(uint32_t ms) { advanceTo(now_ + ms); }
+    void advanceTo(uint32_t ms);
+    bool pending() const { return armed_; }
+    uint32_t deadline() const { return deadline_; }
+
+private:
+    uint32_t now_;
+    uint32_t deadline_;
+    bool armed_;
+};
+
+#endif // DOOR_ACTUATOR_H
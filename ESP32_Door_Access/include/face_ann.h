@@ -0,0 +1,101 @@
+// Approximate Nearest-Neighbour Index (IVF) for the face gallery
+// Stage 1: compare the probe with sqrt(N) coarse centroids (spherical k-means)
+// Stage 2: exact int8 re-rank over the records of the closest lists only
+// Cost per match grows ~O(sqrt(N)) instead of O(N).
+#ifndef FACE_ANN_H
+#define FACE_ANN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "face_embedding.h"
+
+#define ANN_MIN_RECORDS 64     // Below this a brute-force scan is already cheap
+#define ANN_DEFAULT_PROBES 4   // Inverted lists scanned per query
+#define ANN_MAX_PROBES 16      // Upper bound for setProbes()
+#define ANN_MARGIN_PROBES 12   // Lists the margin check of an accepted match may visit (FaceGallery::matchTopK)
+#define ANN_TRAIN_ITERATIONS 8 // k-means refinement passes
+#define ANN_TRAIN_SAMPLE 2048  // Records k-means runs on (evenly spaced over the gallery)
+
+class FaceGallery;
+
+class FaceAnnIndex
+{
+public:
+    FaceAnnIndex();
+    ~FaceAnnIndex();
+
+    // (Re)build centroids and list assignment from the whole gallery.
+    // lists == 0 picks sqrt(records).
+    bool train(const FaceGallery &gallery, size_t lists = 0, int iterations = ANN_TRAIN_ITERATIONS);
+    void reset();
+
+    // train() in three steps, so a caller sharing the gallery only holds its
+    // lock for the copy and for one assignment pass, not during k-means:
+    //   sampleForTraining  under the lock: up to ANN_TRAIN_SAMPLE records to PSRAM
+    //   trainCentroids     no lock: k-means on the sample (the index keeps serving)
+    //   installTraining    under the lock: new centroids, every record assigned
+    bool sampleForTraining(const FaceGallery &gallery, size_t lists = 0);
+    bool trainCentroids(int iterations = ANN_TRAIN_ITERATIONS);
+    bool installTraining(const FaceGallery &gallery);
+    void discardTraining();
+
+    bool trained() const { return lists_ > 0; }
+    size_t lists() const { return lists_; }
+    void setProbes(size_t probes) { probes_ = probes == 0 ? 1 : probes; }
+    size_t probes() const { return probes_ < ANN_MAX_PROBES ? probes_ : ANN_MAX_PROBES; }
+
+    // True when the gallery outgrew the centroid set (2x since last training)
+    bool needsTraining(size_t records) const;
+
+    // Gallery mutation hooks - keep per-record assignments in sync
+    void recordAdded(const FaceGallery &gallery, size_t record);
+    void recordMoved(size_t from, size_t to);
+    void recordsTruncated(size_t count);
+
+    // Two-stage search. Returns the best record index or -1.
+    int search(const FaceGallery &gallery, const QuantizedEmbedding &probe, float &similarity) const;
+
+    // Stage 1 only, for custom re-rankers: the (up to maxLists, at most
+    // ANN_MAX_PROBES) lists closest to the probe, best first, with their
+    // centroid similarities when requested. Returns 0 when the index is out
+    // of sync with the gallery.
+    size_t closestLists(const FaceGallery &gallery, const QuantizedEmbedding &probe, int *lists, size_t maxLists,
+                        float *similarity = nullptr) const;
+    // Highest similarity any record of the list can have with a probe whose
+    // similarity to the list centroid is centroidSimilarity (triangle
+    // inequality on the sphere with the list radius)
+    float listBound(int list, float centroidSimilarity) const;
+    // Records of one list (valid until the next gallery mutation)
+    const uint32_t *listMembers(int list, size_t &count) const;
+
+private:
+    int nearestList(const QuantizedEmbedding &embedding, float &similarity) const;
+    static int nearestCentroid(const QuantizedEmbedding &embedding, const QuantizedEmbedding *centroids, size_t count,
+                               float &similarity);
+    bool reserveAssignments(size_t records);
+    void rebuildLists() const;
+
+    QuantizedEmbedding *centroids_;
+    float *radius_; // Lowest member-to-centroid similarity per list (only shrinks until retrained)
+    size_t lists_;
+    size_t probes_;
+    size_t trainedRecords_;
+
+    QuantizedEmbedding *sample_; // Pending training (sampleForTraining .. installTraining)
+    size_t sampleCount_;
+    QuantizedEmbedding *pendingCentroids_;
+    size_t pendingLists_;
+    bool pendingTrained_;
+
+    uint16_t *assign_; // List of every record
+    size_t assignCount_;
+    size_t assignCapacity_;
+
+    // CSR view of the inverted lists, rebuilt lazily after mutations
+    mutable uint32_t *offsets_;
+    mutable uint32_t *members_;
+    mutable size_t membersCapacity_;
+    mutable bool dirty_;
+};
+
+#endif // FACE_ANN_H
@@ -0,0 +1,62 @@
+// Face Directory - compact name/metadata table for enrolled users
+// Stored beside the journal (/spiffs/faces.dir), ~100 bytes per user, so
+// listing users never reads embeddings. Versioned header + CRC.
+// Uses stdio on top of the ESP-IDF VFS, so it also builds on a host.
+#ifndef FACE_DIRECTORY_H
+#define FACE_DIRECTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "face_gallery.h"
+
+#define FACE_DIRECTORY_VERSION 2
+#define DIRECTORY_FIELD_LEN 32 // jabatan / departemen
+#define DIRECTORY_DATE_LEN 11  // masaBerlaku "YYYY-MM-DD"
+
+// On-flash entry: the count leads and every other field is a char array,
+// so the layout has no padding
+struct FaceDirectoryEntry
+{
+    uint16_t templates; // Templates in the gallery (0 = metadata only, not enrolled)
+    char name[FACE_NAME_LEN];
+    char jabatan[DIRECTORY_FIELD_LEN];
+    char departemen[DIRECTORY_FIELD_LEN];
+    char masaBerlaku[DIRECTORY_DATE_LEN];
+};
+
+class FaceDirectory
+{
+public:
+    FaceDirectory();
+    ~FaceDirectory();
+
+    // Missing file = empty directory. A bad header/CRC also yields an empty
+    // directory (metadata is rebuilt from the gallery by syncWithGallery()).
+    bool load(const char *path);
+    bool save(const char *path) const; // Atomic: writes <path>.tmp then renames
+
+    void clear() { count_ = 0; }
+    size_t count() const { return count_; }
+    const FaceDirectoryEntry &entry(size_t i) const { return entries_[i]; }
+
+    int find(const char *name) const;
+    FaceDirectoryEntry *upsert(const char *name);
+    bool remove(const char *name);
+
+    // Update one metadata field set (nullptr = leave unchanged)
+    bool setMetadata(const char *name, const char *jabatan, const char *departemen, const char *masaBerlaku);
+
+    // Mirror gallery users/template counts. Returns true if anything changed.
+    bool syncWithGallery(const FaceGallery &gallery);
+
+private:
+    bool reserve(size_t count);
+    FaceDirectoryEntry *append(const char *name);
+
+    FaceDirectoryEntry *entries_;
+    size_t count_;
+    size_t capacity_;
+};
+
+#endif // FACE_DIRECTORY_H
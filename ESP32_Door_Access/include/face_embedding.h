@@ -0,0 +1,45 @@
+// Face Embedding Quantization & Similarity Kernels
+// int8 gallery format (per-vector scale) for the 512-d face embeddings
+// ESP32-S3: dot product uses the PIE vector unit (EE.VMULAS.S8.ACCX)
+// Other targets (host builds): portable scalar fallback
+#ifndef FACE_EMBEDDING_H
+#define FACE_EMBEDDING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FACE_EMBEDDING_DIM 512
+
+// Define FACE_EMBEDDING_SCALAR to force the portable kernel on the S3 as well
+#if defined(CONFIG_IDF_TARGET_ESP32S3) && !defined(FACE_EMBEDDING_SCALAR)
+#define FACE_EMBEDDING_USE_PIE 1
+#else
+#define FACE_EMBEDDING_USE_PIE 0
+#endif
+
+// Quantized embedding: 528 bytes instead of 2048 bytes of float
+// data[] comes first so the 128-bit PIE loads stay 16-byte aligned
+struct alignas(16) QuantizedEmbedding
+{
+    int8_t data[FACE_EMBEDDING_DIM];
+    float scale; // Original value ~= data[i] * scale
+    float norm;  // L2 norm of the dequantized vector (never 0 for a valid entry)
+};
+
+// Symmetric per-vector quantization: scale = max|x| / 127
+void quantizeEmbedding(const float *src, QuantizedEmbedding &dst);
+void dequantizeEmbedding(const QuantizedEmbedding &src, float *dst);
+
+// Integer dot product. n must be a multiple of 16 and both pointers
+// 16-byte aligned (always true for QuantizedEmbedding::data)
+int32_t dotProductS8(const int8_t *a, const int8_t *b, size_t n);
+
+// Cosine similarity on the float path (reference) and on the int8 path
+float cosineSimilarity(const float *a, const float *b, size_t n);
+float cosineSimilarityQ8(const QuantizedEmbedding &a, const QuantizedEmbedding &b);
+
+// Brute-force scan over a contiguous block (PSRAM gallery or a mapped flash
+// partition alike). Returns the best index or -1 when count is 0.
+int bestMatchQ8(const QuantizedEmbedding &probe, const QuantizedEmbedding *gallery, size_t count, float &similarity);
+
+#endif // FACE_EMBEDDING_H
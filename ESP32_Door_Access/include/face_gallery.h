@@ -0,0 +1,119 @@
+// Resident Face Gallery Index
+// All enrolled embeddings (int8) live in PSRAM, loaded once at boot.
+// A name -> user directory keeps per-user record counts up to date, so
+// status and user endpoints never have to touch /fr.bin.
+// No Arduino dependency: builds on the host as well.
+#ifndef FACE_GALLERY_H
+#define FACE_GALLERY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "face_embedding.h"
+#include "face_matcher.h"
+
+#define FACE_NAME_LEN 17            // Matches char name[17] in /fr.bin
+#define GALLERY_DEFAULT_USERS 256   // Initial directory capacity (grows on demand)
+#define GALLERY_DEFAULT_RECORDS 256 // Initial embedding capacity (grows on demand)
+#define GALLERY_MAX_TEMPLATES 8     // Upper bound for templates kept per user by fuseUser()
+
+struct GalleryUser
+{
+    char name[FACE_NAME_LEN];
+    uint16_t records; // Embeddings enrolled for this user (0 = free slot)
+};
+
+class FaceAnnIndex;
+
+class FaceGallery
+{
+public:
+    FaceGallery();
+    ~FaceGallery();
+
+    bool begin(size_t recordCapacity = GALLERY_DEFAULT_RECORDS, size_t userCapacity = GALLERY_DEFAULT_USERS);
+    void clear();
+
+    // Optional ANN index: kept in sync on every mutation, used by match() once trained
+    void attachIndex(FaceAnnIndex *index) { index_ = index; }
+
+    // Add one embedding for a user (creates the user on first record)
+    // Returns the record index, or -1 when out of memory / name invalid
+    int addRecord(const char *name, const float *embedding);
+    int addRecord(const char *name, const QuantizedEmbedding &embedding);
+
+    // Remove every record of a user. Returns the number of records removed.
+    int removeUser(const char *name);
+
+    // Template aggregation: replace a user's records with their normalized
+    // centroid plus up to maxTemplates - 1 most diverse captures.
+    // Returns the number of records the user has afterwards.
+    int fuseUser(const char *name, int maxTemplates);
+
+    // Migration for galleries enrolled one record per capture: fuse every user.
+    // Returns the number of records removed.
+    int fuseAllUsers(int maxTemplates);
+
+    // Directory lookups - O(1) average
+    int findUser(const char *name) const;
+    const GalleryUser &user(int userIndex) const { return users_[userIndex]; }
+    size_t userSlots() const { return userSlots_; }
+    size_t userCount() const { return userCount_; }
+    size_t recordCount() const { return recordCount_; }
+    size_t memoryUsage() const;
+
+    // Bumped by every mutation: lets multi-step readers (exports) detect changes
+    uint32_t revision() const { return revision_; }
+
+    // Record access (records are contiguous, order is not stable across removals)
+    const QuantizedEmbedding &embedding(size_t record) const { return embeddings_[record]; }
+    int recordUser(size_t record) const { return recordUser_[record]; }
+    const EmbeddingBounds &bounds(size_t record) const { return bounds_[record]; }
+
+    // Best match over all records (two-stage via the ANN index when trained,
+    // brute force otherwise). Returns the user index or -1.
+    int match(const QuantizedEmbedding &probe, float &similarity) const;
+
+    // Top-k distinct users with best-vs-second margin, pruned with partial
+    // dot-product bounds (see face_matcher.h). With the ANN index the probed
+    // lists come first; a best candidate above threshold extends the margin
+    // check to the ANN_MARGIN_PROBES closest lists, skipping lists whose
+    // centroid bound cannot come within safeMargin of the best.
+    void matchTopK(const QuantizedEmbedding &probe, int k, float threshold, float safeMargin, FaceMatchResult &result) const;
+
+    // Visit every active user: callback(userIndex, const GalleryUser &)
+    template <typename Callback>
+    void forEachUser(Callback callback) const
+    {
+        for (size_t i = 0; i < userSlots_; i++)
+        {
+            if (users_[i].records > 0)
+                callback((int)i, users_[i]);
+        }
+    }
+
+private:
+    int createUser(const char *name);
+    bool growRecords();
+    bool growUsers();
+    void rebuildDirectory();
+    uint32_t directorySlot(const char *name) const;
+
+    QuantizedEmbedding *embeddings_;
+    EmbeddingBounds *bounds_; // Tail norms per record for early-exit matching
+    uint16_t *recordUser_;
+    size_t recordCount_;
+    size_t recordCapacity_;
+
+    GalleryUser *users_;
+    size_t userSlots_; // Used user slots (active + freed)
+    size_t userCount_; // Active users
+    size_t userCapacity_;
+
+    int16_t *directory_; // Open addressing: user index or -1
+    size_t directorySize_;
+
+    FaceAnnIndex *index_;
+    uint32_t revision_;
+};
+
+#endif // FACE_GALLERY_H
@@ -0,0 +1,79 @@
+// Top-k Face Matcher with early-exit pruning
+// Keeps the k best distinct users for a probe plus the best-vs-second margin,
+// so ambiguous matches can be rejected in the same frame.
+// Scores are accumulated in MATCH_STAGES partial dot products; after each
+// stage a Cauchy-Schwarz bound on the remaining dimensions tells whether the
+// candidate can still matter. Once the best candidate passes the threshold,
+// everything that cannot come within safeMargin of it is dropped early.
+// No Arduino dependency: builds on the host as well.
+#ifndef FACE_MATCHER_H
+#define FACE_MATCHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "face_embedding.h"
+
+#define MATCH_MAX_K 8
+#define MATCH_STAGES 4 // 4 x 128 dims (keeps every partial kernel 16-byte aligned)
+#define MATCH_STAGE_DIM (FACE_EMBEDDING_DIM / MATCH_STAGES)
+
+// Per-record norms of the dimensions after each stage (int8 units)
+struct EmbeddingBounds
+{
+    float tail[MATCH_STAGES - 1]; // tail[s] = ||data[(s + 1) * MATCH_STAGE_DIM ..]||
+};
+
+void computeEmbeddingBounds(const QuantizedEmbedding &embedding, EmbeddingBounds &bounds);
+
+struct FaceCandidate
+{
+    int user;
+    int record;
+    float similarity;
+};
+
+struct FaceMatchResult
+{
+    FaceCandidate top[MATCH_MAX_K]; // Best first, one entry per user
+    int count;
+    float margin;     // best - second best user; exact when compared against safeMargin (pruning only blurs larger margins)
+    uint32_t scored;  // Candidates scored over all dimensions
+    uint32_t pruned;  // Candidates dropped after a partial dot product
+};
+
+class FaceTopK
+{
+public:
+    // threshold/safeMargin enable margin pruning (threshold > 1 disables it)
+    FaceTopK(const QuantizedEmbedding &probe, int k, float threshold, float safeMargin);
+
+    // bounds == nullptr scores the candidate in full (no pruning)
+    void offer(int record, int user, const QuantizedEmbedding &embedding, const EmbeddingBounds *bounds);
+
+    // A group of candidates (e.g. an ANN list) whose scores cannot exceed
+    // upper. True when the group cannot matter and was counted as pruned;
+    // false when its candidates have to be offered.
+    bool skip(float upper, uint32_t candidates);
+
+    void finish(FaceMatchResult &result) const;
+
+    float best() const { return count_ > 0 ? top_[0].similarity : -2.0f; }
+
+private:
+    float cutoff() const;
+    void insert(int record, int user, float similarity);
+
+    const QuantizedEmbedding &probe_;
+    float probeTail_[MATCH_STAGES - 1];
+    int k_;
+    float threshold_;
+    float safeMargin_;
+
+    FaceCandidate top_[MATCH_MAX_K];
+    int count_;
+    float prunedBound_; // Highest upper bound of a pruned candidate of another user
+    uint32_t scored_;
+    uint32_t pruned_;
+};
+
+#endif // FACE_MATCHER_H
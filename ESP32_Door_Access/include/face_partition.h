@@ -0,0 +1,93 @@
+// Memory-Mapped Face Partition
+// Optional read-only snapshot of the gallery in a dedicated flash data
+// partition ("faces", see partitions_faces.csv). The partition is mapped with
+// esp_partition_mmap, so the matcher scans the embeddings in place through the
+// flash cache: no SPIFFS, no File::read, no copies.
+// Host builds map a regular file with mmap(2), so the same matcher code runs
+// (and can be benchmarked) on Linux; the file stands in for the partition
+// and keeps its size.
+#ifndef FACE_PARTITION_H
+#define FACE_PARTITION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "face_embedding.h"
+#include "face_gallery.h"
+#include "face_matcher.h"
+
+#define FACE_PARTITION_VERSION 2 // 2: + per-record tail norms for early-exit matching
+#define FACE_PARTITION_LABEL "faces"
+#define FACE_PARTITION_SUBTYPE 0x40 // Custom data subtype (0x40-0xFE are free for applications)
+
+class FacePartition
+{
+public:
+    FacePartition();
+    ~FacePartition();
+
+    // ESP32: label of the data partition. Host: path of the backing file
+    // (create it with the partition size first, e.g. truncate -s 1M).
+    // Returns false when there is no such partition/file, or it is empty. An empty or invalid
+    // snapshot still opens (valid() == false) so it can be written.
+    bool open(const char *label);
+    void close();
+    bool isOpen() const;
+    bool valid() const { return records_ != nullptr; }
+
+    // Replace the snapshot with the live gallery (erase + write, then remap).
+    // The header is written last, so a power cut leaves an invalid snapshot,
+    // never a half-valid one.
+    bool write(const FaceGallery &gallery);
+
+    // The same write in two steps, for a gallery other tasks may change:
+    // serialize() copies it into a PSRAM image (a memcpy pass, cheap enough
+    // to hold the gallery lock for), write(image) erases and programs flash
+    // from that copy without it. The image is freed with psramFree().
+    static uint8_t *serialize(const FaceGallery &gallery, size_t &size, uint32_t &checksum);
+    bool write(const uint8_t *image, size_t size);
+
+    // Content checksum the snapshot would have for this gallery; equal to
+    // checksum() when the snapshot is up to date
+    static uint32_t galleryChecksum(const FaceGallery &gallery);
+    uint32_t checksum() const { return checksum_; }
+
+    size_t capacity() const { return capacity_; }
+    size_t recordCount() const { return recordCount_; }
+    size_t userCount() const { return userCount_; }
+
+    // In-place access to the mapped snapshot (valid() only)
+    const QuantizedEmbedding &embedding(size_t record) const { return records_[record]; }
+    const char *recordName(size_t record) const { return names_ + recordUser_[record] * FACE_NAME_LEN; }
+    const char *userName(int user) const { return names_ + user * FACE_NAME_LEN; }
+
+    // Brute-force best match over the mapped embeddings. Returns the record or -1.
+    int match(const QuantizedEmbedding &probe, float &similarity) const;
+
+    // Top-k distinct users (FaceCandidate::user indexes userName()), pruned
+    // with the tail norms stored in the snapshot
+    void matchTopK(const QuantizedEmbedding &probe, int k, float threshold, float safeMargin, FaceMatchResult &result) const;
+
+private:
+    bool map();
+    void unmap();
+    bool parse();
+
+    const uint8_t *base_;
+    size_t capacity_;
+    const char *names_;
+    const uint16_t *recordUser_;
+    const QuantizedEmbedding *records_;
+    const EmbeddingBounds *bounds_;
+    size_t recordCount_;
+    size_t userCount_;
+    uint32_t checksum_;
+
+#ifdef ESP_PLATFORM
+    const void *partition_; // const esp_partition_t *
+    uint32_t mapHandle_;    // esp_partition_mmap_handle_t
+#else
+    int fd_;
+#endif
+};
+
+#endif // FACE_PARTITION_H
@@ -0,0 +1,64 @@
+// Region-of-Interest Face Search
+// Once a face has been found, the next frame is searched first in a window
+// around the last face box (ROI_EXPAND x its size); the full frame is only
+// scanned again when the ROI search comes up empty. The detector's cost
+// scales with the pixels it scans, so a person approaching the door costs a
+// fraction of a full-frame pass per frame.
+// No Arduino dependency: builds on the host as well.
+#ifndef FACE_ROI_H
+#define FACE_ROI_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "face_tracker.h"
+
+#define ROI_EXPAND 2.0f            // ROI side = this x the larger face box side
+#define ROI_MIN_SIZE 96            // Never search a window smaller than this (detector pyramid)
+#define ROI_MAX_AREA_FRACTION 0.6f // Larger ROIs are not worth it: scan the full frame
+
+struct FaceRoi
+{
+    int x; // Top-left corner
+    int y;
+    int width;
+    int height;
+};
+
+struct FaceRoiStats
+{
+    uint32_t roiSearches;
+    uint32_t roiHits;
+    uint32_t fullSearches;
+    uint64_t pixelsScanned; // By both kinds of search
+};
+
+class FaceRoiTracker
+{
+public:
+    FaceRoiTracker();
+
+    // Window to search first in the next frame; false = scan the full frame
+    bool next(int frameWidth, int frameHeight, FaceRoi &roi) const;
+
+    // Outcomes (boxes in full-frame coordinates)
+    void roiHit(const FaceBox &box, const FaceRoi &roi);
+    void roiMiss(const FaceRoi &roi);
+    void fullFound(const FaceBox &box, int frameWidth, int frameHeight);
+    void fullMissed(int frameWidth, int frameHeight);
+
+    void reset() { haveFace_ = false; }
+    const FaceRoiStats &stats() const { return stats_; }
+
+private:
+    bool haveFace_;
+    FaceBox last_;
+    FaceRoiStats stats_;
+};
+
+// Copy the ROI out of a packed RGB888 frame (rows of frameWidth * 3 bytes)
+void cropRgb888(const uint8_t *frame, int frameWidth, const FaceRoi &roi, uint8_t *out);
+
+// Face box found inside the ROI (ROI-relative corners) to full-frame coordinates
+FaceBox roiBoxToFrame(const FaceRoi &roi, int left, int top, int right, int bottom);
+
+#endif // FACE_ROI_H
@@ -0,0 +1,89 @@
+// Journaled Face Store
+// Versioned file header + append-only log of enrollments and deletions
+// (tombstones), CRC per record.
+// Replay at boot rebuilds the resident FaceGallery; compaction rewrites only
+// the live templates to a temporary log and swaps it in.
+// Uses stdio on top of the ESP-IDF VFS ("/spiffs/..."), so it also builds on a host.
+#ifndef FACE_STORE_H
+#define FACE_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "face_embedding.h"
+#include "face_gallery.h"
+
+#define FACE_STORE_VERSION 2
+#define FACE_STORE_PATH_LEN 48
+#define FACE_STORE_COMPACT_MIN_DEAD 16384 // Don't compact for less than 16 KB of garbage
+
+enum FaceStoreRecordType : uint8_t
+{
+    STORE_RECORD_ENROLL = 1,    // name + QuantizedEmbedding
+    STORE_RECORD_TOMBSTONE = 2, // name: drop every earlier record of this user
+    STORE_RECORD_COMMIT = 3,    // Written last by compaction (marks a complete log)
+    STORE_RECORD_CLEAR = 4      // Drop every earlier record (clear all faces)
+};
+
+class FaceStore
+{
+public:
+    FaceStore();
+    ~FaceStore();
+
+    // Opens (or recovers) the log at path. Returns false if it cannot be created.
+    bool begin(const char *path);
+    void end();
+    bool exists() const;
+
+    // Rebuild the gallery from the log. A torn or corrupt tail is ignored and
+    // flagged so the next compaction drops it. Returns false (and refuses
+    // further appends) for a journal without a valid header or written by a
+    // newer firmware.
+    bool replay(FaceGallery &gallery);
+    uint16_t version() const { return version_; }
+
+    // Durable appends (flushed + fsync'd before returning)
+    bool appendEnroll(const char *name, const QuantizedEmbedding &embedding);
+    bool appendUser(const FaceGallery &gallery, const char *name); // All templates of a user
+    bool appendTombstone(const char *name);
+    bool appendClear();
+
+    // Compaction: rewrite the live gallery as a fresh log
+    bool needsCompaction(const FaceGallery &gallery) const;
+    bool compact(const FaceGallery &gallery);
+
+    // compact() in three steps, so a caller sharing the gallery only holds
+    // its lock while records are copied, not during the rewrite:
+    //   prepareCompaction  under the lock: live records to a PSRAM image
+    //   writeCompaction    no lock: the image to the temp log (fsync'd)
+    //   finishCompaction   under the lock: appends made since prepare are
+    //                      carried over, then commit and swap the logs
+    // Nothing but appends may touch the store between the steps.
+    uint8_t *prepareCompaction(const FaceGallery &gallery, size_t &size);
+    bool writeCompaction(const uint8_t *image, size_t size);
+    bool finishCompaction();
+
+    size_t fileBytes() const { return fileBytes_; }
+    size_t liveBytes(const FaceGallery &gallery) const;
+    uint32_t corruptRecords() const { return corruptRecords_; }
+
+private:
+    bool writeFileHeader(FILE *f);
+    bool appendRecord(FILE *f, uint8_t type, const uint8_t *payload, uint16_t length);
+    bool syncFile(FILE *f);
+    void recoverCompaction();
+
+    char path_[FACE_STORE_PATH_LEN];
+    char tempPath_[FACE_STORE_PATH_LEN + 4];
+    FILE *file_;
+    size_t fileBytes_;
+    uint32_t sequence_;
+    uint32_t corruptRecords_;
+    uint16_t version_;
+    bool tornTail_;
+    size_t compactMark_;  // fileBytes_ at prepareCompaction()
+    size_t compactBytes_; // Temp log size after writeCompaction(), 0 = not written
+};
+
+#endif // FACE_STORE_H
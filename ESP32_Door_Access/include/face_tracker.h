@@ -0,0 +1,92 @@
+// Face Track Cache
+// Follows the detected face box from frame to frame (IoU continuity) and
+// reuses the last embedding match while the track is stable, so a person
+// standing still for the liveness frames does not cost one recognizer
+// inference per frame. A new face, drift away from the box the embedding
+// was taken on, a refresh deadline or a gallery change forces a fresh
+// inference.
+// Reused matches feed liveness but do not count as confirmations: with
+// TRACK_REFRESH_FRAMES 3 a still face gets a fresh inference every 4th
+// frame, so 3 confirmations take about 9 frames.
+// No Arduino dependency: builds on the host as well.
+#ifndef FACE_TRACKER_H
+#define FACE_TRACKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRACK_MIN_IOU 0.5f       // Below this vs. the previous frame: a different face / new track
+#define TRACK_DRIFT_IOU 0.7f     // Below this vs. the embedded box: re-embed (pose/position drift)
+#define TRACK_REFRESH_FRAMES 3   // Re-embed after this many reused frames
+#define TRACK_REFRESH_MS 3000    // ... or after this long, whichever comes first
+#define TRACK_NAME_LEN 17
+
+struct FaceBox
+{
+    int cx; // Center X
+    int cy; // Center Y
+    int width;
+    int height;
+};
+
+float faceBoxIoU(const FaceBox &a, const FaceBox &b);
+
+enum FaceTrackDecision : uint8_t
+{
+    TRACK_REUSE = 0,   // Cached match is still valid
+    TRACK_NEW = 1,     // No track, or the face jumped: embed
+    TRACK_DRIFT = 2,   // Same track, but moved too far from the embedded box: embed
+    TRACK_REFRESH = 3, // Same track, cache too old (or gallery changed): embed
+};
+
+struct FaceTrackStats
+{
+    uint32_t frames;     // Frames with a face
+    uint32_t inferences; // Frames that ran the recognizer
+    uint32_t reused;     // Frames answered from the cache (= inferences saved)
+    uint32_t tracks;     // Tracks started
+    uint32_t drifts;     // Re-embeds caused by drift
+    uint32_t refreshes;  // Re-embeds caused by the refresh deadline / gallery changes
+};
+
+class FaceTracker
+{
+public:
+    FaceTracker();
+
+    // Feed the box of the current frame. galleryRevision invalidates cached
+    // matches once users are enrolled/deleted. On TRACK_REUSE the cached
+    // result is available through matched()/name()/similarity().
+    FaceTrackDecision update(const FaceBox &box, uint32_t nowMs, uint32_t galleryRevision);
+
+    // Record the result of the inference update() asked for
+    void store(bool matched, const char *name, float similarity);
+
+    // No face in the frame: the track ends
+    void reset() { active_ = false; }
+
+    // Number of the current track: changes whenever a different face is tracked
+    uint32_t track() const { return stats_.tracks; }
+
+    bool matched() const { return matched_; }
+    const char *name() const { return name_; }
+    float similarity() const { return similarity_; }
+    const FaceTrackStats &stats() const { return stats_; }
+
+private:
+    bool active_;
+    bool cached_;
+    FaceBox last_;     // Box of the previous frame
+    FaceBox anchor_;   // Box the cached embedding was taken on
+    uint32_t anchorMs_;
+    uint32_t revision_;
+    uint16_t reusedFrames_;
+
+    bool matched_;
+    char name_[TRACK_NAME_LEN];
+    float similarity_;
+
+    FaceTrackStats stats_;
+};
+
+#endif // FACE_TRACKER_H
@@ -0,0 +1,47 @@
+// Multi-Face Track Set
+// Keeps one FaceTracker per face in view, so every face in a frame has its
+// own track id and cached match. Detected boxes are associated with the
+// existing tracks greedily by IoU; a face that matches no track opens a new
+// one, and tracks without a box in the current frame end. Because each track
+// reuses its cached match until it drifts or needs a refresh, the recognizer
+// only runs for faces that are new or moved, not once per face per frame.
+// No Arduino dependency: builds on the host as well.
+#ifndef FACE_TRACKS_H
+#define FACE_TRACKS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "face_tracker.h"
+
+#define MAX_FACE_TRACKS 4 // Faces followed at once (more are ignored for the frame)
+
+struct FaceTrackSlot
+{
+    bool active;
+    bool seen;       // Matched a box in the current frame
+    uint16_t id;     // Stable for the life of the track (log correlation)
+    FaceBox box;
+    FaceTracker tracker;
+};
+
+class FaceTrackSet
+{
+public:
+    FaceTrackSet();
+
+    // Frame protocol: beginFrame(), assign() per detected box, endFrame()
+    void beginFrame();
+    int assign(const FaceBox &box); // Slot index, -1 when every slot is taken this frame
+    void endFrame();                // Ends the tracks that got no box
+
+    void clear();
+
+    FaceTrackSlot &slot(int index) { return slots_[index]; }
+    size_t activeCount() const;
+
+private:
+    FaceTrackSlot slots_[MAX_FACE_TRACKS];
+    uint16_t nextId_;
+};
+
+#endif // FACE_TRACKS_H
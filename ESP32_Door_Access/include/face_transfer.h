@@ -0,0 +1,144 @@
+// Face Gallery Transfer - streaming export/import format
+// Clones the enrolled gallery (int8 templates + names + metadata) between
+// doors. Both sides work record by record on small fixed buffers, so the
+// whole gallery is never held in RAM. Every frame carries its own CRC and an
+// END frame checksums the complete stream. gallery_tool.py reads and writes
+// the same format on a PC.
+// No Arduino dependency: builds on the host as well.
+#ifndef FACE_TRANSFER_H
+#define FACE_TRANSFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "face_embedding.h"
+#include "face_gallery.h"
+#include "face_directory.h"
+#include "face_store.h"
+
+#define FACE_TRANSFER_VERSION 1
+#define FACE_TRANSFER_MAX_FACES 32 // Templates per user an import can stage (fused users have <= 8)
+
+enum FaceTransferRecordType : uint8_t
+{
+    TRANSFER_RECORD_USER = 1, // name + metadata + number of FACE frames that follow
+    TRANSFER_RECORD_FACE = 2, // One QuantizedEmbedding of the preceding user
+    TRANSFER_RECORD_END = 3   // users, faces, crc32 of every byte before this frame
+};
+
+// Frame: uint8 type | uint8 reserved | uint16 length | payload | uint32 crc32(frame head + payload)
+#define TRANSFER_HEADER_SIZE 16
+#define TRANSFER_FRAME_OVERHEAD 8
+#define TRANSFER_USER_PAYLOAD (FACE_NAME_LEN + 2 * DIRECTORY_FIELD_LEN + DIRECTORY_DATE_LEN + 2)
+#define TRANSFER_FACE_PAYLOAD (FACE_EMBEDDING_DIM + 2 * sizeof(float))
+#define TRANSFER_END_PAYLOAD 12
+#define TRANSFER_MAX_FRAME (TRANSFER_FRAME_OVERHEAD + TRANSFER_FACE_PAYLOAD)
+
+// Pull-side serializer, e.g. for a chunked HTTP response.
+// Caller holds the gallery lock around each read().
+class FaceExporter
+{
+public:
+    FaceExporter();
+    ~FaceExporter();
+
+    // Caller holds the gallery lock. False when the record order does not fit in memory.
+    bool begin(const FaceGallery &gallery, const FaceDirectory *directory);
+
+    // Copy up to maxLen bytes of the stream into buf. Returns 0 once the stream
+    // is complete - or aborted because the gallery changed between calls, in
+    // which case the END frame is never sent and importers reject the stream.
+    size_t read(uint8_t *buf, size_t maxLen);
+
+    bool aborted() const { return aborted_; }
+    uint32_t users() const { return users_; }
+    uint32_t faces() const { return faces_; }
+
+private:
+    bool nextFrame();
+    void frame(uint8_t type, const uint8_t *payload, uint16_t length);
+
+    enum State : uint8_t
+    {
+        EXPORT_HEADER,
+        EXPORT_USER,
+        EXPORT_FACES,
+        EXPORT_END,
+        EXPORT_DONE
+    };
+
+    const FaceGallery *gallery_;
+    const FaceDirectory *directory_;
+    uint32_t revision_;
+    State state_;
+    bool aborted_;
+    size_t userSlot_;
+    uint32_t *order_;     // Record indices grouped by user slot (built by begin())
+    size_t recordCursor_; // Position in order_, one pass over the whole export
+    uint32_t users_;
+    uint32_t faces_;
+    uint32_t crc_; // Running CRC of everything emitted before the END frame
+
+    uint8_t pending_[TRANSFER_MAX_FRAME];
+    size_t pendingLength_;
+    size_t pendingPos_;
+};
+
+// Push-side parser, e.g. fed from an HTTP upload handler chunk by chunk.
+// Users are committed one at a time (gallery + directory + journal) once all
+// of their templates arrived with valid CRCs, so a broken stream never leaves
+// a half-imported user behind. Imported users replace existing ones.
+class FaceImporter
+{
+public:
+    FaceImporter();
+    ~FaceImporter();
+
+    // directory and store may be nullptr (host tools, tests)
+    bool begin(FaceGallery &gallery, FaceDirectory *directory, FaceStore *store);
+    void end();
+
+    // Returns false once the stream is invalid (see error())
+    bool feed(const uint8_t *data, size_t len);
+
+    bool finished() const { return state_ == IMPORT_DONE; }
+    const char *error() const { return error_; }
+    uint32_t users() const { return users_; }
+    uint32_t faces() const { return faces_; }
+
+private:
+    bool fail(const char *error);
+    bool handleFrame();
+    bool commitUser();
+
+    enum State : uint8_t
+    {
+        IMPORT_IDLE,
+        IMPORT_HEADER,
+        IMPORT_FRAME_HEAD,
+        IMPORT_FRAME_BODY,
+        IMPORT_DONE,
+        IMPORT_FAILED
+    };
+
+    FaceGallery *gallery_;
+    FaceDirectory *directory_;
+    FaceStore *store_;
+    State state_;
+    const char *error_;
+    uint32_t users_;
+    uint32_t faces_;
+    uint32_t crc_;
+
+    uint8_t frame_[TRANSFER_MAX_FRAME];
+    size_t frameFill_;
+    size_t frameNeed_;
+
+    // Staged user: committed once `expected_` FACE frames arrived
+    uint8_t user_[TRANSFER_USER_PAYLOAD];
+    bool userOpen_;
+    uint16_t expected_;
+    uint16_t staged_;
+    QuantizedEmbedding *stage_; // FACE_TRANSFER_MAX_FACES entries (PSRAM)
+};
+
+#endif // FACE_TRANSFER_H
@@ -0,0 +1,108 @@
+// Dual-Core Capture / Inference Pipeline
+// Stage 1 (capture core) acquires camera frames and pushes them into a
+// lock-free SPSC queue; stage 2 (inference core) pops the newest frame and
+// runs detection/recognition on it. While frame N is being processed, frame
+// N+1 is already being captured.
+// Stages sit behind FrameSource / FrameProcessor, and the stage loop is
+// plain captureStep() / inferenceStep() calls, so the scheduling can be
+// exercised on a host with std::thread (FreeRTOS tasks on the ESP32).
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "spsc_queue.h"
+
+#ifndef PIPELINE_QUEUE_DEPTH
+#define PIPELINE_QUEUE_DEPTH 1    // Frames in flight between the stages (1 = double buffering)
+#endif
+#define PIPELINE_IDLE_WAIT_MS 20  // Longest nap of an idle stage before re-checking
+#define PIPELINE_CAPTURE_STACK 4096
+#define PIPELINE_INFERENCE_STACK 16384
+
+struct PipelineFrame
+{
+    void *handle;         // Platform frame (camera_fb_t * on the ESP32)
+    uint32_t sequence;    // Capture order
+    uint32_t capturedMs;
+};
+
+class FrameSource
+{
+public:
+    virtual ~FrameSource() {}
+    virtual bool acquire(PipelineFrame &frame) = 0; // May block for the next frame
+    virtual void release(PipelineFrame &frame) = 0; // Hand the buffer back to the driver
+    virtual uint32_t nowMs() = 0;
+};
+
+class FrameProcessor
+{
+public:
+    virtual ~FrameProcessor() {}
+    virtual void process(const PipelineFrame &frame) = 0;
+};
+
+struct PipelineStats
+{
+    uint32_t captured;
+    uint32_t processed;
+    uint32_t dropped;         // Stale frames skipped in favour of a newer one
+    uint32_t captureFailures;
+    uint32_t lastLatencyMs;   // Capture -> end of processing, last frame
+};
+
+class FramePipeline
+{
+public:
+    FramePipeline(FrameSource &source, FrameProcessor &processor);
+    ~FramePipeline();
+
+    // Spawns both stages (FreeRTOS tasks pinned to the given cores, or std::threads)
+    bool start(int captureCore, int inferenceCore);
+    void stop();
+
+    // Stop feeding frames and wait until both stages are idle and the queue is
+    // empty (camera free for someone else). resume() restarts capture.
+    void pause();
+    void resume();
+    bool paused() const { return paused_.load(); }
+
+    // One iteration of each stage. Return false when there was nothing to do.
+    bool captureStep();
+    bool inferenceStep();
+
+    // Stage loops (task/thread bodies started by start())
+    void runCapture();
+    void runInference();
+
+    PipelineStats stats() const;
+
+private:
+    void wakeCapture();
+    void wakeInference();
+    void waitCapture();
+    void waitInference();
+
+    FrameSource &source_;
+    FrameProcessor &processor_;
+    SpscQueue<PipelineFrame, PIPELINE_QUEUE_DEPTH> queue_;
+
+    std::atomic<bool> running_;
+    std::atomic<bool> paused_;
+    std::atomic<bool> captureBusy_;
+    std::atomic<bool> inferenceBusy_;
+    uint32_t sequence_;
+
+    std::atomic<uint32_t> captured_;
+    std::atomic<uint32_t> processed_;
+    std::atomic<uint32_t> dropped_;
+    std::atomic<uint32_t> captureFailures_;
+    std::atomic<uint32_t> lastLatencyMs_;
+
+    struct Platform;
+    Platform *platform_;
+};
+
+#endif // FRAME_PIPELINE_H
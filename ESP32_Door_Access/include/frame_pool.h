@@ -0,0 +1,129 @@
+// Reference-Counted Frame Buffer Pool
+// A fixed set of PSRAM buffers allocated once at boot. A captured frame lives
+// in one pooled buffer and is shared by reference (FrameRef) between the
+// detector, the MJPEG streamer and snapshot readers - no copies, no malloc per
+// frame. The buffer returns to the pool when the last reference goes away.
+// No Arduino dependency: builds on the host as well.
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#endif
+
+#define FRAME_POOL_MAX_BUFFERS 8
+
+class FramePool;
+
+struct FrameBuffer
+{
+    uint8_t *data;
+    size_t capacity;
+    size_t length;
+    uint16_t width;
+    uint16_t height;
+    int format;          // Sensor pixel format (pixformat_t on the ESP32)
+    uint32_t sequence;
+    uint32_t capturedMs;
+
+    std::atomic<int> refs; // 0 = free
+    FramePool *pool;
+};
+
+// Shared reference to a pooled buffer (copy = retain, destroy = release)
+class FrameRef
+{
+public:
+    FrameRef() : buffer_(nullptr) {}
+    FrameRef(const FrameRef &other);
+    FrameRef(FrameRef &&other) : buffer_(other.buffer_) { other.buffer_ = nullptr; }
+    FrameRef &operator=(const FrameRef &other);
+    FrameRef &operator=(FrameRef &&other);
+    ~FrameRef() { reset(); }
+
+    // Takes over a reference that is already counted (see detach())
+    static FrameRef adopt(FrameBuffer *buffer);
+
+    // Gives up ownership without releasing, e.g. to pass it through a queue
+    FrameBuffer *detach();
+
+    void reset();
+    FrameBuffer *get() const { return buffer_; }
+    FrameBuffer *operator->() const { return buffer_; }
+    explicit operator bool() const { return buffer_ != nullptr; }
+
+private:
+    FrameBuffer *buffer_;
+};
+
+struct FramePoolStats
+{
+    uint32_t buffers;
+    uint32_t inUse;
+    uint32_t peakInUse;
+    uint32_t acquired;
+    uint32_t exhausted; // acquire() found every buffer in use (frame dropped)
+    uint32_t oversize;  // Frame larger than a pooled buffer (frame dropped)
+};
+
+class FramePool
+{
+public:
+    FramePool();
+    ~FramePool();
+
+    bool begin(size_t buffers, size_t bufferBytes);
+    void end(); // Only once every reference is gone
+
+    // A free buffer with one reference, or an empty ref when the pool is exhausted
+    FrameRef acquire();
+
+    // Raw counting for handles that travel outside a FrameRef
+    static void retain(FrameBuffer *buffer);
+    static void release(FrameBuffer *buffer);
+
+    void noteOversize() { oversize_++; }
+    size_t bufferBytes() const { return bufferBytes_; }
+    FramePoolStats stats() const;
+
+private:
+    void recycled();
+
+    FrameBuffer buffers_[FRAME_POOL_MAX_BUFFERS];
+    size_t count_;
+    size_t bufferBytes_;
+    std::atomic<uint32_t> inUse_;
+    std::atomic<uint32_t> peakInUse_;
+    std::atomic<uint32_t> acquired_;
+    std::atomic<uint32_t> exhausted_;
+    std::atomic<uint32_t> oversize_;
+};
+
+// Latest published frame, readable from any task. The lock only covers the
+// pointer swap and refcount bump, never a frame copy.
+class FrameSlot
+{
+public:
+    FrameSlot();
+
+    void publish(const FrameRef &frame);
+    FrameRef latest();
+    void clear();
+
+private:
+    void lock();
+    void unlock();
+
+#ifdef ESP_PLATFORM
+    portMUX_TYPE mux_; // Spinning task must not starve a lower-priority holder on the same core
+#else
+    std::atomic<bool> lock_;
+#endif
+    FrameRef frame_;
+};
+
+#endif // FRAME_POOL_H
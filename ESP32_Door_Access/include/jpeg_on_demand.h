@@ -0,0 +1,69 @@
+// JPEG On Demand
+// With raw (RGB565) capture the detector reads pixels directly and no frame
+// is JPEG-decoded on the recognition path. Only the frames somebody actually
+// looks at - the MJPEG stream and /api/snapshot - are encoded, once per
+// captured frame however many viewers share it: the encoded copy is cached
+// (keyed by the raw frame's sequence) in a pooled buffer of its own.
+// Frames that already are JPEG pass through untouched.
+// The encoder is a callback (fmt2jpg_cb on the ESP32), so the cache logic
+// builds on the host as well.
+#ifndef JPEG_ON_DEMAND_H
+#define JPEG_ON_DEMAND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "frame_pool.h"
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#else
+#include <mutex>
+#endif
+
+// Encode raw into out->data (out->capacity bytes); sets out->length.
+// false = encoder error or the JPEG does not fit.
+typedef bool (*JpegEncodeFn)(const FrameBuffer &raw, FrameBuffer &out, void *context);
+
+struct JpegCacheStats
+{
+    uint32_t encoded;  // Frames encoded
+    uint32_t reused;   // Requests served from the cached encoding
+    uint32_t failures; // Encoder errors or no free JPEG buffer
+    uint32_t lastEncodeBytes;
+};
+
+class JpegFrameCache
+{
+public:
+    // jpegFormat: the pixel format value that marks a frame as JPEG already
+    JpegFrameCache(FramePool &pool, int jpegFormat, JpegEncodeFn encode, void *context);
+
+    bool begin();
+
+    // JPEG version of `raw` (same sequence / timestamp), or an empty ref.
+    // Thread-safe; concurrent callers for the same frame share one encoding.
+    FrameRef jpeg(const FrameRef &raw);
+
+    void clear(); // Drop the cached encoding
+    JpegCacheStats stats() const { return stats_; }
+
+private:
+    void lock();
+    void unlock();
+
+    FramePool &pool_;
+    int jpegFormat_;
+    JpegEncodeFn encode_;
+    void *context_;
+    FrameRef cached_;
+    JpegCacheStats stats_;
+
+#ifdef ESP_PLATFORM
+    SemaphoreHandle_t mutex_; // Held across an encode - callers are tasks, not ISRs
+#else
+    std::mutex mutex_;
+#endif
+};
+
+#endif // JPEG_ON_DEMAND_H
@@ -0,0 +1,58 @@
+// Chunked JSON Array Stream
+// Feeds a chunked HTTP response with a JSON array whose elements are
+// serialized one at a time, when the response asks for more bytes, straight
+// from their source (SD log, name directory, directory listing, scan results).
+// Only the element being sent is held, so peak memory does not grow with the
+// number of elements. An element that does not fit into the response buffer
+// is carried over to the next call.
+// No Arduino dependency: builds on the host as well.
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_STREAM_ELEMENT_MAX 256 // Longest element; longer ones are dropped (counted)
+
+// Writes the next element (without separator) into out and returns its
+// length; capacity or more = it did not fit. 0 = no more elements.
+typedef size_t (*JsonElementFn)(void *context, char *out, size_t capacity);
+
+class JsonArrayStream
+{
+public:
+    // open / close wrap the elements, e.g. "{\"networks\":[" and "]}"; must be literals
+    JsonArrayStream(JsonElementFn next, void *context, const char *open = "[", const char *close = "]");
+
+    // Chunked response filler: fills up to maxLen bytes, 0 = response complete
+    size_t read(uint8_t *buffer, size_t maxLen);
+
+    bool done() const { return stage_ == DONE && pendingPos_ == pendingLen_; }
+    uint32_t elements() const { return elements_; }
+    uint32_t dropped() const { return dropped_; }
+
+private:
+    bool load();
+
+    enum Stage
+    {
+        OPEN,
+        ELEMENTS,
+        CLOSE,
+        DONE
+    };
+
+    JsonElementFn next_;
+    void *context_;
+    const char *open_;
+    const char *close_;
+    Stage stage_;
+    const char *pending_; // Bytes still to send: element_ or open_ / close_
+    size_t pendingLen_;
+    size_t pendingPos_;
+    uint32_t elements_;
+    uint32_t dropped_;
+    char element_[JSON_STREAM_ELEMENT_MAX + 1]; // + separator
+};
+
+#endif // JSON_STREAM_H
@@ -0,0 +1,86 @@
+// Fixed-Buffer JSON Writer
+// Serializes an API reply into a caller-provided buffer (a stack array in
+// the HTTP handlers) without touching the heap: no String concatenation and
+// no temporaries. Field names must be string literals - their length is a
+// compile-time constant and they are copied as-is - while every string value
+// (user names, SSIDs, ...) is escaped. Commas are placed from a bit stack of
+// the open containers.
+// On overflow the writer stops writing and ok() turns false; the buffer
+// stays NUL-terminated but does not hold valid JSON.
+// No Arduino dependency: builds on the host as well.
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_WRITER_MAX_DEPTH 16
+
+class JsonWriter
+{
+public:
+    JsonWriter(char *buffer, size_t capacity);
+
+    // Containers: a top-level value / array element, or a field of the enclosing object
+    JsonWriter &beginObject() { return open('{'); }
+    JsonWriter &beginArray() { return open('['); }
+    template <size_t N>
+    JsonWriter &beginObject(const char (&name)[N]) { return key(name, N - 1).open('{'); }
+    template <size_t N>
+    JsonWriter &beginArray(const char (&name)[N]) { return key(name, N - 1).open('['); }
+    JsonWriter &endObject() { return close('}'); }
+    JsonWriter &endArray() { return close(']'); }
+
+    // Fields of the enclosing object; the value is written by value() below
+    template <size_t N, typename T>
+    JsonWriter &field(const char (&name)[N], T v) { return key(name, N - 1).value(v); }
+    template <size_t N>
+    JsonWriter &field(const char (&name)[N], double v, int decimals) { return key(name, N - 1).value(v, decimals); }
+    template <size_t N>
+    JsonWriter &fieldNull(const char (&name)[N]) { return key(name, N - 1).null(); }
+
+    // Array elements
+    JsonWriter &value(const char *s); // Escaped; nullptr = null
+    JsonWriter &value(bool v);
+    JsonWriter &value(int v) { return value((long long)v); }
+    JsonWriter &value(long v) { return value((long long)v); }
+    JsonWriter &value(long long v);
+    JsonWriter &value(unsigned v) { return value((unsigned long long)v); }
+    JsonWriter &value(unsigned long v) { return value((unsigned long long)v); }
+    JsonWriter &value(unsigned long long v);
+    JsonWriter &value(double v, int decimals = 2); // NaN / infinity = null
+    JsonWriter &null();
+
+    // A string value assembled from pieces, e.g. "Enrolling step 2/5"
+    template <size_t N>
+    JsonWriter &beginString(const char (&name)[N]) { return key(name, N - 1).openString(); }
+    JsonWriter &append(const char *text); // Escaped
+    JsonWriter &append(const char *text, size_t len);
+    JsonWriter &append(long long v);
+    JsonWriter &endString();
+
+    bool ok() const { return !overflow_; }
+    const char *c_str() const { return buffer_; }
+    size_t length() const { return length_; }
+
+private:
+    JsonWriter &key(const char *name, size_t len);
+    JsonWriter &open(char bracket);
+    JsonWriter &close(char bracket);
+    JsonWriter &openString();
+    void separate();
+    void put(char c);
+    void put(const char *s, size_t n);
+    void putEscaped(const char *s, size_t n);
+    void putUnsigned(unsigned long long v);
+
+    char *buffer_;
+    size_t capacity_; // Usable bytes, the terminator excluded
+    size_t length_;
+    bool overflow_;
+    bool afterKey_;   // The next value belongs to the key just written
+    uint8_t depth_;
+    uint32_t filled_; // Bit d: container at depth d already has an element
+};
+
+#endif // JSON_WRITER_H
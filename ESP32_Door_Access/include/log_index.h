@@ -0,0 +1,135 @@
+// Access Log Block Index
+// Summary of every LOG_INDEX_BLOCK consecutive events of the AccessLog ring:
+// min/max timestamp, a bitmask of the actions seen and a 64-bit user bitmap
+// (bit = hash(user) % 64). A query walks the ring newest first and skips
+// every block whose summary rules it out, so a filtered search over months
+// of history reads only the blocks that can contain a match.
+// The summaries live in PSRAM, are kept current by the log itself (observer)
+// and are saved next to the log on every sync; on boot only the events
+// appended after the last save are re-read.
+// Uses stdio on top of the ESP-IDF VFS ("/sdcard/..."), so it also builds on a host.
+#ifndef LOG_INDEX_H
+#define LOG_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "access_log.h"
+
+#define LOG_INDEX_VERSION 1
+#define LOG_INDEX_BLOCK 256       // Events per summary (must divide the ring capacity)
+#define LOG_QUERY_MAX_SCAN 4096   // Events read per request at most; the cursor resumes
+#define LOG_QUERY_CHUNK 16        // Records per SD read of a query
+
+struct LogBlockSummary
+{
+    uint32_t baseSequence; // First event of the block, 0 = empty
+    uint32_t minTimestamp;
+    uint32_t maxTimestamp;
+    uint16_t actionMask;   // 1 << AccessAction
+    uint64_t userBits;
+    bool dirty;
+};
+
+uint64_t logUserBit(const char *user);
+
+class AccessLogIndex : public AccessLogObserver
+{
+public:
+    AccessLogIndex();
+    ~AccessLogIndex();
+
+    // Loads path (or rebuilds it from the log) and attaches to the log
+    bool begin(AccessLog &log, const char *path);
+    void end();
+
+    // Could block holding baseSequence contain a match? Unknown blocks: true.
+    bool mayMatch(uint32_t baseSequence, uint32_t since, uint32_t until, uint16_t actionMask, uint64_t userBit);
+
+    void appended(const AccessLogRecord *records, size_t count) override;
+    void synced() override;
+
+    uint32_t blockCount() const { return blockCount_; }
+    uint32_t rebuiltRecords() const { return rebuiltRecords_; }
+
+private:
+    bool load();
+    void note(const AccessLogRecord &record);
+    bool save();
+    void catchUp(AccessLog &log, uint32_t from);
+
+    char path_[ACCESS_LOG_PATH_LEN];
+    FILE *file_;
+    LogBlockSummary *blocks_;
+    uint32_t blockCount_;
+    uint32_t capacity_;
+    uint32_t coveredNext_; // Every event below this is in the summaries
+    uint32_t rebuiltRecords_;
+
+#ifdef ESP_PLATFORM
+    SemaphoreHandle_t mutex_;
+#else
+    std::mutex mutex_;
+#endif
+    void lock();
+    void unlock();
+};
+
+struct AccessLogQuery
+{
+    uint32_t since;      // Timestamp range, inclusive
+    uint32_t until;
+    const char *user;    // nullptr = any
+    uint16_t actionMask; // 0 = any
+    uint32_t cursor;     // Only events below this sequence; 0 = from the newest
+    size_t limit;
+};
+
+struct AccessLogPage
+{
+    size_t count;
+    uint32_t nextCursor;    // Pass back as cursor for the next page, 0 = no more
+    uint32_t scanned;       // Events read
+    uint32_t skippedBlocks; // Ruled out by their summary
+};
+
+// One page of a query, produced a record at a time so a response can stream
+// it without holding the page in memory. query.user must outlive the scan.
+class AccessLogScan
+{
+public:
+    AccessLogScan(AccessLog &log, AccessLogIndex &index, const AccessLogQuery &query);
+
+    // Next match, newest first; false = the page is complete
+    bool next(AccessLogRecord &record);
+
+    // Start the same page over. After a complete pass the replay ends where
+    // that pass ended and reads only the chunks it read, so a caller can
+    // learn page().nextCursor first and stream the records second.
+    void rewind();
+
+    const AccessLogPage &page() const { return page_; }
+
+private:
+    bool fill();
+
+    AccessLog &log_;
+    AccessLogIndex &index_;
+    AccessLogQuery query_;
+    uint64_t userBit_;
+    uint32_t oldest_;
+    uint32_t start_;   // Exclusive upper bound of the page
+    uint32_t seq_;     // Everything at or above has been read
+    uint32_t stop_;    // Replay: where the first pass stopped reading
+    size_t limit_;
+    bool replaying_;
+    AccessLogRecord chunk_[LOG_QUERY_CHUNK];
+    uint32_t chunkPos_; // Unconsumed records of chunk_, consumed from the top
+    AccessLogPage page_;
+};
+
+// Newest first, at most min(limit, capacity of out) events
+AccessLogPage queryAccessLog(AccessLog &log, AccessLogIndex &index, const AccessLogQuery &query,
+                             AccessLogRecord *out, size_t outCapacity);
+
+#endif // LOG_INDEX_H
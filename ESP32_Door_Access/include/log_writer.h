@@ -0,0 +1,86 @@
+// Group-Commit Access Log Writer
+// logActivity() only pushes the event into a bounded lock-free queue and
+// returns; a background task drains the queue into the AccessLog ring. All
+// events that arrive within one flush interval are written with a single
+// file write and one fsync. Critical events (ACCESS_GRANTED, ...) wake the
+// task at once, so they are on the card within one write, not one interval.
+// A full queue drops the event (counted) instead of stalling recognition.
+// FreeRTOS task on the ESP32, std::thread on the host.
+#ifndef LOG_WRITER_H
+#define LOG_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "access_log.h"
+
+#define LOG_QUEUE_DEPTH 64          // Power of two
+#define LOG_BATCH_MAX 32            // Records per file write
+#define LOG_FLUSH_INTERVAL_MS 1000  // Longest a non-critical event waits for the card
+#define LOG_WRITER_STACK 6144       // Batch on the stack + FATFS
+
+struct LogWriterStats
+{
+    uint32_t queued;
+    uint32_t written;
+    uint32_t dropped;       // Queue full (or log unavailable)
+    uint32_t failed;        // Lost to a failed SD write
+    uint32_t batches;
+    uint32_t lastBatch;
+    uint32_t largestBatch;
+    uint32_t depth;         // Events waiting right now
+    uint32_t peakDepth;
+};
+
+class LogWriter
+{
+public:
+    explicit LogWriter(AccessLog &log, uint32_t flushIntervalMs = LOG_FLUSH_INTERVAL_MS);
+    ~LogWriter();
+
+    bool start(int core);
+    void stop(); // Writes whatever is still queued
+
+    // Any task, never blocks. critical = flush now instead of at the interval.
+    bool push(const AccessLogRecord &record, bool critical);
+
+    // One group commit: drains up to LOG_BATCH_MAX events. Called by the
+    // task; call it directly only while the task is not running.
+    size_t flush();
+
+    void run(); // Task body
+    LogWriterStats stats() const;
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> turn; // Vyukov bounded queue: whose turn the slot is
+        AccessLogRecord record;
+    };
+
+    bool pop(AccessLogRecord &record);
+    void wake();
+    void waitMs(uint32_t ms);
+
+    AccessLog &log_;
+    uint32_t flushIntervalMs_;
+    Slot slots_[LOG_QUEUE_DEPTH];
+    std::atomic<size_t> enqueuePos_;
+    std::atomic<size_t> dequeuePos_;
+    std::atomic<bool> running_;
+    std::atomic<bool> urgent_;
+
+    std::atomic<uint32_t> queued_;
+    std::atomic<uint32_t> written_;
+    std::atomic<uint32_t> dropped_;
+    std::atomic<uint32_t> failed_;
+    std::atomic<uint32_t> batches_;
+    std::atomic<uint32_t> lastBatch_;
+    std::atomic<uint32_t> largestBatch_;
+    std::atomic<uint32_t> peakDepth_;
+
+    struct Platform;
+    Platform *platform_;
+};
+
+#endif // LOG_WRITER_H
@@ -0,0 +1,77 @@
+// Multi-Client MJPEG Fan-Out
+// Serves the latest pooled frame to several stream clients without ever
+// blocking on one of them: every client owns a reference to the frame it is
+// currently sending plus a byte offset, and pump() only writes what each
+// socket accepts right now. A client that is still busy with an old frame
+// simply skips the frames captured meanwhile (counted as dropped).
+// Sockets sit behind StreamSink, so the fan-out runs on the host as well.
+#ifndef MJPEG_FANOUT_H
+#define MJPEG_FANOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "frame_pool.h"
+
+#define MJPEG_MAX_CLIENTS 3
+#define MJPEG_HEADER_MAX 256
+
+class StreamSink
+{
+public:
+    virtual ~StreamSink() {}
+    // Bytes taken without blocking (0 = send buffer full), -1 = connection gone
+    virtual int send(const uint8_t *data, size_t len) = 0;
+    virtual void close() = 0;
+};
+
+struct MjpegStats
+{
+    uint32_t clients;
+    uint32_t accepted;
+    uint32_t rejected;      // Turned away, all client slots busy
+    uint32_t framesSent;
+    uint32_t framesDropped; // Frames a client skipped because it was still sending an older one
+};
+
+class MjpegFanout
+{
+public:
+    explicit MjpegFanout(const char *boundary);
+    ~MjpegFanout();
+
+    // Takes ownership of the sink (deleted once the client goes away).
+    // Returns false - and closes/deletes the sink - when every slot is busy.
+    bool add(StreamSink *sink);
+
+    // Write as much as every socket takes; clients that finished their frame
+    // move on to `latest` if it is newer
+    void pump(const FrameRef &latest);
+
+    void closeAll();
+    size_t clientCount() const { return count_; }
+    MjpegStats stats() const;
+
+private:
+    struct Client
+    {
+        StreamSink *sink;
+        FrameRef frame;
+        char header[MJPEG_HEADER_MAX];
+        size_t headerLen;
+        size_t offset;         // Into header, then into the frame data
+        uint32_t lastSequence; // 0 = nothing sent yet
+    };
+
+    bool flush(Client &client); // false = connection gone
+    void drop(size_t index);
+
+    const char *boundary_;
+    Client clients_[MJPEG_MAX_CLIENTS];
+    size_t count_;
+    uint32_t accepted_;
+    uint32_t rejected_;
+    uint32_t framesSent_;
+    uint32_t framesDropped_;
+};
+
+#endif // MJPEG_FANOUT_H
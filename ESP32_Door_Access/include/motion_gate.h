@@ -0,0 +1,83 @@
+// Motion Gate
+// Cheap pre-filter in front of the face detector: a heavily downscaled
+// grayscale thumbnail of each frame is compared with the previous one, and
+// the detector only runs when enough pixels changed. An empty corridor then
+// costs a 1/8-scale JPEG decode (or a block average of a raw frame) plus a
+// ~1k pixel difference per frame instead of a full detector pass.
+// replayMotionGate() runs the gate over a recorded (labelled) sequence and
+// reports the skip rate and how many arrivals it would have missed.
+// No Arduino dependency: builds on the host as well.
+#ifndef MOTION_GATE_H
+#define MOTION_GATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MOTION_THUMB_MAX_PIXELS (64 * 64)
+#define MOTION_PIXEL_DELTA 24       // Gray levels a pixel must change by to count
+#define MOTION_CHANGED_FRACTION 0.02f // Fraction of changed pixels that counts as motion
+#define MOTION_ARRIVAL_WINDOW 5     // Frames after an arrival the gate may take to fire
+
+// Big-endian RGB565 (esp32-camera jpg2rgb565 output) to 8-bit luma
+void rgb565beToGray(const uint8_t *rgb565, uint8_t *gray, size_t pixels);
+
+// Raw big-endian RGB565 frame to a gray thumbnail, averaging divisor x
+// divisor blocks (partial blocks at the right/bottom edge included). The
+// thumbnail is ceil(width / divisor) x ceil(height / divisor).
+void downscaleRgb565beToGray(const uint8_t *rgb565, int width, int height, int divisor, uint8_t *gray);
+
+// Number of pixels whose absolute difference exceeds delta
+size_t countChangedPixels(const uint8_t *a, const uint8_t *b, size_t pixels, uint8_t delta);
+
+struct MotionGateConfig
+{
+    uint8_t pixelDelta;
+    float changedFraction;
+};
+
+struct MotionGateStats
+{
+    uint32_t frames;
+    uint32_t motion;        // Frames let through to the detector
+    uint32_t lastChanged;   // Changed pixels in the last comparison
+};
+
+class MotionGate
+{
+public:
+    explicit MotionGate(const MotionGateConfig &config);
+
+    // Compare with the previous thumbnail and keep this one as the reference.
+    // The first frame (or a size change) always counts as motion.
+    bool update(const uint8_t *gray, int width, int height);
+
+    // Forget the reference, e.g. after the gate was bypassed for a while
+    void reset() { pixels_ = 0; }
+
+    const MotionGateStats &stats() const { return stats_; }
+
+private:
+    MotionGateConfig config_;
+    uint8_t reference_[MOTION_THUMB_MAX_PIXELS];
+    size_t pixels_;
+    MotionGateStats stats_;
+};
+
+// ==================== REPLAY ====================
+
+struct MotionReplayResult
+{
+    uint32_t frames;
+    uint32_t skipped;        // Frames the detector would not have seen
+    uint32_t arrivals;       // Empty -> occupied transitions in the labels
+    uint32_t missedArrivals; // Arrivals with no motion within MOTION_ARRIVAL_WINDOW frames
+    float skipRate;
+    float missedArrivalRate;
+};
+
+// frames: count gray thumbnails of width x height, back to back.
+// occupied: ground truth per frame (someone in view).
+void replayMotionGate(const MotionGateConfig &config, const uint8_t *frames, const bool *occupied,
+                      size_t count, int width, int height, MotionReplayResult &result);
+
+#endif // MOTION_GATE_H
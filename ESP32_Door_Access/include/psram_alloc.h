@@ -0,0 +1,37 @@
+// PSRAM Allocation Helpers
+// ESP32: large buffers go to external PSRAM (heap_caps)
+// Host builds: plain aligned heap allocation
+#ifndef PSRAM_ALLOC_H
+#define PSRAM_ALLOC_H
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#endif
+
+inline void *psramAlloc(size_t size, size_t align = 16)
+{
+    if (size == 0)
+        return nullptr;
+#ifdef ESP_PLATFORM
+    return heap_caps_aligned_alloc(align, size, MALLOC_CAP_SPIRAM);
+#else
+    void *p = nullptr;
+    return posix_memalign(&p, align < sizeof(void *) ? sizeof(void *) : align, size) == 0 ? p : nullptr;
+#endif
+}
+
+inline void psramFree(void *p)
+{
+    if (!p)
+        return;
+#ifdef ESP_PLATFORM
+    heap_caps_free(p);
+#else
+    free(p);
+#endif
+}
+
+#endif // PSRAM_ALLOC_H
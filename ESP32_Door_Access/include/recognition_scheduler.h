@@ -0,0 +1,95 @@
+// Adaptive Recognition Scheduler
+// Decides which pipeline frames get a detector run. While a face is in view
+// the detector runs at the active rate (every frame by default); once the
+// scene has been empty for a while the interval backs off exponentially to
+// the idle rate. simulateScheduler() replays a person walking up to the door
+// against a policy and reports time-to-unlock and inference duty cycle.
+// No Arduino dependency: builds on the host as well.
+#ifndef RECOGNITION_SCHEDULER_H
+#define RECOGNITION_SCHEDULER_H
+
+#include <stdint.h>
+
+#define SCHEDULER_BACKOFF_START_MS 100 // First idle interval after the linger time (adaptive)
+#define SCHEDULER_SIM_PHASES 8         // Arrival phases averaged by simulateScheduler()
+#define SCHEDULER_NEVER 0xFFFFFFFFu
+
+enum SchedulePolicy
+{
+    SCHEDULE_FIXED = 0,   // One run every idleIntervalMs, face or not (legacy 1 s polling)
+    SCHEDULE_ADAPTIVE,    // Active rate while a face is present, backs off to idleIntervalMs
+    SCHEDULE_EVERY_FRAME, // Every pipeline frame
+    SCHEDULE_POLICY_COUNT
+};
+
+const char *schedulePolicyName(SchedulePolicy policy);
+bool parseSchedulePolicy(const char *name, SchedulePolicy &policy);
+
+struct SchedulerConfig
+{
+    SchedulePolicy policy;
+    uint32_t activeIntervalMs; // Between runs while a face is present (0 = every frame)
+    uint32_t idleIntervalMs;   // Slowest rate with an empty scene
+    uint32_t lingerMs;         // Keep the active rate this long after the last face
+};
+
+struct SchedulerStats
+{
+    uint32_t runs;
+    uint32_t faceRuns;
+    uint32_t skipped; // Frames that were not due
+};
+
+class RecognitionScheduler
+{
+public:
+    explicit RecognitionScheduler(const SchedulerConfig &config);
+
+    void configure(const SchedulerConfig &config);
+    const SchedulerConfig &config() const { return config_; }
+
+    // Should this frame get a detector run? (Frames that are not due count as skipped)
+    bool due(uint32_t nowMs);
+
+    // Outcome of the run started at nowMs
+    void ran(uint32_t nowMs, bool faceFound);
+
+    uint32_t intervalMs() const { return interval_; }
+    bool active() const { return interval_ == config_.activeIntervalMs && config_.policy == SCHEDULE_ADAPTIVE; }
+    const SchedulerStats &stats() const { return stats_; }
+
+private:
+    SchedulerConfig config_;
+    uint32_t interval_;
+    uint32_t lastRunMs_;
+    uint32_t lastFaceMs_;
+    bool hasRun_;
+    bool seenFace_;
+    SchedulerStats stats_;
+};
+
+// ==================== SIMULATION ====================
+
+struct SchedulerScenario
+{
+    uint32_t frameIntervalMs; // Camera frame period
+    uint32_t detectMs;        // Detector run on a frame
+    uint32_t recognizeMs;     // Extra work when a face is found (embedding + matching)
+    uint32_t runsToUnlock;    // Consecutive face runs before the door opens (confirmations / liveness history)
+    uint32_t arrivalMs;       // Person appears this long after the scene went empty
+};
+
+struct SchedulerSimResult
+{
+    uint32_t meanUnlockMs;  // Arrival -> door opens, averaged over SCHEDULER_SIM_PHASES arrival phases
+    uint32_t worstUnlockMs;
+    float idleDutyCycle;    // Inference core busy fraction with an empty scene
+    float activeDutyCycle;  // Busy fraction between arrival and unlock
+};
+
+// Single inference core fed by the pipeline: a frame that arrives while the
+// core is busy replaces the waiting one, and the core picks the newest frame
+// as soon as it is free.
+SchedulerSimResult simulateScheduler(const SchedulerConfig &config, const SchedulerScenario &scenario);
+
+#endif // RECOGNITION_SCHEDULER_H
@@ -0,0 +1,51 @@
+// Lock-free Single-Producer / Single-Consumer Queue
+// Fixed capacity ring with monotonically increasing head/tail counters.
+// One task may push, one (other) task may pop - no locks, no allocation.
+// std::atomic only, so the same header runs under FreeRTOS and std::thread.
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+#include <atomic>
+
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+public:
+    SpscQueue() : head_(0), tail_(0) {}
+
+    // Producer side. Returns false when full.
+    bool push(const T &item)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) == Capacity)
+            return false;
+        slots_[tail % Capacity] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false when empty.
+    bool pop(T &item)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+        item = slots_[head % Capacity];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Snapshots - exact only on the calling side
+    size_t size() const { return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+    bool full() const { return size() == Capacity; }
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    T slots_[Capacity];
+    std::atomic<size_t> head_; // Next slot to pop (consumer owned)
+    std::atomic<size_t> tail_; // Next slot to push (producer owned)
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,413 @@
+/**
+ * Access Log Ring
+ *
+ * File layout (little endian):
+ *   header copy 0 (32 bytes) | header copy 1 (32 bytes) | record slots
+ *
+ * Header copy:
+ *   uint32 magic "ALOG" | uint16 version | uint16 record size |
+ *   uint32 capacity | uint32 first sequence | uint32 next sequence |
+ *   uint32 generation | uint32 reserved | uint32 crc32(copy[0..27])
+ * Updates alternate between the two copies (generation & 1), so a torn
+ * header write always leaves the previous copy intact.
+ *
+ * Record slot (64 bytes):
+ *   uint16 magic (0xA10C) | uint8 action | uint8 success | uint32 sequence |
+ *   uint32 timestamp | float confidence | char user[32] | 12 reserved |
+ *   uint32 crc32(slot[0..59])
+ *
+ * The header is only rewritten every ACCESS_LOG_HEADER_INTERVAL appends (and
+ * on clear/end). begin() rolls forward from the header's next sequence over
+ * every slot that holds a valid record with exactly the expected sequence -
+ * a slot still holding the record from one lap earlier stops the scan.
+ */
+
+#include "access_log.h"
+#include "crc32.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#define LOG_FILE_MAGIC 0x474F4C41 // "ALOG"
+#define LOG_HEADER_SIZE 32
+#define LOG_HEADERS_BYTES (2 * LOG_HEADER_SIZE)
+#define LOG_RECORD_MAGIC 0xA10C
+#define LOG_RECORD_SIZE 64
+
+static const char *const ACTION_NAMES[ACCESS_ACTION_COUNT] = {
+    "OTHER",
+    "ACCESS_GRANTED",
+    "DENIED_LOW_CONFIDENCE",
+    "DENIED_LIVENESS_FAIL",
+    "DENIED_NOT_ENROLLED",
+    "FACE_IN_VIEW",
+    "TAILGATING_SUSPECTED",
+};
+
+bool accessActionLookup(const char *name, AccessAction &action)
+{
+    for (int i = 0; i < ACCESS_ACTION_COUNT; i++)
+    {
+        if (strcmp(name, ACTION_NAMES[i]) == 0)
+        {
+            action = static_cast<AccessAction>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+AccessAction accessActionCode(const char *name)
+{
+    AccessAction action;
+    return accessActionLookup(name, action) ? action : ACCESS_ACTION_OTHER;
+}
+
+const char *accessActionName(uint8_t code)
+{
+    return code < ACCESS_ACTION_COUNT ? ACTION_NAMES[code] : ACTION_NAMES[ACCESS_ACTION_OTHER];
+}
+
+static void putU16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void putU32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = (v >> (8 * i)) & 0xFF;
+}
+
+static uint16_t getU16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t getU32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+AccessLog::AccessLog(uint32_t capacity)
+    : file_(nullptr), capacity_(capacity), firstSequence_(1), nextSequence_(1),
+      headerGeneration_(0), appendsSinceHeader_(0), corruptRecords_(0), observer_(nullptr)
+{
+    path_[0] = '\0';
+#ifdef ESP_PLATFORM
+    mutex_ = nullptr;
+#endif
+}
+
+AccessLog::~AccessLog()
+{
+    end();
+}
+
+#ifdef ESP_PLATFORM
+
+void AccessLog::lock() { xSemaphoreTake(mutex_, portMAX_DELAY); }
+void AccessLog::unlock() { xSemaphoreGive(mutex_); }
+
+#else
+
+void AccessLog::lock() { mutex_.lock(); }
+void AccessLog::unlock() { mutex_.unlock(); }
+
+#endif
+
+bool AccessLog::begin(const char *path)
+{
+#ifdef ESP_PLATFORM
+    if (!mutex_)
+        mutex_ = xSemaphoreCreateMutex();
+    if (!mutex_)
+        return false;
+#endif
+    end();
+    strncpy(path_, path, sizeof(path_) - 1);
+    path_[sizeof(path_) - 1] = '\0';
+
+    file_ = fopen(path_, "r+b");
+    if (file_)
+        setvbuf(file_, nullptr, _IOFBF, ACCESS_LOG_IO_BUFFER);
+    if (file_ && readHeader())
+    {
+        // Roll forward over records appended after the last header update
+        AccessLogRecord record;
+        uint32_t recovered = 0;
+        while (recovered < capacity_ && readRecord(nextSequence_, record))
+        {
+            nextSequence_++;
+            recovered++;
+        }
+        return true;
+    }
+
+    // New (or unreadable) ring: start over
+    if (file_)
+        fclose(file_);
+    file_ = fopen(path_, "w+b");
+    if (!file_)
+        return false;
+    setvbuf(file_, nullptr, _IOFBF, ACCESS_LOG_IO_BUFFER);
+    firstSequence_ = 1;
+    nextSequence_ = 1;
+    headerGeneration_ = 0;
+    if (!writeHeader() || !writeHeader() || !syncLocked()) // Both copies valid
+    {
+        end();
+        return false;
+    }
+    return true;
+}
+
+void AccessLog::end()
+{
+    if (file_)
+    {
+        if (appendsSinceHeader_)
+            writeHeader();
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+bool AccessLog::readHeader()
+{
+    uint8_t copies[LOG_HEADERS_BYTES];
+    if (fseek(file_, 0, SEEK_SET) != 0 || fread(copies, 1, sizeof(copies), file_) != sizeof(copies))
+        return false;
+
+    const uint8_t *best = nullptr;
+    for (int i = 0; i < 2; i++)
+    {
+        const uint8_t *h = copies + i * LOG_HEADER_SIZE;
+        if (getU32(h) != LOG_FILE_MAGIC || getU32(h + 28) != crc32Update(0, h, 28))
+            continue;
+        if (getU16(h + 4) > ACCESS_LOG_VERSION || getU16(h + 6) != LOG_RECORD_SIZE || getU32(h + 8) == 0)
+            continue;
+        if (!best || (int32_t)(getU32(h + 20) - getU32(best + 20)) > 0)
+            best = h;
+    }
+    if (!best)
+        return false;
+
+    capacity_ = getU32(best + 8);
+    firstSequence_ = getU32(best + 12);
+    nextSequence_ = getU32(best + 16);
+    headerGeneration_ = getU32(best + 20);
+    appendsSinceHeader_ = 0;
+    return true;
+}
+
+bool AccessLog::writeHeader()
+{
+    headerGeneration_++;
+    uint8_t h[LOG_HEADER_SIZE] = {0};
+    putU32(h, LOG_FILE_MAGIC);
+    putU16(h + 4, ACCESS_LOG_VERSION);
+    putU16(h + 6, LOG_RECORD_SIZE);
+    putU32(h + 8, capacity_);
+    putU32(h + 12, firstSequence_);
+    putU32(h + 16, nextSequence_);
+    putU32(h + 20, headerGeneration_);
+    putU32(h + 28, crc32Update(0, h, 28));
+
+    if (fseek(file_, (headerGeneration_ & 1) * LOG_HEADER_SIZE, SEEK_SET) != 0 ||
+        fwrite(h, 1, LOG_HEADER_SIZE, file_) != LOG_HEADER_SIZE)
+        return false;
+    appendsSinceHeader_ = 0;
+    return true;
+}
+
+static void encodeRecord(uint8_t *slot, const AccessLogRecord &record)
+{
+    memset(slot, 0, LOG_RECORD_SIZE);
+    putU16(slot, LOG_RECORD_MAGIC);
+    slot[2] = record.action;
+    slot[3] = record.success ? 1 : 0;
+    putU32(slot + 4, record.sequence);
+    putU32(slot + 8, record.timestamp);
+    memcpy(slot + 12, &record.confidence, sizeof(float));
+    memcpy(slot + 16, record.user, strnlen(record.user, ACCESS_LOG_USER_LEN - 1));
+    putU32(slot + 60, crc32Update(0, slot, 60));
+}
+
+long AccessLog::slotOffset(uint32_t sequence) const
+{
+    return LOG_HEADERS_BYTES + (long)((sequence - 1) % capacity_) * LOG_RECORD_SIZE;
+}
+
+// Sequences already assigned. One seek per contiguous run of slots; the
+// stdio buffer (ACCESS_LOG_IO_BUFFER) merges the run into one card write.
+bool AccessLog::writeRecords(const AccessLogRecord *records, size_t count)
+{
+    uint8_t slot[LOG_RECORD_SIZE];
+    for (size_t i = 0; i < count; i++)
+    {
+        if ((i == 0 || (records[i].sequence - 1) % capacity_ == 0) &&
+            fseek(file_, slotOffset(records[i].sequence), SEEK_SET) != 0)
+            return false;
+        encodeRecord(slot, records[i]);
+        if (fwrite(slot, 1, LOG_RECORD_SIZE, file_) != LOG_RECORD_SIZE)
+            return false;
+    }
+    return true;
+}
+
+bool AccessLog::readRecord(uint32_t sequence, AccessLogRecord &record)
+{
+    uint8_t slot[LOG_RECORD_SIZE];
+    if (fseek(file_, slotOffset(sequence), SEEK_SET) != 0 || fread(slot, 1, LOG_RECORD_SIZE, file_) != LOG_RECORD_SIZE)
+        return false;
+    return decodeRecord(slot, sequence, record);
+}
+
+bool AccessLog::decodeRecord(const uint8_t *slot, uint32_t sequence, AccessLogRecord &record)
+{
+    if (getU16(slot) != LOG_RECORD_MAGIC || getU32(slot + 4) != sequence)
+        return false; // Never written, or an older lap
+    if (getU32(slot + 60) != crc32Update(0, slot, 60))
+    {
+        corruptRecords_++;
+        return false;
+    }
+
+    record.sequence = sequence;
+    record.action = slot[2];
+    record.success = slot[3] != 0;
+    record.timestamp = getU32(slot + 8);
+    memcpy(&record.confidence, slot + 12, sizeof(float));
+    memcpy(record.user, slot + 16, ACCESS_LOG_USER_LEN);
+    record.user[ACCESS_LOG_USER_LEN - 1] = '\0';
+    return true;
+}
+
+bool AccessLog::append(AccessLogRecord &record)
+{
+    return append(&record, 1);
+}
+
+bool AccessLog::append(AccessLogRecord *records, size_t count)
+{
+    if (!file_ || count == 0)
+        return file_ != nullptr;
+    lock();
+    for (size_t i = 0; i < count; i++)
+        records[i].sequence = nextSequence_ + i;
+    bool ok = writeRecords(records, count);
+    if (ok)
+    {
+        nextSequence_ += count;
+        appendsSinceHeader_ += count;
+        if (observer_)
+            observer_->appended(records, count);
+        if (appendsSinceHeader_ >= ACCESS_LOG_HEADER_INTERVAL)
+            ok = writeHeader();
+        ok = fflush(file_) == 0 && ok;
+    }
+    unlock();
+    return ok;
+}
+
+bool AccessLog::sync()
+{
+    if (!file_)
+        return false;
+    lock();
+    bool ok = syncLocked();
+    unlock();
+    return ok;
+}
+
+// Records only: a lagging header is caught up by the roll-forward in begin()
+bool AccessLog::syncLocked()
+{
+    if (fflush(file_) != 0)
+        return false;
+    fsync(fileno(file_));
+    if (observer_)
+        observer_->synced();
+    return true;
+}
+
+bool AccessLog::clear()
+{
+    if (!file_)
+        return false;
+    lock();
+    firstSequence_ = nextSequence_;
+    bool ok = writeHeader() && syncLocked();
+    unlock();
+    return ok;
+}
+
+bool AccessLog::read(uint32_t sequence, AccessLogRecord &record)
+{
+    if (!file_)
+        return false;
+    lock();
+    bool ok = sequence >= oldestLocked() && sequence < nextSequence_ && readRecord(sequence, record);
+    unlock();
+    return ok;
+}
+
+size_t AccessLog::readRange(uint32_t first, size_t count, AccessLogRecord *out)
+{
+    if (!file_ || count == 0)
+        return 0;
+    lock();
+    size_t done = 0;
+    if (fseek(file_, slotOffset(first), SEEK_SET) == 0)
+    {
+        uint8_t slots[8 * LOG_RECORD_SIZE];
+        while (done < count)
+        {
+            size_t chunk = count - done < 8 ? count - done : 8;
+            size_t got = fread(slots, LOG_RECORD_SIZE, chunk, file_);
+            for (size_t i = 0; i < got; i++, done++)
+            {
+                if (!decodeRecord(slots + i * LOG_RECORD_SIZE, first + done, out[done]))
+                    out[done].sequence = 0;
+            }
+            if (got < chunk)
+                break; // End of a ring that has not filled up yet
+        }
+    }
+    for (size_t i = done; i < count; i++)
+        out[i].sequence = 0;
+    unlock();
+    return done;
+}
+
+uint32_t AccessLog::oldestLocked() const
+{
+    uint32_t lapStart = nextSequence_ > capacity_ ? nextSequence_ - capacity_ : 1;
+    return firstSequence_ > lapStart ? firstSequence_ : lapStart;
+}
+
+uint32_t AccessLog::firstSequence()
+{
+    lock();
+    uint32_t first = oldestLocked();
+    unlock();
+    return first;
+}
+
+uint32_t AccessLog::nextSequence()
+{
+    lock();
+    uint32_t next = nextSequence_;
+    unlock();
+    return next;
+}
+
+uint32_t AccessLog::count()
+{
+    lock();
+    uint32_t n = nextSequence_ - oldestLocked();
+    unlock();
+    return n;
+}
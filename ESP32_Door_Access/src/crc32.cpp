@@ -0,0 +1,41 @@
+#include "crc32.h"
+
+#ifdef ESP_PLATFORM
+
+#include <esp_rom_crc.h>
+
+uint32_t crc32Update(uint32_t crc, const void *data, size_t len)
+{
+    return esp_rom_crc32_le(crc, (const uint8_t *)data, (uint32_t)len);
+}
+
+#else
+
+static uint32_t crcTable[256];
+static bool crcTableReady = false;
+
+static void buildCrcTable()
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crcTable[i] = c;
+    }
+    crcTableReady = true;
+}
+
+uint32_t crc32Update(uint32_t crc, const void *data, size_t len)
+{
+    if (!crcTableReady)
+        buildCrcTable();
+
+    const uint8_t *p = (const uint8_t *)data;
+    crc = ~crc;
+    while (len--)
+        crc = crcTable[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+#endif
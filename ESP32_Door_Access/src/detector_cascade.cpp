@@ -0,0 +1,47 @@
+/**
+ * Face Detector Cascade Counters
+ *
+ * Reading the numbers: many fast hits with a low confirmed / handoffs ratio
+ * means the fast stage fires on noise; a low fast hit rate while people are
+ * at the door means it is too strict (its misses never reach the accurate
+ * stage).
+ */
+
+#include "detector_cascade.h"
+
+#include <string.h>
+
+static const char *const STAGE_NAMES[DETECT_STAGE_COUNT] = {"fast", "accurate", "roi"};
+
+const char *detectorStageName(DetectorStage stage)
+{
+    return stage < DETECT_STAGE_COUNT ? STAGE_NAMES[stage] : "unknown";
+}
+
+DetectorCascade::DetectorCascade() : handoffs_(0), confirmed_(0)
+{
+    memset(stages_, 0, sizeof(stages_));
+}
+
+void DetectorCascade::record(DetectorStage stage, bool hit, uint32_t elapsedUs)
+{
+    DetectorStageStats &s = stages_[stage];
+    s.runs++;
+    if (hit)
+        s.hits++;
+    s.lastUs = elapsedUs;
+    s.totalUs += elapsedUs;
+}
+
+void DetectorCascade::handoff(bool confirmed)
+{
+    handoffs_++;
+    if (confirmed)
+        confirmed_++;
+}
+
+uint32_t DetectorCascade::averageUs(DetectorStage stage) const
+{
+    const DetectorStageStats &s = stages_[stage];
+    return s.runs ? (uint32_t)(s.totalUs / s.runs) : 0;
+}
@@ -0,0 +1,300 @@
+/**
+ * Door / LED Actuator State Machine
+ *
+ * Three independent deadlines share one one-shot timer: relock, the next LED
+ * edge and the end of the enrollment pause. Every command and every timer
+ * expiry runs advanceLocked(), which applies whatever is due and returns the
+ * distance to the earliest remaining deadline; the timer is then re-armed
+ * for exactly that. A late timer (busy esp_timer task) just applies several
+ * transitions in one go.
+ *
+ * Times are 32-bit milliseconds compared with wrap-safe differences, so the
+ * ~49 day rollover of the time base is harmless.
+ */
+
+#include "door_actuator.h"
+
+static bool reached(uint32_t now, uint32_t deadline)
+{
+    return (int32_t)(now - deadline) >= 0;
+}
+
+static uint32_t earlier(uint32_t next, uint32_t now, uint32_t deadline)
+{
+    uint32_t wait = reached(now, deadline) ? 0 : deadline - now;
+    return wait < next ? wait : next;
+}
+
+void ActuatorClock::fire()
+{
+    if (actuator_)
+        actuator_->onTimer();
+}
+
+DoorActuator::DoorActuator(ActuatorClock &clock, const ActuatorOutputs &outputs)
+    : clock_(clock), outputs_(outputs), relayOn_(false), unlockedAt_(0), relockAt_(0),
+      ledIdle_(false), ledOn_(false), ledEdgesLeft_(0), ledNextAt_(0),
+      enrollmentHeld_(false), enrollmentReleaseAt_(0)
+{
+#ifdef ESP_PLATFORM
+    mutex_ = nullptr;
+#endif
+    clock_.attach(this);
+}
+
+#ifdef ESP_PLATFORM
+
+void DoorActuator::lockState() { xSemaphoreTake(mutex_, portMAX_DELAY); }
+void DoorActuator::unlockState() { xSemaphoreGive(mutex_); }
+
+#else
+
+void DoorActuator::lockState() { mutex_.lock(); }
+void DoorActuator::unlockState() { mutex_.unlock(); }
+
+#endif
+
+bool DoorActuator::begin(bool ledIdle)
+{
+#ifdef ESP_PLATFORM
+    if (!mutex_)
+        mutex_ = xSemaphoreCreateMutex();
+    if (!mutex_)
+        return false;
+#endif
+    if (!clock_.begin())
+        return false;
+
+    lockState();
+    relayOn_ = false;
+    outputs_.relay(false, outputs_.context);
+    ledIdle_ = ledIdle;
+    ledEdgesLeft_ = 0;
+    setLed(ledIdle);
+    unlockState();
+    return true;
+}
+
+void DoorActuator::setLed(bool on)
+{
+    ledOn_ = on;
+    outputs_.led(on, outputs_.context);
+}
+
+void DoorActuator::unlock(uint32_t durationMs)
+{
+    lockState();
+    uint32_t now = clock_.nowMs();
+    if (!relayOn_)
+    {
+        relayOn_ = true;
+        outputs_.relay(true, outputs_.context);
+    }
+    unlockedAt_ = now ? now : 1; // 0 means "never"
+    relockAt_ = now + durationMs;
+
+    ledEdgesLeft_ = ACTUATOR_UNLOCK_BLINKS * 2;
+    ledNextAt_ = now;
+    rescheduleLocked(now);
+    unlockState();
+}
+
+void DoorActuator::lock()
+{
+    lockState();
+    if (relayOn_)
+    {
+        relayOn_ = false;
+        outputs_.relay(false, outputs_.context);
+    }
+    rescheduleLocked(clock_.nowMs());
+    unlockState();
+}
+
+void DoorActuator::blink(uint8_t count)
+{
+    lockState();
+    uint32_t now = clock_.nowMs();
+    ledEdgesLeft_ = count * 2;
+    ledNextAt_ = now;
+    rescheduleLocked(now);
+    unlockState();
+}
+
+void DoorActuator::setLedIdle(bool on)
+{
+    lockState();
+    ledIdle_ = on;
+    if (ledEdgesLeft_ == 0 && ledOn_ != on)
+        setLed(on);
+    unlockState();
+}
+
+void DoorActuator::holdEnrollment(uint32_t pauseMs)
+{
+    lockState();
+    uint32_t now = clock_.nowMs();
+    enrollmentHeld_ = true;
+    enrollmentReleaseAt_ = now + pauseMs;
+    rescheduleLocked(now);
+    unlockState();
+}
+
+void DoorActuator::releaseEnrollment()
+{
+    lockState();
+    enrollmentHeld_ = false;
+    rescheduleLocked(clock_.nowMs());
+    unlockState();
+}
+
+bool DoorActuator::enrollmentHeld()
+{
+    lockState();
+    bool held = enrollmentHeld_;
+    unlockState();
+    return held;
+}
+
+bool DoorActuator::doorUnlocked()
+{
+    lockState();
+    bool on = relayOn_;
+    unlockState();
+    return on;
+}
+
+uint32_t DoorActuator::unlockedAtMs()
+{
+    lockState();
+    uint32_t at = unlockedAt_;
+    unlockState();
+    return at;
+}
+
+uint32_t DoorActuator::relockInMs()
+{
+    lockState();
+    uint32_t now = clock_.nowMs();
+    uint32_t left = relayOn_ && !reached(now, relockAt_) ? relockAt_ - now : 0;
+    unlockState();
+    return left;
+}
+
+void DoorActuator::onTimer()
+{
+    lockState();
+    rescheduleLocked(clock_.nowMs());
+    unlockState();
+}
+
+void DoorActuator::rescheduleLocked(uint32_t now)
+{
+    uint32_t next = advanceLocked(now);
+    if (next == ACTUATOR_NO_DEADLINE)
+        clock_.cancel();
+    else
+        clock_.schedule(next);
+}
+
+uint32_t DoorActuator::advanceLocked(uint32_t now)
+{
+    uint32_t next = ACTUATOR_NO_DEADLINE;
+
+    if (relayOn_)
+    {
+        if (reached(now, relockAt_))
+        {
+            relayOn_ = false;
+            outputs_.relay(false, outputs_.context);
+            if (outputs_.event)
+                outputs_.event(ACTUATOR_DOOR_LOCKED, outputs_.context);
+        }
+        else
+            next = earlier(next, now, relockAt_);
+    }
+
+    if (enrollmentHeld_)
+    {
+        if (reached(now, enrollmentReleaseAt_))
+        {
+            enrollmentHeld_ = false;
+            if (outputs_.event)
+                outputs_.event(ACTUATOR_ENROLLMENT_READY, outputs_.context);
+            if (ledEdgesLeft_ == 0)
+            {
+                ledEdgesLeft_ = ACTUATOR_CUE_BLINKS * 2;
+                ledNextAt_ = now;
+            }
+        }
+        else
+            next = earlier(next, now, enrollmentReleaseAt_);
+    }
+
+    // A late timer applies only the current edge, then restarts the pattern
+    // clock from now so a blink is never shortened to nothing
+    if (ledEdgesLeft_ > 0 && reached(now, ledNextAt_))
+    {
+        ledEdgesLeft_--;
+        setLed(ledEdgesLeft_ == 0 ? ledIdle_ : !ledOn_);
+        ledNextAt_ = now + ACTUATOR_BLINK_MS;
+    }
+    if (ledEdgesLeft_ > 0)
+        next = earlier(next, now, ledNextAt_);
+
+    return next;
+}
+
+// ==================== Clocks ====================
+
+#ifdef ESP_PLATFORM
+
+bool EspTimerClock::begin()
+{
+    if (timer_)
+        return true;
+    esp_timer_create_args_t args = {};
+    args.callback = &EspTimerClock::callback;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "door_actuator";
+    return esp_timer_create(&args, &timer_) == ESP_OK;
+}
+
+void EspTimerClock::schedule(uint32_t delayMs)
+{
+    if (!timer_)
+        return;
+    esp_timer_stop(timer_); // ESP_ERR_INVALID_STATE when idle: fine
+    esp_timer_start_once(timer_, (uint64_t)delayMs * 1000);
+}
+
+void EspTimerClock::cancel()
+{
+    if (timer_)
+        esp_timer_stop(timer_);
+}
+
+void EspTimerClock::callback(void *arg)
+{
+    static_cast<EspTimerClock *>(arg)->fire();
+}
+
+#endif
+
+void VirtualClock::schedule(uint32_t delayMs)
+{
+    deadline_ = now_ + delayMs;
+    armed_ = true;
+}
+
+void VirtualClock::advanceTo(uint32_t ms)
+{
+    while (armed_ && (int32_t)(ms - deadline_) >= 0)
+    {
+        now_ = deadline_;
+        armed_ = false;
+        fire(); // May re-arm, possibly for a deadline that is also due
+    }
+    now_ = ms;
+}
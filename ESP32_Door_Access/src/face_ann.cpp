@@ -0,0 +1,428 @@
+/**
+ * Approximate Nearest-Neighbour Index (IVF) for the face gallery
+ *
+ * Centroids are trained with spherical k-means directly on int8 records (an
+ * evenly spaced sample of the gallery) and stored in the same
+ * QuantizedEmbedding format, so both stages reuse the PIE dot-product kernel. Each record remembers its list; the CSR arrays
+ * used by search() are rebuilt lazily after enroll/delete.
+ *
+ * Every list also keeps its radius, the lowest similarity of a member to the
+ * centroid (the widest angle theta). A probe at angle phi from the centroid
+ * is at least phi - theta away from every member, which bounds a whole list
+ * without touching its records. Quantized similarities are exact cosines of
+ * the dequantized vectors, so the bound only needs slack for float rounding.
+ */
+
+#include "face_ann.h"
+#include "face_gallery.h"
+#include "psram_alloc.h"
+
+#include <math.h>
+#include <string.h>
+
+#define ANN_BOUND_SLACK 1e-3f // Float rounding in similarities and acosf
+
+FaceAnnIndex::FaceAnnIndex()
+    : centroids_(nullptr), radius_(nullptr), lists_(0), probes_(ANN_DEFAULT_PROBES), trainedRecords_(0),
+      sample_(nullptr), sampleCount_(0), pendingCentroids_(nullptr), pendingLists_(0), pendingTrained_(false),
+      assign_(nullptr), assignCount_(0), assignCapacity_(0),
+      offsets_(nullptr), members_(nullptr), membersCapacity_(0), dirty_(true)
+{
+}
+
+FaceAnnIndex::~FaceAnnIndex()
+{
+    reset();
+    discardTraining();
+}
+
+void FaceAnnIndex::reset()
+{
+    psramFree(centroids_);
+    psramFree(radius_);
+    psramFree(assign_);
+    psramFree(offsets_);
+    psramFree(members_);
+    centroids_ = nullptr;
+    radius_ = nullptr;
+    assign_ = nullptr;
+    offsets_ = nullptr;
+    members_ = nullptr;
+    lists_ = 0;
+    trainedRecords_ = 0;
+    assignCount_ = 0;
+    assignCapacity_ = 0;
+    membersCapacity_ = 0;
+    dirty_ = true;
+}
+
+bool FaceAnnIndex::needsTraining(size_t records) const
+{
+    if (records < ANN_MIN_RECORDS)
+        return false;
+    return !trained() || records > trainedRecords_ * 2;
+}
+
+bool FaceAnnIndex::reserveAssignments(size_t records)
+{
+    if (records <= assignCapacity_)
+        return true;
+
+    size_t capacity = assignCapacity_ ? assignCapacity_ : 64;
+    while (capacity < records)
+        capacity *= 2;
+
+    uint16_t *assign = (uint16_t *)psramAlloc(capacity * sizeof(uint16_t));
+    if (!assign)
+        return false;
+    if (assign_)
+        memcpy(assign, assign_, assignCount_ * sizeof(uint16_t));
+    psramFree(assign_);
+    assign_ = assign;
+    assignCapacity_ = capacity;
+    return true;
+}
+
+int FaceAnnIndex::nearestList(const QuantizedEmbedding &embedding, float &similarity) const
+{
+    return nearestCentroid(embedding, centroids_, lists_, similarity);
+}
+
+int FaceAnnIndex::nearestCentroid(const QuantizedEmbedding &embedding, const QuantizedEmbedding *centroids, size_t count,
+                                  float &bestSimilarity)
+{
+    int best = 0;
+    bestSimilarity = -2.0f;
+    for (size_t c = 0; c < count; c++)
+    {
+        float s = cosineSimilarityQ8(embedding, centroids[c]);
+        if (s > bestSimilarity)
+        {
+            bestSimilarity = s;
+            best = (int)c;
+        }
+    }
+    return best;
+}
+
+bool FaceAnnIndex::train(const FaceGallery &gallery, size_t lists, int iterations)
+{
+    bool ok = sampleForTraining(gallery, lists) && trainCentroids(iterations) && installTraining(gallery);
+    discardTraining();
+    return ok;
+}
+
+void FaceAnnIndex::discardTraining()
+{
+    psramFree(sample_);
+    psramFree(pendingCentroids_);
+    sample_ = nullptr;
+    pendingCentroids_ = nullptr;
+    sampleCount_ = 0;
+    pendingLists_ = 0;
+    pendingTrained_ = false;
+}
+
+bool FaceAnnIndex::sampleForTraining(const FaceGallery &gallery, size_t lists)
+{
+    discardTraining();
+    size_t records = gallery.recordCount();
+    if (records == 0)
+    {
+        reset();
+        return false;
+    }
+
+    if (lists == 0)
+        lists = (size_t)sqrtf((float)records);
+    if (lists < 1)
+        lists = 1;
+    if (lists > records)
+        lists = records;
+    if (lists > UINT16_MAX)
+        lists = UINT16_MAX;
+
+    size_t count = records < ANN_TRAIN_SAMPLE ? records : ANN_TRAIN_SAMPLE;
+    if (count < lists)
+        count = lists;
+    sample_ = (QuantizedEmbedding *)psramAlloc(count * sizeof(QuantizedEmbedding));
+    if (!sample_)
+        return false;
+    for (size_t i = 0; i < count; i++)
+        sample_[i] = gallery.embedding(i * records / count);
+    sampleCount_ = count;
+    pendingLists_ = lists;
+    return true;
+}
+
+bool FaceAnnIndex::trainCentroids(int iterations)
+{
+    size_t lists = pendingLists_;
+    if (!sample_ || lists == 0)
+        return false;
+
+    pendingCentroids_ = (QuantizedEmbedding *)psramAlloc(lists * sizeof(QuantizedEmbedding));
+    float *sums = (float *)psramAlloc(lists * FACE_EMBEDDING_DIM * sizeof(float));
+    uint32_t *counts = (uint32_t *)psramAlloc(lists * sizeof(uint32_t));
+    if (!pendingCentroids_ || !sums || !counts)
+    {
+        psramFree(sums);
+        psramFree(counts);
+        discardTraining();
+        return false;
+    }
+
+    // Deterministic seeding: evenly spaced sample records
+    for (size_t c = 0; c < lists; c++)
+    {
+        pendingCentroids_[c] = sample_[c * sampleCount_ / lists];
+    }
+
+    float similarity;
+    for (int it = 0; it < iterations; it++)
+    {
+        memset(sums, 0, lists * FACE_EMBEDDING_DIM * sizeof(float));
+        memset(counts, 0, lists * sizeof(uint32_t));
+
+        for (size_t r = 0; r < sampleCount_; r++)
+        {
+            const QuantizedEmbedding &e = sample_[r];
+            int c = nearestCentroid(e, pendingCentroids_, lists, similarity);
+            counts[c]++;
+
+            // Accumulate unit vectors (spherical k-means)
+            float inv = e.scale / e.norm;
+            float *sum = sums + (size_t)c * FACE_EMBEDDING_DIM;
+            for (int i = 0; i < FACE_EMBEDDING_DIM; i++)
+                sum[i] += e.data[i] * inv;
+        }
+
+        for (size_t c = 0; c < lists; c++)
+        {
+            if (counts[c] == 0)
+                continue; // Empty list keeps its previous centroid
+            quantizeEmbedding(sums + c * FACE_EMBEDDING_DIM, pendingCentroids_[c]);
+        }
+    }
+
+    psramFree(sums);
+    psramFree(counts);
+    pendingTrained_ = true;
+    return true;
+}
+
+bool FaceAnnIndex::installTraining(const FaceGallery &gallery)
+{
+    size_t records = gallery.recordCount();
+    if (!pendingTrained_ || records == 0)
+    {
+        discardTraining();
+        return false;
+    }
+
+    size_t lists = pendingLists_;
+    QuantizedEmbedding *centroids = pendingCentroids_;
+    pendingCentroids_ = nullptr;
+    discardTraining();
+
+    reset();
+    centroids_ = centroids;
+    radius_ = (float *)psramAlloc(lists * sizeof(float));
+    if (!radius_ || !reserveAssignments(records))
+    {
+        reset();
+        return false;
+    }
+    lists_ = lists;
+    assignCount_ = records;
+
+    // One k-means step over the whole gallery: the sample placed the
+    // centroids, every record pulls its own centroid toward it
+    float *sums = (float *)psramAlloc(lists * FACE_EMBEDDING_DIM * sizeof(float));
+    float similarity;
+    if (sums)
+    {
+        memset(sums, 0, lists * FACE_EMBEDDING_DIM * sizeof(float));
+        for (size_t r = 0; r < records; r++)
+        {
+            const QuantizedEmbedding &e = gallery.embedding(r);
+            float inv = e.scale / e.norm;
+            float *sum = sums + (size_t)nearestList(e, similarity) * FACE_EMBEDDING_DIM;
+            for (int i = 0; i < FACE_EMBEDDING_DIM; i++)
+                sum[i] += e.data[i] * inv;
+        }
+        for (size_t c = 0; c < lists; c++)
+        {
+            float norm = 0.0f;
+            for (int i = 0; i < FACE_EMBEDDING_DIM; i++)
+                norm += sums[c * FACE_EMBEDDING_DIM + i] * sums[c * FACE_EMBEDDING_DIM + i];
+            if (norm > 0.0f)
+                quantizeEmbedding(sums + c * FACE_EMBEDDING_DIM, centroids_[c]);
+        }
+        psramFree(sums);
+    }
+
+    // Assignment against the final centroids
+    for (size_t c = 0; c < lists; c++)
+        radius_[c] = 1.0f;
+    for (size_t r = 0; r < records; r++)
+    {
+        int c = nearestList(gallery.embedding(r), similarity);
+        assign_[r] = (uint16_t)c;
+        if (similarity < radius_[c])
+            radius_[c] = similarity;
+    }
+
+    trainedRecords_ = records;
+    dirty_ = true;
+    return true;
+}
+
+void FaceAnnIndex::recordAdded(const FaceGallery &gallery, size_t record)
+{
+    if (!trained())
+        return;
+    if (!reserveAssignments(record + 1))
+    {
+        reset(); // Fall back to brute force rather than serve a stale index
+        return;
+    }
+    float similarity;
+    int c = nearestList(gallery.embedding(record), similarity);
+    assign_[record] = (uint16_t)c;
+    if (similarity < radius_[c])
+        radius_[c] = similarity;
+    if (record >= assignCount_)
+        assignCount_ = record + 1;
+    dirty_ = true;
+}
+
+void FaceAnnIndex::recordMoved(size_t from, size_t to)
+{
+    if (!trained() || from >= assignCount_ || to >= assignCount_)
+        return;
+    assign_[to] = assign_[from];
+    dirty_ = true;
+}
+
+void FaceAnnIndex::recordsTruncated(size_t count)
+{
+    if (!trained())
+        return;
+    if (count < assignCount_)
+        assignCount_ = count;
+    dirty_ = true;
+}
+
+void FaceAnnIndex::rebuildLists() const
+{
+    if (!offsets_)
+        offsets_ = (uint32_t *)psramAlloc((lists_ + 1) * sizeof(uint32_t));
+    if (membersCapacity_ < assignCount_)
+    {
+        psramFree(members_);
+        membersCapacity_ = assignCapacity_;
+        members_ = (uint32_t *)psramAlloc(membersCapacity_ * sizeof(uint32_t));
+    }
+    if (!offsets_ || !members_)
+        return;
+
+    // Counting sort of records by list: offsets_[c] = first member of list c
+    memset(offsets_, 0, (lists_ + 1) * sizeof(uint32_t));
+    for (size_t r = 0; r < assignCount_; r++)
+        offsets_[assign_[r] + 1]++;
+    for (size_t c = 0; c < lists_; c++)
+        offsets_[c + 1] += offsets_[c];
+
+    uint32_t *cursor = (uint32_t *)psramAlloc(lists_ * sizeof(uint32_t));
+    if (!cursor)
+        return;
+    memcpy(cursor, offsets_, lists_ * sizeof(uint32_t));
+    for (size_t r = 0; r < assignCount_; r++)
+        members_[cursor[assign_[r]]++] = (uint32_t)r;
+    psramFree(cursor);
+
+    dirty_ = false;
+}
+
+size_t FaceAnnIndex::closestLists(const FaceGallery &gallery, const QuantizedEmbedding &probe, int *topList, size_t maxLists,
+                                  float *similarity) const
+{
+    if (!trained() || assignCount_ != gallery.recordCount())
+        return 0;
+    if (dirty_)
+        rebuildLists();
+    if (dirty_)
+        return 0;
+
+    // Keep the maxLists most similar centroids (small insertion-sorted set)
+    size_t probes = maxLists < ANN_MAX_PROBES ? maxLists : ANN_MAX_PROBES;
+    if (probes > lists_)
+        probes = lists_;
+    float topScore[ANN_MAX_PROBES];
+    size_t kept = 0;
+
+    for (size_t c = 0; c < lists_; c++)
+    {
+        float s = cosineSimilarityQ8(probe, centroids_[c]);
+        if (kept == probes && s <= topScore[kept - 1])
+            continue;
+
+        size_t pos = kept < probes ? kept++ : kept - 1;
+        while (pos > 0 && topScore[pos - 1] < s)
+        {
+            topScore[pos] = topScore[pos - 1];
+            topList[pos] = topList[pos - 1];
+            pos--;
+        }
+        topScore[pos] = s;
+        topList[pos] = (int)c;
+    }
+    if (similarity)
+        memcpy(similarity, topScore, kept * sizeof(float));
+    return kept;
+}
+
+float FaceAnnIndex::listBound(int list, float centroidSimilarity) const
+{
+    float phi = acosf(centroidSimilarity > 1.0f ? 1.0f : (centroidSimilarity < -1.0f ? -1.0f : centroidSimilarity));
+    float theta = acosf(radius_[list] > 1.0f ? 1.0f : (radius_[list] < -1.0f ? -1.0f : radius_[list]));
+    if (phi <= theta)
+        return 1.0f;
+    return cosf(phi - theta) + ANN_BOUND_SLACK;
+}
+
+const uint32_t *FaceAnnIndex::listMembers(int list, size_t &count) const
+{
+    count = offsets_[list + 1] - offsets_[list];
+    return members_ + offsets_[list];
+}
+
+int FaceAnnIndex::search(const FaceGallery &gallery, const QuantizedEmbedding &probe, float &similarity) const
+{
+    similarity = -1.0f;
+
+    // Stage 1: closest centroids
+    int topList[ANN_MAX_PROBES];
+    size_t kept = closestLists(gallery, probe, topList, probes());
+
+    // Stage 2: exact re-rank inside the selected lists
+    int bestRecord = -1;
+    for (size_t p = 0; p < kept; p++)
+    {
+        size_t count;
+        const uint32_t *members = listMembers(topList[p], count);
+        for (size_t m = 0; m < count; m++)
+        {
+            uint32_t r = members[m];
+            float s = cosineSimilarityQ8(probe, gallery.embedding(r));
+            if (s > similarity)
+            {
+                similarity = s;
+                bestRecord = (int)r;
+            }
+        }
+    }
+
+    return bestRecord;
+}
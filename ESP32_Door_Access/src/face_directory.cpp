@@ -0,0 +1,213 @@
+/**
+ * Face Directory
+ *
+ * File layout (little endian):
+ *   uint32 magic "FDIR" | uint16 version | uint16 entry size |
+ *   uint32 count | uint32 crc32(entries)
+ *   FaceDirectoryEntry[count]
+ */
+
+#include "face_directory.h"
+#include "crc32.h"
+#include "psram_alloc.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define DIRECTORY_MAGIC 0x52494446 // "FDIR"
+#define DIRECTORY_HEADER_SIZE 16
+
+static_assert(sizeof(FaceDirectoryEntry) == 2 + FACE_NAME_LEN + 2 * DIRECTORY_FIELD_LEN + DIRECTORY_DATE_LEN,
+              "FaceDirectoryEntry must not contain padding");
+
+static void copyField(char *dst, const char *src, size_t size)
+{
+    memset(dst, 0, size);
+    if (src)
+        memcpy(dst, src, strnlen(src, size - 1));
+}
+
+FaceDirectory::FaceDirectory() : entries_(nullptr), count_(0), capacity_(0)
+{
+}
+
+FaceDirectory::~FaceDirectory()
+{
+    psramFree(entries_);
+}
+
+bool FaceDirectory::reserve(size_t count)
+{
+    if (count <= capacity_)
+        return true;
+
+    size_t capacity = capacity_ ? capacity_ * 2 : 64;
+    while (capacity < count)
+        capacity *= 2;
+
+    FaceDirectoryEntry *entries = (FaceDirectoryEntry *)psramAlloc(capacity * sizeof(FaceDirectoryEntry), 4);
+    if (!entries)
+        return false;
+    if (entries_)
+        memcpy(entries, entries_, count_ * sizeof(FaceDirectoryEntry));
+    psramFree(entries_);
+    entries_ = entries;
+    capacity_ = capacity;
+    return true;
+}
+
+bool FaceDirectory::load(const char *path)
+{
+    count_ = 0;
+
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return true; // No directory yet
+
+    uint32_t header[DIRECTORY_HEADER_SIZE / 4];
+    bool ok = fread(header, 1, DIRECTORY_HEADER_SIZE, f) == DIRECTORY_HEADER_SIZE &&
+              header[0] == DIRECTORY_MAGIC;
+    ok = ok && (header[1] & 0xFFFF) == FACE_DIRECTORY_VERSION &&
+         (header[1] >> 16) == sizeof(FaceDirectoryEntry) &&
+         reserve(header[2]);
+
+    if (ok)
+    {
+        size_t count = header[2];
+        ok = fread(entries_, sizeof(FaceDirectoryEntry), count, f) == count &&
+             crc32Update(0, entries_, count * sizeof(FaceDirectoryEntry)) == header[3];
+        count_ = ok ? count : 0;
+    }
+    fclose(f);
+    return ok;
+}
+
+bool FaceDirectory::save(const char *path) const
+{
+    char tempPath[64];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+
+    FILE *f = fopen(tempPath, "wb");
+    if (!f)
+        return false;
+
+    uint32_t header[DIRECTORY_HEADER_SIZE / 4];
+    header[0] = DIRECTORY_MAGIC;
+    header[1] = FACE_DIRECTORY_VERSION | ((uint32_t)sizeof(FaceDirectoryEntry) << 16);
+    header[2] = (uint32_t)count_;
+    header[3] = crc32Update(0, entries_, count_ * sizeof(FaceDirectoryEntry));
+
+    bool ok = fwrite(header, 1, DIRECTORY_HEADER_SIZE, f) == DIRECTORY_HEADER_SIZE &&
+              fwrite(entries_, sizeof(FaceDirectoryEntry), count_, f) == count_;
+    ok = fclose(f) == 0 && ok;
+
+    if (!ok)
+    {
+        ::remove(tempPath);
+        return false;
+    }
+    ::remove(path);
+    return rename(tempPath, path) == 0;
+}
+
+int FaceDirectory::find(const char *name) const
+{
+    for (size_t i = 0; i < count_; i++)
+    {
+        if (strncmp(entries_[i].name, name, FACE_NAME_LEN - 1) == 0)
+            return (int)i;
+    }
+    return -1;
+}
+
+FaceDirectoryEntry *FaceDirectory::upsert(const char *name)
+{
+    if (!name || !name[0])
+        return nullptr;
+
+    int index = find(name);
+    if (index >= 0)
+        return &entries_[index];
+    return append(name);
+}
+
+// New entry, caller made sure the name is not listed yet
+FaceDirectoryEntry *FaceDirectory::append(const char *name)
+{
+    if (!reserve(count_ + 1))
+        return nullptr;
+
+    FaceDirectoryEntry &e = entries_[count_++];
+    memset(&e, 0, sizeof(e));
+    copyField(e.name, name, sizeof(e.name));
+    return &e;
+}
+
+bool FaceDirectory::remove(const char *name)
+{
+    int index = find(name);
+    if (index < 0)
+        return false;
+
+    // Keep insertion order (list order seen by the app)
+    memmove(&entries_[index], &entries_[index + 1], (count_ - index - 1) * sizeof(FaceDirectoryEntry));
+    count_--;
+    return true;
+}
+
+bool FaceDirectory::setMetadata(const char *name, const char *jabatan, const char *departemen, const char *masaBerlaku)
+{
+    FaceDirectoryEntry *e = upsert(name);
+    if (!e)
+        return false;
+
+    if (jabatan)
+        copyField(e->jabatan, jabatan, sizeof(e->jabatan));
+    if (departemen)
+        copyField(e->departemen, departemen, sizeof(e->departemen));
+    if (masaBerlaku)
+        copyField(e->masaBerlaku, masaBerlaku, sizeof(e->masaBerlaku));
+    return true;
+}
+
+bool FaceDirectory::syncWithGallery(const FaceGallery &gallery)
+{
+    bool changed = false;
+
+    // Gallery users already listed, by user index: the gallery's hash lookup
+    // replaces a scan of the directory per user
+    uint8_t *listed = (uint8_t *)psramAlloc(gallery.userSlots() ? gallery.userSlots() : 1);
+    if (!listed)
+        return false;
+    memset(listed, 0, gallery.userSlots());
+
+    for (size_t i = 0; i < count_; i++)
+    {
+        int user = gallery.findUser(entries_[i].name);
+        uint16_t templates = 0;
+        if (user >= 0)
+        {
+            templates = gallery.user(user).records;
+            listed[user] = 1;
+        }
+        if (entries_[i].templates != templates)
+        {
+            entries_[i].templates = templates;
+            changed = true;
+        }
+    }
+
+    gallery.forEachUser([&](int index, const GalleryUser &user) {
+        if (listed[index])
+            return;
+        FaceDirectoryEntry *e = append(user.name);
+        if (e)
+        {
+            e->templates = user.records;
+            changed = true;
+        }
+    });
+
+    psramFree(listed);
+    return changed;
+}
@@ -0,0 +1,135 @@
+/**
+ * Face Embedding Quantization & Similarity Kernels
+ *
+ * The recognizer produces 512 float values per face. Stored as int8 with a
+ * per-vector scale, one gallery entry shrinks from 2 KB to 528 bytes and a
+ * comparison becomes 32 PIE multiply-accumulate instructions on the S3.
+ */
+
+#include "face_embedding.h"
+
+#include <math.h>
+
+void quantizeEmbedding(const float *src, QuantizedEmbedding &dst)
+{
+    float maxAbs = 0.0f;
+    for (int i = 0; i < FACE_EMBEDDING_DIM; i++)
+    {
+        float v = fabsf(src[i]);
+        if (v > maxAbs)
+            maxAbs = v;
+    }
+
+    // All-zero vector: keep a valid (non-zero) scale so the entry never divides by 0
+    dst.scale = maxAbs > 0.0f ? maxAbs / 127.0f : 1.0f;
+    float inv = 1.0f / dst.scale;
+
+    int32_t sumSq = 0;
+    for (int i = 0; i < FACE_EMBEDDING_DIM; i++)
+    {
+        int q = (int)lroundf(src[i] * inv);
+        if (q > 127)
+            q = 127;
+        if (q < -127)
+            q = -127;
+        dst.data[i] = (int8_t)q;
+        sumSq += q * q;
+    }
+
+    // Norm of the dequantized vector, so cosineSimilarityQ8(a, a) == 1
+    dst.norm = sqrtf((float)sumSq) * dst.scale;
+    if (dst.norm == 0.0f)
+        dst.norm = 1.0f;
+}
+
+void dequantizeEmbedding(const QuantizedEmbedding &src, float *dst)
+{
+    for (int i = 0; i < FACE_EMBEDDING_DIM; i++)
+    {
+        dst[i] = src.data[i] * src.scale;
+    }
+}
+
+#if FACE_EMBEDDING_USE_PIE
+
+int32_t dotProductS8(const int8_t *a, const int8_t *b, size_t n)
+{
+    // 16 lanes per EE.VMULAS, products accumulate in the 40-bit ACCX register.
+    // 512 * 127 * 127 fits in 32 bits, so the final SRS never saturates.
+    int32_t result;
+    const int8_t *pa = a;
+    const int8_t *pb = b;
+    int shift = 0;
+    size_t loops = n / 16;
+
+    asm volatile(
+        "ee.zero.accx\n"
+        "loopnez %[loops], 0f\n"
+        "ee.vld.128.ip q0, %[pa], 16\n"
+        "ee.vld.128.ip q1, %[pb], 16\n"
+        "ee.vmulas.s8.accx q0, q1\n"
+        "0:\n"
+        "ee.srs.accx %[res], %[shift], 0\n"
+        : [pa] "+r"(pa), [pb] "+r"(pb), [res] "=r"(result)
+        : [loops] "r"(loops), [shift] "r"(shift)
+        : "memory");
+
+    return result;
+}
+
+#else
+
+int32_t dotProductS8(const int8_t *a, const int8_t *b, size_t n)
+{
+    // Four independent accumulators keep the host compiler free to vectorize
+    int32_t acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+    for (size_t i = 0; i < n; i += 4)
+    {
+        acc0 += a[i] * b[i];
+        acc1 += a[i + 1] * b[i + 1];
+        acc2 += a[i + 2] * b[i + 2];
+        acc3 += a[i + 3] * b[i + 3];
+    }
+    return acc0 + acc1 + acc2 + acc3;
+}
+
+#endif
+
+float cosineSimilarity(const float *a, const float *b, size_t n)
+{
+    float dot = 0.0f, normA = 0.0f, normB = 0.0f;
+    for (size_t i = 0; i < n; i++)
+    {
+        dot += a[i] * b[i];
+        normA += a[i] * a[i];
+        normB += b[i] * b[i];
+    }
+    if (normA == 0.0f || normB == 0.0f)
+        return 0.0f;
+    return dot / (sqrtf(normA) * sqrtf(normB));
+}
+
+float cosineSimilarityQ8(const QuantizedEmbedding &a, const QuantizedEmbedding &b)
+{
+    int32_t dot = dotProductS8(a.data, b.data, FACE_EMBEDDING_DIM);
+    return (dot * a.scale * b.scale) / (a.norm * b.norm);
+}
+
+int bestMatchQ8(const QuantizedEmbedding &probe, const QuantizedEmbedding *gallery, size_t count, float &similarity)
+{
+    int best = -1;
+    float bestSimilarity = -1.0f;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        float s = cosineSimilarityQ8(probe, gallery[i]);
+        if (s > bestSimilarity)
+        {
+            bestSimilarity = s;
+            best = (int)i;
+        }
+    }
+
+    similarity = bestSimilarity;
+    return best;
+}
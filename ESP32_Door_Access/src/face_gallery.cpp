@@ -0,0 +1,445 @@
+/**
+ * Resident Face Gallery Index
+ *
+ * Embeddings are stored structure-of-arrays: one contiguous PSRAM block of
+ * QuantizedEmbedding plus a parallel owner table, so the matcher streams
+ * through memory linearly. Removing a user swaps the last record into each
+ * hole, which keeps the block dense without shifting.
+ */
+
+#include "face_gallery.h"
+#include "face_ann.h"
+#include "psram_alloc.h"
+
+#include <math.h>
+#include <string.h>
+
+FaceGallery::FaceGallery()
+    : embeddings_(nullptr), bounds_(nullptr), recordUser_(nullptr), recordCount_(0), recordCapacity_(0),
+      users_(nullptr), userSlots_(0), userCount_(0), userCapacity_(0),
+      directory_(nullptr), directorySize_(0), index_(nullptr), revision_(0)
+{
+}
+
+FaceGallery::~FaceGallery()
+{
+    psramFree(embeddings_);
+    psramFree(bounds_);
+    psramFree(recordUser_);
+    psramFree(users_);
+    psramFree(directory_);
+}
+
+bool FaceGallery::begin(size_t recordCapacity, size_t userCapacity)
+{
+    psramFree(embeddings_);
+    psramFree(bounds_);
+    psramFree(recordUser_);
+    psramFree(users_);
+    psramFree(directory_);
+
+    if (recordCapacity == 0)
+        recordCapacity = 1;
+    if (userCapacity == 0)
+        userCapacity = 1;
+
+    embeddings_ = (QuantizedEmbedding *)psramAlloc(recordCapacity * sizeof(QuantizedEmbedding));
+    bounds_ = (EmbeddingBounds *)psramAlloc(recordCapacity * sizeof(EmbeddingBounds), 4);
+    recordUser_ = (uint16_t *)psramAlloc(recordCapacity * sizeof(uint16_t));
+    users_ = (GalleryUser *)psramAlloc(userCapacity * sizeof(GalleryUser));
+
+    // Directory at most half full
+    directorySize_ = 1;
+    while (directorySize_ < userCapacity * 2)
+        directorySize_ <<= 1;
+    directory_ = (int16_t *)psramAlloc(directorySize_ * sizeof(int16_t));
+
+    recordCapacity_ = recordCapacity;
+    userCapacity_ = userCapacity;
+
+    if (!embeddings_ || !bounds_ || !recordUser_ || !users_ || !directory_)
+    {
+        recordCapacity_ = 0;
+        userCapacity_ = 0;
+        clear();
+        return false;
+    }
+
+    clear();
+    return true;
+}
+
+void FaceGallery::clear()
+{
+    recordCount_ = 0;
+    userSlots_ = 0;
+    userCount_ = 0;
+    revision_++;
+    if (directory_)
+        memset(directory_, 0xFF, directorySize_ * sizeof(int16_t));
+    if (index_)
+        index_->reset();
+}
+
+size_t FaceGallery::memoryUsage() const
+{
+    return recordCapacity_ * (sizeof(QuantizedEmbedding) + sizeof(EmbeddingBounds) + sizeof(uint16_t)) +
+           userCapacity_ * sizeof(GalleryUser) + directorySize_ * sizeof(int16_t);
+}
+
+uint32_t FaceGallery::directorySlot(const char *name) const
+{
+    // FNV-1a over at most FACE_NAME_LEN - 1 characters (same truncation as storage)
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < FACE_NAME_LEN - 1 && name[i]; i++)
+    {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash & (directorySize_ - 1);
+}
+
+int FaceGallery::findUser(const char *name) const
+{
+    if (!directory_ || !name || !name[0])
+        return -1;
+
+    uint32_t slot = directorySlot(name);
+    for (size_t probes = 0; probes < directorySize_; probes++)
+    {
+        int16_t index = directory_[slot];
+        if (index < 0)
+            return -1;
+        if (strncmp(users_[index].name, name, FACE_NAME_LEN - 1) == 0)
+            return index;
+        slot = (slot + 1) & (directorySize_ - 1);
+    }
+    return -1;
+}
+
+void FaceGallery::rebuildDirectory()
+{
+    memset(directory_, 0xFF, directorySize_ * sizeof(int16_t));
+    for (size_t i = 0; i < userSlots_; i++)
+    {
+        if (users_[i].records == 0)
+            continue;
+        uint32_t slot = directorySlot(users_[i].name);
+        while (directory_[slot] >= 0)
+            slot = (slot + 1) & (directorySize_ - 1);
+        directory_[slot] = (int16_t)i;
+    }
+}
+
+bool FaceGallery::growRecords()
+{
+    size_t capacity = recordCapacity_ * 2;
+    QuantizedEmbedding *embeddings = (QuantizedEmbedding *)psramAlloc(capacity * sizeof(QuantizedEmbedding));
+    EmbeddingBounds *bounds = (EmbeddingBounds *)psramAlloc(capacity * sizeof(EmbeddingBounds), 4);
+    uint16_t *owners = (uint16_t *)psramAlloc(capacity * sizeof(uint16_t));
+    if (!embeddings || !bounds || !owners)
+    {
+        psramFree(embeddings);
+        psramFree(bounds);
+        psramFree(owners);
+        return false;
+    }
+
+    memcpy(embeddings, embeddings_, recordCount_ * sizeof(QuantizedEmbedding));
+    memcpy(bounds, bounds_, recordCount_ * sizeof(EmbeddingBounds));
+    memcpy(owners, recordUser_, recordCount_ * sizeof(uint16_t));
+    psramFree(embeddings_);
+    psramFree(bounds_);
+    psramFree(recordUser_);
+    embeddings_ = embeddings;
+    bounds_ = bounds;
+    recordUser_ = owners;
+    recordCapacity_ = capacity;
+    return true;
+}
+
+bool FaceGallery::growUsers()
+{
+    size_t capacity = userCapacity_ * 2;
+    size_t directorySize = directorySize_ * 2;
+    if (capacity > INT16_MAX)
+        return false;
+
+    GalleryUser *users = (GalleryUser *)psramAlloc(capacity * sizeof(GalleryUser));
+    int16_t *directory = (int16_t *)psramAlloc(directorySize * sizeof(int16_t));
+    if (!users || !directory)
+    {
+        psramFree(users);
+        psramFree(directory);
+        return false;
+    }
+
+    memcpy(users, users_, userSlots_ * sizeof(GalleryUser));
+    psramFree(users_);
+    psramFree(directory_);
+    users_ = users;
+    directory_ = directory;
+    userCapacity_ = capacity;
+    directorySize_ = directorySize;
+    rebuildDirectory();
+    return true;
+}
+
+int FaceGallery::createUser(const char *name)
+{
+    // Reuse a slot freed by removeUser() before growing
+    size_t index = userSlots_;
+    for (size_t i = 0; i < userSlots_; i++)
+    {
+        if (users_[i].records == 0)
+        {
+            index = i;
+            break;
+        }
+    }
+
+    if (index == userSlots_)
+    {
+        if (userSlots_ == userCapacity_ && !growUsers())
+            return -1;
+        userSlots_++;
+    }
+
+    GalleryUser &u = users_[index];
+    memset(u.name, 0, sizeof(u.name));
+    strncpy(u.name, name, FACE_NAME_LEN - 1);
+    u.records = 0;
+
+    uint32_t slot = directorySlot(u.name);
+    while (directory_[slot] >= 0)
+        slot = (slot + 1) & (directorySize_ - 1);
+    directory_[slot] = (int16_t)index;
+
+    userCount_++;
+    return (int)index;
+}
+
+int FaceGallery::addRecord(const char *name, const float *embedding)
+{
+    QuantizedEmbedding q;
+    quantizeEmbedding(embedding, q);
+    return addRecord(name, q);
+}
+
+int FaceGallery::addRecord(const char *name, const QuantizedEmbedding &embedding)
+{
+    if (!embeddings_ || !name || !name[0])
+        return -1;
+
+    if (recordCount_ == recordCapacity_ && !growRecords())
+        return -1;
+
+    int userIndex = findUser(name);
+    if (userIndex < 0)
+        userIndex = createUser(name);
+    if (userIndex < 0)
+        return -1;
+
+    size_t record = recordCount_++;
+    embeddings_[record] = embedding;
+    computeEmbeddingBounds(embedding, bounds_[record]);
+    recordUser_[record] = (uint16_t)userIndex;
+    users_[userIndex].records++;
+    revision_++;
+    if (index_)
+        index_->recordAdded(*this, record);
+    return (int)record;
+}
+
+int FaceGallery::removeUser(const char *name)
+{
+    int userIndex = findUser(name);
+    if (userIndex < 0)
+        return 0;
+
+    int removed = 0;
+    size_t i = 0;
+    while (i < recordCount_)
+    {
+        if (recordUser_[i] != userIndex)
+        {
+            i++;
+            continue;
+        }
+
+        // Swap-remove: last record fills the hole, re-check the same index
+        size_t last = --recordCount_;
+        if (i != last)
+        {
+            embeddings_[i] = embeddings_[last];
+            bounds_[i] = bounds_[last];
+            recordUser_[i] = recordUser_[last];
+            if (index_)
+                index_->recordMoved(last, i);
+        }
+        removed++;
+    }
+
+    if (index_)
+        index_->recordsTruncated(recordCount_);
+
+    users_[userIndex].records = 0;
+    userCount_--;
+    revision_++;
+    rebuildDirectory();
+    return removed;
+}
+
+int FaceGallery::fuseUser(const char *name, int maxTemplates)
+{
+    int userIndex = findUser(name);
+    if (userIndex < 0)
+        return 0;
+
+    int records = users_[userIndex].records;
+    if (maxTemplates < 1 || records <= 1)
+        return records;
+    if (maxTemplates > GALLERY_MAX_TEMPLATES)
+        maxTemplates = GALLERY_MAX_TEMPLATES;
+
+    uint32_t *members = (uint32_t *)psramAlloc(records * sizeof(uint32_t));
+    QuantizedEmbedding *templates = (QuantizedEmbedding *)psramAlloc(maxTemplates * sizeof(QuantizedEmbedding));
+    float *centroid = (float *)psramAlloc(FACE_EMBEDDING_DIM * sizeof(float)); // 2 KB: off the caller's stack
+    if (!members || !templates || !centroid)
+    {
+        psramFree(members);
+        psramFree(templates);
+        psramFree(centroid);
+        return records;
+    }
+
+    // Centroid of the unit-normalized captures
+    memset(centroid, 0, FACE_EMBEDDING_DIM * sizeof(float));
+    int count = 0;
+    for (size_t r = 0; r < recordCount_ && count < records; r++)
+    {
+        if (recordUser_[r] != userIndex)
+            continue;
+        members[count++] = (uint32_t)r;
+
+        const QuantizedEmbedding &e = embeddings_[r];
+        float inv = e.scale / e.norm;
+        for (int i = 0; i < FACE_EMBEDDING_DIM; i++)
+            centroid[i] += e.data[i] * inv;
+    }
+    quantizeEmbedding(centroid, templates[0]);
+    int kept = 1;
+
+    // Greedy farthest-first: each extra exemplar is the capture least similar
+    // to everything kept so far
+    while (kept < maxTemplates && kept < count + 1)
+    {
+        int pick = -1;
+        float pickScore = 2.0f;
+        for (int m = 0; m < count; m++)
+        {
+            if (members[m] == UINT32_MAX)
+                continue;
+            float closest = -2.0f;
+            for (int t = 0; t < kept; t++)
+            {
+                float s = cosineSimilarityQ8(embeddings_[members[m]], templates[t]);
+                if (s > closest)
+                    closest = s;
+            }
+            if (closest < pickScore)
+            {
+                pickScore = closest;
+                pick = m;
+            }
+        }
+        if (pick < 0)
+            break;
+        templates[kept++] = embeddings_[members[pick]];
+        members[pick] = UINT32_MAX;
+    }
+
+    char userName[FACE_NAME_LEN];
+    memcpy(userName, users_[userIndex].name, sizeof(userName));
+    removeUser(userName);
+    for (int t = 0; t < kept; t++)
+        addRecord(userName, templates[t]);
+
+    psramFree(members);
+    psramFree(templates);
+    psramFree(centroid);
+    return kept;
+}
+
+int FaceGallery::fuseAllUsers(int maxTemplates)
+{
+    size_t before = recordCount_;
+    char name[FACE_NAME_LEN];
+
+    // fuseUser() re-creates the user in the first free slot, which is never
+    // past its current slot, so a forward walk visits every user once
+    for (size_t i = 0; i < userSlots_; i++)
+    {
+        if (users_[i].records <= 1)
+            continue;
+        memcpy(name, users_[i].name, sizeof(name));
+        fuseUser(name, maxTemplates);
+    }
+    return (int)(before - recordCount_);
+}
+
+int FaceGallery::match(const QuantizedEmbedding &probe, float &similarity) const
+{
+    if (index_ && index_->trained())
+    {
+        int record = index_->search(*this, probe, similarity);
+        if (record >= 0)
+            return recordUser_[record];
+    }
+
+    int bestRecord = bestMatchQ8(probe, embeddings_, recordCount_, similarity);
+    return bestRecord < 0 ? -1 : recordUser_[bestRecord];
+}
+
+void FaceGallery::matchTopK(const QuantizedEmbedding &probe, int k, float threshold, float safeMargin, FaceMatchResult &result) const
+{
+    FaceTopK topK(probe, k, threshold, safeMargin);
+
+    int lists[ANN_MAX_PROBES];
+    float centroidSimilarity[ANN_MAX_PROBES];
+    size_t marginProbes = index_ && index_->probes() > ANN_MARGIN_PROBES ? index_->probes() : ANN_MARGIN_PROBES;
+    size_t listCount = index_ ? index_->closestLists(*this, probe, lists, marginProbes, centroidSimilarity) : 0;
+    if (listCount > 0)
+    {
+        size_t probed = index_->probes() < listCount ? index_->probes() : listCount;
+        for (size_t l = 0; l < listCount; l++)
+        {
+            if (l == probed && topK.best() < threshold)
+                break; // Rejected: the probed lists were the whole search
+
+            // The runner-up of an accepted match may sit in a list that was
+            // not probed. Within safeMargin of the best it scores at least
+            // threshold - safeMargin, so it lies next to the probe: only the
+            // next closest lists are visited, and of those only the ones whose
+            // centroid bound can still reach best - safeMargin. The cost stays
+            // O(sqrt(N)); a probe below the threshold keeps the IVF recall
+            // loss and can only be rejected by a record the probes missed.
+            size_t count;
+            const uint32_t *members = index_->listMembers(lists[l], count);
+            if (l >= probed && topK.skip(index_->listBound(lists[l], centroidSimilarity[l]), (uint32_t)count))
+                continue;
+            for (size_t m = 0; m < count; m++)
+            {
+                uint32_t r = members[m];
+                topK.offer((int)r, recordUser_[r], embeddings_[r], &bounds_[r]);
+            }
+        }
+    }
+    else
+    {
+        for (size_t r = 0; r < recordCount_; r++)
+            topK.offer((int)r, recordUser_[r], embeddings_[r], &bounds_[r]);
+    }
+
+    topK.finish(result);
+}
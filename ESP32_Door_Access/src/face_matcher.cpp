@@ -0,0 +1,141 @@
+/**
+ * Top-k Face Matcher
+ *
+ * similarity = dot(q, g) * q.scale * g.scale / (q.norm * g.norm), and after
+ * stage s the remaining dot product is bounded by ||q_tail|| * ||g_tail||
+ * (Cauchy-Schwarz), so
+ *   upper(s) = (partialDot + probeTail[s] * tail[s]) * factor
+ * never underestimates the final score. A candidate is dropped as soon as
+ * upper(s) falls below the current cutoff:
+ *   - the k-th best score once the list is full, and
+ *   - best - safeMargin once the best candidate passed the threshold.
+ */
+
+#include "face_matcher.h"
+
+#include <math.h>
+
+static void tailNorms(const QuantizedEmbedding &e, float *tail)
+{
+    int32_t sum = 0;
+    for (int s = MATCH_STAGES - 1; s > 0; s--)
+    {
+        const int8_t *p = e.data + s * MATCH_STAGE_DIM;
+        sum += dotProductS8(p, p, MATCH_STAGE_DIM);
+        tail[s - 1] = sqrtf((float)sum);
+    }
+}
+
+void computeEmbeddingBounds(const QuantizedEmbedding &embedding, EmbeddingBounds &bounds)
+{
+    tailNorms(embedding, bounds.tail);
+}
+
+FaceTopK::FaceTopK(const QuantizedEmbedding &probe, int k, float threshold, float safeMargin)
+    : probe_(probe), k_(k < 1 ? 1 : (k > MATCH_MAX_K ? MATCH_MAX_K : k)),
+      threshold_(threshold), safeMargin_(safeMargin), count_(0), prunedBound_(-2.0f), scored_(0), pruned_(0)
+{
+    tailNorms(probe, probeTail_);
+}
+
+float FaceTopK::cutoff() const
+{
+    float cut = -2.0f;
+    if (count_ == k_)
+        cut = top_[k_ - 1].similarity;
+    if (count_ > 0 && top_[0].similarity >= threshold_ && top_[0].similarity - safeMargin_ > cut)
+        cut = top_[0].similarity - safeMargin_;
+    return cut;
+}
+
+void FaceTopK::offer(int record, int user, const QuantizedEmbedding &embedding, const EmbeddingBounds *bounds)
+{
+    float factor = (probe_.scale * embedding.scale) / (probe_.norm * embedding.norm);
+
+    if (!bounds)
+    {
+        scored_++;
+        insert(record, user, dotProductS8(probe_.data, embedding.data, FACE_EMBEDDING_DIM) * factor);
+        return;
+    }
+
+    float cut = cutoff();
+    int32_t dot = 0;
+    for (int s = 0; s < MATCH_STAGES; s++)
+    {
+        dot += dotProductS8(probe_.data + s * MATCH_STAGE_DIM, embedding.data + s * MATCH_STAGE_DIM, MATCH_STAGE_DIM);
+        if (s == MATCH_STAGES - 1)
+            break;
+
+        float upper = (dot + probeTail_[s] * bounds->tail[s]) * factor;
+        if (upper < cut)
+        {
+            pruned_++;
+            if ((count_ == 0 || user != top_[0].user) && upper > prunedBound_)
+                prunedBound_ = upper;
+            return;
+        }
+    }
+
+    scored_++;
+    insert(record, user, dot * factor);
+}
+
+bool FaceTopK::skip(float upper, uint32_t candidates)
+{
+    if (upper >= cutoff())
+        return false;
+    pruned_ += candidates;
+    if (upper > prunedBound_)
+        prunedBound_ = upper; // May hold another user: blurs the margin like record pruning
+    return true;
+}
+
+void FaceTopK::insert(int record, int user, float similarity)
+{
+    // One entry per user: a better template of a listed user replaces its entry
+    int pos = -1;
+    for (int i = 0; i < count_; i++)
+    {
+        if (top_[i].user == user)
+        {
+            if (similarity <= top_[i].similarity)
+                return;
+            pos = i;
+            break;
+        }
+    }
+
+    if (pos < 0)
+    {
+        if (count_ < k_)
+            pos = count_++;
+        else if (similarity > top_[k_ - 1].similarity)
+            pos = k_ - 1;
+        else
+            return;
+    }
+
+    while (pos > 0 && top_[pos - 1].similarity < similarity)
+    {
+        top_[pos] = top_[pos - 1];
+        pos--;
+    }
+    top_[pos].user = user;
+    top_[pos].record = record;
+    top_[pos].similarity = similarity;
+}
+
+void FaceTopK::finish(FaceMatchResult &result) const
+{
+    result.count = count_;
+    for (int i = 0; i < count_; i++)
+        result.top[i] = top_[i];
+
+    float second = count_ > 1 ? top_[1].similarity : -1.0f;
+    if (prunedBound_ > second)
+        second = prunedBound_;
+    result.margin = count_ > 0 ? top_[0].similarity - second : 0.0f;
+    result.scored = scored_;
+    result.pruned = pruned_;
+}
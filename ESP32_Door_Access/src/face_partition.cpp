@@ -0,0 +1,412 @@
+/**
+ * Memory-Mapped Face Partition
+ *
+ * Snapshot layout (little endian, offsets from the partition start):
+ *   0   uint32 magic "FPRT" | uint16 version | uint16 embedding dim |
+ *       uint32 records | uint32 users | uint32 crc32(body) | uint32 reserved[3]
+ *   32  char names[users][FACE_NAME_LEN]              (padded to 16 bytes)
+ *   ..  uint16 recordUser[records]                    (padded to 16 bytes)
+ *   ..  QuantizedEmbedding[records]                   (16-byte aligned)
+ *   ..  EmbeddingBounds[records]                      (tail norms, see face_matcher.h)
+ *
+ * The body CRC doubles as a content checksum: galleryChecksum() feeds the
+ * same serialization into crc32Update(), so a snapshot is known to be up to
+ * date without comparing it record by record.
+ */
+
+#include "face_partition.h"
+#include "crc32.h"
+#include "psram_alloc.h"
+
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include <esp_partition.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define PARTITION_MAGIC 0x54525046 // "FPRT"
+#define PARTITION_HEADER_SIZE 32
+#define PARTITION_WRITE_CHUNK 1024 // Internal-RAM bounce buffer for flash writes
+#define PARTITION_SECTOR 4096
+
+// Embedding bytes covered by the snapshot (struct tail padding is written as zeros)
+#define PARTITION_EMBEDDING_BYTES (FACE_EMBEDDING_DIM + 2 * sizeof(float))
+
+static size_t align16(size_t n)
+{
+    return (n + 15) & ~(size_t)15;
+}
+
+static size_t namesOffset()
+{
+    return PARTITION_HEADER_SIZE;
+}
+
+static size_t recordUserOffset(size_t users)
+{
+    return align16(namesOffset() + users * FACE_NAME_LEN);
+}
+
+static size_t recordsOffset(size_t users, size_t records)
+{
+    return align16(recordUserOffset(users) + records * sizeof(uint16_t));
+}
+
+static size_t boundsOffset(size_t users, size_t records)
+{
+    return recordsOffset(users, records) + records * sizeof(QuantizedEmbedding);
+}
+
+static size_t snapshotSize(size_t users, size_t records)
+{
+    return boundsOffset(users, records) + records * sizeof(EmbeddingBounds);
+}
+
+// Serializes the snapshot body (everything after the header) into sink(data, len)
+template <typename Sink>
+static bool serializeBody(const FaceGallery &gallery, Sink &sink)
+{
+    static const uint8_t zeros[16] = {0};
+    size_t users = gallery.userCount();
+    size_t records = gallery.recordCount();
+
+    // Gallery user slots have holes after removals: number active users densely
+    uint16_t *dense = (uint16_t *)psramAlloc((gallery.userSlots() ? gallery.userSlots() : 1) * sizeof(uint16_t), 4);
+    if (!dense)
+        return false;
+
+    bool ok = true;
+    uint16_t next = 0;
+    gallery.forEachUser([&](int index, const GalleryUser &user) {
+        dense[index] = next++;
+        ok = ok && sink(user.name, FACE_NAME_LEN);
+    });
+
+    size_t pos = namesOffset() + users * FACE_NAME_LEN;
+    ok = ok && sink(zeros, recordUserOffset(users) - pos);
+
+    uint16_t owners[64];
+    for (size_t r = 0; ok && r < records; r += 64)
+    {
+        size_t n = records - r < 64 ? records - r : 64;
+        for (size_t i = 0; i < n; i++)
+            owners[i] = dense[gallery.recordUser(r + i)];
+        ok = sink(owners, n * sizeof(uint16_t));
+    }
+
+    pos = recordUserOffset(users) + records * sizeof(uint16_t);
+    ok = ok && sink(zeros, recordsOffset(users, records) - pos);
+
+    for (size_t r = 0; ok && r < records; r++)
+    {
+        ok = sink(&gallery.embedding(r), PARTITION_EMBEDDING_BYTES) &&
+             sink(zeros, sizeof(QuantizedEmbedding) - PARTITION_EMBEDDING_BYTES);
+    }
+
+    for (size_t r = 0; ok && r < records; r++)
+        ok = sink(&gallery.bounds(r), sizeof(EmbeddingBounds));
+
+    psramFree(dense);
+    return ok;
+}
+
+static void buildHeader(uint32_t *header, size_t records, size_t users, uint32_t crc)
+{
+    memset(header, 0, PARTITION_HEADER_SIZE);
+    header[0] = PARTITION_MAGIC;
+    header[1] = FACE_PARTITION_VERSION | ((uint32_t)FACE_EMBEDDING_DIM << 16);
+    header[2] = (uint32_t)records;
+    header[3] = (uint32_t)users;
+    header[4] = crc;
+}
+
+uint32_t FacePartition::galleryChecksum(const FaceGallery &gallery)
+{
+    uint32_t crc = 0;
+    auto sink = [&](const void *data, size_t len) {
+        crc = crc32Update(crc, data, len);
+        return true;
+    };
+    return serializeBody(gallery, sink) ? crc : 0;
+}
+
+uint8_t *FacePartition::serialize(const FaceGallery &gallery, size_t &size, uint32_t &checksum)
+{
+    size_t records = gallery.recordCount();
+    size_t users = gallery.userCount();
+    size = snapshotSize(users, records);
+    uint8_t *image = (uint8_t *)psramAlloc(size, 16);
+    if (!image)
+        return nullptr;
+
+    size_t offset = PARTITION_HEADER_SIZE;
+    uint32_t crc = 0;
+    auto sink = [&](const void *data, size_t len) {
+        crc = crc32Update(crc, data, len);
+        memcpy(image + offset, data, len);
+        offset += len;
+        return true;
+    };
+    if (!serializeBody(gallery, sink))
+    {
+        psramFree(image);
+        return nullptr;
+    }
+
+    buildHeader((uint32_t *)image, records, users, crc);
+    checksum = crc;
+    return image;
+}
+
+bool FacePartition::write(const FaceGallery &gallery)
+{
+    size_t size;
+    uint32_t checksum;
+    uint8_t *image = serialize(gallery, size, checksum);
+    if (!image)
+        return false;
+    bool ok = write(image, size);
+    psramFree(image);
+    return ok;
+}
+
+FacePartition::FacePartition()
+    : base_(nullptr), capacity_(0), names_(nullptr), recordUser_(nullptr), records_(nullptr), bounds_(nullptr),
+      recordCount_(0), userCount_(0), checksum_(0),
+#ifdef ESP_PLATFORM
+      partition_(nullptr), mapHandle_(0)
+#else
+      fd_(-1)
+#endif
+{
+}
+
+FacePartition::~FacePartition()
+{
+    close();
+}
+
+bool FacePartition::parse()
+{
+    names_ = nullptr;
+    recordUser_ = nullptr;
+    records_ = nullptr;
+    bounds_ = nullptr;
+    recordCount_ = 0;
+    userCount_ = 0;
+    checksum_ = 0;
+
+    if (!base_ || capacity_ < PARTITION_HEADER_SIZE)
+        return false;
+
+    uint32_t header[PARTITION_HEADER_SIZE / 4];
+    memcpy(header, base_, PARTITION_HEADER_SIZE);
+    if (header[0] != PARTITION_MAGIC ||
+        (header[1] & 0xFFFF) != FACE_PARTITION_VERSION ||
+        (header[1] >> 16) != FACE_EMBEDDING_DIM)
+        return false;
+
+    size_t records = header[2];
+    size_t users = header[3];
+    size_t end = snapshotSize(users, records);
+    if (users > 0xFFFF || end > capacity_)
+        return false;
+
+    // One pass over the mapped body at open; matching never re-checks it
+    if (crc32Update(0, base_ + PARTITION_HEADER_SIZE, end - PARTITION_HEADER_SIZE) != header[4])
+        return false;
+
+    names_ = (const char *)(base_ + namesOffset());
+    recordUser_ = (const uint16_t *)(base_ + recordUserOffset(users));
+    records_ = (const QuantizedEmbedding *)(base_ + recordsOffset(users, records));
+    bounds_ = (const EmbeddingBounds *)(base_ + boundsOffset(users, records));
+    recordCount_ = records;
+    userCount_ = users;
+    checksum_ = header[4];
+    return true;
+}
+
+int FacePartition::match(const QuantizedEmbedding &probe, float &similarity) const
+{
+    if (!records_)
+    {
+        similarity = -1.0f;
+        return -1;
+    }
+    return bestMatchQ8(probe, records_, recordCount_, similarity);
+}
+
+void FacePartition::matchTopK(const QuantizedEmbedding &probe, int k, float threshold, float safeMargin, FaceMatchResult &result) const
+{
+    FaceTopK topK(probe, k, threshold, safeMargin);
+    for (size_t r = 0; r < recordCount_; r++)
+        topK.offer((int)r, recordUser_[r], records_[r], &bounds_[r]);
+    topK.finish(result);
+}
+
+#ifdef ESP_PLATFORM
+
+bool FacePartition::open(const char *label)
+{
+    close();
+    const esp_partition_t *partition = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)FACE_PARTITION_SUBTYPE, label);
+    if (!partition)
+        return false;
+
+    partition_ = partition;
+    capacity_ = partition->size;
+    if (!map())
+    {
+        close();
+        return false;
+    }
+    parse();
+    return true;
+}
+
+bool FacePartition::map()
+{
+    const esp_partition_t *partition = (const esp_partition_t *)partition_;
+    const void *ptr = nullptr;
+    esp_partition_mmap_handle_t handle;
+    if (esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &ptr, &handle) != ESP_OK)
+        return false;
+    base_ = (const uint8_t *)ptr;
+    mapHandle_ = handle;
+    return true;
+}
+
+void FacePartition::unmap()
+{
+    if (base_)
+        esp_partition_munmap(mapHandle_);
+    base_ = nullptr;
+    parse();
+}
+
+void FacePartition::close()
+{
+    unmap();
+    partition_ = nullptr;
+    capacity_ = 0;
+}
+
+bool FacePartition::isOpen() const
+{
+    return partition_ != nullptr;
+}
+
+bool FacePartition::write(const uint8_t *image, size_t size)
+{
+    if (!partition_ || size < PARTITION_HEADER_SIZE || size > capacity_)
+        return false;
+
+    const esp_partition_t *partition = (const esp_partition_t *)partition_;
+
+    // The mapping must not be read while its sectors are rewritten
+    unmap();
+
+    size_t eraseSize = (size + PARTITION_SECTOR - 1) & ~(size_t)(PARTITION_SECTOR - 1);
+    bool ok = esp_partition_erase_range(partition, 0, eraseSize) == ESP_OK;
+
+    // The image lives in PSRAM: stage it through an internal-RAM buffer
+    uint8_t *chunk = (uint8_t *)heap_caps_malloc(PARTITION_WRITE_CHUNK, MALLOC_CAP_INTERNAL);
+    ok = ok && chunk;
+    for (size_t offset = PARTITION_HEADER_SIZE; ok && offset < size; offset += PARTITION_WRITE_CHUNK)
+    {
+        size_t n = size - offset < PARTITION_WRITE_CHUNK ? size - offset : PARTITION_WRITE_CHUNK;
+        memcpy(chunk, image + offset, n);
+        ok = esp_partition_write(partition, offset, chunk, n) == ESP_OK;
+    }
+
+    // Header last: until it lands, the erased (0xFF) magic marks the snapshot invalid
+    if (ok)
+    {
+        memcpy(chunk, image, PARTITION_HEADER_SIZE);
+        ok = esp_partition_write(partition, 0, chunk, PARTITION_HEADER_SIZE) == ESP_OK;
+    }
+    heap_caps_free(chunk);
+
+    return map() && parse() && ok;
+}
+
+#else // Host stand-in: the "partition" is a regular file of fixed size mapped with mmap(2)
+
+bool FacePartition::open(const char *path)
+{
+    close();
+    // Like a partition table entry, the backing file has to exist with its size
+    fd_ = ::open(path, O_RDWR);
+    if (fd_ < 0)
+        return false;
+    if (!map())
+    {
+        close();
+        return false;
+    }
+    parse();
+    return true;
+}
+
+bool FacePartition::map()
+{
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || st.st_size == 0)
+        return false;
+
+    void *ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd_, 0);
+    if (ptr == MAP_FAILED)
+        return false;
+    base_ = (const uint8_t *)ptr;
+    capacity_ = st.st_size;
+    return true;
+}
+
+void FacePartition::unmap()
+{
+    if (base_)
+        munmap((void *)base_, capacity_);
+    base_ = nullptr;
+    capacity_ = 0;
+    parse();
+}
+
+void FacePartition::close()
+{
+    unmap();
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+}
+
+bool FacePartition::isOpen() const
+{
+    return fd_ >= 0;
+}
+
+bool FacePartition::write(const uint8_t *image, size_t size)
+{
+    if (fd_ < 0 || size < PARTITION_HEADER_SIZE || size > capacity_)
+        return false;
+
+    unmap();
+
+    // Header slot stays zero (invalid) until the body is complete; the file
+    // keeps its size, as a partition does
+    uint8_t empty[PARTITION_HEADER_SIZE] = {0};
+    bool ok = pwrite(fd_, empty, PARTITION_HEADER_SIZE, 0) == PARTITION_HEADER_SIZE && fsync(fd_) == 0;
+    size_t body = size - PARTITION_HEADER_SIZE;
+    ok = ok && (body == 0 || pwrite(fd_, image + PARTITION_HEADER_SIZE, body, PARTITION_HEADER_SIZE) == (ssize_t)body);
+    ok = ok && fsync(fd_) == 0;
+    ok = ok && pwrite(fd_, image, PARTITION_HEADER_SIZE, 0) == PARTITION_HEADER_SIZE && fsync(fd_) == 0;
+
+    return map() && parse() && ok;
+}
+
+#endif
@@ -0,0 +1,98 @@
+/**
+ * Region-of-Interest Face Search
+ *
+ * The ROI is a square centred on the last face box, clamped into the frame
+ * (shifted, not shrunk, at the borders) so a face moving towards an edge
+ * stays inside it. A miss forgets the box: the full-frame scan that follows
+ * either finds the face again (new ROI) or ends the search until the next
+ * detection.
+ */
+
+#include "face_roi.h"
+
+#include <string.h>
+
+FaceRoiTracker::FaceRoiTracker() : haveFace_(false)
+{
+    last_ = {0, 0, 0, 0};
+    stats_.roiSearches = 0;
+    stats_.roiHits = 0;
+    stats_.fullSearches = 0;
+    stats_.pixelsScanned = 0;
+}
+
+static int clampInt(int v, int lo, int hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+bool FaceRoiTracker::next(int frameWidth, int frameHeight, FaceRoi &roi) const
+{
+    if (!haveFace_ || frameWidth <= 0 || frameHeight <= 0)
+        return false;
+
+    int side = (int)((last_.width > last_.height ? last_.width : last_.height) * ROI_EXPAND);
+    if (side < ROI_MIN_SIZE)
+        side = ROI_MIN_SIZE;
+    roi.width = side < frameWidth ? side : frameWidth;
+    roi.height = side < frameHeight ? side : frameHeight;
+    if ((float)roi.width * roi.height > ROI_MAX_AREA_FRACTION * frameWidth * frameHeight)
+        return false;
+
+    roi.x = clampInt(last_.cx - roi.width / 2, 0, frameWidth - roi.width);
+    roi.y = clampInt(last_.cy - roi.height / 2, 0, frameHeight - roi.height);
+    return true;
+}
+
+void FaceRoiTracker::roiHit(const FaceBox &box, const FaceRoi &roi)
+{
+    stats_.roiSearches++;
+    stats_.roiHits++;
+    stats_.pixelsScanned += (uint64_t)roi.width * roi.height;
+    last_ = box;
+    haveFace_ = true;
+}
+
+void FaceRoiTracker::roiMiss(const FaceRoi &roi)
+{
+    stats_.roiSearches++;
+    stats_.pixelsScanned += (uint64_t)roi.width * roi.height;
+    haveFace_ = false;
+}
+
+void FaceRoiTracker::fullFound(const FaceBox &box, int frameWidth, int frameHeight)
+{
+    stats_.fullSearches++;
+    stats_.pixelsScanned += (uint64_t)frameWidth * frameHeight;
+    last_ = box;
+    haveFace_ = true;
+}
+
+void FaceRoiTracker::fullMissed(int frameWidth, int frameHeight)
+{
+    stats_.fullSearches++;
+    stats_.pixelsScanned += (uint64_t)frameWidth * frameHeight;
+    haveFace_ = false;
+}
+
+void cropRgb888(const uint8_t *frame, int frameWidth, const FaceRoi &roi, uint8_t *out)
+{
+    size_t rowBytes = (size_t)roi.width * 3;
+    const uint8_t *src = frame + ((size_t)roi.y * frameWidth + roi.x) * 3;
+    for (int row = 0; row < roi.height; row++)
+    {
+        memcpy(out, src, rowBytes);
+        out += rowBytes;
+        src += (size_t)frameWidth * 3;
+    }
+}
+
+FaceBox roiBoxToFrame(const FaceRoi &roi, int left, int top, int right, int bottom)
+{
+    FaceBox box;
+    box.cx = roi.x + (left + right) / 2;
+    box.cy = roi.y + (top + bottom) / 2;
+    box.width = right - left;
+    box.height = bottom - top;
+    return box;
+}
@@ -0,0 +1,481 @@
+/**
+ * Journaled Face Store
+ *
+ * File header (16 bytes, little endian):
+ *   uint32 magic "FJNL" | uint16 version | uint16 embedding dim |
+ *   uint16 name length | uint16 reserved | uint32 crc32(header[0..11])
+ *
+ * Record layout (little endian):
+ *   uint16 magic (0xFA5E) | uint8 type | uint8 reserved | uint16 length |
+ *   uint16 reserved | uint32 sequence | uint32 crc32(header[0..11] + payload)
+ *   payload[length]
+ *
+ * Deletions never rewrite the file: a tombstone (or a CLEAR record for
+ * everyone) is appended and applied to the in-memory gallery immediately. Compaction writes <log>.tmp ending with
+ * a COMMIT record; only a temp log with a valid COMMIT is ever promoted, so
+ * a crash at any point leaves either the old or the new log intact.
+ */
+
+#include "face_store.h"
+#include "crc32.h"
+#include "psram_alloc.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#define STORE_FILE_MAGIC 0x4C4E4A46 // "FJNL"
+#define STORE_FILE_HEADER_SIZE 16
+#define STORE_MAGIC 0xFA5E
+#define STORE_HEADER_SIZE 16
+#define STORE_ENROLL_PAYLOAD (FACE_NAME_LEN + FACE_EMBEDDING_DIM + 2 * sizeof(float))
+#define STORE_MAX_PAYLOAD STORE_ENROLL_PAYLOAD
+
+#define STORE_COPY_CHUNK 1024 // Tail carried over by finishCompaction()
+
+static void putU16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void putU32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = (v >> (8 * i)) & 0xFF;
+}
+
+static uint16_t getU16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t getU32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void encodeEnroll(uint8_t *payload, const char *name, const QuantizedEmbedding &e)
+{
+    memset(payload, 0, FACE_NAME_LEN);
+    memcpy(payload, name, strnlen(name, FACE_NAME_LEN - 1));
+    memcpy(payload + FACE_NAME_LEN, e.data, FACE_EMBEDDING_DIM);
+    memcpy(payload + FACE_NAME_LEN + FACE_EMBEDDING_DIM, &e.scale, sizeof(float));
+    memcpy(payload + FACE_NAME_LEN + FACE_EMBEDDING_DIM + sizeof(float), &e.norm, sizeof(float));
+}
+
+static void decodeEnroll(const uint8_t *payload, char *name, QuantizedEmbedding &e)
+{
+    memcpy(name, payload, FACE_NAME_LEN);
+    name[FACE_NAME_LEN - 1] = '\0';
+    memcpy(e.data, payload + FACE_NAME_LEN, FACE_EMBEDDING_DIM);
+    memcpy(&e.scale, payload + FACE_NAME_LEN + FACE_EMBEDDING_DIM, sizeof(float));
+    memcpy(&e.norm, payload + FACE_NAME_LEN + FACE_EMBEDDING_DIM + sizeof(float), sizeof(float));
+}
+
+static void encodeFileHeader(uint8_t *header)
+{
+    memset(header, 0, STORE_FILE_HEADER_SIZE);
+    putU32(header, STORE_FILE_MAGIC);
+    putU16(header + 4, FACE_STORE_VERSION);
+    putU16(header + 6, FACE_EMBEDDING_DIM);
+    putU16(header + 8, FACE_NAME_LEN);
+    putU32(header + 12, crc32Update(0, header, 12));
+}
+
+static void encodeRecordHeader(uint8_t *header, uint8_t type, uint32_t sequence, const uint8_t *payload, uint16_t length)
+{
+    memset(header, 0, STORE_HEADER_SIZE);
+    putU16(header, STORE_MAGIC);
+    header[2] = type;
+    putU16(header + 4, length);
+    putU32(header + 8, sequence);
+    uint32_t crc = crc32Update(0, header, 12);
+    putU32(header + 12, crc32Update(crc, payload, length));
+}
+
+// Reads one record. Returns false at EOF or on a torn/corrupt record.
+static bool readRecord(FILE *f, uint8_t &type, uint8_t *payload, uint16_t &length, bool &corrupt)
+{
+    uint8_t header[STORE_HEADER_SIZE];
+    corrupt = false;
+
+    size_t got = fread(header, 1, STORE_HEADER_SIZE, f);
+    if (got == 0)
+        return false;
+    if (got != STORE_HEADER_SIZE || getU16(header) != STORE_MAGIC)
+    {
+        corrupt = true;
+        return false;
+    }
+
+    type = header[2];
+    length = getU16(header + 4);
+    if (length > STORE_MAX_PAYLOAD || fread(payload, 1, length, f) != length)
+    {
+        corrupt = true;
+        return false;
+    }
+
+    uint32_t crc = crc32Update(0, header, 12);
+    crc = crc32Update(crc, payload, length);
+    if (crc != getU32(header + 12))
+    {
+        corrupt = true;
+        return false;
+    }
+    return true;
+}
+
+FaceStore::FaceStore()
+    : file_(nullptr), fileBytes_(0), sequence_(0), corruptRecords_(0), version_(FACE_STORE_VERSION), tornTail_(false),
+      compactMark_(0), compactBytes_(0)
+{
+    path_[0] = '\0';
+    tempPath_[0] = '\0';
+}
+
+FaceStore::~FaceStore()
+{
+    end();
+}
+
+bool FaceStore::begin(const char *path)
+{
+    end();
+    strncpy(path_, path, sizeof(path_) - 1);
+    path_[sizeof(path_) - 1] = '\0';
+    snprintf(tempPath_, sizeof(tempPath_), "%s.tmp", path_);
+
+    recoverCompaction();
+
+    file_ = fopen(path_, "ab");
+    if (!file_)
+        return false;
+    fseek(file_, 0, SEEK_END);
+    fileBytes_ = ftell(file_);
+
+    if (fileBytes_ == 0)
+    {
+        if (!writeFileHeader(file_) || !syncFile(file_))
+            return false;
+        fileBytes_ = STORE_FILE_HEADER_SIZE;
+    }
+    return true;
+}
+
+bool FaceStore::writeFileHeader(FILE *f)
+{
+    uint8_t header[STORE_FILE_HEADER_SIZE];
+    encodeFileHeader(header);
+    return fwrite(header, 1, STORE_FILE_HEADER_SIZE, f) == STORE_FILE_HEADER_SIZE;
+}
+
+void FaceStore::end()
+{
+    if (file_)
+    {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+bool FaceStore::exists() const
+{
+    return fileBytes_ > STORE_FILE_HEADER_SIZE;
+}
+
+void FaceStore::recoverCompaction()
+{
+    FILE *tmp = fopen(tempPath_, "rb");
+    if (!tmp)
+        return;
+
+    // Promote the temp log only if it was written completely
+    uint8_t payload[STORE_MAX_PAYLOAD];
+    uint8_t type = 0, lastType = 0;
+    uint16_t length;
+    bool corrupt = false;
+    fseek(tmp, STORE_FILE_HEADER_SIZE, SEEK_SET);
+    while (readRecord(tmp, type, payload, length, corrupt))
+        lastType = type;
+    fclose(tmp);
+
+    if (!corrupt && lastType == STORE_RECORD_COMMIT)
+    {
+        remove(path_);
+        rename(tempPath_, path_);
+    }
+    else
+    {
+        remove(tempPath_);
+    }
+}
+
+bool FaceStore::replay(FaceGallery &gallery)
+{
+    FILE *f = fopen(path_, "rb");
+    if (!f)
+        return false;
+
+    uint8_t payload[STORE_MAX_PAYLOAD];
+    uint8_t type;
+    uint16_t length;
+    bool corrupt = false;
+    char name[FACE_NAME_LEN];
+    QuantizedEmbedding embedding;
+
+    // Versioned header (0 = missing or corrupt)
+    uint8_t header[STORE_FILE_HEADER_SIZE];
+    bool valid = fread(header, 1, STORE_FILE_HEADER_SIZE, f) == STORE_FILE_HEADER_SIZE &&
+                 getU32(header) == STORE_FILE_MAGIC &&
+                 getU32(header + 12) == crc32Update(0, header, 12);
+    version_ = valid ? getU16(header + 4) : 0;
+    if (version_ != FACE_STORE_VERSION || getU16(header + 6) != FACE_EMBEDDING_DIM ||
+        getU16(header + 8) != FACE_NAME_LEN)
+    {
+        // Unknown layout: leave the file untouched and refuse to append
+        fclose(f);
+        end();
+        return false;
+    }
+
+    gallery.clear();
+    while (readRecord(f, type, payload, length, corrupt))
+    {
+        sequence_++;
+        if (type == STORE_RECORD_ENROLL && length == STORE_ENROLL_PAYLOAD)
+        {
+            decodeEnroll(payload, name, embedding);
+            gallery.addRecord(name, embedding);
+        }
+        else if (type == STORE_RECORD_TOMBSTONE && length == FACE_NAME_LEN)
+        {
+            memcpy(name, payload, FACE_NAME_LEN);
+            name[FACE_NAME_LEN - 1] = '\0';
+            gallery.removeUser(name);
+        }
+        else if (type == STORE_RECORD_CLEAR)
+        {
+            gallery.clear();
+        }
+    }
+    fclose(f);
+
+    // Anything after the first bad record is a torn write from a crash;
+    // appends would land behind it, so the next compaction must drop it
+    if (corrupt)
+    {
+        corruptRecords_++;
+        tornTail_ = true;
+    }
+    return true;
+}
+
+bool FaceStore::syncFile(FILE *f)
+{
+    if (fflush(f) != 0)
+        return false;
+    fsync(fileno(f));
+    return true;
+}
+
+bool FaceStore::appendRecord(FILE *f, uint8_t type, const uint8_t *payload, uint16_t length)
+{
+    uint8_t header[STORE_HEADER_SIZE];
+    encodeRecordHeader(header, type, ++sequence_, payload, length);
+    if (fwrite(header, 1, STORE_HEADER_SIZE, f) != STORE_HEADER_SIZE)
+        return false;
+    if (length > 0 && fwrite(payload, 1, length, f) != length)
+        return false;
+    return true;
+}
+
+bool FaceStore::appendEnroll(const char *name, const QuantizedEmbedding &embedding)
+{
+    if (!file_)
+        return false;
+
+    uint8_t payload[STORE_ENROLL_PAYLOAD];
+    encodeEnroll(payload, name, embedding);
+    if (!appendRecord(file_, STORE_RECORD_ENROLL, payload, STORE_ENROLL_PAYLOAD) || !syncFile(file_))
+        return false;
+
+    fileBytes_ += STORE_HEADER_SIZE + STORE_ENROLL_PAYLOAD;
+    return true;
+}
+
+bool FaceStore::appendUser(const FaceGallery &gallery, const char *name)
+{
+    if (!file_)
+        return false;
+
+    int user = gallery.findUser(name);
+    if (user < 0)
+        return false;
+
+    uint8_t payload[STORE_ENROLL_PAYLOAD];
+    for (size_t r = 0; r < gallery.recordCount(); r++)
+    {
+        if (gallery.recordUser(r) != user)
+            continue;
+        encodeEnroll(payload, gallery.user(user).name, gallery.embedding(r));
+        if (!appendRecord(file_, STORE_RECORD_ENROLL, payload, STORE_ENROLL_PAYLOAD))
+            return false;
+        fileBytes_ += STORE_HEADER_SIZE + STORE_ENROLL_PAYLOAD;
+    }
+    return syncFile(file_);
+}
+
+bool FaceStore::appendTombstone(const char *name)
+{
+    if (!file_)
+        return false;
+
+    uint8_t payload[FACE_NAME_LEN] = {0};
+    memcpy(payload, name, strnlen(name, FACE_NAME_LEN - 1));
+    if (!appendRecord(file_, STORE_RECORD_TOMBSTONE, payload, FACE_NAME_LEN) || !syncFile(file_))
+        return false;
+
+    fileBytes_ += STORE_HEADER_SIZE + FACE_NAME_LEN;
+    return true;
+}
+
+bool FaceStore::appendClear()
+{
+    if (!file_)
+        return false;
+
+    uint8_t payload[1] = {0};
+    if (!appendRecord(file_, STORE_RECORD_CLEAR, payload, 0) || !syncFile(file_))
+        return false;
+
+    fileBytes_ += STORE_HEADER_SIZE;
+    return true;
+}
+
+size_t FaceStore::liveBytes(const FaceGallery &gallery) const
+{
+    return gallery.recordCount() * (STORE_HEADER_SIZE + STORE_ENROLL_PAYLOAD);
+}
+
+bool FaceStore::needsCompaction(const FaceGallery &gallery) const
+{
+    if (version_ != FACE_STORE_VERSION)
+        return false;
+    if (tornTail_)
+        return true;
+    size_t live = STORE_FILE_HEADER_SIZE + liveBytes(gallery);
+    size_t dead = fileBytes_ > live ? fileBytes_ - live : 0;
+    return dead >= FACE_STORE_COMPACT_MIN_DEAD && dead > live;
+}
+
+bool FaceStore::compact(const FaceGallery &gallery)
+{
+    size_t size;
+    uint8_t *image = prepareCompaction(gallery, size);
+    if (!image)
+        return false;
+    bool ok = writeCompaction(image, size);
+    psramFree(image);
+    return ok && finishCompaction();
+}
+
+uint8_t *FaceStore::prepareCompaction(const FaceGallery &gallery, size_t &size)
+{
+    if (version_ != FACE_STORE_VERSION)
+        return nullptr; // Never overwrite a journal we could not read
+
+    size = STORE_FILE_HEADER_SIZE + liveBytes(gallery);
+    uint8_t *image = (uint8_t *)psramAlloc(size);
+    if (!image)
+        return nullptr;
+
+    uint8_t *p = image;
+    encodeFileHeader(p);
+    p += STORE_FILE_HEADER_SIZE;
+
+    for (size_t r = 0; r < gallery.recordCount(); r++)
+    {
+        uint8_t *payload = p + STORE_HEADER_SIZE;
+        encodeEnroll(payload, gallery.user(gallery.recordUser(r)).name, gallery.embedding(r));
+        encodeRecordHeader(p, STORE_RECORD_ENROLL, ++sequence_, payload, STORE_ENROLL_PAYLOAD);
+        p += STORE_HEADER_SIZE + STORE_ENROLL_PAYLOAD;
+    }
+
+    compactMark_ = fileBytes_;
+    compactBytes_ = 0;
+    return image;
+}
+
+bool FaceStore::writeCompaction(const uint8_t *image, size_t size)
+{
+    FILE *tmp = fopen(tempPath_, "wb");
+    if (!tmp)
+        return false;
+    bool ok = fwrite(image, 1, size, tmp) == size && syncFile(tmp);
+    fclose(tmp);
+    if (!ok)
+    {
+        remove(tempPath_);
+        return false;
+    }
+    compactBytes_ = size;
+    return true;
+}
+
+bool FaceStore::finishCompaction()
+{
+    if (compactBytes_ == 0)
+        return false;
+    size_t written = compactBytes_;
+    compactBytes_ = 0;
+
+    FILE *tmp = fopen(tempPath_, "ab");
+    if (!tmp)
+    {
+        remove(tempPath_);
+        return false;
+    }
+
+    // Records journaled while the image was written (already fsync'd there)
+    bool ok = true;
+    if (fileBytes_ > compactMark_)
+    {
+        FILE *log = fopen(path_, "rb");
+        ok = log && fseek(log, (long)compactMark_, SEEK_SET) == 0;
+        uint8_t chunk[STORE_COPY_CHUNK];
+        size_t left = fileBytes_ - compactMark_;
+        while (ok && left > 0)
+        {
+            size_t n = left < sizeof(chunk) ? left : sizeof(chunk);
+            ok = fread(chunk, 1, n, log) == n && fwrite(chunk, 1, n, tmp) == n;
+            left -= n;
+            written += n;
+        }
+        if (log)
+            fclose(log);
+    }
+
+    uint8_t payload[1] = {0};
+    ok = ok && appendRecord(tmp, STORE_RECORD_COMMIT, payload, 0) && syncFile(tmp);
+    fclose(tmp);
+    written += STORE_HEADER_SIZE;
+
+    if (!ok)
+    {
+        remove(tempPath_);
+        return false;
+    }
+
+    // Swap logs. A crash between remove() and rename() is repaired by
+    // recoverCompaction() on the next begin().
+    end();
+    remove(path_);
+    rename(tempPath_, path_);
+
+    file_ = fopen(path_, "ab");
+    fileBytes_ = written;
+    version_ = FACE_STORE_VERSION;
+    tornTail_ = false;
+    return file_ != nullptr;
+}
@@ -0,0 +1,92 @@
+/**
+ * Face Track Cache
+ *
+ * Two IoU tests per frame: against the previous frame (is this still the
+ * same face?) and against the anchor box the cached embedding was computed
+ * on (has the face moved/turned enough that the embedding may be stale?).
+ * Slow drift therefore keeps the track alive but still triggers a re-embed.
+ */
+
+#include "face_tracker.h"
+
+#include <string.h>
+
+float faceBoxIoU(const FaceBox &a, const FaceBox &b)
+{
+    int ax0 = a.cx - a.width / 2, ax1 = ax0 + a.width;
+    int ay0 = a.cy - a.height / 2, ay1 = ay0 + a.height;
+    int bx0 = b.cx - b.width / 2, bx1 = bx0 + b.width;
+    int by0 = b.cy - b.height / 2, by1 = by0 + b.height;
+
+    int iw = (ax1 < bx1 ? ax1 : bx1) - (ax0 > bx0 ? ax0 : bx0);
+    int ih = (ay1 < by1 ? ay1 : by1) - (ay0 > by0 ? ay0 : by0);
+    if (iw <= 0 || ih <= 0)
+        return 0.0f;
+
+    float inter = (float)iw * ih;
+    float uni = (float)a.width * a.height + (float)b.width * b.height - inter;
+    return uni > 0.0f ? inter / uni : 0.0f;
+}
+
+FaceTracker::FaceTracker()
+    : active_(false), cached_(false), last_(), anchor_(), anchorMs_(0), revision_(0), reusedFrames_(0),
+      matched_(false), similarity_(0.0f), stats_()
+{
+    name_[0] = '\0';
+}
+
+FaceTrackDecision FaceTracker::update(const FaceBox &box, uint32_t nowMs, uint32_t galleryRevision)
+{
+    stats_.frames++;
+
+    FaceTrackDecision decision;
+    if (!active_ || faceBoxIoU(box, last_) < TRACK_MIN_IOU)
+    {
+        decision = TRACK_NEW;
+        stats_.tracks++;
+    }
+    else if (faceBoxIoU(box, anchor_) < TRACK_DRIFT_IOU)
+    {
+        decision = TRACK_DRIFT;
+        stats_.drifts++;
+    }
+    else if (!cached_ || galleryRevision != revision_ ||
+             reusedFrames_ >= TRACK_REFRESH_FRAMES || nowMs - anchorMs_ >= TRACK_REFRESH_MS)
+    {
+        decision = TRACK_REFRESH;
+        stats_.refreshes++;
+    }
+    else
+    {
+        decision = TRACK_REUSE;
+    }
+
+    active_ = true;
+    last_ = box;
+
+    if (decision == TRACK_REUSE)
+    {
+        reusedFrames_++;
+        stats_.reused++;
+        return decision;
+    }
+
+    // Caller runs the recognizer and reports back through store()
+    cached_ = false;
+    anchor_ = box;
+    anchorMs_ = nowMs;
+    revision_ = galleryRevision;
+    reusedFrames_ = 0;
+    stats_.inferences++;
+    return decision;
+}
+
+void FaceTracker::store(bool matched, const char *name, float similarity)
+{
+    matched_ = matched;
+    similarity_ = similarity;
+    memset(name_, 0, sizeof(name_));
+    if (name)
+        strncpy(name_, name, TRACK_NAME_LEN - 1);
+    cached_ = true;
+}
@@ -0,0 +1,93 @@
+/**
+ * Multi-Face Track Set
+ *
+ * Association is greedy in detection order: each box takes the unclaimed
+ * active track it overlaps most (IoU >= TRACK_MIN_IOU). With a handful of
+ * faces at a door, greedy and optimal assignment practically never differ,
+ * and it keeps the per-frame cost at a few dozen IoU evaluations.
+ */
+
+#include "face_tracks.h"
+
+FaceTrackSet::FaceTrackSet() : nextId_(1)
+{
+    clear();
+}
+
+void FaceTrackSet::clear()
+{
+    for (int i = 0; i < MAX_FACE_TRACKS; i++)
+    {
+        slots_[i].active = false;
+        slots_[i].seen = false;
+        slots_[i].tracker.reset();
+    }
+}
+
+void FaceTrackSet::beginFrame()
+{
+    for (int i = 0; i < MAX_FACE_TRACKS; i++)
+        slots_[i].seen = false;
+}
+
+int FaceTrackSet::assign(const FaceBox &box)
+{
+    int best = -1;
+    float bestIoU = TRACK_MIN_IOU;
+    int free = -1;
+    for (int i = 0; i < MAX_FACE_TRACKS; i++)
+    {
+        FaceTrackSlot &slot = slots_[i];
+        if (!slot.active)
+        {
+            if (free < 0)
+                free = i;
+            continue;
+        }
+        if (slot.seen)
+            continue;
+        float iou = faceBoxIoU(slot.box, box);
+        if (iou >= bestIoU)
+        {
+            best = i;
+            bestIoU = iou;
+        }
+    }
+
+    if (best < 0)
+    {
+        if (free < 0)
+            return -1;
+        best = free;
+        FaceTrackSlot &slot = slots_[best];
+        slot.active = true;
+        slot.id = nextId_++;
+        if (nextId_ == 0)
+            nextId_ = 1;
+        slot.tracker.reset();
+    }
+
+    slots_[best].seen = true;
+    slots_[best].box = box;
+    return best;
+}
+
+void FaceTrackSet::endFrame()
+{
+    for (int i = 0; i < MAX_FACE_TRACKS; i++)
+    {
+        if (slots_[i].active && !slots_[i].seen)
+        {
+            slots_[i].active = false;
+            slots_[i].tracker.reset();
+        }
+    }
+}
+
+size_t FaceTrackSet::activeCount() const
+{
+    size_t n = 0;
+    for (int i = 0; i < MAX_FACE_TRACKS; i++)
+        n += slots_[i].active;
+    return n;
+}
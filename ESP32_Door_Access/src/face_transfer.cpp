@@ -0,0 +1,428 @@
+/**
+ * Face Gallery Transfer
+ *
+ * Stream layout (little endian):
+ *   uint32 magic "FGEX" | uint16 version | uint16 embedding dim |
+ *   uint32 reserved | uint32 crc32(header[0..11])
+ *   then per user:  USER frame, followed by `templates` FACE frames
+ *   finally:        END frame
+ *
+ * USER payload: name[17] | jabatan[32] | departemen[32] | masaBerlaku[11] | uint16 templates
+ * FACE payload: int8 data[512] | float scale | float norm
+ * END payload:  uint32 users | uint32 faces | uint32 crc32(stream before END)
+ */
+
+#include "face_transfer.h"
+#include "crc32.h"
+#include "psram_alloc.h"
+
+#include <math.h>
+#include <string.h>
+
+#define TRANSFER_MAGIC 0x58454746 // "FGEX"
+
+#define USER_NAME_OFFSET 0
+#define USER_JABATAN_OFFSET FACE_NAME_LEN
+#define USER_DEPARTEMEN_OFFSET (USER_JABATAN_OFFSET + DIRECTORY_FIELD_LEN)
+#define USER_DATE_OFFSET (USER_DEPARTEMEN_OFFSET + DIRECTORY_FIELD_LEN)
+#define USER_TEMPLATES_OFFSET (USER_DATE_OFFSET + DIRECTORY_DATE_LEN)
+
+static void putU16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void putU32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = (v >> (8 * i)) & 0xFF;
+}
+
+static uint16_t getU16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t getU32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Copies a fixed-size field into a NUL-terminated string
+static void getField(char *dst, const uint8_t *src, size_t size)
+{
+    memcpy(dst, src, size);
+    dst[size - 1] = '\0';
+}
+
+// ========================================
+// EXPORT
+// ========================================
+FaceExporter::FaceExporter()
+    : gallery_(nullptr), directory_(nullptr), revision_(0), state_(EXPORT_DONE), aborted_(false),
+      userSlot_(0), order_(nullptr), recordCursor_(0), users_(0), faces_(0), crc_(0), pendingLength_(0), pendingPos_(0)
+{
+}
+
+FaceExporter::~FaceExporter()
+{
+    psramFree(order_);
+}
+
+bool FaceExporter::begin(const FaceGallery &gallery, const FaceDirectory *directory)
+{
+    // Records are not grouped by user: counting-sort their indices by user
+    // slot once, so the whole export is a single pass over records.
+    // Indices stay valid as long as the gallery revision does not change.
+    psramFree(order_);
+    order_ = nullptr;
+    gallery_ = nullptr;
+    state_ = EXPORT_DONE;
+
+    size_t records = gallery.recordCount();
+    size_t slots = gallery.userSlots();
+    uint32_t *next = (uint32_t *)psramAlloc((slots + 1) * sizeof(uint32_t));
+    order_ = (uint32_t *)psramAlloc((records ? records : 1) * sizeof(uint32_t));
+    if (!next || !order_)
+    {
+        psramFree(next);
+        psramFree(order_);
+        order_ = nullptr;
+        return false;
+    }
+
+    uint32_t offset = 0;
+    for (size_t u = 0; u < slots; u++)
+    {
+        next[u] = offset;
+        offset += gallery.user(u).records;
+    }
+    for (size_t r = 0; r < records; r++)
+        order_[next[gallery.recordUser(r)]++] = r;
+    psramFree(next);
+
+    gallery_ = &gallery;
+    directory_ = directory;
+    revision_ = gallery.revision();
+    state_ = EXPORT_HEADER;
+    aborted_ = false;
+    userSlot_ = 0;
+    recordCursor_ = 0;
+    users_ = 0;
+    faces_ = 0;
+    crc_ = 0;
+    pendingLength_ = 0;
+    pendingPos_ = 0;
+    return true;
+}
+
+void FaceExporter::frame(uint8_t type, const uint8_t *payload, uint16_t length)
+{
+    pending_[0] = type;
+    pending_[1] = 0;
+    putU16(pending_ + 2, length);
+    memcpy(pending_ + 4, payload, length);
+    putU32(pending_ + 4 + length, crc32Update(0, pending_, 4 + length));
+    pendingLength_ = TRANSFER_FRAME_OVERHEAD + length;
+}
+
+bool FaceExporter::nextFrame()
+{
+    switch (state_)
+    {
+    case EXPORT_HEADER:
+        putU32(pending_, TRANSFER_MAGIC);
+        putU16(pending_ + 4, FACE_TRANSFER_VERSION);
+        putU16(pending_ + 6, FACE_EMBEDDING_DIM);
+        putU32(pending_ + 8, 0);
+        putU32(pending_ + 12, crc32Update(0, pending_, 12));
+        pendingLength_ = TRANSFER_HEADER_SIZE;
+        state_ = EXPORT_USER;
+        return true;
+
+    case EXPORT_USER:
+        if (recordCursor_ >= gallery_->recordCount())
+        {
+            state_ = EXPORT_END;
+            return nextFrame();
+        }
+        else
+        {
+            userSlot_ = gallery_->recordUser(order_[recordCursor_]);
+            const GalleryUser &user = gallery_->user(userSlot_);
+            uint8_t payload[TRANSFER_USER_PAYLOAD] = {0};
+            memcpy(payload + USER_NAME_OFFSET, user.name, FACE_NAME_LEN);
+
+            int entry = directory_ ? directory_->find(user.name) : -1;
+            if (entry >= 0)
+            {
+                const FaceDirectoryEntry &e = directory_->entry(entry);
+                memcpy(payload + USER_JABATAN_OFFSET, e.jabatan, DIRECTORY_FIELD_LEN);
+                memcpy(payload + USER_DEPARTEMEN_OFFSET, e.departemen, DIRECTORY_FIELD_LEN);
+                memcpy(payload + USER_DATE_OFFSET, e.masaBerlaku, DIRECTORY_DATE_LEN);
+            }
+            putU16(payload + USER_TEMPLATES_OFFSET, user.records);
+
+            frame(TRANSFER_RECORD_USER, payload, TRANSFER_USER_PAYLOAD);
+            users_++;
+            state_ = EXPORT_FACES;
+            return true;
+        }
+
+    case EXPORT_FACES:
+        // order_ holds the user's records back to back
+        if (recordCursor_ >= gallery_->recordCount() || gallery_->recordUser(order_[recordCursor_]) != (int)userSlot_)
+        {
+            state_ = EXPORT_USER;
+            return nextFrame();
+        }
+        frame(TRANSFER_RECORD_FACE, (const uint8_t *)&gallery_->embedding(order_[recordCursor_]), TRANSFER_FACE_PAYLOAD);
+        recordCursor_++;
+        faces_++;
+        return true;
+
+    case EXPORT_END:
+    {
+        uint8_t payload[TRANSFER_END_PAYLOAD];
+        putU32(payload, users_);
+        putU32(payload + 4, faces_);
+        putU32(payload + 8, crc_);
+        frame(TRANSFER_RECORD_END, payload, TRANSFER_END_PAYLOAD);
+        state_ = EXPORT_DONE;
+        return true;
+    }
+
+    default:
+        return false;
+    }
+}
+
+size_t FaceExporter::read(uint8_t *buf, size_t maxLen)
+{
+    if (!gallery_)
+        return 0;
+
+    size_t written = 0;
+    while (written < maxLen)
+    {
+        if (pendingPos_ == pendingLength_)
+        {
+            // Record indices are only stable while the gallery is unchanged
+            if (gallery_->revision() != revision_)
+            {
+                aborted_ = true;
+                state_ = EXPORT_DONE;
+            }
+            if (!nextFrame())
+                break;
+            // END already embedded the CRC so far; nothing follows it
+            crc_ = crc32Update(crc_, pending_, pendingLength_);
+            pendingPos_ = 0;
+        }
+
+        size_t n = pendingLength_ - pendingPos_;
+        if (n > maxLen - written)
+            n = maxLen - written;
+        memcpy(buf + written, pending_ + pendingPos_, n);
+        pendingPos_ += n;
+        written += n;
+    }
+    return written;
+}
+
+// ========================================
+// IMPORT
+// ========================================
+FaceImporter::FaceImporter()
+    : gallery_(nullptr), directory_(nullptr), store_(nullptr), state_(IMPORT_IDLE), error_(nullptr),
+      users_(0), faces_(0), crc_(0), frameFill_(0), frameNeed_(0),
+      userOpen_(false), expected_(0), staged_(0), stage_(nullptr)
+{
+}
+
+FaceImporter::~FaceImporter()
+{
+    psramFree(stage_);
+}
+
+bool FaceImporter::begin(FaceGallery &gallery, FaceDirectory *directory, FaceStore *store)
+{
+    if (!stage_)
+        stage_ = (QuantizedEmbedding *)psramAlloc(FACE_TRANSFER_MAX_FACES * sizeof(QuantizedEmbedding));
+
+    gallery_ = &gallery;
+    directory_ = directory;
+    store_ = store;
+    users_ = 0;
+    faces_ = 0;
+    crc_ = 0;
+    frameFill_ = 0;
+    frameNeed_ = TRANSFER_HEADER_SIZE;
+    userOpen_ = false;
+    staged_ = 0;
+    error_ = nullptr;
+    state_ = IMPORT_HEADER;
+    return stage_ ? true : fail("out of memory");
+}
+
+void FaceImporter::end()
+{
+    // Drops a staged user of an unfinished stream; committed users stay
+    userOpen_ = false;
+    if (state_ != IMPORT_DONE && state_ != IMPORT_FAILED)
+        state_ = IMPORT_IDLE;
+    psramFree(stage_);
+    stage_ = nullptr;
+}
+
+bool FaceImporter::fail(const char *error)
+{
+    if (state_ != IMPORT_FAILED)
+        error_ = error;
+    state_ = IMPORT_FAILED;
+    userOpen_ = false;
+    return false;
+}
+
+bool FaceImporter::feed(const uint8_t *data, size_t len)
+{
+    while (len > 0)
+    {
+        if (state_ == IMPORT_FAILED || state_ == IMPORT_IDLE)
+            return false;
+        if (state_ == IMPORT_DONE)
+            return true; // Trailing bytes after END are ignored
+
+        size_t n = frameNeed_ - frameFill_;
+        if (n > len)
+            n = len;
+        memcpy(frame_ + frameFill_, data, n);
+        frameFill_ += n;
+        data += n;
+        len -= n;
+        if (frameFill_ < frameNeed_)
+            break;
+
+        if (state_ == IMPORT_HEADER)
+        {
+            if (getU32(frame_) != TRANSFER_MAGIC || getU32(frame_ + 12) != crc32Update(0, frame_, 12))
+                return fail("not a gallery export");
+            if (getU16(frame_ + 4) != FACE_TRANSFER_VERSION)
+                return fail("unsupported export version");
+            if (getU16(frame_ + 6) != FACE_EMBEDDING_DIM)
+                return fail("embedding dimension mismatch");
+            crc_ = crc32Update(crc_, frame_, TRANSFER_HEADER_SIZE);
+            state_ = IMPORT_FRAME_HEAD;
+            frameFill_ = 0;
+            frameNeed_ = 4;
+        }
+        else if (state_ == IMPORT_FRAME_HEAD)
+        {
+            uint16_t length = getU16(frame_ + 2);
+            if (length > TRANSFER_MAX_FRAME - TRANSFER_FRAME_OVERHEAD)
+                return fail("corrupt frame length");
+            state_ = IMPORT_FRAME_BODY;
+            frameNeed_ = TRANSFER_FRAME_OVERHEAD + length;
+        }
+        else if (!handleFrame())
+        {
+            return false;
+        }
+    }
+    return state_ != IMPORT_FAILED;
+}
+
+bool FaceImporter::handleFrame()
+{
+    uint8_t type = frame_[0];
+    uint16_t length = getU16(frame_ + 2);
+    const uint8_t *payload = frame_ + 4;
+
+    if (getU32(frame_ + 4 + length) != crc32Update(0, frame_, 4 + length))
+        return fail("frame checksum mismatch");
+
+    if (type == TRANSFER_RECORD_USER)
+    {
+        if (length != TRANSFER_USER_PAYLOAD)
+            return fail("corrupt user frame");
+        if (userOpen_)
+            return fail("user frame before previous user was complete");
+
+        memcpy(user_, payload, TRANSFER_USER_PAYLOAD);
+        expected_ = getU16(payload + USER_TEMPLATES_OFFSET);
+        staged_ = 0;
+        if (!user_[0] || expected_ > FACE_TRANSFER_MAX_FACES)
+            return fail("invalid user or too many templates");
+        userOpen_ = true;
+        if (expected_ == 0 && !commitUser())
+            return false;
+    }
+    else if (type == TRANSFER_RECORD_FACE)
+    {
+        if (length != TRANSFER_FACE_PAYLOAD || !userOpen_)
+            return fail("unexpected face frame");
+
+        QuantizedEmbedding &e = stage_[staged_++];
+        memcpy(&e, payload, TRANSFER_FACE_PAYLOAD);
+        if (!(e.scale > 0.0f) || !isfinite(e.scale))
+            return fail("invalid template");
+        // The stored norm divides every similarity: derive it from the data
+        // instead of trusting the sender (an all-zero template has none)
+        e.norm = sqrtf((float)dotProductS8(e.data, e.data, FACE_EMBEDDING_DIM)) * e.scale;
+        if (!(e.norm > 0.0f) || !isfinite(e.norm))
+            return fail("invalid template");
+        if (staged_ == expected_ && !commitUser())
+            return false;
+    }
+    else if (type == TRANSFER_RECORD_END)
+    {
+        if (length != TRANSFER_END_PAYLOAD || userOpen_)
+            return fail("unexpected end frame");
+        if (getU32(payload) != users_ || getU32(payload + 4) != faces_ || getU32(payload + 8) != crc_)
+            return fail("stream checksum mismatch");
+        state_ = IMPORT_DONE;
+        return true;
+    }
+    // Unknown types are skipped (forward compatible), but still checksummed
+
+    crc_ = crc32Update(crc_, frame_, frameNeed_);
+    state_ = IMPORT_FRAME_HEAD;
+    frameFill_ = 0;
+    frameNeed_ = 4;
+    return true;
+}
+
+bool FaceImporter::commitUser()
+{
+    char name[FACE_NAME_LEN];
+    getField(name, user_ + USER_NAME_OFFSET, FACE_NAME_LEN);
+    userOpen_ = false;
+
+    if (expected_ > 0)
+    {
+        gallery_->removeUser(name);
+        for (uint16_t i = 0; i < staged_; i++)
+        {
+            if (gallery_->addRecord(name, stage_[i]) < 0)
+                return fail("gallery full");
+        }
+        if (store_ && !(store_->appendTombstone(name) && store_->appendUser(*gallery_, name)))
+            return fail("journal write failed");
+    }
+
+    if (directory_)
+    {
+        char jabatan[DIRECTORY_FIELD_LEN];
+        char departemen[DIRECTORY_FIELD_LEN];
+        char masaBerlaku[DIRECTORY_DATE_LEN];
+        getField(jabatan, user_ + USER_JABATAN_OFFSET, DIRECTORY_FIELD_LEN);
+        getField(departemen, user_ + USER_DEPARTEMEN_OFFSET, DIRECTORY_FIELD_LEN);
+        getField(masaBerlaku, user_ + USER_DATE_OFFSET, DIRECTORY_DATE_LEN);
+        directory_->setMetadata(name, jabatan, departemen, masaBerlaku);
+    }
+
+    users_++;
+    faces_ += staged_;
+    return true;
+}
@@ -0,0 +1,360 @@
+/**
+ * Dual-Core Capture / Inference Pipeline
+ *
+ *   capture core                         inference core
+ *   ------------                         --------------
+ *   wait for a free slot                 wait for a frame
+ *   source.acquire()  (frame N+1)        pop (newest wins, older ones released)
+ *   push  --------- SpscQueue -------->  wake capture, process(N), release(N)
+ *
+ * The inference stage frees the queue slot before it starts processing, so
+ * the capture stage fetches the next frame while the current one is still
+ * being inferred. With PIPELINE_QUEUE_DEPTH 1 at most one frame waits, so
+ * the frame being processed is never older than one inference period.
+ *
+ * Idle stages sleep on a task notification (a condition variable on the
+ * host) that the other stage raises after each push/pop; the timeout only
+ * bounds how long a pause or stop request takes to be noticed.
+ */
+
+#include "frame_pipeline.h"
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+#ifdef ESP_PLATFORM
+
+struct FramePipeline::Platform
+{
+    TaskHandle_t captureTask = nullptr;
+    TaskHandle_t inferenceTask = nullptr;
+    std::atomic<int> runningTasks{0};
+};
+
+static void napMs(uint32_t ms)
+{
+    vTaskDelay(pdMS_TO_TICKS(ms) ? pdMS_TO_TICKS(ms) : 1);
+}
+
+#else
+
+struct StageSignal
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool pending = false;
+
+    void raise()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending = true;
+        }
+        cond.notify_one();
+    }
+
+    void wait(uint32_t ms)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait_for(lock, std::chrono::milliseconds(ms), [this] { return pending; });
+        pending = false;
+    }
+};
+
+struct FramePipeline::Platform
+{
+    std::thread captureThread;
+    std::thread inferenceThread;
+    StageSignal captureSignal;
+    StageSignal inferenceSignal;
+};
+
+static void napMs(uint32_t ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+#endif
+
+FramePipeline::FramePipeline(FrameSource &source, FrameProcessor &processor)
+    : source_(source), processor_(processor),
+      running_(false), paused_(false), captureBusy_(false), inferenceBusy_(false), sequence_(0),
+      captured_(0), processed_(0), dropped_(0), captureFailures_(0), lastLatencyMs_(0),
+      platform_(new Platform())
+{
+}
+
+FramePipeline::~FramePipeline()
+{
+    stop();
+    delete platform_;
+}
+
+// ==================== STAGES ====================
+
+bool FramePipeline::captureStep()
+{
+    if (paused_.load() || queue_.full())
+        return false;
+
+    // Announce before re-checking, so pause() either sees us busy or we see it
+    captureBusy_.store(true);
+    if (paused_.load())
+    {
+        captureBusy_.store(false);
+        return false;
+    }
+
+    PipelineFrame frame;
+    if (!source_.acquire(frame))
+    {
+        captureFailures_++;
+        captureBusy_.store(false);
+        return false;
+    }
+    frame.sequence = ++sequence_;
+    frame.capturedMs = source_.nowMs();
+
+    queue_.push(frame); // Only producer and a slot was free: cannot fail
+    captured_++;
+    captureBusy_.store(false);
+    wakeInference();
+    return true;
+}
+
+bool FramePipeline::inferenceStep()
+{
+    inferenceBusy_.store(true);
+
+    PipelineFrame frame;
+    if (!queue_.pop(frame))
+    {
+        inferenceBusy_.store(false);
+        return false;
+    }
+
+    // Keep only the newest frame
+    PipelineFrame newer;
+    while (queue_.pop(newer))
+    {
+        source_.release(frame);
+        dropped_++;
+        frame = newer;
+    }
+
+    // Slot is free again: capture the next frame while this one is processed
+    wakeCapture();
+
+    if (paused_.load())
+    {
+        // Draining for pause(): hand the buffer back untouched
+        source_.release(frame);
+        dropped_++;
+        inferenceBusy_.store(false);
+        return true;
+    }
+
+    processor_.process(frame);
+    lastLatencyMs_.store(source_.nowMs() - frame.capturedMs);
+    source_.release(frame);
+    processed_++;
+
+    inferenceBusy_.store(false);
+    return true;
+}
+
+// ==================== CONTROL ====================
+
+void FramePipeline::pause()
+{
+    paused_.store(true);
+    wakeInference();
+    while (captureBusy_.load() || inferenceBusy_.load() || !queue_.empty())
+    {
+        wakeInference();
+        napMs(1);
+    }
+}
+
+void FramePipeline::resume()
+{
+    paused_.store(false);
+    wakeCapture();
+}
+
+PipelineStats FramePipeline::stats() const
+{
+    PipelineStats s;
+    s.captured = captured_.load();
+    s.processed = processed_.load();
+    s.dropped = dropped_.load();
+    s.captureFailures = captureFailures_.load();
+    s.lastLatencyMs = lastLatencyMs_.load();
+    return s;
+}
+
+#ifdef ESP_PLATFORM
+
+static void captureTaskEntry(void *arg)
+{
+    FramePipeline *pipeline = static_cast<FramePipeline *>(arg);
+    pipeline->runCapture();
+}
+
+static void inferenceTaskEntry(void *arg)
+{
+    FramePipeline *pipeline = static_cast<FramePipeline *>(arg);
+    pipeline->runInference();
+}
+
+bool FramePipeline::start(int captureCore, int inferenceCore)
+{
+    if (running_.load())
+        return true;
+    running_.store(true);
+    platform_->runningTasks.store(2);
+
+    // Capture only waits on the camera DMA: low priority next to WiFi.
+    // Inference gets the other core to itself (above the Arduino loop).
+    if (xTaskCreatePinnedToCore(captureTaskEntry, "capture", PIPELINE_CAPTURE_STACK, this, 2,
+                                &platform_->captureTask, captureCore) != pdPASS)
+    {
+        running_.store(false);
+        platform_->runningTasks.store(0);
+        return false;
+    }
+    if (xTaskCreatePinnedToCore(inferenceTaskEntry, "inference", PIPELINE_INFERENCE_STACK, this, 2,
+                                &platform_->inferenceTask, inferenceCore) != pdPASS)
+    {
+        platform_->runningTasks.store(1);
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void FramePipeline::stop()
+{
+    if (!running_.load())
+        return;
+    running_.store(false);
+    while (platform_->runningTasks.load() > 0)
+    {
+        wakeCapture();
+        wakeInference();
+        napMs(1);
+    }
+    // Frames still queued go back to the driver
+    PipelineFrame frame;
+    while (queue_.pop(frame))
+        source_.release(frame);
+}
+
+void FramePipeline::runCapture()
+{
+    while (running_.load())
+    {
+        if (!captureStep())
+            waitCapture();
+    }
+    platform_->captureTask = nullptr;
+    platform_->runningTasks--;
+    vTaskDelete(nullptr);
+}
+
+void FramePipeline::runInference()
+{
+    while (running_.load())
+    {
+        if (!inferenceStep())
+            waitInference();
+    }
+    platform_->inferenceTask = nullptr;
+    platform_->runningTasks--;
+    vTaskDelete(nullptr);
+}
+
+void FramePipeline::wakeCapture()
+{
+    TaskHandle_t task = platform_->captureTask;
+    if (task)
+        xTaskNotifyGive(task);
+}
+
+void FramePipeline::wakeInference()
+{
+    TaskHandle_t task = platform_->inferenceTask;
+    if (task)
+        xTaskNotifyGive(task);
+}
+
+void FramePipeline::waitCapture()
+{
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PIPELINE_IDLE_WAIT_MS));
+}
+
+void FramePipeline::waitInference()
+{
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PIPELINE_IDLE_WAIT_MS));
+}
+
+#else
+
+bool FramePipeline::start(int captureCore, int inferenceCore)
+{
+    (void)captureCore; // The host scheduler picks the cores
+    (void)inferenceCore;
+    if (running_.load())
+        return true;
+    running_.store(true);
+    platform_->captureThread = std::thread([this] { runCapture(); });
+    platform_->inferenceThread = std::thread([this] { runInference(); });
+    return true;
+}
+
+void FramePipeline::stop()
+{
+    if (!running_.load())
+        return;
+    running_.store(false);
+    wakeCapture();
+    wakeInference();
+    platform_->captureThread.join();
+    platform_->inferenceThread.join();
+
+    PipelineFrame frame;
+    while (queue_.pop(frame))
+        source_.release(frame);
+}
+
+void FramePipeline::runCapture()
+{
+    while (running_.load())
+    {
+        if (!captureStep())
+            waitCapture();
+    }
+}
+
+void FramePipeline::runInference()
+{
+    while (running_.load())
+    {
+        if (!inferenceStep())
+            waitInference();
+    }
+}
+
+void FramePipeline::wakeCapture() { platform_->captureSignal.raise(); }
+void FramePipeline::wakeInference() { platform_->inferenceSignal.raise(); }
+void FramePipeline::waitCapture() { platform_->captureSignal.wait(PIPELINE_IDLE_WAIT_MS); }
+void FramePipeline::waitInference() { platform_->inferenceSignal.wait(PIPELINE_IDLE_WAIT_MS); }
+
+#endif
@@ -0,0 +1,226 @@
+/**
+ * Reference-Counted Frame Buffer Pool
+ *
+ * Each FrameBuffer carries its own atomic reference count; refs == 0 marks
+ * it free. acquire() claims a free buffer with a 0 -> 1 compare-exchange, so
+ * no lock is needed between the capture task and the consumers releasing
+ * buffers from other tasks/cores. The data areas are allocated once in
+ * begin() and only returned to the heap by end().
+ */
+
+#include "frame_pool.h"
+#include "psram_alloc.h"
+
+// ==================== FrameRef ====================
+
+FrameRef::FrameRef(const FrameRef &other) : buffer_(other.buffer_)
+{
+    FramePool::retain(buffer_);
+}
+
+FrameRef &FrameRef::operator=(const FrameRef &other)
+{
+    if (this != &other)
+    {
+        FramePool::retain(other.buffer_);
+        reset();
+        buffer_ = other.buffer_;
+    }
+    return *this;
+}
+
+FrameRef &FrameRef::operator=(FrameRef &&other)
+{
+    if (this != &other)
+    {
+        reset();
+        buffer_ = other.buffer_;
+        other.buffer_ = nullptr;
+    }
+    return *this;
+}
+
+FrameRef FrameRef::adopt(FrameBuffer *buffer)
+{
+    FrameRef ref;
+    ref.buffer_ = buffer;
+    return ref;
+}
+
+FrameBuffer *FrameRef::detach()
+{
+    FrameBuffer *buffer = buffer_;
+    buffer_ = nullptr;
+    return buffer;
+}
+
+void FrameRef::reset()
+{
+    FramePool::release(buffer_);
+    buffer_ = nullptr;
+}
+
+// ==================== FramePool ====================
+
+FramePool::FramePool()
+    : count_(0), bufferBytes_(0), inUse_(0), peakInUse_(0), acquired_(0), exhausted_(0), oversize_(0)
+{
+    for (size_t i = 0; i < FRAME_POOL_MAX_BUFFERS; i++)
+    {
+        buffers_[i].data = nullptr;
+        buffers_[i].capacity = 0;
+        buffers_[i].refs.store(0);
+        buffers_[i].pool = this;
+    }
+}
+
+FramePool::~FramePool()
+{
+    end();
+}
+
+bool FramePool::begin(size_t buffers, size_t bufferBytes)
+{
+    end();
+    if (buffers > FRAME_POOL_MAX_BUFFERS)
+        buffers = FRAME_POOL_MAX_BUFFERS;
+
+    for (size_t i = 0; i < buffers; i++)
+    {
+        buffers_[i].data = static_cast<uint8_t *>(psramAlloc(bufferBytes));
+        if (!buffers_[i].data)
+        {
+            count_ = i;
+            end();
+            return false;
+        }
+        buffers_[i].capacity = bufferBytes;
+        buffers_[i].length = 0;
+        buffers_[i].refs.store(0);
+    }
+    count_ = buffers;
+    bufferBytes_ = bufferBytes;
+    return true;
+}
+
+void FramePool::end()
+{
+    for (size_t i = 0; i < count_; i++)
+    {
+        psramFree(buffers_[i].data);
+        buffers_[i].data = nullptr;
+        buffers_[i].capacity = 0;
+    }
+    count_ = 0;
+    bufferBytes_ = 0;
+}
+
+FrameRef FramePool::acquire()
+{
+    for (size_t i = 0; i < count_; i++)
+    {
+        int expected = 0;
+        if (buffers_[i].refs.compare_exchange_strong(expected, 1, std::memory_order_acquire))
+        {
+            FrameBuffer &buffer = buffers_[i];
+            buffer.length = 0;
+            buffer.width = 0;
+            buffer.height = 0;
+            buffer.format = 0;
+            buffer.sequence = 0;
+            buffer.capturedMs = 0;
+
+            acquired_++;
+            uint32_t inUse = ++inUse_;
+            uint32_t peak = peakInUse_.load();
+            while (inUse > peak && !peakInUse_.compare_exchange_weak(peak, inUse))
+            {
+            }
+            return FrameRef::adopt(&buffer);
+        }
+    }
+    exhausted_++;
+    return FrameRef();
+}
+
+void FramePool::retain(FrameBuffer *buffer)
+{
+    if (buffer)
+        buffer->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FramePool::release(FrameBuffer *buffer)
+{
+    if (buffer && buffer->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        buffer->pool->recycled();
+}
+
+void FramePool::recycled()
+{
+    inUse_--;
+}
+
+FramePoolStats FramePool::stats() const
+{
+    FramePoolStats s;
+    s.buffers = count_;
+    s.inUse = inUse_.load();
+    s.peakInUse = peakInUse_.load();
+    s.acquired = acquired_.load();
+    s.exhausted = exhausted_.load();
+    s.oversize = oversize_.load();
+    return s;
+}
+
+// ==================== FrameSlot ====================
+
+#ifdef ESP_PLATFORM
+
+FrameSlot::FrameSlot()
+{
+    portMUX_INITIALIZE(&mux_);
+}
+
+void FrameSlot::lock() { portENTER_CRITICAL(&mux_); }
+void FrameSlot::unlock() { portEXIT_CRITICAL(&mux_); }
+
+#else
+
+FrameSlot::FrameSlot() : lock_(false) {}
+
+void FrameSlot::lock()
+{
+    bool expected = false;
+    while (!lock_.compare_exchange_weak(expected, true, std::memory_order_acquire))
+        expected = false;
+}
+
+void FrameSlot::unlock() { lock_.store(false, std::memory_order_release); }
+
+#endif
+
+void FrameSlot::publish(const FrameRef &frame)
+{
+    FrameRef incoming = frame; // Retain outside the lock
+    lock();
+    FrameBuffer *previous = frame_.detach();
+    frame_ = FrameRef::adopt(incoming.detach());
+    unlock();
+    FramePool::release(previous);
+}
+
+FrameRef FrameSlot::latest()
+{
+    lock();
+    FrameRef frame = frame_;
+    unlock();
+    return frame;
+}
+
+void FrameSlot::clear()
+{
+    lock();
+    FrameBuffer *previous = frame_.detach();
+    unlock();
+    FramePool::release(previous);
+}
@@ -0,0 +1,93 @@
+/**
+ * JPEG On Demand
+ *
+ * The lock is held across the encode on purpose: the stream task and an HTTP
+ * snapshot asking for the same new frame at the same time must not encode it
+ * twice. The second caller waits one encode and then gets the cached copy.
+ * A newer raw frame replaces the cached encoding; viewers still sending the
+ * old one keep it alive through their own FrameRef.
+ */
+
+#include "jpeg_on_demand.h"
+
+JpegFrameCache::JpegFrameCache(FramePool &pool, int jpegFormat, JpegEncodeFn encode, void *context)
+    : pool_(pool), jpegFormat_(jpegFormat), encode_(encode), context_(context)
+{
+    stats_.encoded = 0;
+    stats_.reused = 0;
+    stats_.failures = 0;
+    stats_.lastEncodeBytes = 0;
+#ifdef ESP_PLATFORM
+    mutex_ = nullptr;
+#endif
+}
+
+#ifdef ESP_PLATFORM
+
+bool JpegFrameCache::begin()
+{
+    if (!mutex_)
+        mutex_ = xSemaphoreCreateMutex();
+    return mutex_ != nullptr;
+}
+
+void JpegFrameCache::lock() { xSemaphoreTake(mutex_, portMAX_DELAY); }
+void JpegFrameCache::unlock() { xSemaphoreGive(mutex_); }
+
+#else
+
+bool JpegFrameCache::begin() { return true; }
+
+void JpegFrameCache::lock() { mutex_.lock(); }
+void JpegFrameCache::unlock() { mutex_.unlock(); }
+
+#endif
+
+FrameRef JpegFrameCache::jpeg(const FrameRef &raw)
+{
+    if (!raw)
+        return FrameRef();
+    if (raw->format == jpegFormat_)
+        return raw;
+
+    lock();
+    if (cached_ && cached_->sequence == raw->sequence)
+    {
+        FrameRef hit = cached_;
+        stats_.reused++;
+        unlock();
+        return hit;
+    }
+
+    FrameRef out = pool_.acquire();
+    if (out)
+    {
+        out->length = 0;
+        if (encode_(*raw.get(), *out.get(), context_) && out->length > 0)
+        {
+            out->width = raw->width;
+            out->height = raw->height;
+            out->format = jpegFormat_;
+            out->sequence = raw->sequence;
+            out->capturedMs = raw->capturedMs;
+            stats_.encoded++;
+            stats_.lastEncodeBytes = out->length;
+            cached_ = out;
+        }
+        else
+        {
+            out.reset();
+        }
+    }
+    if (!out)
+        stats_.failures++;
+    unlock();
+    return out;
+}
+
+void JpegFrameCache::clear()
+{
+    lock();
+    cached_.reset();
+    unlock();
+}
@@ -0,0 +1,80 @@
+/**
+ * Chunked JSON Array Stream
+ *
+ * The response pulls: every read() copies whatever is pending, then asks
+ * the source for the next piece (opening text, one element, closing text)
+ * until the buffer is full. A partly sent piece stays pending, so an element
+ * may straddle two TCP chunks. The separator is written in front of every
+ * element but the first, which keeps the source callbacks separator-free.
+ */
+
+#include "json_stream.h"
+#include <string.h>
+
+JsonArrayStream::JsonArrayStream(JsonElementFn next, void *context, const char *open, const char *close)
+    : next_(next), context_(context), open_(open), close_(close), stage_(OPEN),
+      pending_(nullptr), pendingLen_(0), pendingPos_(0), elements_(0), dropped_(0)
+{
+}
+
+// Makes the next piece pending; false = nothing left
+bool JsonArrayStream::load()
+{
+    pendingPos_ = 0;
+    switch (stage_)
+    {
+    case OPEN:
+        pending_ = open_;
+        pendingLen_ = strlen(open_);
+        stage_ = ELEMENTS;
+        return true;
+
+    case ELEMENTS:
+        for (;;)
+        {
+            size_t n = next_(context_, element_ + 1, JSON_STREAM_ELEMENT_MAX);
+            if (n == 0)
+                break;
+            if (n >= JSON_STREAM_ELEMENT_MAX)
+            {
+                dropped_++; // Truncated JSON would break the whole array
+                continue;
+            }
+            element_[0] = ',';
+            pending_ = elements_ ? element_ : element_ + 1;
+            pendingLen_ = elements_ ? n + 1 : n;
+            elements_++;
+            return true;
+        }
+        stage_ = CLOSE;
+        // fall through
+
+    case CLOSE:
+        pending_ = close_;
+        pendingLen_ = strlen(close_);
+        stage_ = DONE;
+        return true;
+
+    case DONE:
+    default:
+        pendingLen_ = 0;
+        return false;
+    }
+}
+
+size_t JsonArrayStream::read(uint8_t *buffer, size_t maxLen)
+{
+    size_t written = 0;
+    while (written < maxLen)
+    {
+        if (pendingPos_ == pendingLen_ && !load())
+            break;
+        size_t n = pendingLen_ - pendingPos_;
+        if (n > maxLen - written)
+            n = maxLen - written;
+        memcpy(buffer + written, pending_ + pendingPos_, n);
+        pendingPos_ += n;
+        written += n;
+    }
+    return written;
+}
@@ -0,0 +1,258 @@
+/**
+ * Fixed-Buffer JSON Writer
+ *
+ * Integers are converted by hand (no printf); only fractional numbers go
+ * through snprintf, into a small local buffer. Escaping follows RFC 8259:
+ * quote, backslash and control characters are escaped, every other byte -
+ * UTF-8 included - is copied unchanged.
+ */
+
+#include "json_writer.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+JsonWriter::JsonWriter(char *buffer, size_t capacity)
+    : buffer_(buffer), capacity_(capacity ? capacity - 1 : 0), length_(0), overflow_(capacity == 0),
+      afterKey_(false), depth_(0), filled_(0)
+{
+    if (capacity)
+        buffer_[0] = '\0';
+}
+
+// ==================== Output ====================
+
+void JsonWriter::put(char c)
+{
+    if (overflow_ || length_ == capacity_)
+    {
+        overflow_ = true;
+        return;
+    }
+    buffer_[length_++] = c;
+    buffer_[length_] = '\0';
+}
+
+void JsonWriter::put(const char *s, size_t n)
+{
+    if (overflow_ || n > capacity_ - length_)
+    {
+        overflow_ = true;
+        return;
+    }
+    memcpy(buffer_ + length_, s, n);
+    length_ += n;
+    buffer_[length_] = '\0';
+}
+
+void JsonWriter::putEscaped(const char *s, size_t n)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *end = s + n;
+    while (s < end && !overflow_)
+    {
+        // Copy the run that needs no escaping in one go
+        const char *run = s;
+        while (s < end && *s != '"' && *s != '\\' && (unsigned char)*s >= 0x20)
+            s++;
+        if (s > run)
+            put(run, s - run);
+        if (s == end)
+            break;
+
+        char c = *s++;
+        switch (c)
+        {
+        case '"':
+        case '\\':
+        {
+            char pair[2] = {'\\', c};
+            put(pair, 2);
+            break;
+        }
+        case '\n':
+            put("\\n", 2);
+            break;
+        case '\r':
+            put("\\r", 2);
+            break;
+        case '\t':
+            put("\\t", 2);
+            break;
+        default:
+        {
+            char code[6] = {'\\', 'u', '0', '0', hex[(c >> 4) & 0x0F], hex[c & 0x0F]};
+            put(code, 6);
+            break;
+        }
+        }
+    }
+}
+
+void JsonWriter::putUnsigned(unsigned long long v)
+{
+    char digits[20];
+    size_t n = 0;
+    do
+    {
+        digits[sizeof(digits) - ++n] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    put(digits + sizeof(digits) - n, n);
+}
+
+// ==================== Structure ====================
+
+// Comma in front of every element of a container but the first
+void JsonWriter::separate()
+{
+    if (afterKey_)
+    {
+        afterKey_ = false;
+        return;
+    }
+    if (depth_ == 0)
+        return;
+    uint32_t bit = 1u << depth_;
+    if (filled_ & bit)
+        put(',');
+    filled_ |= bit;
+}
+
+JsonWriter &JsonWriter::key(const char *name, size_t len)
+{
+    separate();
+    put('"');
+    put(name, len);
+    put("\":", 2);
+    afterKey_ = true;
+    return *this;
+}
+
+JsonWriter &JsonWriter::open(char bracket)
+{
+    separate();
+    if (depth_ + 1 >= JSON_WRITER_MAX_DEPTH)
+    {
+        overflow_ = true;
+        return *this;
+    }
+    put(bracket);
+    depth_++;
+    filled_ &= ~(1u << depth_);
+    return *this;
+}
+
+JsonWriter &JsonWriter::close(char bracket)
+{
+    if (depth_ > 0)
+        depth_--;
+    put(bracket);
+    return *this;
+}
+
+// ==================== Values ====================
+
+JsonWriter &JsonWriter::value(const char *s)
+{
+    if (!s)
+        return null();
+    separate();
+    put('"');
+    putEscaped(s, strlen(s));
+    put('"');
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(bool v)
+{
+    separate();
+    if (v)
+        put("true", 4);
+    else
+        put("false", 5);
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(long long v)
+{
+    separate();
+    if (v < 0)
+    {
+        put('-');
+        putUnsigned(0ULL - (unsigned long long)v);
+    }
+    else
+    {
+        putUnsigned((unsigned long long)v);
+    }
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(unsigned long long v)
+{
+    separate();
+    putUnsigned(v);
+    return *this;
+}
+
+JsonWriter &JsonWriter::value(double v, int decimals)
+{
+    if (isnan(v) || isinf(v))
+        return null(); // Not representable in JSON
+    separate();
+    char text[32];
+    int n = snprintf(text, sizeof(text), "%.*f", decimals, v);
+    if (n < 0 || n >= (int)sizeof(text))
+        overflow_ = true;
+    else
+        put(text, n);
+    return *this;
+}
+
+JsonWriter &JsonWriter::null()
+{
+    separate();
+    put("null", 4);
+    return *this;
+}
+
+JsonWriter &JsonWriter::openString()
+{
+    separate();
+    put('"');
+    return *this;
+}
+
+JsonWriter &JsonWriter::append(const char *text)
+{
+    if (text)
+        putEscaped(text, strlen(text));
+    return *this;
+}
+
+JsonWriter &JsonWriter::append(const char *text, size_t len)
+{
+    putEscaped(text, len);
+    return *this;
+}
+
+JsonWriter &JsonWriter::append(long long v)
+{
+    if (v < 0)
+    {
+        put('-');
+        putUnsigned(0ULL - (unsigned long long)v);
+    }
+    else
+    {
+        putUnsigned((unsigned long long)v);
+    }
+    return *this;
+}
+
+JsonWriter &JsonWriter::endString()
+{
+    put('"');
+    return *this;
+}
@@ -0,0 +1,414 @@
+/**
+ * Access Log Block Index
+ *
+ * Block b holds the summary of events [base, base + LOG_INDEX_BLOCK) with
+ * base = b * LOG_INDEX_BLOCK + 1 + k * capacity, i.e. the same slots of the
+ * ring on every lap. A summary is reset when the first event of a new lap
+ * lands in it, and a query only trusts a summary whose base matches the
+ * block it is looking at.
+ *
+ * File layout (little endian):
+ *   header (32 bytes): uint32 magic "AIDX" | uint16 version | uint16 block |
+ *     uint32 ring capacity | uint32 block count | uint32 covered next |
+ *     8 reserved | uint32 crc32(header[0..27])
+ *   summary (32 bytes) per block: uint32 base | uint32 min ts | uint32 max ts |
+ *     uint16 action mask | 2 reserved | uint64 user bits | 4 reserved |
+ *     uint32 crc32(summary[0..27])
+ * Only dirty summaries are rewritten, followed by the header, on each sync.
+ */
+
+#include "log_index.h"
+#include "crc32.h"
+#include "psram_alloc.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#define INDEX_MAGIC 0x58444941 // "AIDX"
+#define INDEX_HEADER_SIZE 32
+#define INDEX_ENTRY_SIZE 32
+#define INDEX_READ_CHUNK 64
+
+static void putU16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void putU32(uint8_t *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = (v >> (8 * i)) & 0xFF;
+}
+
+static uint16_t getU16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t getU32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint64_t logUserBit(const char *user)
+{
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (const char *c = user; *c; c++)
+        hash = (hash ^ (uint8_t)*c) * 16777619u;
+    return 1ULL << (hash % 64);
+}
+
+AccessLogIndex::AccessLogIndex()
+    : file_(nullptr), blocks_(nullptr), blockCount_(0), capacity_(0), coveredNext_(1), rebuiltRecords_(0)
+{
+    path_[0] = '\0';
+#ifdef ESP_PLATFORM
+    mutex_ = nullptr;
+#endif
+}
+
+AccessLogIndex::~AccessLogIndex()
+{
+    end();
+}
+
+#ifdef ESP_PLATFORM
+
+void AccessLogIndex::lock() { xSemaphoreTake(mutex_, portMAX_DELAY); }
+void AccessLogIndex::unlock() { xSemaphoreGive(mutex_); }
+
+#else
+
+void AccessLogIndex::lock() { mutex_.lock(); }
+void AccessLogIndex::unlock() { mutex_.unlock(); }
+
+#endif
+
+bool AccessLogIndex::begin(AccessLog &log, const char *path)
+{
+#ifdef ESP_PLATFORM
+    if (!mutex_)
+        mutex_ = xSemaphoreCreateMutex();
+    if (!mutex_)
+        return false;
+#endif
+    end();
+    if (log.capacity() % LOG_INDEX_BLOCK != 0)
+        return false;
+    strncpy(path_, path, sizeof(path_) - 1);
+    path_[sizeof(path_) - 1] = '\0';
+
+    capacity_ = log.capacity();
+    blockCount_ = capacity_ / LOG_INDEX_BLOCK;
+    blocks_ = (LogBlockSummary *)psramAlloc(blockCount_ * sizeof(LogBlockSummary));
+    if (!blocks_)
+        return false;
+    memset(blocks_, 0, blockCount_ * sizeof(LogBlockSummary));
+    coveredNext_ = 1;
+
+    file_ = fopen(path_, "r+b");
+    bool loaded = file_ && load();
+    if (!loaded)
+    {
+        // Missing, stale or from another ring: rebuild from the log itself
+        if (file_)
+            fclose(file_);
+        file_ = fopen(path_, "w+b");
+        if (!file_)
+        {
+            end();
+            return false;
+        }
+        memset(blocks_, 0, blockCount_ * sizeof(LogBlockSummary));
+        for (uint32_t i = 0; i < blockCount_; i++)
+            blocks_[i].dirty = true; // Write the whole file once
+        coveredNext_ = 1;
+    }
+    if (coveredNext_ > log.nextSequence())
+    {
+        // The log is behind the index (replaced or reset): start over
+        memset(blocks_, 0, blockCount_ * sizeof(LogBlockSummary));
+        for (uint32_t i = 0; i < blockCount_; i++)
+            blocks_[i].dirty = true;
+        coveredNext_ = 1;
+    }
+
+    catchUp(log, coveredNext_);
+    log.setObserver(this);
+    lock();
+    bool ok = save();
+    unlock();
+    return ok;
+}
+
+void AccessLogIndex::end()
+{
+    if (file_)
+    {
+        fclose(file_);
+        file_ = nullptr;
+    }
+    psramFree(blocks_);
+    blocks_ = nullptr;
+    blockCount_ = 0;
+}
+
+bool AccessLogIndex::load()
+{
+    uint8_t h[INDEX_HEADER_SIZE];
+    if (fseek(file_, 0, SEEK_SET) != 0 || fread(h, 1, sizeof(h), file_) != sizeof(h))
+        return false;
+    if (getU32(h) != INDEX_MAGIC || getU32(h + 28) != crc32Update(0, h, 28) ||
+        getU16(h + 4) > LOG_INDEX_VERSION || getU16(h + 6) != LOG_INDEX_BLOCK ||
+        getU32(h + 8) != capacity_ || getU32(h + 12) != blockCount_)
+        return false;
+    coveredNext_ = getU32(h + 16);
+
+    uint8_t e[INDEX_ENTRY_SIZE];
+    for (uint32_t i = 0; i < blockCount_; i++)
+    {
+        if (fread(e, 1, sizeof(e), file_) != sizeof(e))
+            return false;
+        LogBlockSummary &b = blocks_[i];
+        if (getU32(e + 28) != crc32Update(0, e, 28))
+        {
+            b.baseSequence = 0; // Unknown: queries scan it
+            continue;
+        }
+        b.baseSequence = getU32(e);
+        b.minTimestamp = getU32(e + 4);
+        b.maxTimestamp = getU32(e + 8);
+        b.actionMask = getU16(e + 12);
+        memcpy(&b.userBits, e + 16, sizeof(uint64_t));
+        b.dirty = false;
+    }
+    return true;
+}
+
+bool AccessLogIndex::save()
+{
+    if (!file_)
+        return false;
+    uint8_t e[INDEX_ENTRY_SIZE];
+    for (uint32_t i = 0; i < blockCount_; i++)
+    {
+        LogBlockSummary &b = blocks_[i];
+        if (!b.dirty)
+            continue;
+        memset(e, 0, sizeof(e));
+        putU32(e, b.baseSequence);
+        putU32(e + 4, b.minTimestamp);
+        putU32(e + 8, b.maxTimestamp);
+        putU16(e + 12, b.actionMask);
+        memcpy(e + 16, &b.userBits, sizeof(uint64_t));
+        putU32(e + 28, crc32Update(0, e, 28));
+        if (fseek(file_, INDEX_HEADER_SIZE + (long)i * INDEX_ENTRY_SIZE, SEEK_SET) != 0 ||
+            fwrite(e, 1, sizeof(e), file_) != sizeof(e))
+            return false;
+        b.dirty = false;
+    }
+
+    uint8_t h[INDEX_HEADER_SIZE] = {0};
+    putU32(h, INDEX_MAGIC);
+    putU16(h + 4, LOG_INDEX_VERSION);
+    putU16(h + 6, LOG_INDEX_BLOCK);
+    putU32(h + 8, capacity_);
+    putU32(h + 12, blockCount_);
+    putU32(h + 16, coveredNext_);
+    putU32(h + 28, crc32Update(0, h, 28));
+    if (fseek(file_, 0, SEEK_SET) != 0 || fwrite(h, 1, sizeof(h), file_) != sizeof(h) || fflush(file_) != 0)
+        return false;
+    fsync(fileno(file_));
+    return true;
+}
+
+void AccessLogIndex::catchUp(AccessLog &log, uint32_t from)
+{
+    AccessLogRecord chunk[INDEX_READ_CHUNK];
+    uint32_t first = log.firstSequence();
+    uint32_t next = log.nextSequence();
+    uint32_t seq = from > first ? from : first;
+    while (seq < next)
+    {
+        // Stay inside one lap of the ring
+        uint32_t slot = (seq - 1) % capacity_;
+        uint32_t n = next - seq;
+        if (n > INDEX_READ_CHUNK)
+            n = INDEX_READ_CHUNK;
+        if (n > capacity_ - slot)
+            n = capacity_ - slot;
+        log.readRange(seq, n, chunk);
+        lock();
+        for (uint32_t i = 0; i < n; i++)
+        {
+            if (chunk[i].sequence)
+            {
+                note(chunk[i]);
+                rebuiltRecords_++;
+            }
+        }
+        unlock();
+        seq += n;
+    }
+    lock();
+    coveredNext_ = next;
+    unlock();
+}
+
+void AccessLogIndex::note(const AccessLogRecord &record)
+{
+    uint32_t offset = (record.sequence - 1) % LOG_INDEX_BLOCK;
+    uint32_t base = record.sequence - offset;
+    LogBlockSummary &b = blocks_[((record.sequence - 1) / LOG_INDEX_BLOCK) % blockCount_];
+    if (b.baseSequence != base)
+    {
+        b.baseSequence = base;
+        b.minTimestamp = record.timestamp;
+        b.maxTimestamp = record.timestamp;
+        b.actionMask = 0;
+        b.userBits = 0;
+    }
+    if (record.timestamp < b.minTimestamp)
+        b.minTimestamp = record.timestamp;
+    if (record.timestamp > b.maxTimestamp)
+        b.maxTimestamp = record.timestamp;
+    b.actionMask |= 1 << record.action;
+    b.userBits |= logUserBit(record.user);
+    b.dirty = true;
+    if (record.sequence >= coveredNext_)
+        coveredNext_ = record.sequence + 1;
+}
+
+void AccessLogIndex::appended(const AccessLogRecord *records, size_t count)
+{
+    if (!blocks_)
+        return;
+    lock();
+    for (size_t i = 0; i < count; i++)
+        note(records[i]);
+    unlock();
+}
+
+void AccessLogIndex::synced()
+{
+    if (!blocks_)
+        return;
+    lock();
+    save();
+    unlock();
+}
+
+bool AccessLogIndex::mayMatch(uint32_t baseSequence, uint32_t since, uint32_t until, uint16_t actionMask, uint64_t userBit)
+{
+    if (!blocks_)
+        return true;
+    lock();
+    const LogBlockSummary &b = blocks_[((baseSequence - 1) / LOG_INDEX_BLOCK) % blockCount_];
+    bool match = b.baseSequence != baseSequence ||
+                 (b.maxTimestamp >= since && b.minTimestamp <= until &&
+                  (!actionMask || (b.actionMask & actionMask)) &&
+                  (!userBit || (b.userBits & userBit)));
+    unlock();
+    return match;
+}
+
+// ==================== Query ====================
+
+static bool recordMatches(const AccessLogRecord &r, const AccessLogQuery &q)
+{
+    return r.sequence && r.timestamp >= q.since && r.timestamp <= q.until &&
+           (!q.actionMask || (q.actionMask & (1 << r.action))) &&
+           (!q.user || strcmp(r.user, q.user) == 0);
+}
+
+AccessLogScan::AccessLogScan(AccessLog &log, AccessLogIndex &index, const AccessLogQuery &query)
+    : log_(log), index_(index), query_(query), stop_(0), limit_(query.limit), replaying_(false), chunkPos_(0)
+{
+    userBit_ = query.user ? logUserBit(query.user) : 0;
+    oldest_ = log.firstSequence();
+    uint32_t next = log.nextSequence();
+    start_ = query.cursor && query.cursor < next ? query.cursor : next;
+    seq_ = start_;
+    page_ = {0, 0, 0, 0};
+}
+
+void AccessLogScan::rewind()
+{
+    if (!replaying_)
+    {
+        stop_ = seq_;
+        limit_ = page_.count;
+        replaying_ = true;
+    }
+    seq_ = start_;
+    chunkPos_ = 0;
+    page_.count = 0;
+}
+
+// Reads the next chunk that may hold a match into chunk_
+bool AccessLogScan::fill()
+{
+    while (seq_ > oldest_ && seq_ > stop_)
+    {
+        if (!replaying_ && page_.scanned >= LOG_QUERY_MAX_SCAN)
+        {
+            page_.nextCursor = seq_; // Budget spent: resume here
+            return false;
+        }
+
+        uint32_t base = ((seq_ - 2) / LOG_INDEX_BLOCK) * LOG_INDEX_BLOCK + 1; // Block of seq - 1
+        uint32_t low = base > oldest_ ? base : oldest_;
+        if (!index_.mayMatch(base, query_.since, query_.until, query_.actionMask, userBit_))
+        {
+            if (!replaying_)
+                page_.skippedBlocks++;
+            seq_ = low;
+            continue;
+        }
+
+        // Newest chunk of the block first, newest record of the chunk first
+        uint32_t n = seq_ - low < LOG_QUERY_CHUNK ? seq_ - low : LOG_QUERY_CHUNK;
+        log_.readRange(seq_ - n, n, chunk_);
+        if (!replaying_)
+            page_.scanned += n;
+        seq_ -= n;
+        chunkPos_ = n;
+        return true;
+    }
+    return false;
+}
+
+bool AccessLogScan::next(AccessLogRecord &record)
+{
+    if (page_.count >= limit_)
+        return false;
+    for (;;)
+    {
+        while (chunkPos_ > 0)
+        {
+            const AccessLogRecord &r = chunk_[--chunkPos_];
+            if (!recordMatches(r, query_) || r.sequence < oldest_)
+                continue;
+            record = r;
+            if (++page_.count == limit_ && !replaying_)
+                page_.nextCursor = r.sequence > oldest_ ? r.sequence : 0;
+            return true;
+        }
+        if (!fill())
+            return false;
+    }
+}
+
+AccessLogPage queryAccessLog(AccessLog &log, AccessLogIndex &index, const AccessLogQuery &query,
+                             AccessLogRecord *out, size_t outCapacity)
+{
+    AccessLogQuery bounded = query;
+    if (bounded.limit > outCapacity)
+        bounded.limit = outCapacity;
+    AccessLogScan scan(log, index, bounded);
+    size_t n = 0;
+    while (scan.next(out[n]))
+        n++;
+    return scan.page();
+}
@@ -0,0 +1,267 @@
+/**
+ * Group-Commit Access Log Writer
+ *
+ * The queue is Dmitry Vyukov's bounded MPMC ring: every slot carries a turn
+ * counter, producers claim a position with one CAS and publish the record by
+ * advancing the slot's turn, so several tasks may log at once without a lock
+ * and the writer task never blocks a producer.
+ *
+ * Writer loop:
+ *   sleep until an urgent push or the flush interval
+ *   repeat flush() until the queue is empty
+ * Each flush() pops at most LOG_BATCH_MAX records and hands them to
+ * AccessLog::append(records, n), which turns them into one card write (two
+ * when the batch wraps around the ring) followed by one fsync.
+ */
+
+#include "log_writer.h"
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+static_assert((LOG_QUEUE_DEPTH & (LOG_QUEUE_DEPTH - 1)) == 0, "LOG_QUEUE_DEPTH must be a power of two");
+
+#ifdef ESP_PLATFORM
+
+struct LogWriter::Platform
+{
+    TaskHandle_t task = nullptr;
+    std::atomic<bool> exited{true};
+};
+
+void LogWriter::wake()
+{
+    if (platform_->task)
+        xTaskNotifyGive(platform_->task);
+}
+
+void LogWriter::waitMs(uint32_t ms)
+{
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms));
+}
+
+#else
+
+struct LogWriter::Platform
+{
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool pending = false;
+};
+
+void LogWriter::wake()
+{
+    {
+        std::lock_guard<std::mutex> lock(platform_->mutex);
+        platform_->pending = true;
+    }
+    platform_->cond.notify_one();
+}
+
+void LogWriter::waitMs(uint32_t ms)
+{
+    std::unique_lock<std::mutex> lock(platform_->mutex);
+    platform_->cond.wait_for(lock, std::chrono::milliseconds(ms), [this] { return platform_->pending; });
+    platform_->pending = false;
+}
+
+#endif
+
+LogWriter::LogWriter(AccessLog &log, uint32_t flushIntervalMs)
+    : log_(log), flushIntervalMs_(flushIntervalMs), enqueuePos_(0), dequeuePos_(0),
+      running_(false), urgent_(false), queued_(0), written_(0), dropped_(0), failed_(0),
+      batches_(0), lastBatch_(0), largestBatch_(0), peakDepth_(0), platform_(new Platform())
+{
+    for (size_t i = 0; i < LOG_QUEUE_DEPTH; i++)
+        slots_[i].turn.store(i, std::memory_order_relaxed);
+}
+
+LogWriter::~LogWriter()
+{
+    stop();
+    delete platform_;
+}
+
+// ==================== QUEUE ====================
+
+bool LogWriter::push(const AccessLogRecord &record, bool critical)
+{
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;)
+    {
+        slot = &slots_[pos & (LOG_QUEUE_DEPTH - 1)];
+        size_t turn = slot->turn.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)turn - (intptr_t)pos;
+        if (diff == 0)
+        {
+            if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            dropped_++; // Full: the writer is a whole queue behind
+            return false;
+        }
+        else
+        {
+            pos = enqueuePos_.load(std::memory_order_relaxed);
+        }
+    }
+    slot->record = record;
+    slot->turn.store(pos + 1, std::memory_order_release);
+
+    queued_++;
+    uint32_t depth = (uint32_t)(pos + 1 - dequeuePos_.load(std::memory_order_relaxed));
+    uint32_t peak = peakDepth_.load();
+    while (depth > peak && !peakDepth_.compare_exchange_weak(peak, depth))
+    {
+    }
+
+    if (critical)
+    {
+        urgent_.store(true);
+        wake();
+    }
+    return true;
+}
+
+// Single consumer (the writer task / flush caller)
+bool LogWriter::pop(AccessLogRecord &record)
+{
+    size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+    Slot &slot = slots_[pos & (LOG_QUEUE_DEPTH - 1)];
+    if (slot.turn.load(std::memory_order_acquire) != pos + 1)
+        return false; // Empty, or the producer is still copying
+    record = slot.record;
+    slot.turn.store(pos + LOG_QUEUE_DEPTH, std::memory_order_release);
+    dequeuePos_.store(pos + 1, std::memory_order_relaxed);
+    return true;
+}
+
+// ==================== WRITER ====================
+
+size_t LogWriter::flush()
+{
+    AccessLogRecord batch[LOG_BATCH_MAX];
+    size_t n = 0;
+    while (n < LOG_BATCH_MAX && pop(batch[n]))
+        n++;
+    if (n == 0)
+        return 0;
+
+    if (log_.append(batch, n) && log_.sync())
+        written_ += n;
+    else
+        failed_ += n;
+
+    batches_++;
+    lastBatch_.store(n);
+    if (n > largestBatch_.load())
+        largestBatch_.store(n);
+    return n;
+}
+
+void LogWriter::run()
+{
+    while (running_.load())
+    {
+        if (!urgent_.load())
+            waitMs(flushIntervalMs_);
+        urgent_.store(false);
+        while (flush() > 0)
+        {
+        }
+    }
+    while (flush() > 0)
+    {
+    }
+#ifdef ESP_PLATFORM
+    platform_->task = nullptr;
+    platform_->exited.store(true);
+    vTaskDelete(nullptr);
+#endif
+}
+
+LogWriterStats LogWriter::stats() const
+{
+    LogWriterStats s;
+    s.queued = queued_.load();
+    s.written = written_.load();
+    s.dropped = dropped_.load();
+    s.failed = failed_.load();
+    s.batches = batches_.load();
+    s.lastBatch = lastBatch_.load();
+    s.largestBatch = largestBatch_.load();
+    s.depth = (uint32_t)(enqueuePos_.load() - dequeuePos_.load());
+    s.peakDepth = peakDepth_.load();
+    return s;
+}
+
+#ifdef ESP_PLATFORM
+
+static void logWriterTaskEntry(void *arg)
+{
+    LogWriter *writer = static_cast<LogWriter *>(arg);
+    writer->run();
+}
+
+bool LogWriter::start(int core)
+{
+    if (running_.load())
+        return true;
+    running_.store(true);
+    platform_->exited.store(false);
+
+    // Below the pipeline: logging may lag, recognition may not
+    if (xTaskCreatePinnedToCore(logWriterTaskEntry, "logWriter", LOG_WRITER_STACK, this, 1,
+                                &platform_->task, core) != pdPASS)
+    {
+        running_.store(false);
+        platform_->exited.store(true);
+        return false;
+    }
+    return true;
+}
+
+void LogWriter::stop()
+{
+    if (!running_.load())
+        return;
+    running_.store(false);
+    wake();
+    while (!platform_->exited.load())
+        vTaskDelay(1);
+}
+
+#else
+
+bool LogWriter::start(int core)
+{
+    (void)core;
+    if (running_.load())
+        return true;
+    running_.store(true);
+    platform_->thread = std::thread([this] { run(); });
+    return true;
+}
+
+void LogWriter::stop()
+{
+    if (!running_.load())
+        return;
+    running_.store(false);
+    wake();
+    if (platform_->thread.joinable())
+        platform_->thread.join();
+}
+
+#endif
@@ -9,11 +9,16 @@
  * - SPIFFS for face embeddings
  * - WiFi AP for Flutter app communication
  * - Door relay control (GPIO 21)
- * - MJPEG live stream on port 81
+ * - MJPEG live stream on port 81 (several viewers, recognition keeps running)
+ * - Capture (core 0) and detection/recognition (core 1) overlap via a lock-free frame queue
  *
  * STORAGE ARCHITECTURE:
  * - SD Card: Activity logs (persistent, unlimited storage)
- * - SPIFFS: Face embeddings (/fr.bin ~2KB per face)
+ * - SPIFFS: Face journal (/faces.log, append-only int8 templates + tombstones)
+ *           Face directory (/faces.dir, names + user metadata, no embeddings)
+ * - Flash:  Optional "faces" data partition - memory-mapped read-only gallery snapshot
+ *           /fr.bin is only read once to migrate legacy galleries
+ * - PSRAM: Resident int8 gallery index (540 bytes per face, loaded once at boot)
  * - RAM: Minimal buffer (5 logs max before flush to SD)
  */
 
@@ -25,11 +30,39 @@
 #include <SD_MMC.h>
 #include <Preferences.h>
 #include <vector>
-#include <set>
+#include <memory>
 #include <eloquent_esp32cam.h>
 #include <eloquent_esp32cam/face/detection.h>
 #include <eloquent_esp32cam/face/recognition.h>
+#include <img_converters.h>
+#include <human_face_detect_msr01.hpp>
+#include <human_face_detect_mnp01.hpp>
 #include "camera_pins.h"
+#include "face_embedding.h"
+#include "face_gallery.h"
+#include "face_ann.h"
+#include "face_store.h"
+#include "access_log.h"
+#include "log_writer.h"
+#include "log_index.h"
+#include "json_stream.h"
+#include "json_writer.h"
+#include "face_directory.h"
+#include "face_partition.h"
+#include "face_transfer.h"
+#include "face_tracker.h"
+#include "frame_pipeline.h"
+#include "frame_pool.h"
+#include "jpeg_on_demand.h"
+#include "mjpeg_fanout.h"
+#include "recognition_scheduler.h"
+#include "motion_gate.h"
+#include "face_roi.h"
+#include "detector_cascade.h"
+#include "face_tracks.h"
+#include "door_actuator.h"
+#include "psram_alloc.h"
+#include <lwip/sockets.h>
 
 using eloq::camera;
 using eloq::face::detection;
@@ -54,8 +87,10 @@ String configuredPassword = "";
 
 // Activity log storage - MINIMAL RAM buffer, flush to SD card
 #define MAX_RAM_LOGS 5 // Small buffer, flush to SD when full
-#define MAX_SD_LOGS 50 // Maximum logs stored on SD card
-#define SD_LOG_FILE "/access_logs.csv"
+#define ACCESS_LOG_FILE "/sdcard/access_log.bin" // Binary ring, ACCESS_LOG_CAPACITY events (see access_log.h)
+#define ACCESS_LOG_INDEX_FILE "/sdcard/access_log.idx" // Per-block summaries for /api/logs filters (see log_index.h)
+#define LOG_QUERY_PAGE_MAX 200                   // Events per /api/logs page
+#define SD_LOG_FILE "/access_logs.csv"           // Old CSV log, imported into the ring once
 #define SD_PROFILES_DIR "/profiles" // Directory for user profile images
 struct ActivityLog
 {
@@ -69,6 +104,10 @@ ActivityLog ramLogBuffer[MAX_RAM_LOGS];
 int ramLogIndex = 0;
 int ramLogCount = 0;
 bool sdCardReady = false;
+AccessLog accessLog;
+AccessLogIndex accessLogIndex;
+LogWriter logWriter(accessLog); // Group commit: one SD write per LOG_FLUSH_INTERVAL_MS (see log_writer.h)
+#define LOG_WRITER_CORE 0
 unsigned long bootTime = 0; // Track boot time for timestamps
 
 // ========================================
@@ -76,14 +115,25 @@ unsigned long bootTime = 0; // Track boot time for timestamps
 // ========================================
 #define PART_BOUNDARY "123456789000000000000987654321"
 WiFiServer streamServer(81); // MJPEG stream on port 81
+#define STREAM_TASK_CORE 0         // Next to WiFi; inference keeps core 1
+#define STREAM_PUMP_INTERVAL_MS 10 // Socket polling while viewers are connected
+#define STREAM_IDLE_INTERVAL_MS 50 // Accept polling with no viewers
+TaskHandle_t streamTaskHandle = nullptr;
 
-// handleMJPEGStream() defined after global variables
+// streamTask() defined after global variables
 
 // ========================================
 // ANTI-SPOOFING & RECOGNITION CONFIG
 // ========================================
 #define RECOGNITION_THRESHOLD 0.92f // Stricter threshold for better accuracy (improved from 0.88)
 #define RECOGNITION_CONFIRM_COUNT 3 // Must match 3 times consecutively
+#define RECOGNITION_MIN_MARGIN 0.05f // Best user must beat the runner-up by this much (else ambiguous)
+#define RECOGNITION_TOP_K 3         // Candidates kept by the matcher (logged for ambiguous matches)
+#define DETECTION_CONFIDENCE 0.8f   // Face detector score (improved from 0.7 - stricter detection)
+#define RECOGNITION_POLICY SCHEDULE_ADAPTIVE // fixed | adaptive | every_frame (switchable via /api/scheduler)
+#define RECOGNITION_ACTIVE_INTERVAL 0        // ms between detector runs while a face is in view (0 = every frame)
+#define RECOGNITION_IDLE_INTERVAL 1000       // ms between detector runs with an empty scene
+#define RECOGNITION_LINGER_MS 2000           // Stay at the active rate this long after the face left
 #define SAME_USER_COOLDOWN 5000     // 5 seconds between same user access
 #define DOOR_UNLOCK_DURATION 3000
 #define DOOR_RELAY_PIN 21
@@ -120,18 +170,110 @@ FacePosition faceHistory[LIVENESS_CHECK_COUNT];
 int faceHistoryIndex = 0;
 int faceHistoryCount = 0;
 
+// Face track cache - reuses the last match while the same face stays put
+// (TRACK_REFRESH_FRAMES / TRACK_REFRESH_MS in face_tracker.h bound the reuse).
+// Reused frames feed liveness but never count toward RECOGNITION_CONFIRM_COUNT.
+FaceTracker faceTracker;
+uint32_t notEnrolledLoggedTrack = 0; // Track whose DENIED_NOT_ENROLLED is already logged (0 = none)
+
+// Detector scheduling - full rate while someone is at the door, backs off
+// when the scene is empty (see recognition_scheduler.h). Web changes are
+// staged and picked up by the inference task.
+RecognitionScheduler recognitionScheduler({RECOGNITION_POLICY, RECOGNITION_ACTIVE_INTERVAL,
+                                           RECOGNITION_IDLE_INTERVAL, RECOGNITION_LINGER_MS});
+SchedulerConfig pendingSchedulerConfig;
+volatile bool schedulerConfigPending = false;
+uint32_t detectCostMs = 120;    // Running averages, feed the /api/scheduler simulation
+uint32_t recognizeCostMs = 180;
+
+// Motion gate in front of the detector while nobody is in view (see motion_gate.h)
+#define MOTION_GATE_ENABLED 1
+#define MOTION_THUMB_SCALE JPG_SCALE_8X // 240x240 -> 30x30 thumbnail
+#define MOTION_THUMB_DIVISOR 8
+MotionGate motionGate({MOTION_PIXEL_DELTA, MOTION_CHANGED_FRACTION});
+
+// ROI search (see face_roi.h). The window is scanned with the same esp-dl
+// two-stage detector the eloquent library wraps. Full-frame searches run the
+// pair once per frame too (detectFullFrame): the primary face, its landmarks
+// for the recognizer and every other face all come from that one pass.
+// (The eloquent detector is left to enrollment.)
+#define ROI_SEARCH_ENABLED 1
+FaceRoiTracker faceRoi;
+HumanFaceDetectMSR01 roiDetector(0.1F, 0.5F, 10, 0.2F);
+HumanFaceDetectMNP01 roiRefiner(0.5F, 0.3F, 5);
+uint8_t *roiFrameRgb = nullptr; // Decoded frame (RGB888, PSRAM)
+bool roiFrameDecoded = false;   // roiFrameRgb already holds the current frame
+uint8_t *roiCropRgb = nullptr;  // ROI window (RGB888, PSRAM)
+size_t roiBufferBytes = 0;
+std::list<dl::detect::result_t> *frameFaces = nullptr; // Full-frame results of this frame, nullptr after an ROI hit
+std::vector<int> primaryLandmarks;                    // Primary face keypoints, full-frame coordinates
+
+// Detector cascade (see detector_cascade.h): with nobody in view the
+// proposal stage alone checks for presence, the refinement stage only runs on
+// frames where it fired. Counters: GET /api/detector
+#define DETECTOR_CASCADE_ENABLED 1
+DetectorCascade detectorCascade;
+
+// Every face in the frame, not only detection.first (see face_tracks.h). The
+// main path keeps handling the primary face; the others get their own tracks
+// and cached matches. An unknown face during an unlock is reported once.
+#define MULTI_FACE_ENABLED 1
+#define TAILGATE_GRACE_MS 2000 // Unknown faces this long after relocking still count
+FaceTrackSet otherFaceTracks;
+uint32_t tailgateAlertedFor = 0; // Unlock time of the last TAILGATING_SUSPECTED event
+uint32_t tailgateEvents = 0;
+
 // Global variables - MINIMAL RAM USAGE
 AsyncWebServer server(80);
-bool isDoorUnlocked = false;
-unsigned long doorUnlockTime = 0;
+#define API_JSON_BUFFER 2048 // Stack buffer of one JSON reply, on the async_tcp task (see json_writer.h)
 bool enrollmentMode = false;
 bool enrollmentJustCompleted = false;
-bool liveFeedActive = false;           // Pause scanning when live feed is active
-unsigned long liveFeedLastRequest = 0; // Track last live feed request
 String lastEnrolledUser = "";
 String currentEnrollmentUser = "";
 int enrollmentSteps = 0;
 const int REQUIRED_ENROLLMENT_STEPS = 3;
+QuantizedEmbedding enrollmentCaptures[REQUIRED_ENROLLMENT_STEPS]; // Staged until the last step; a cancel drops them
+const unsigned long ENROLLMENT_STEP_PAUSE = 2000; // Frames are skipped (not slept on) between steps
+
+// Relay, status LED and enrollment pacing run on a one-shot esp_timer (see
+// door_actuator.h): unlocking, relocking and blinking never block a task
+void actuatorRelay(bool on, void *context) { digitalWrite(DOOR_RELAY_PIN, on ? HIGH : LOW); }
+void actuatorLed(bool on, void *context) { digitalWrite(STATUS_LED_PIN, on ? HIGH : LOW); }
+void actuatorEvent(ActuatorEvent event, void *context)
+{
+    if (event == ACTUATOR_DOOR_LOCKED)
+        Serial.println("Door locked automatically");
+    else if (event == ACTUATOR_ENROLLMENT_READY)
+        Serial.println("[ENROLL] Ready for the next step");
+}
+EspTimerClock actuatorClock;
+DoorActuator doorActuator(actuatorClock, {actuatorRelay, actuatorLed, actuatorEvent, nullptr});
+
+// Template aggregation: enrollment captures are fused into a normalized centroid
+// (+ diverse exemplars) so each identity costs this many comparisons per match.
+// 0 = keep every capture as its own template (legacy behaviour)
+#define GALLERY_TEMPLATES_PER_USER 1
+
+// Resident face gallery - int8 copy of /fr.bin kept in PSRAM, loaded once at boot
+FaceGallery faceGallery;
+FaceAnnIndex faceAnnIndex; // IVF front-end for large galleries (trained past ANN_MIN_RECORDS)
+
+// Journaled face store (append-only, CRC per record) - source of truth for the gallery
+#define FACE_STORE_PATH "/spiffs/faces.log"
+FaceStore faceStore;
+SemaphoreHandle_t galleryMutex = nullptr;   // Guards faceGallery/faceStore across tasks
+TaskHandle_t faceStoreTaskHandle = nullptr; // Background index training, compaction + snapshot rewrite
+
+// Name/metadata directory beside the journal - /api/users reads only this
+#define FACE_DIRECTORY_PATH "/spiffs/faces.dir"
+#define DEFAULT_MASA_BERLAKU "2025-12-31" // Shown when no expiry date was set
+FaceDirectory faceDirectory;
+
+// Optional memory-mapped snapshot (only if the partition table has a "faces"
+// data partition, see partitions_faces.csv). Matched in place from flash while
+// it is current; any gallery change falls back to PSRAM until it is rewritten.
+FacePartition facePartition;
+bool facePartitionCurrent = false;
 
 // System status structure - only essentials in RAM
 struct
@@ -154,65 +296,219 @@ void initWiFiAP();
 void setupWebServer();
 void handleEnrollment();
 void handleRecognition();
-void handleMJPEGStream();
+void streamTask(void *param);
 bool checkLiveness();
 void resetLivenessTracking();
 void unlockDoor(const String &userName);
 void logActivity(const String &userName, const String &action, bool success, float confidence = 0.0);
+void importLegacyLogFile();
 void updateSystemStatus();
+void loadFaceGallery();
+void releaseLegacyGallery();
+void importLegacyGallery();
+void faceStoreTask(void *param);
+void trainFaceIndexIfNeeded();
+void syncFaceDirectory();
+void refreshFacePartition();
+bool matchFaceGallery(const float *embedding, String &name, float &similarity);
+bool motionInFrame();
+bool decodeFrameRgb888();
+bool detectInRoi(const FaceRoi &roi, FaceBox &box);
+bool detectFullFrame(bool presenceCheck, FaceBox &box);
+void processOtherFaces(const FaceBox &primary);
+bool unlockWindowActive();
+void reportTailgating(uint16_t trackId);
 String getSystemInfo();
 
 // ========================================
-// MJPEG STREAMING FUNCTION
+// CAPTURE / INFERENCE PIPELINE
 // ========================================
-void handleMJPEGStream()
+// Capture runs on core 0 (next to WiFi, it mostly waits on the camera DMA),
+// detection + recognition on core 1, handed off through a lock-free queue
+// (see frame_pipeline.h). The driver buffer is handed back right after it
+// is copied into the pool, so the camera fills frame N+1 while frame N is
+// still being inferred.
+#define PIPELINE_CAPTURE_CORE 0
+#define PIPELINE_INFERENCE_CORE 1
+#define CAMERA_FRAME_BUFFERS 2
+
+// Raw capture: the sensor delivers RGB565, which the detector converts to
+// RGB888 without a JPEG decode. JPEG is only produced for frames that are
+// streamed or snapshotted (see jpeg_on_demand.h). 0 = JPEG capture as before.
+#define CAPTURE_RAW_FRAMES 1
+#define STREAM_JPEG_QUALITY 80 // fmt2jpg scale (0-100)
+
+// Pooled PSRAM frames (see frame_pool.h). Each captured frame is moved out of
+// the driver buffer once and then shared by reference between the detector,
+// the MJPEG stream and /api/snapshot. One buffer per concurrent reader plus
+// one being filled; a frame is dropped (and counted) when all are in use.
+#define FRAME_POOL_BUFFERS 6 // capture + queue + inference + latest + one per stream client that lags behind
+#if CAPTURE_RAW_FRAMES
+#define FRAME_POOL_BUFFER_BYTES (240 * 240 * 2) // One 240x240 RGB565 frame
+#else
+#define FRAME_POOL_BUFFER_BYTES (64 * 1024) // 240x240 JPEG at high quality stays well below this
+#endif
+#define JPEG_POOL_BUFFERS 4 // cached encoding + one being encoded + viewers still sending older ones
+#define JPEG_POOL_BUFFER_BYTES (64 * 1024)
+FramePool framePool;
+FrameSlot latestFrame; // Newest captured frame, for the stream and snapshots
+FramePool jpegPool;
+
+// fmt2jpg_cb streams the encoder output straight into the pooled buffer
+size_t jpegChunkToBuffer(void *arg, size_t index, const void *data, size_t len)
 {
-    // Check for new stream client
-    WiFiClient client = streamServer.available();
-    if (client)
-    {
-        Serial.println("[STREAM] New MJPEG client connected");
-        liveFeedActive = true;
-        liveFeedLastRequest = millis();
-
-        // Send HTTP header
-        client.println("HTTP/1.1 200 OK");
-        client.println("Content-Type: multipart/x-mixed-replace; boundary=" PART_BOUNDARY);
-        client.println("Access-Control-Allow-Origin: *");
-        client.println("Cache-Control: no-cache");
-        client.println("Connection: close");
-        client.println();
-
-        // Stream frames continuously while client is connected
-        while (client.connected())
+    FrameBuffer *out = static_cast<FrameBuffer *>(arg);
+    if (index + len > out->capacity)
+        return 0; // Abort: the JPEG does not fit
+    memcpy(out->data + index, data, len);
+    out->length = index + len;
+    return len;
+}
+
+bool encodeFrameJpeg(const FrameBuffer &raw, FrameBuffer &out, void *context)
+{
+    return fmt2jpg_cb(raw.data, raw.length, raw.width, raw.height, static_cast<pixformat_t>(raw.format),
+                      STREAM_JPEG_QUALITY, jpegChunkToBuffer, &out);
+}
+
+JpegFrameCache jpegFrames(jpegPool, PIXFORMAT_JPEG, encodeFrameJpeg, nullptr);
+
+class CameraFrameSource : public FrameSource
+{
+public:
+    bool acquire(PipelineFrame &frame) override
+    {
+        camera_fb_t *fb = esp_camera_fb_get();
+        if (!fb)
+            return false;
+
+        FrameRef buffer = framePool.acquire();
+        if (buffer && fb->len > buffer->capacity)
         {
-            if (!camera.capture().isOk())
-            {
-                delay(10);
-                continue;
-            }
+            framePool.noteOversize();
+            buffer.reset();
+        }
+        if (!buffer)
+        {
+            esp_camera_fb_return(fb);
+            return false;
+        }
 
-            // Send frame boundary and headers
-            client.printf("\r\n--%s\r\n", PART_BOUNDARY);
-            client.printf("Content-Type: image/jpeg\r\n");
-            client.printf("Content-Length: %u\r\n\r\n", camera.frame->len);
-
-            // Send frame data
-            size_t written = client.write(camera.frame->buf, camera.frame->len);
-            if (written != camera.frame->len)
-            {
-                Serial.println("[STREAM] Write error, client disconnected");
-                break;
-            }
+        // The only copy: the driver buffer goes straight back to the camera
+        memcpy(buffer->data, fb->buf, fb->len);
+        buffer->length = fb->len;
+        buffer->width = fb->width;
+        buffer->height = fb->height;
+        buffer->format = fb->format;
+        buffer->sequence = ++sequence_;
+        buffer->capturedMs = millis();
+        if (lastCaptureMs_)
+            frameIntervalMs_ = (frameIntervalMs_ * 7 + (buffer->capturedMs - lastCaptureMs_)) / 8;
+        lastCaptureMs_ = buffer->capturedMs;
+        esp_camera_fb_return(fb);
+
+        latestFrame.publish(buffer);
+        frame.handle = buffer.detach(); // The queue owns this reference now
+        return true;
+    }
+
+    void release(PipelineFrame &frame) override
+    {
+        FramePool::release(static_cast<FrameBuffer *>(frame.handle));
+    }
+
+    uint32_t nowMs() override { return millis(); }
+
+    uint32_t frameIntervalMs() const { return frameIntervalMs_; }
+
+private:
+    uint32_t sequence_ = 0;
+    uint32_t lastCaptureMs_ = 0;
+    uint32_t frameIntervalMs_ = 40; // Running average of the capture period
+};
+
+// The eloquent detector works on camera.frame, so each handed-off frame is
+// lent to it as a camera_fb_t view of the pooled buffer for the duration of
+// the handler. Only the inference task touches camera.frame.
+class AccessFrameProcessor : public FrameProcessor
+{
+public:
+    void process(const PipelineFrame &frame) override
+    {
+        const FrameBuffer *buffer = static_cast<const FrameBuffer *>(frame.handle);
+        camera_fb_t view = {};
+        view.buf = buffer->data;
+        view.len = buffer->length;
+        view.width = buffer->width;
+        view.height = buffer->height;
+        view.format = static_cast<pixformat_t>(buffer->format);
+
+        camera.frame = &view;
+        if (enrollmentMode)
+            handleEnrollment();
+        else
+            handleRecognition();
+        camera.frame = nullptr; // Pool buffer, never handed to esp_camera_fb_return()
+    }
+};
+
+CameraFrameSource cameraFrameSource;
+AccessFrameProcessor accessFrameProcessor;
+FramePipeline framePipeline(cameraFrameSource, accessFrameProcessor);
+
+// ========================================
+// MJPEG STREAMING TASK
+// ========================================
+// Non-blocking socket for the fan-out: send() takes what fits in the lwIP
+// send buffer and returns, so a slow viewer only delays itself
+class SocketStreamSink : public StreamSink
+{
+public:
+    explicit SocketStreamSink(const WiFiClient &client) : client_(client) {}
+
+    int send(const uint8_t *data, size_t len) override
+    {
+        int fd = client_.fd();
+        if (fd < 0)
+            return -1;
+        int n = ::send(fd, data, len, MSG_DONTWAIT);
+        if (n < 0)
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        return n;
+    }
+
+    void close() override { client_.stop(); }
 
-            liveFeedLastRequest = millis();
-            delay(33); // ~30 FPS
+private:
+    WiFiClient client_;
+};
+
+MjpegFanout mjpegFanout(PART_BOUNDARY);
+
+// Accepts viewers on port 81 and fans the latest pooled frame out to all of
+// them. Runs beside the pipeline - watching the feed never pauses recognition.
+void streamTask(void *param)
+{
+    for (;;)
+    {
+        WiFiClient client = streamServer.available();
+        if (client)
+        {
+            if (mjpegFanout.add(new SocketStreamSink(client)))
+                Serial.printf("[STREAM] MJPEG client connected (%u/%d)\n", (unsigned)mjpegFanout.clientCount(), MJPEG_MAX_CLIENTS);
+            else
+                Serial.println("[STREAM] MJPEG client rejected, all stream slots busy");
+        }
+
+        size_t before = mjpegFanout.clientCount();
+        if (before > 0)
+        {
+            mjpegFanout.pump(jpegFrames.jpeg(latestFrame.latest())); // Encoded once per frame, shared
+            if (mjpegFanout.clientCount() < before)
+                Serial.printf("[STREAM] MJPEG client disconnected (%u left)\n", (unsigned)mjpegFanout.clientCount());
         }
 
-        // Client disconnected
-        Serial.println("[STREAM] MJPEG client disconnected");
-        client.stop();
-        liveFeedActive = false;
+        vTaskDelay(pdMS_TO_TICKS(mjpegFanout.clientCount() > 0 ? STREAM_PUMP_INTERVAL_MS : STREAM_IDLE_INTERVAL_MS));
     }
 }
 
@@ -232,8 +528,8 @@ void setup()
     // Initialize hardware pins
     pinMode(DOOR_RELAY_PIN, OUTPUT);
     pinMode(STATUS_LED_PIN, OUTPUT);
-    digitalWrite(DOOR_RELAY_PIN, LOW);
-    digitalWrite(STATUS_LED_PIN, LOW);
+    if (!doorActuator.begin(false)) // Relay and LED off
+        Serial.println("ERROR: Door actuator timer could not be created!");
 
     // Step 1: Initialize Camera with optimal settings
     Serial.println("\n1. Initializing Camera...");
@@ -242,6 +538,18 @@ void setup()
         Serial.println("ERROR: Camera initialization failed!");
         return;
     }
+    if (!framePool.begin(FRAME_POOL_BUFFERS, FRAME_POOL_BUFFER_BYTES))
+    {
+        Serial.println("ERROR: Frame pool allocation failed!");
+        return;
+    }
+#if CAPTURE_RAW_FRAMES
+    if (!jpegPool.begin(JPEG_POOL_BUFFERS, JPEG_POOL_BUFFER_BYTES) || !jpegFrames.begin())
+    {
+        Serial.println("ERROR: JPEG buffer allocation failed!");
+        return;
+    }
+#endif
     systemStatus.cameraReady = true;
     Serial.printf("Free Heap after Camera init: %d bytes\n", ESP.getFreeHeap());
 
@@ -254,20 +562,22 @@ void setup()
         Serial.println("✓ SD Card initialized successfully");
         Serial.printf("   Card Size: %llu MB\n", SD_MMC.cardSize() / (1024 * 1024));
 
-        // Create/verify log file header if new
-        if (!SD_MMC.exists(SD_LOG_FILE))
+        // Open (or create) the access log ring, picking up the old CSV log once
+        if (accessLog.begin(ACCESS_LOG_FILE))
         {
-            File logFile = SD_MMC.open(SD_LOG_FILE, FILE_WRITE);
-            if (logFile)
-            {
-                logFile.println("timestamp,username,action,success,confidence");
-                logFile.close();
-                Serial.println("   Created new log file with header");
-            }
+            if (SD_MMC.exists(SD_LOG_FILE))
+                importLegacyLogFile();
+            if (accessLogIndex.begin(accessLog, ACCESS_LOG_INDEX_FILE))
+                Serial.printf("   Log index: %u blocks (%u events re-indexed)\n", accessLogIndex.blockCount(), accessLogIndex.rebuiltRecords());
+            else
+                Serial.println("⚠ Log index unavailable - filtered queries scan the whole log");
+            if (!logWriter.start(LOG_WRITER_CORE))
+                Serial.println("⚠ Log writer task could not be started");
+            Serial.printf("   Access log: %u events (capacity %u)\n", accessLog.count(), accessLog.capacity());
         }
         else
         {
-            Serial.println("   Log file exists, will append");
+            Serial.println("⚠ Access log could not be opened - logging to RAM only");
         }
     }
     else
@@ -285,6 +595,7 @@ void setup()
         return;
     }
     systemStatus.recognitionReady = true;
+    loadFaceGallery();
     Serial.printf("Free Heap after Recognition init: %d bytes\n", ESP.getFreeHeap());
 
     // Step 3: Initialize WiFi (Station mode first, then AP fallback)
@@ -300,9 +611,17 @@ void setup()
     // Step 5: Start MJPEG Stream Server on port 81
     Serial.println("\n5. Starting MJPEG Stream Server...");
     streamServer.begin();
+    xTaskCreatePinnedToCore(streamTask, "mjpeg", 4096, nullptr, 1, &streamTaskHandle, STREAM_TASK_CORE);
     Serial.println("[STREAM] MJPEG stream server started on port 81");
     Serial.printf("Free Heap after Stream Server init: %d bytes\n", ESP.getFreeHeap());
 
+    // Step 6: Start the capture/inference pipeline
+    Serial.println("\n6. Starting capture/inference pipeline...");
+    if (framePipeline.start(PIPELINE_CAPTURE_CORE, PIPELINE_INFERENCE_CORE))
+        Serial.printf("[PIPELINE] Capture on core %d, inference on core %d\n", PIPELINE_CAPTURE_CORE, PIPELINE_INFERENCE_CORE);
+    else
+        Serial.println("[PIPELINE] ERROR: failed to start pipeline tasks");
+
     updateSystemStatus();
 
     Serial.println("\n=== SYSTEM READY ===");
@@ -326,7 +645,7 @@ void setup()
     Serial.printf("Final Free Heap: %d bytes\n", ESP.getFreeHeap());
     Serial.printf("Final Free PSRAM: %d bytes\n", ESP.getFreePsram());
 
-    digitalWrite(STATUS_LED_PIN, HIGH); // System ready indicator
+    doorActuator.setLedIdle(true); // System ready indicator
 }
 
 // ========================================
@@ -334,31 +653,9 @@ void setup()
 // ========================================
 void loop()
 {
-    // Handle MJPEG streaming (blocks while client is connected)
-    handleMJPEGStream();
-
-    // Handle door unlock timing
-    if (isDoorUnlocked && millis() - doorUnlockTime > DOOR_UNLOCK_DURATION)
-    {
-        digitalWrite(DOOR_RELAY_PIN, LOW);
-        isDoorUnlocked = false;
-        Serial.println("Door locked automatically");
-    }
-
-    // Handle face recognition or enrollment (only when not streaming)
-    if (systemStatus.cameraReady && systemStatus.recognitionReady && !liveFeedActive)
-    {
-        if (enrollmentMode)
-        {
-            handleEnrollment();
-        }
-        else
-        {
-            handleRecognition();
-        }
-    }
-
-    delay(50); // Small delay between iterations
+    // MJPEG viewers are served by streamTask, recognition by the pipeline tasks,
+    // relocking and the LED by the actuator timer - nothing is left to poll
+    delay(1000);
 }
 
 // ========================================
@@ -370,7 +667,16 @@ bool initCamera()
     camera.pinout.freenove_s3();
     camera.brownout.disable();
     camera.resolution.face(); // 240x240 - optimal for face recognition
+#if CAPTURE_RAW_FRAMES
+    camera.config.pixel_format = PIXFORMAT_RGB565; // No JPEG decode before detection
+#else
     camera.quality.high();
+#endif
+
+    // Double buffering for the pipeline: the driver fills one buffer while
+    // inference still holds the other, and always hands out the newest frame
+    camera.config.fb_count = CAMERA_FRAME_BUFFERS;
+    camera.config.grab_mode = CAMERA_GRAB_LATEST;
 
     // Initialize camera with retry mechanism
     int attempts = 0;
@@ -388,7 +694,7 @@ bool initRecognition()
 {
     // Configure detection for accuracy
     detection.accurate();
-    detection.confidence(0.8); // Improved from 0.7 - stricter detection
+    detection.confidence(DETECTION_CONFIDENCE);
 
     // Configure recognition threshold
     recognition.confidence(RECOGNITION_THRESHOLD);
@@ -473,6 +779,188 @@ void initWiFiAP()
     Serial.printf("IP address: %s\n", WiFi.softAPIP().toString().c_str());
 }
 
+// ========================================
+// STREAMED JSON RESPONSES
+// ========================================
+// List endpoints serialize one element per JsonArrayStream pull, straight
+// from the source, instead of building the whole array in a String first.
+// The source state lives as long as the response (shared_ptr in the filler).
+size_t nextLogElement(void *context, char *out, size_t capacity);
+size_t nextRamLogElement(void *context, char *out, size_t capacity);
+size_t nextUserElement(void *context, char *out, size_t capacity);
+size_t nextProfileElement(void *context, char *out, size_t capacity);
+size_t nextNetworkElement(void *context, char *out, size_t capacity);
+
+struct LogListStream
+{
+    String user; // The scan's query.user points here
+    AccessLogScan scan;
+    JsonArrayStream json;
+
+    LogListStream(const AccessLogQuery &query, const String &userFilter)
+        : user(userFilter), scan(accessLog, accessLogIndex, withUser(query, user)), json(nextLogElement, this) {}
+
+    static AccessLogQuery withUser(AccessLogQuery query, const String &user)
+    {
+        query.user = user.length() > 0 ? user.c_str() : nullptr;
+        return query;
+    }
+};
+
+struct RamLogStream
+{
+    int next = 0;
+    int limit = 0;
+    JsonArrayStream json{nextRamLogElement, this};
+};
+
+// Ids are list positions: an edit between two chunks may shift the ones not
+// sent yet, just as an edit between GET /api/users and a PUT by id always could
+struct UserListStream
+{
+    size_t next = 0;
+    int userId = 0;
+    JsonArrayStream json{nextUserElement, this};
+};
+
+struct ProfileListStream
+{
+    File dir;
+    JsonArrayStream json{nextProfileElement, this, "{\"profiles\":[", "]}"};
+};
+
+struct WifiScanStream
+{
+    int count = 0;
+    int next = 0;
+    JsonArrayStream json{nextNetworkElement, this, "{\"networks\":[", "]}"};
+
+    ~WifiScanStream() { WiFi.scanDelete(); } // Results stay in the driver until the response is gone
+};
+
+template <typename Source>
+AsyncWebServerResponse *beginJsonStream(AsyncWebServerRequest *request, std::shared_ptr<Source> source)
+{
+    return request->beginChunkedResponse("application/json",
+        [source](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+            return source->json.read(buffer, maxLen);
+        });
+}
+
+size_t nextLogElement(void *context, char *out, size_t capacity)
+{
+    LogListStream *logs = static_cast<LogListStream *>(context);
+    AccessLogRecord record;
+    if (!logs->scan.next(record)) {
+        Serial.printf("[API] GET /api/logs - returned %u logs (SD: yes)\n", (unsigned)logs->json.elements());
+        return 0;
+    }
+    JsonWriter json(out, capacity);
+    json.beginObject()
+        .field("username", record.user)
+        .field("status", accessActionName(record.action))
+        .field("success", record.success)
+        .field("confidence", record.confidence)
+        .field("timestamp", record.timestamp)
+        .field("id", record.sequence)
+        .endObject();
+    return json.ok() ? json.length() : capacity;
+}
+
+size_t nextRamLogElement(void *context, char *out, size_t capacity)
+{
+    RamLogStream *logs = static_cast<RamLogStream *>(context);
+    if (logs->next >= ramLogCount || logs->next >= logs->limit) {
+        Serial.printf("[API] GET /api/logs - returned %d logs (SD: no)\n", logs->next);
+        return 0;
+    }
+    int idx = (ramLogIndex - 1 - logs->next++ + MAX_RAM_LOGS) % MAX_RAM_LOGS; // Newest first
+    const ActivityLog &entry = ramLogBuffer[idx];
+    JsonWriter json(out, capacity);
+    json.beginObject()
+        .field("username", entry.username.c_str())
+        .field("status", entry.action.c_str())
+        .field("success", entry.success)
+        .field("confidence", entry.confidence)
+        .field("timestamp", entry.timestamp)
+        .endObject();
+    return json.ok() ? json.length() : capacity;
+}
+
+size_t nextUserElement(void *context, char *out, size_t capacity)
+{
+    UserListStream *users = static_cast<UserListStream *>(context);
+    size_t n = 0;
+    xSemaphoreTake(galleryMutex, portMAX_DELAY);
+    while (n == 0 && users->next < faceDirectory.count()) {
+        const FaceDirectoryEntry &entry = faceDirectory.entry(users->next++);
+        if (entry.templates == 0) continue; // Metadata only, no face enrolled yet
+        JsonWriter json(out, capacity);
+        json.beginObject()
+            .field("id", users->userId++)
+            .field("name", entry.name)
+            .field("jabatan", entry.jabatan)
+            .field("departemen", entry.departemen)
+            .field("masaBerlaku", entry.masaBerlaku[0] ? entry.masaBerlaku : DEFAULT_MASA_BERLAKU)
+            .endObject();
+        n = json.ok() ? json.length() : capacity;
+    }
+    xSemaphoreGive(galleryMutex);
+    if (n == 0)
+        Serial.printf("[API] GET /api/users - returned %d unique users\n", users->userId);
+    return n;
+}
+
+size_t nextProfileElement(void *context, char *out, size_t capacity)
+{
+    ProfileListStream *profiles = static_cast<ProfileListStream *>(context);
+    if (!profiles->dir || !profiles->dir.isDirectory())
+        return 0;
+    for (File file = profiles->dir.openNextFile(); file; file = profiles->dir.openNextFile()) {
+        const char *name = file.name();
+        size_t len = strlen(name);
+        if (file.isDirectory() || len < 4 || strcmp(name + len - 4, ".jpg") != 0) continue;
+        
+        // Username is the filename without ".jpg"
+        JsonWriter json(out, capacity);
+        json.beginObject()
+            .beginString("username").append(name, len - 4).endString()
+            .field("size", file.size())
+            .endObject();
+        return json.ok() ? json.length() : capacity;
+    }
+    profiles->dir.close();
+    return 0;
+}
+
+size_t nextNetworkElement(void *context, char *out, size_t capacity)
+{
+    WifiScanStream *scan = static_cast<WifiScanStream *>(context);
+    while (scan->next < scan->count) {
+        const wifi_ap_record_t *ap = (const wifi_ap_record_t *)WiFi.getScanInfoByIndex(scan->next++);
+        if (!ap) continue;
+        JsonWriter json(out, capacity);
+        json.beginObject()
+            .field("ssid", (const char *)ap->ssid)
+            .field("rssi", ap->rssi)
+            .field("encryption", ap->authmode != WIFI_AUTH_OPEN)
+            .endObject();
+        return json.ok() ? json.length() : capacity;
+    }
+    return 0;
+}
+
+// Sends a reply built in a stack buffer by JsonWriter
+void sendJson(AsyncWebServerRequest *request, int code, const JsonWriter &json)
+{
+    if (!json.ok()) {
+        Serial.printf("[API] %s reply exceeds %d bytes\n", request->url().c_str(), API_JSON_BUFFER);
+        request->send(500, "application/json", "{\"error\":\"Reply too large\"}");
+        return;
+    }
+    request->send(code, "application/json", json.c_str());
+}
+
 // ========================================
 // WEB SERVER SETUP - MINIMAL ENDPOINTS
 // ========================================
@@ -486,18 +974,53 @@ void setupWebServer()
     // System status endpoint
     server.on("/api/status", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-        String status = "{";
-        status += "\"camera_ready\":" + String(systemStatus.cameraReady ? "true" : "false") + ",";
-        status += "\"recognition_ready\":" + String(systemStatus.recognitionReady ? "true" : "false") + ",";
-        status += "\"total_users\":" + String(systemStatus.totalUsers) + ",";
-        status += "\"last_user\":\"" + systemStatus.lastRecognizedUser + "\",";
-        status += "\"last_confidence\":" + String(systemStatus.lastConfidence, 2) + ",";
-        status += "\"door_unlocked\":" + String(isDoorUnlocked ? "true" : "false") + ",";
-        status += "\"free_heap\":" + String(ESP.getFreeHeap()) + ",";
-        status += "\"free_psram\":" + String(ESP.getFreePsram());
-        status += "}";
+        char buffer[API_JSON_BUFFER];
+        JsonWriter json(buffer, sizeof(buffer));
+        json.beginObject()
+            .field("camera_ready", systemStatus.cameraReady)
+            .field("recognition_ready", systemStatus.recognitionReady)
+            .field("total_users", systemStatus.totalUsers)
+            .field("last_user", systemStatus.lastRecognizedUser.c_str())
+            .field("last_confidence", systemStatus.lastConfidence)
+            .field("door_unlocked", doorActuator.doorUnlocked())
+            .field("recognizer_runs", faceTracker.stats().inferences)
+            .field("recognizer_skipped", faceTracker.stats().reused)
+            .field("motion_checked", motionGate.stats().frames)
+            .field("roi_searches", faceRoi.stats().roiSearches)
+            .field("roi_hits", faceRoi.stats().roiHits)
+            .field("full_searches", faceRoi.stats().fullSearches)
+            .field("other_faces", otherFaceTracks.activeCount())
+            .field("tailgating_events", tailgateEvents)
+            .field("motion_skipped", motionGate.stats().frames - motionGate.stats().motion);
+        PipelineStats pipeline = framePipeline.stats();
+        json.field("frames_captured", pipeline.captured)
+            .field("frames_processed", pipeline.processed)
+            .field("frames_dropped", pipeline.dropped)
+            .field("frame_latency_ms", pipeline.lastLatencyMs);
+        FramePoolStats pool = framePool.stats();
+        json.field("frame_pool_buffers", pool.buffers)
+            .field("frame_pool_in_use", pool.inUse)
+            .field("frame_pool_peak", pool.peakInUse)
+            .field("frame_pool_exhausted", pool.exhausted)
+            .field("frame_pool_oversize", pool.oversize);
+        MjpegStats stream = mjpegFanout.stats();
+        json.field("stream_clients", stream.clients)
+            .field("stream_frames_sent", stream.framesSent)
+            .field("stream_frames_dropped", stream.framesDropped);
+        LogWriterStats logs = logWriter.stats();
+        json.field("log_queue_depth", logs.depth)
+            .field("log_queue_peak", logs.peakDepth)
+            .field("log_last_batch", logs.lastBatch)
+            .field("log_largest_batch", logs.largestBatch)
+            .field("log_events_dropped", logs.dropped);
+        JpegCacheStats jpeg = jpegFrames.stats();
+        json.field("jpeg_encoded", jpeg.encoded)
+            .field("jpeg_reused", jpeg.reused)
+            .field("free_heap", ESP.getFreeHeap())
+            .field("free_psram", ESP.getFreePsram())
+            .endObject();
         
-        request->send(200, "application/json", status); });
+        sendJson(request, 200, json); });
 
     // Start enrollment mode - LIVE CAMERA ONLY
     server.on("/api/enroll/start", HTTP_POST, [](AsyncWebServerRequest *request)
@@ -518,18 +1041,24 @@ void setupWebServer()
         enrollmentMode = true;
         currentEnrollmentUser = userName;
         enrollmentSteps = 0;
+        doorActuator.releaseEnrollment();
         
         Serial.printf("Starting enrollment for: %s\n", userName.c_str());
         
-        request->send(200, "application/json", 
-            "{\"message\":\"Enrollment started for " + userName + "\",\"steps_required\":" + String(REQUIRED_ENROLLMENT_STEPS) + "}"); });
+        char buffer[API_JSON_BUFFER];
+        JsonWriter json(buffer, sizeof(buffer));
+        json.beginObject()
+            .beginString("message").append("Enrollment started for ").append(userName.c_str()).endString()
+            .field("steps_required", REQUIRED_ENROLLMENT_STEPS)
+            .endObject();
+        sendJson(request, 200, json); });
 
     // Cancel enrollment
     server.on("/api/enroll/cancel", HTTP_POST, [](AsyncWebServerRequest *request)
               {
         enrollmentMode = false;
         currentEnrollmentUser = "";
-        enrollmentSteps = 0;
+        enrollmentSteps = 0; // Drops the staged captures, the gallery never saw them
         
         request->send(200, "application/json", "{\"message\":\"Enrollment cancelled\"}"); });
 
@@ -538,23 +1067,22 @@ void setupWebServer()
               {
         Serial.println("[API] Clearing ALL enrolled faces...");
         
-        // Delete the SPIFFS file completely
+        // A legacy gallery that was never migrated must not come back on boot
         if (SPIFFS.exists("/fr.bin")) {
             SPIFFS.remove("/fr.bin");
             Serial.println("[API] Deleted /fr.bin");
         }
         
-        // Clear all enrolled IDs from recognizer
-        for (uint8_t i = 0; i < 20; i++) {
-            recognition.recognizer.delete_id(i);
-        }
-        
-        // Recreate empty file
-        File f = SPIFFS.open("/fr.bin", "wb");
-        f.close();
-        
-        // Reinitialize recognition system
-        recognition.begin();
+        xSemaphoreTake(galleryMutex, portMAX_DELAY);
+        faceGallery.clear();
+        if (!faceStore.appendClear()) // Compaction reclaims the space later
+            Serial.println("[API] WARNING: clear not persisted - faces will return after reboot");
+        facePartitionCurrent = false;
+        faceDirectory.clear();
+        faceDirectory.save(FACE_DIRECTORY_PATH);
+        xSemaphoreGive(galleryMutex);
+        if (faceStoreTaskHandle)
+            xTaskNotifyGive(faceStoreTaskHandle); // Empty the flash snapshot too
         
         // Reset system status
         systemStatus.totalUsers = 0;
@@ -568,7 +1096,7 @@ void setupWebServer()
         lastAccessUser = "";
         lastAccessTime = 0;
         
-        Serial.printf("[API] All faces cleared. Users now: %d\n", recognition.recognizer.get_enrolled_id_num());
+        Serial.printf("[API] All faces cleared. Users now: %u\n", (unsigned)faceGallery.userCount());
         updateSystemStatus();
         
         request->send(200, "application/json", "{\"success\":true,\"message\":\"All enrolled faces cleared\",\"total_users\":0}"); });
@@ -576,37 +1104,39 @@ void setupWebServer()
     // Get enrollment status
     server.on("/api/enroll/status", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-        String status = "{";
+        char buffer[API_JSON_BUFFER];
+        JsonWriter json(buffer, sizeof(buffer));
+        json.beginObject();
 
         if (enrollmentJustCompleted) {
             // Enrollment just completed - signal to Flutter app
-            status += "\"active\":false,";
-            status += "\"user\":\"" + lastEnrolledUser + "\",";
-            status += "\"steps_completed\":" + String(REQUIRED_ENROLLMENT_STEPS) + ",";
-            status += "\"steps_required\":" + String(REQUIRED_ENROLLMENT_STEPS) + ",";
-            status += "\"complete\":true,";
-            status += "\"message\":\"Enrollment completed for " + lastEnrolledUser + "\"";
+            json.field("active", false)
+                .field("user", lastEnrolledUser.c_str())
+                .field("steps_completed", REQUIRED_ENROLLMENT_STEPS)
+                .field("steps_required", REQUIRED_ENROLLMENT_STEPS)
+                .field("complete", true)
+                .beginString("message").append("Enrollment completed for ").append(lastEnrolledUser.c_str()).endString();
             // Clear the flag after sending completion status
             enrollmentJustCompleted = false;
         } else if (enrollmentMode) {
-            status += "\"active\":true,";
-            status += "\"user\":\"" + currentEnrollmentUser + "\",";
-            status += "\"steps_completed\":" + String(enrollmentSteps) + ",";
-            status += "\"steps_required\":" + String(REQUIRED_ENROLLMENT_STEPS) + ",";
-            status += "\"complete\":false,";
-            status += "\"message\":\"Enrolling step " + String(enrollmentSteps + 1) + "/" + String(REQUIRED_ENROLLMENT_STEPS) + "\"";
+            json.field("active", true)
+                .field("user", currentEnrollmentUser.c_str())
+                .field("steps_completed", enrollmentSteps)
+                .field("steps_required", REQUIRED_ENROLLMENT_STEPS)
+                .field("complete", false)
+                .beginString("message").append("Enrolling step ").append(enrollmentSteps + 1).append("/").append(REQUIRED_ENROLLMENT_STEPS).endString();
         } else {
-            status += "\"active\":false,";
-            status += "\"user\":\"\",";
-            status += "\"steps_completed\":0,";
-            status += "\"steps_required\":" + String(REQUIRED_ENROLLMENT_STEPS) + ",";
-            status += "\"complete\":false,";
-            status += "\"message\":\"Ready to enroll\"";
+            json.field("active", false)
+                .field("user", "")
+                .field("steps_completed", 0)
+                .field("steps_required", REQUIRED_ENROLLMENT_STEPS)
+                .field("complete", false)
+                .field("message", "Ready to enroll");
         }
 
-        status += "}";
+        json.endObject();
         
-        request->send(200, "application/json", status); });
+        sendJson(request, 200, json); });
 
     // Unlock door manually
     server.on("/api/door/unlock", HTTP_POST, [](AsyncWebServerRequest *request)
@@ -614,93 +1144,68 @@ void setupWebServer()
         unlockDoor("Manual");
         request->send(200, "application/json", "{\"message\":\"Door unlocked manually\"}"); });
 
-    // Get access logs - from SD card if available, else RAM buffer
+    // Get access logs - from SD card if available, else RAM buffer.
+    // SD filters: since/until (timestamp range), user, action (comma separated),
+    // cursor (from the X-Next-Cursor header of the previous page), limit
     server.on("/api/logs", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-        String json = "[";
-        bool first = true;
-        int logCount = 0;
-        
         // Optional limit parameter
         int limit = 100;  // Default limit
         if (request->hasParam("limit")) {
             limit = request->getParam("limit")->value().toInt();
         }
+        limit = constrain(limit, 1, LOG_QUERY_PAGE_MAX);
         
-        // Read from SD card if available
-        if (sdCardReady && SD_MMC.exists(SD_LOG_FILE)) {
-            File logFile = SD_MMC.open(SD_LOG_FILE, FILE_READ);
-            if (logFile) {
-                // Skip header line
-                logFile.readStringUntil('\n');
-                
-                // Read all lines into temporary storage to get newest first
-                std::vector<String> lines;
-                while (logFile.available() && lines.size() < 500) {  // Max 500 to prevent memory issues
-                    String line = logFile.readStringUntil('\n');
-                    line.trim();
-                    if (line.length() > 0) {
-                        lines.push_back(line);
-                    }
-                }
-                logFile.close();
-                
-                // Output newest first (reverse order)
-                int start = max(0, (int)lines.size() - limit);
-                for (int i = lines.size() - 1; i >= start; i--) {
-                    // Parse CSV: timestamp,username,action,success,confidence
-                    String line = lines[i];
-                    int p1 = line.indexOf(',');
-                    int p2 = line.indexOf(',', p1+1);
-                    int p3 = line.indexOf(',', p2+1);
-                    int p4 = line.indexOf(',', p3+1);
-                    
-                    if (p1 > 0 && p2 > 0 && p3 > 0 && p4 > 0) {
-                        String ts = line.substring(0, p1);
-                        String user = line.substring(p1+1, p2);
-                        String action = line.substring(p2+1, p3);
-                        String success = line.substring(p3+1, p4);
-                        String conf = line.substring(p4+1);
-                        
-                        if (!first) json += ",";
-                        first = false;
-                        
-                        json += "{";
-                        json += "\"username\":\"" + user + "\",";
-                        json += "\"status\":\"" + action + "\",";
-                        json += "\"success\":";
-                        json += (success == "1") ? "true" : "false";
-                        json += ",";
-                        json += "\"confidence\":" + conf + ",";
-                        json += "\"timestamp\":" + ts;
-                        json += "}";
-                        logCount++;
-                    }
+        // Fallback: Return from RAM buffer (newest first)
+        if (!sdCardReady || !accessLog.ready()) {
+            std::shared_ptr<RamLogStream> logs = std::make_shared<RamLogStream>();
+            logs->limit = limit;
+            request->send(beginJsonStream(request, logs));
+            return;
+        }
+        
+        // Query the SD ring, newest first, skipping blocks the index rules out
+        AccessLogQuery query = {0, 0xFFFFFFFF, nullptr, 0, 0, (size_t)limit};
+        String user;
+        if (request->hasParam("since"))
+            query.since = strtoul(request->getParam("since")->value().c_str(), nullptr, 10);
+        if (request->hasParam("until"))
+            query.until = strtoul(request->getParam("until")->value().c_str(), nullptr, 10);
+        if (request->hasParam("cursor"))
+            query.cursor = strtoul(request->getParam("cursor")->value().c_str(), nullptr, 10);
+        if (request->hasParam("user"))
+            user = request->getParam("user")->value();
+        if (request->hasParam("action")) {
+            String actions = request->getParam("action")->value() + ",";
+            for (int start = 0, comma; (comma = actions.indexOf(',', start)) >= 0; start = comma + 1) {
+                String name = actions.substring(start, comma);
+                name.trim();
+                if (name.length() == 0)
+                    continue;
+                AccessAction action;
+                if (!accessActionLookup(name.c_str(), action)) {
+                    // A typo must not silently turn into a filter on OTHER
+                    request->send(400, "application/json", "{\"error\":\"Unknown action\"}");
+                    return;
                 }
+                query.actionMask |= 1 << action;
             }
-        } else {
-            // Fallback: Return from RAM buffer (newest first)
-            for (int i = 0; i < ramLogCount && i < limit; i++) {
-                int idx = (ramLogIndex - 1 - i + MAX_RAM_LOGS) % MAX_RAM_LOGS;
-                if (idx < 0) idx += MAX_RAM_LOGS;
-                
-                if (!first) json += ",";
-                first = false;
-                
-                json += "{";
-                json += "\"username\":\"" + ramLogBuffer[idx].username + "\",";
-                json += "\"status\":\"" + ramLogBuffer[idx].action + "\",";
-                json += "\"success\":" + String(ramLogBuffer[idx].success ? "true" : "false") + ",";
-                json += "\"confidence\":" + String(ramLogBuffer[idx].confidence, 2) + ",";
-                json += "\"timestamp\":" + String(ramLogBuffer[idx].timestamp);
-                json += "}";
-                logCount++;
-            }
         }
-        json += "]";
+        std::shared_ptr<LogListStream> logs = std::make_shared<LogListStream>(query, user);
+        
+        // The cursor header leaves before the body: walk the page once to find
+        // where it ends, then replay it record by record as the body streams
+        AccessLogRecord record;
+        while (logs->scan.next(record)) {
+        }
+        AccessLogPage page = logs->scan.page();
+        logs->scan.rewind();
+        Serial.printf("[API] /api/logs scanned %u events, skipped %u blocks\n", page.scanned, page.skippedBlocks);
         
-        Serial.printf("[API] GET /api/logs - returning %d logs (SD: %s)\n", logCount, sdCardReady ? "yes" : "no");
-        request->send(200, "application/json", json); });
+        AsyncWebServerResponse *response = beginJsonStream(request, logs);
+        if (page.nextCursor)
+            response->addHeader("X-Next-Cursor", String(page.nextCursor)); // Body stays a plain array for the app
+        request->send(response); });
 
     // Clear activity logs - both RAM and SD card
     server.on("/api/logs/clear", HTTP_POST, [](AsyncWebServerRequest *request)
@@ -709,14 +1214,9 @@ void setupWebServer()
         ramLogIndex = 0;
         ramLogCount = 0;
         
-        // Clear SD card log file (recreate with header)
-        if (sdCardReady) {
-            SD_MMC.remove(SD_LOG_FILE);
-            File logFile = SD_MMC.open(SD_LOG_FILE, FILE_WRITE);
-            if (logFile) {
-                logFile.println("timestamp,username,action,success,confidence");
-                logFile.close();
-            }
+        // Clear the SD ring (one header write, the file keeps its size)
+        if (sdCardReady && accessLog.ready()) {
+            accessLog.clear();
             Serial.println("[API] Activity logs cleared (RAM + SD card)");
         } else {
             Serial.println("[API] Activity logs cleared (RAM only)");
@@ -727,30 +1227,19 @@ void setupWebServer()
     // Get SD card status
     server.on("/api/sdcard/status", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-        String json = "{";
-        json += "\"available\":" + String(sdCardReady ? "true" : "false");
+        char buffer[API_JSON_BUFFER];
+        JsonWriter json(buffer, sizeof(buffer));
+        json.beginObject().field("available", sdCardReady);
         if (sdCardReady) {
-            json += ",\"card_size_mb\":" + String(SD_MMC.cardSize() / (1024 * 1024));
-            json += ",\"used_bytes\":" + String(SD_MMC.usedBytes());
-            json += ",\"total_bytes\":" + String(SD_MMC.totalBytes());
-            
-            // Count log entries
-            int logLines = 0;
-            if (SD_MMC.exists(SD_LOG_FILE)) {
-                File f = SD_MMC.open(SD_LOG_FILE, FILE_READ);
-                if (f) {
-                    while (f.available()) {
-                        f.readStringUntil('\n');
-                        logLines++;
-                    }
-                    f.close();
-                    logLines--;  // Subtract header
-                }
-            }
-            json += ",\"log_entries\":" + String(logLines);
+            json.field("card_size_mb", SD_MMC.cardSize() / (1024 * 1024))
+                .field("used_bytes", SD_MMC.usedBytes())
+                .field("total_bytes", SD_MMC.totalBytes())
+                .field("log_entries", accessLog.count())
+                .field("log_capacity", accessLog.capacity())
+                .field("log_corrupt_records", accessLog.corruptRecords());
         }
-        json += "}";
-        request->send(200, "application/json", json); });
+        json.endObject();
+        sendJson(request, 200, json); });
 
     // ========================================
     // PROFILE IMAGE ENDPOINTS (SD Card Storage)
@@ -820,8 +1309,14 @@ void setupWebServer()
                     uploadFile.close();
                     Serial.printf("[PROFILE] Upload complete: %s (%d bytes)\n", uploadUsername.c_str(), totalSize);
                     
-                    String response = "{\"success\":true,\"username\":\"" + uploadUsername + "\",\"size\":" + String(totalSize) + "}";
-                    request->send(200, "application/json", response);
+                    char buffer[API_JSON_BUFFER];
+                    JsonWriter json(buffer, sizeof(buffer));
+                    json.beginObject()
+                        .field("success", true)
+                        .field("username", uploadUsername.c_str())
+                        .field("size", totalSize)
+                        .endObject();
+                    sendJson(request, 200, json);
                 } else {
                     request->send(500, "application/json", "{\"success\":false,\"error\":\"File write failed\"}");
                 }
@@ -885,31 +1380,10 @@ void setupWebServer()
             return;
         }
         
-        String json = "{\"profiles\":[";
-        bool first = true;
-        
-        File dir = SD_MMC.open(SD_PROFILES_DIR);
-        if (dir && dir.isDirectory()) {
-            File file = dir.openNextFile();
-            while (file) {
-                if (!file.isDirectory()) {
-                    String filename = String(file.name());
-                    if (filename.endsWith(".jpg")) {
-                        if (!first) json += ",";
-                        first = false;
-                        
-                        // Extract username from filename
-                        String username = filename.substring(0, filename.length() - 4);
-                        json += "{\"username\":\"" + username + "\",\"size\":" + String(file.size()) + "}";
-                    }
-                }
-                file = dir.openNextFile();
-            }
-            dir.close();
-        }
-        json += "]}";
-        
-        request->send(200, "application/json", json); });
+        // The directory is read a file per element while the response is sent
+        std::shared_ptr<ProfileListStream> profiles = std::make_shared<ProfileListStream>();
+        profiles->dir = SD_MMC.open(SD_PROFILES_DIR);
+        request->send(beginJsonStream(request, profiles)); });
 
     // ========================================
     // WIFI CONFIGURATION ENDPOINTS
@@ -918,38 +1392,33 @@ void setupWebServer()
     // Get current WiFi status
     server.on("/api/wifi/status", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-        String json = "{";
-        json += "\"mode\":\"" + String(isStationMode ? "STATION" : "AP") + "\",";
-        json += "\"ssid\":\"" + String(isStationMode ? configuredSSID : AP_SSID) + "\",";
-        json += "\"ip\":\"" + String(isStationMode ? WiFi.localIP().toString() : WiFi.softAPIP().toString()) + "\",";
-        json += "\"rssi\":" + String(isStationMode ? WiFi.RSSI() : 0) + ",";
-        json += "\"connected\":" + String(WiFi.status() == WL_CONNECTED ? "true" : "false");
-        json += "}";
-        request->send(200, "application/json", json); });
+        IPAddress address = isStationMode ? WiFi.localIP() : WiFi.softAPIP();
+        char ip[16];
+        snprintf(ip, sizeof(ip), "%u.%u.%u.%u", address[0], address[1], address[2], address[3]);
+        
+        char buffer[API_JSON_BUFFER];
+        JsonWriter json(buffer, sizeof(buffer));
+        json.beginObject()
+            .field("mode", isStationMode ? "STATION" : "AP")
+            .field("ssid", isStationMode ? configuredSSID.c_str() : AP_SSID)
+            .field("ip", ip)
+            .field("rssi", isStationMode ? WiFi.RSSI() : 0)
+            .field("connected", WiFi.status() == WL_CONNECTED)
+            .endObject();
+        sendJson(request, 200, json); });
 
     // Scan available WiFi networks
     server.on("/api/wifi/scan", HTTP_GET, [](AsyncWebServerRequest *request)
               {
         Serial.println("[API] Scanning WiFi networks...");
         
-        // Perform synchronous scan
+        // Perform synchronous scan; the results are serialized from the driver's list
+        std::shared_ptr<WifiScanStream> scan = std::make_shared<WifiScanStream>();
         int n = WiFi.scanNetworks();
-        
-        String json = "{\"networks\":[";
-        for (int i = 0; i < n; i++) {
-            if (i > 0) json += ",";
-            json += "{";
-            json += "\"ssid\":\"" + WiFi.SSID(i) + "\",";
-            json += "\"rssi\":" + String(WiFi.RSSI(i)) + ",";
-            json += "\"encryption\":" + String(WiFi.encryptionType(i) != WIFI_AUTH_OPEN ? "true" : "false");
-            json += "}";
-        }
-        json += "]}";
-        
-        WiFi.scanDelete(); // Clean up scan results
+        scan->count = n > 0 ? n : 0;
         
         Serial.printf("[API] Found %d networks\n", n);
-        request->send(200, "application/json", json); });
+        request->send(beginJsonStream(request, scan)); });
 
     // Configure WiFi credentials
     server.on("/api/wifi", HTTP_POST, [](AsyncWebServerRequest *request)
@@ -976,82 +1445,193 @@ void setupWebServer()
         
         // Restart ESP32 to apply new WiFi config
         Serial.println("[API] Restarting ESP32 to apply new WiFi config...");
+        logWriter.stop(); // Commit queued log events first
         ESP.restart(); });
 
     // Note: MJPEG streaming is handled by WiFiServer on port 81
 
     // API to control live feed state
+    // Kept for older app builds: the stream no longer pauses recognition, so
+    // there is nothing left to switch
     server.on("/api/livefeed/start", HTTP_POST, [](AsyncWebServerRequest *request)
               {
-        liveFeedActive = true;
-        liveFeedLastRequest = millis();
-        Serial.println("[API] Live feed STARTED - Recognition PAUSED");
-        request->send(200, "application/json", "{\"success\":true,\"message\":\"Live feed started, recognition paused\"}"); });
+        request->send(200, "application/json", "{\"success\":true,\"message\":\"Live feed started, recognition keeps running\"}"); });
 
     server.on("/api/livefeed/stop", HTTP_POST, [](AsyncWebServerRequest *request)
               {
-        liveFeedActive = false;
-        Serial.println("[API] Live feed STOPPED - Recognition RESUMED");
-        request->send(200, "application/json", "{\"success\":true,\"message\":\"Live feed stopped, recognition resumed\"}"); });
+        request->send(200, "application/json", "{\"success\":true,\"message\":\"Live feed stopped\"}"); });
+
+    // Latest camera frame as a single JPEG - served by reference from the frame
+    // pool, encoded on demand from a raw capture (no capture, recognition keeps running)
+    server.on("/api/snapshot", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+        // Held until the response is freed, even if the client drops
+        std::shared_ptr<FrameRef> frame = std::make_shared<FrameRef>(jpegFrames.jpeg(latestFrame.latest()));
+        if (!*frame) {
+            request->send(503, "application/json", "{\"error\":\"No frame captured yet\"}");
+            return;
+        }
+        
+        AsyncWebServerResponse *response = request->beginResponse("image/jpeg", (*frame)->length,
+            [frame](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                size_t len = (*frame)->length - index;
+                if (len > maxLen)
+                    len = maxLen;
+                memcpy(buffer, (*frame)->data + index, len);
+                return len;
+            });
+        request->send(response); });
+
+    // Detector stage counters for tuning the fast -> accurate hand-off
+    server.on("/api/detector", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+        char buffer[API_JSON_BUFFER];
+        JsonWriter json(buffer, sizeof(buffer));
+        json.beginObject()
+            .field("cascade", (bool)DETECTOR_CASCADE_ENABLED)
+            .field("handoffs", detectorCascade.handoffs())
+            .field("confirmed", detectorCascade.confirmed())
+            .beginArray("stages");
+        for (int i = 0; i < DETECT_STAGE_COUNT; i++) {
+            DetectorStage stage = static_cast<DetectorStage>(i);
+            const DetectorStageStats &stats = detectorCascade.stats(stage);
+            json.beginObject()
+                .field("stage", detectorStageName(stage))
+                .field("runs", stats.runs)
+                .field("hits", stats.hits)
+                .field("misses", stats.runs - stats.hits)
+                .field("avg_us", detectorCascade.averageUs(stage))
+                .field("last_us", stats.lastUs)
+                .endObject();
+        }
+        json.endArray().endObject();
+        sendJson(request, 200, json); });
+
+    // Recognition scheduler: current policy + a simulation of every policy with
+    // the measured frame period and detector/recognizer costs
+    server.on("/api/scheduler", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+        const SchedulerConfig &config = recognitionScheduler.config();
+        const SchedulerStats &stats = recognitionScheduler.stats();
+        SchedulerScenario scenario;
+        scenario.frameIntervalMs = cameraFrameSource.frameIntervalMs();
+        scenario.detectMs = detectCostMs;
+        scenario.recognizeMs = recognizeCostMs;
+        scenario.runsToUnlock = max(RECOGNITION_CONFIRM_COUNT, LIVENESS_CHECK_COUNT);
+        scenario.arrivalMs = 10000;
+
+        char buffer[API_JSON_BUFFER];
+        JsonWriter json(buffer, sizeof(buffer));
+        json.beginObject()
+            .field("policy", schedulePolicyName(config.policy))
+            .field("active_ms", config.activeIntervalMs)
+            .field("idle_ms", config.idleIntervalMs)
+            .field("linger_ms", config.lingerMs)
+            .field("interval_ms", recognitionScheduler.intervalMs())
+            .field("runs", stats.runs)
+            .field("face_runs", stats.faceRuns)
+            .field("skipped", stats.skipped)
+            .field("frame_ms", scenario.frameIntervalMs)
+            .field("detect_ms", scenario.detectMs)
+            .field("recognize_ms", scenario.recognizeMs)
+            .beginArray("simulation");
+        for (int p = 0; p < SCHEDULE_POLICY_COUNT; p++) {
+            SchedulerConfig candidate = config;
+            candidate.policy = static_cast<SchedulePolicy>(p);
+            SchedulerSimResult sim = simulateScheduler(candidate, scenario);
+            json.beginObject().field("policy", schedulePolicyName(candidate.policy));
+            if (sim.meanUnlockMs == SCHEDULER_NEVER)
+                json.fieldNull("unlock_ms");
+            else
+                json.field("unlock_ms", sim.meanUnlockMs);
+            if (sim.worstUnlockMs == SCHEDULER_NEVER)
+                json.fieldNull("worst_unlock_ms");
+            else
+                json.field("worst_unlock_ms", sim.worstUnlockMs);
+            json.field("idle_duty", sim.idleDutyCycle, 3)
+                .field("active_duty", sim.activeDutyCycle, 3)
+                .endObject();
+        }
+        json.endArray().endObject();
+        sendJson(request, 200, json); });
+
+    // Change the scheduling policy (policy=fixed|adaptive|every_frame, optional
+    // active_ms / idle_ms / linger_ms). Not persisted across reboots.
+    server.on("/api/scheduler", HTTP_POST, [](AsyncWebServerRequest *request)
+              {
+        SchedulerConfig config = recognitionScheduler.config();
+        if (request->hasParam("policy", true)) {
+            if (!parseSchedulePolicy(request->getParam("policy", true)->value().c_str(), config.policy)) {
+                request->send(400, "application/json", "{\"error\":\"Unknown policy\"}");
+                return;
+            }
+        }
+        if (request->hasParam("active_ms", true))
+            config.activeIntervalMs = request->getParam("active_ms", true)->value().toInt();
+        if (request->hasParam("idle_ms", true))
+            config.idleIntervalMs = request->getParam("idle_ms", true)->value().toInt();
+        if (request->hasParam("linger_ms", true))
+            config.lingerMs = request->getParam("linger_ms", true)->value().toInt();
+
+        pendingSchedulerConfig = config;
+        schedulerConfigPending = true;
+        Serial.printf("[API] Scheduler policy: %s (active %u ms, idle %u ms, linger %u ms)\n",
+                      schedulePolicyName(config.policy), config.activeIntervalMs, config.idleIntervalMs, config.lingerMs);
+        char buffer[API_JSON_BUFFER];
+        JsonWriter json(buffer, sizeof(buffer));
+        json.beginObject().field("success", true).field("policy", schedulePolicyName(config.policy)).endObject();
+        sendJson(request, 200, json); });
 
     // User management endpoints - reads actual enrolled faces from SPIFFS (returns UNIQUE users only)
     server.on("/api/users", HTTP_GET, [](AsyncWebServerRequest *request)
               {
-        // Read enrolled users from SPIFFS file - return UNIQUE names only
-        String json = "[";
-        bool first = true;
-        int userId = 0;
-        std::set<String> seenNames;
+        // Stream enrolled users from the resident name directory (unique names, no flash I/O)
+        request->send(beginJsonStream(request, std::make_shared<UserListStream>())); });
+
+    // Create/update user metadata (jabatan, departemen, masaBerlaku) in the name directory.
+    // Faces are still enrolled through /api/enroll; metadata may arrive before or after.
+    auto handleUserMetadata = [](AsyncWebServerRequest *request)
+    {
+        String name = request->hasParam("name", true) ? request->getParam("name", true)->value() : "";
+        name.trim();
         
-        File file = SPIFFS.open("/fr.bin", "rb");
-        if (file) {
-            while (file.available()) {
-                // Structure matches enrolled_face_t in recognition.h
-                struct {
-                    int id;
-                    char name[17];
-                    float embedding[512];
-                    uint8_t ctrl[2];
-                } enrolled;
-                
-                file.read((uint8_t*)&enrolled, sizeof(enrolled));
-                
-                // Verify control bytes
-                if (enrolled.ctrl[0] != 0x14 || enrolled.ctrl[1] != 0x08) {
-                    break; // Parse error, stop reading
+        xSemaphoreTake(galleryMutex, portMAX_DELAY);
+        if (name.length() == 0 && request->hasParam("id", true)) {
+            // Resolve the list index returned by GET /api/users
+            int targetId = request->getParam("id", true)->value().toInt();
+            int userId = 0;
+            for (size_t i = 0; i < faceDirectory.count(); i++) {
+                const FaceDirectoryEntry &entry = faceDirectory.entry(i);
+                if (entry.templates == 0) continue;
+                if (userId++ == targetId) {
+                    name = entry.name;
+                    break;
                 }
-                
-                // Skip empty or invalid names
-                if (strlen(enrolled.name) == 0) continue;
-                
-                // Skip if we already added this user (unique names only)
-                String userName = String(enrolled.name);
-                if (seenNames.count(userName) > 0) continue;
-                seenNames.insert(userName);
-                
-                if (!first) json += ",";
-                first = false;
-                
-                json += "{";
-                json += "\"id\":" + String(userId) + ",";
-                json += "\"name\":\"" + userName + "\",";
-                json += "\"jabatan\":\"\",";
-                json += "\"departemen\":\"\",";
-                json += "\"masaBerlaku\":\"2025-12-31\"";
-                json += "}";
-                userId++;
             }
-            file.close();
         }
-        json += "]";
         
-        Serial.printf("[API] GET /api/users - returning %d unique users\n", userId);
-        request->send(200, "application/json", json); });
-
-    server.on("/api/users", HTTP_POST, [](AsyncWebServerRequest *request)
-              {
-        // Dummy response - user data handled by face recognition system
-        request->send(200, "application/json", "{\"success\":true,\"message\":\"User data received\"}"); });
+        if (name.length() == 0 || name.length() >= FACE_NAME_LEN) {
+            xSemaphoreGive(galleryMutex);
+            request->send(400, "application/json", "{\"success\":false,\"message\":\"Missing or invalid name\"}");
+            return;
+        }
+        
+        auto field = [&](const char *key) -> const char * {
+            return request->hasParam(key, true) ? request->getParam(key, true)->value().c_str() : nullptr;
+        };
+        bool ok = faceDirectory.setMetadata(name.c_str(), field("jabatan"), field("departemen"), field("masaBerlaku")) &&
+                  faceDirectory.save(FACE_DIRECTORY_PATH);
+        xSemaphoreGive(galleryMutex);
+        
+        Serial.printf("[API] %s user metadata: %s\n", ok ? "Saved" : "FAILED to save", name.c_str());
+        if (ok) {
+            request->send(200, "application/json", "{\"success\":true,\"message\":\"User data saved\"}");
+        } else {
+            request->send(500, "application/json", "{\"success\":false,\"message\":\"Failed to save user data\"}");
+        }
+    };
+    server.on("/api/users", HTTP_POST, handleUserMetadata);
+    server.on("/api/users", HTTP_PUT, handleUserMetadata);
 
     // Delete user endpoint - SAFE IMPLEMENTATION (no dynamic memory)
     server.on("/api/users", HTTP_DELETE, [](AsyncWebServerRequest *request)
@@ -1073,78 +1653,168 @@ void setupWebServer()
         
         Serial.printf("[API] DELETE user request - id: %d, name: %s\n", targetId, targetName.c_str());
         
-        // Use temporary file approach - safer for memory
-        File readFile = SPIFFS.open("/fr.bin", "rb");
-        if (!readFile) {
-            request->send(500, "application/json", "{\"success\":false,\"message\":\"Cannot open faces file\"}");
+        // Directory lookup first - unknown users never touch flash. Under the
+        // lock: the inference task or an import may be rebuilding the directory.
+        xSemaphoreTake(galleryMutex, portMAX_DELAY);
+        if (faceGallery.findUser(targetName.c_str()) < 0) {
+            xSemaphoreGive(galleryMutex);
+            request->send(404, "application/json", "{\"success\":false,\"message\":\"User not found\"}");
             return;
         }
         
-        File writeFile = SPIFFS.open("/fr_temp.bin", "wb");
-        if (!writeFile) {
-            readFile.close();
-            request->send(500, "application/json", "{\"success\":false,\"message\":\"Cannot create temp file\"}");
-            return;
-        }
+        // Tombstone in the journal + in-memory removal - no file rewrite, no model reload
+        int deletedCount = faceGallery.removeUser(targetName.c_str());
+        bool persisted = faceStore.appendTombstone(targetName.c_str());
+        int keptCount = faceGallery.recordCount();
+        faceDirectory.remove(targetName.c_str());
+        faceDirectory.save(FACE_DIRECTORY_PATH);
+        facePartitionCurrent = false;
+        xSemaphoreGive(galleryMutex);
         
-        // Structure for enrolled face - static allocation
-        struct EnrolledFace {
-            int id;
-            char name[17];
-            float embedding[512];
-            uint8_t ctrl[2];
-        };
+        if (!persisted) {
+            Serial.println("[API] WARNING: tombstone not persisted - user will return after reboot");
+        }
+        if (faceStoreTaskHandle) {
+            xTaskNotifyGive(faceStoreTaskHandle); // Compaction / snapshot rewrite in the background
+        }
         
-        int currentId = 0;
-        int deletedCount = 0;
-        int keptCount = 0;
+        Serial.printf("[API] Deleted %d face records, kept %d\n", deletedCount, keptCount);
+        updateSystemStatus();
         
-        while (readFile.available() >= sizeof(EnrolledFace)) {
-            EnrolledFace enrolled;
-            size_t bytesRead = readFile.read((uint8_t*)&enrolled, sizeof(EnrolledFace));
+        char buffer[API_JSON_BUFFER];
+        JsonWriter json(buffer, sizeof(buffer));
+        json.beginObject()
+            .field("success", true)
+            .beginString("message").append("Deleted ").append(deletedCount).append(" face records").endString()
+            .field("remaining", keptCount)
+            .endObject();
+        sendJson(request, 200, json); });
+
+    // Gallery export - streams every user (metadata + int8 templates) as one
+    // checksummed binary stream, a frame at a time (see face_transfer.h)
+    server.on("/api/gallery/export", HTTP_GET, [](AsyncWebServerRequest *request)
+              {
+        // One exporter per response: freed with the response, even if the client drops
+        std::shared_ptr<FaceExporter> exporter = std::make_shared<FaceExporter>();
+        xSemaphoreTake(galleryMutex, portMAX_DELAY);
+        bool started = exporter->begin(faceGallery, &faceDirectory);
+        xSemaphoreGive(galleryMutex);
+        if (!started) {
+            request->send(503, "application/json", "{\"success\":false,\"error\":\"Not enough memory for export\"}");
+            return;
+        }
+
+        Serial.printf("[API] Gallery export started (%u users)\n", (unsigned)faceGallery.userCount());
+        AsyncWebServerResponse *response = request->beginChunkedResponse("application/octet-stream",
+            [exporter](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+                xSemaphoreTake(galleryMutex, portMAX_DELAY);
+                size_t len = exporter->read(buffer, maxLen);
+                xSemaphoreGive(galleryMutex);
+                if (len == 0) {
+                    Serial.printf("[API] Gallery export %s: %u users, %u templates, %u bytes\n",
+                                  exporter->aborted() ? "ABORTED (gallery changed)" : "done",
+                                  exporter->users(), exporter->faces(), (unsigned)index);
+                }
+                return len;
+            });
+        response->addHeader("Content-Disposition", "attachment; filename=\"gallery.fgex\"");
+        request->send(response); });
+
+    // Gallery import - multipart upload of an export stream, applied user by user
+    // as it arrives (imported users replace existing ones with the same name)
+    server.on("/api/gallery/import", HTTP_POST,
+              // Request handler (called after upload complete)
+              [](AsyncWebServerRequest *request)
+              {
+                  // Response sent by upload handler
+              },
+              // File upload handler - parses chunks directly, NO full-file buffer
+              [](AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final)
+              {
+            static FaceImporter importer;
+            static bool importOk = false;
+            static AsyncWebServerRequest *importOwner = nullptr; // The one upload being applied
             
-            if (bytesRead != sizeof(EnrolledFace)) break;
-            if (enrolled.ctrl[0] != 0x14 || enrolled.ctrl[1] != 0x08) break;
+            // Users are committed as they arrive: bring the directory up to
+            // date with whatever was applied and mark the flash snapshot stale.
+            // Index training is left to faceStoreTask (notified by the caller):
+            // k-means does not belong on the async_tcp stack or under the lock.
+            // Caller holds galleryMutex.
+            static auto finishImport = []() {
+                importer.end();
+                importOwner = nullptr;
+                faceDirectory.syncWithGallery(faceGallery);
+                faceDirectory.save(FACE_DIRECTORY_PATH);
+                facePartitionCurrent = false;
+            };
             
-            // Check if this face should be deleted
-            bool shouldDelete = false;
-            if (targetName.length() > 0 && String(enrolled.name) == targetName) {
-                shouldDelete = true;
+            xSemaphoreTake(galleryMutex, portMAX_DELAY);
+            if (index == 0 && !importOwner) {
+                importOwner = request;
+                importOk = importer.begin(faceGallery, &faceDirectory, &faceStore);
+                Serial.printf("[GALLERY] Import started: %s\n", filename.c_str());
+                
+                // A client that drops mid-upload must not hold the importer forever
+                request->onDisconnect([request]() {
+                    xSemaphoreTake(galleryMutex, portMAX_DELAY);
+                    bool dropped = importOwner == request;
+                    unsigned users = importer.users();
+                    if (dropped) {
+                        finishImport();
+                    }
+                    xSemaphoreGive(galleryMutex);
+                    if (dropped) {
+                        Serial.printf("[GALLERY] Import ABORTED (client gone): %u users applied\n", users);
+                        if (faceStoreTaskHandle)
+                            xTaskNotifyGive(faceStoreTaskHandle);
+                        updateSystemStatus();
+                    }
+                });
+            }
+            if (request != importOwner) {
+                // Another upload owns the importer: drop this body, answer 409 at its end
+                xSemaphoreGive(galleryMutex);
+                if (final) {
+                    Serial.println("[GALLERY] Import refused: another import is in progress");
+                    request->send(409, "application/json", "{\"success\":false,\"error\":\"Another import is in progress\"}");
+                }
+                return;
+            }
+            if (importOk) {
+                importOk = importer.feed(data, len);
             }
             
-            if (shouldDelete) {
-                deletedCount++;
-                Serial.printf("[API] Deleting face: %s (record: %d)\n", enrolled.name, currentId);
-            } else {
-                // Keep this face - write to temp file
-                writeFile.write((uint8_t*)&enrolled, sizeof(EnrolledFace));
-                keptCount++;
+            // Read the outcome before the lock goes: the next upload may begin() right after
+            bool complete = final && importOk && importer.finished();
+            unsigned users = importer.users();
+            unsigned templates = importer.faces();
+            const char *error = importer.error();
+            if (final) {
+                finishImport();
             }
-            currentId++;
-        }
-        
-        readFile.close();
-        writeFile.close();
-        
-        if (deletedCount == 0) {
-            // No faces deleted, remove temp file
-            SPIFFS.remove("/fr_temp.bin");
-            request->send(404, "application/json", "{\"success\":false,\"message\":\"User not found\"}");
-            return;
-        }
-        
-        // Replace original file with temp file
-        SPIFFS.remove("/fr.bin");
-        SPIFFS.rename("/fr_temp.bin", "/fr.bin");
-        
-        Serial.printf("[API] Deleted %d face records, kept %d\n", deletedCount, keptCount);
-        
-        // Reload recognition system
-        recognition.begin();
-        updateSystemStatus();
-        
-        String response = "{\"success\":true,\"message\":\"Deleted " + String(deletedCount) + " face records\",\"remaining\":" + String(keptCount) + "}";
-        request->send(200, "application/json", response); });
+            xSemaphoreGive(galleryMutex);
+            
+            if (final) {
+                if (faceStoreTaskHandle)
+                    xTaskNotifyGive(faceStoreTaskHandle);
+                updateSystemStatus();
+                
+                Serial.printf("[GALLERY] Import %s: %u users, %u templates (%u bytes)%s%s\n",
+                              complete ? "complete" : "FAILED", users, templates, (unsigned)(index + len),
+                              error ? " - " : "", error ? error : "");
+                
+                char buffer[API_JSON_BUFFER];
+                JsonWriter json(buffer, sizeof(buffer));
+                json.beginObject()
+                    .field("success", complete)
+                    .field("users", users)
+                    .field("templates", templates);
+                if (!complete) {
+                    json.field("error", error ? error : "truncated stream");
+                }
+                json.endObject();
+                sendJson(request, complete ? 200 : 400, json);
+            } });
 
     server.begin();
 
@@ -1161,21 +1831,29 @@ void handleEnrollment()
         return;
     }
 
-    // Capture image
-    if (!camera.capture().isOk())
+    // Let the user move between steps (frames in the meantime are dropped)
+    if (doorActuator.enrollmentHeld())
     {
         return;
     }
 
-    // Detect face
-    if (!recognition.detect().isOk())
+    // Detect face - the same esp-dl pass and aligned embedding as recognition,
+    // so nothing is written to /fr.bin or kept in the recognizer's float list
+    FaceBox box;
+    frameFaces = nullptr;
+    roiFrameDecoded = false;
+    if (!detectFullFrame(false, box))
     {
         return; // No face detected, continue waiting
     }
 
-    // Enroll face
-    if (recognition.enroll(currentEnrollmentUser).isOk())
+    std::vector<int> shape = {(int)camera.frame->height, (int)camera.frame->width, 3};
+    const float *embedding = recognition.recognizer.get_face_emb(roiFrameRgb, shape, primaryLandmarks).get_element_ptr();
+    if (embedding)
     {
+        // Stage the capture - it reaches the gallery only once enrollment completes
+        quantizeEmbedding(embedding, enrollmentCaptures[enrollmentSteps]);
+
         enrollmentSteps++;
         Serial.printf("Enrollment step %d/%d completed for %s\n",
                       enrollmentSteps, REQUIRED_ENROLLMENT_STEPS, currentEnrollmentUser.c_str());
@@ -1193,69 +1871,123 @@ void handleEnrollment()
             currentEnrollmentUser = "";
             enrollmentSteps = 0;
 
+            // Fuse the new captures into the per-user template(s) and journal them,
+            // replacing whatever the user had before
+            xSemaphoreTake(galleryMutex, portMAX_DELAY);
+            faceGallery.removeUser(lastEnrolledUser.c_str());
+            for (int i = 0; i < REQUIRED_ENROLLMENT_STEPS; i++)
+                faceGallery.addRecord(lastEnrolledUser.c_str(), enrollmentCaptures[i]);
+            faceGallery.fuseUser(lastEnrolledUser.c_str(), GALLERY_TEMPLATES_PER_USER);
+            facePartitionCurrent = false;
+            faceStore.appendTombstone(lastEnrolledUser.c_str());
+            if (!faceStore.appendUser(faceGallery, lastEnrolledUser.c_str()))
+                Serial.println("[GALLERY] WARNING: enrollment not persisted to journal");
+            syncFaceDirectory();
+            xSemaphoreGive(galleryMutex);
+            if (faceStoreTaskHandle)
+                xTaskNotifyGive(faceStoreTaskHandle); // Index training + flash snapshot rewrite
             updateSystemStatus();
         }
-
-        delay(2000); // Pause between enrollment steps
+        else
+        {
+            doorActuator.holdEnrollment(ENROLLMENT_STEP_PAUSE); // LED cues the next step
+        }
     }
 }
 
 void handleRecognition()
 {
-    static unsigned long lastRecognitionAttempt = 0;
     static unsigned long lastStatusPrint = 0;
-    const unsigned long RECOGNITION_INTERVAL = 1000;   // 1 second between attempts (faster for liveness)
     const unsigned long STATUS_PRINT_INTERVAL = 10000; // 10 seconds status update
-    const unsigned long LIVE_FEED_TIMEOUT = 5000;      // Auto-resume after 5 seconds of no live feed requests
 
-    // Auto-disable live feed if no requests for 5 seconds
-    if (liveFeedActive && (millis() - liveFeedLastRequest > LIVE_FEED_TIMEOUT))
+    if (schedulerConfigPending)
     {
-        liveFeedActive = false;
-        Serial.println("📷 Live feed timeout - Recognition RESUMED");
+        recognitionScheduler.configure(pendingSchedulerConfig);
+        schedulerConfigPending = false;
     }
 
-    // Skip recognition if live feed is active
-    if (liveFeedActive)
+    unsigned long runStart = millis();
+    if (!recognitionScheduler.due(runStart))
     {
-        return;
+        return; // Frame dropped, the scheduler is backing off
     }
 
-    if (millis() - lastRecognitionAttempt < RECOGNITION_INTERVAL)
+#if MOTION_GATE_ENABLED
+    // Empty scene: only wake the detector when the thumbnail changed. Someone
+    // already in view (liveness history) bypasses the gate, standing still is fine.
+    if (faceHistoryCount > 0)
+    {
+        motionGate.reset(); // Stale once the face leaves: first gated frame re-detects
+    }
+    else if (!motionInFrame())
     {
+        recognitionScheduler.ran(runStart, false);
         return;
     }
-
-    lastRecognitionAttempt = millis();
+#endif
 
     // Print periodic status
     if (millis() - lastStatusPrint > STATUS_PRINT_INTERVAL)
     {
         lastStatusPrint = millis();
-        Serial.printf("[SYSTEM] Scanning active | Free heap: %d bytes | Users: %d\n",
-                      ESP.getFreeHeap(), systemStatus.totalUsers);
+        const FaceTrackStats &track = faceTracker.stats();
+        Serial.printf("[SYSTEM] Scanning active | Free heap: %d bytes | Users: %d | Inferences: %u run, %u saved\n",
+                      ESP.getFreeHeap(), systemStatus.totalUsers, track.inferences, track.reused);
     }
 
-    // Capture image
-    if (!camera.capture().isOk())
+    // Detect face (camera.frame is the frame handed off by the pipeline)
+    // Search around the last face first, the full frame only when that fails
+    FaceBox box;
+    bool faceFound = false;
+    bool fullDetected = false; // frameFaces holds every face of this frame
+    int frameWidth = camera.frame->width;
+    int frameHeight = camera.frame->height;
+    frameFaces = nullptr; // The ROI search reuses the refiner's result list
+    roiFrameDecoded = false;
+#if ROI_SEARCH_ENABLED
+    FaceRoi roi;
+    if (!unlockWindowActive() && faceRoi.next(frameWidth, frameHeight, roi)) // Full frames while tailgating matters
     {
-        return;
+        unsigned long stageStart = micros();
+        faceFound = detectInRoi(roi, box);
+        detectorCascade.record(DETECT_STAGE_ROI, faceFound, micros() - stageStart);
+        if (faceFound)
+            faceRoi.roiHit(box, roi);
+        else
+            faceRoi.roiMiss(roi);
     }
-
-    // Detect face
-    if (!recognition.detect().isOk())
+#endif
+    if (!faceFound)
     {
-        // No face - reset liveness tracking
+        // Nobody in view: the proposal stage alone is the presence check
+        faceFound = detectFullFrame(DETECTOR_CASCADE_ENABLED && faceHistoryCount == 0, box);
+        fullDetected = true;
+        if (faceFound)
+        {
+            faceRoi.fullFound(box, frameWidth, frameHeight);
+        }
+        else
+        {
+            faceRoi.fullMissed(frameWidth, frameHeight);
+        }
+    }
+    detectCostMs = (detectCostMs * 7 + (millis() - runStart)) / 8;
+    recognitionScheduler.ran(runStart, faceFound);
+    if (!faceFound)
+    {
+        // No face - reset liveness tracking and end the face track
         resetLivenessTracking();
+        faceTracker.reset();
+        otherFaceTracks.clear();
         return;
     }
 
     // Face detected - record position for liveness check
     FacePosition currentPos;
-    currentPos.cx = detection.first.cx;
-    currentPos.cy = detection.first.cy;
-    currentPos.width = detection.first.width;
-    currentPos.height = detection.first.height;
+    currentPos.cx = box.cx;
+    currentPos.cy = box.cy;
+    currentPos.width = box.width;
+    currentPos.height = box.height;
     currentPos.valid = true;
 
     // Store in history
@@ -1275,11 +2007,45 @@ void handleRecognition()
         return;
     }
 
-    // Recognize face
-    if (recognition.recognize().isOk())
+#if MULTI_FACE_ENABLED
+    // Everyone else in the frame - on full-frame searches, which is every
+    // frame while the door is open (the ROI search pauses then)
+    if (fullDetected)
+        processOtherFaces(box);
+#endif
+
+    // Recognize face - recognizer extracts the embedding, int8 gallery does the matching.
+    // A stable track answers from the cache instead of re-running the recognizer.
+    String recognizedName;
+    float confidence = 0.0;
+    bool matched;
+    bool reused = faceTracker.update(box, millis(), faceGallery.revision()) == TRACK_REUSE;
+    if (reused)
+    {
+        matched = faceTracker.matched();
+        recognizedName = faceTracker.name();
+        confidence = faceTracker.similarity();
+        Serial.println("[TRACK] Stable face - reusing last embedding match");
+    }
+    else
+    {
+        // Aligned on the landmarks of this frame's detection (ROI or full frame alike)
+        unsigned long recognizeStart = millis();
+        std::vector<int> shape = {frameHeight, frameWidth, 3};
+        const float *embedding = recognition.recognizer.get_face_emb(roiFrameRgb, shape, primaryLandmarks).get_element_ptr();
+        if (!embedding)
+        {
+            // No fresh embedding: the recognizer's last one may be another face
+            faceTracker.reset();
+            return;
+        }
+        matched = matchFaceGallery(embedding, recognizedName, confidence);
+        faceTracker.store(matched, recognizedName.c_str(), confidence);
+        recognizeCostMs = (recognizeCostMs * 7 + (millis() - recognizeStart)) / 8;
+    }
+
+    if (matched)
     {
-        String recognizedName = recognition.match.name.c_str();
-        float confidence = recognition.match.similarity;
 
         // Skip if name is empty or unknown
         if (recognizedName.length() == 0 || recognizedName == "empty" || recognizedName == "unknown")
@@ -1303,15 +2069,19 @@ void handleRecognition()
             return;
         }
 
-        // Check for consecutive match confirmation (same person)
+        // Check for consecutive match confirmation (same person). A cached
+        // match is not a new observation: only fresh embeddings confirm, so
+        // RECOGNITION_CONFIRM_COUNT means that many independent inferences
+        // whatever TRACK_REFRESH_FRAMES is.
         if (recognizedName == lastConfirmedUser)
         {
-            consecutiveMatches++;
+            if (!reused)
+                consecutiveMatches++;
         }
         else
         {
             // Different person detected - reset
-            consecutiveMatches = 1;
+            consecutiveMatches = reused ? 0 : 1;
             lastConfirmedUser = recognizedName;
             resetLivenessTracking();
             faceHistory[0] = currentPos;
@@ -1380,11 +2150,210 @@ void handleRecognition()
         resetLivenessTracking();
         consecutiveMatches = 0;
         lastConfirmedUser = "";
-        logActivity("Unknown", "DENIED_NOT_ENROLLED", false);
+        // One log entry per unknown face, not one per frame it stays in view
+        if (faceTracker.track() != notEnrolledLoggedTrack)
+        {
+            notEnrolledLoggedTrack = faceTracker.track();
+            logActivity("Unknown", "DENIED_NOT_ENROLLED", false);
+        }
         Serial.println("[ERROR] Face not recognized - not enrolled");
+        if (unlockWindowActive())
+            reportTailgating(0);
     }
 }
 
+// 1/8-scale gray thumbnail of the current frame for the motion gate: block
+// average of a raw frame, 1/8-scale decode of a JPEG one. Fails open:
+// anything it cannot thumbnail goes to the detector.
+bool motionInFrame()
+{
+    static uint8_t thumbRgb565[MOTION_THUMB_MAX_PIXELS * 2];
+    static uint8_t thumbGray[MOTION_THUMB_MAX_PIXELS];
+
+    int width = (camera.frame->width + MOTION_THUMB_DIVISOR - 1) / MOTION_THUMB_DIVISOR;
+    int height = (camera.frame->height + MOTION_THUMB_DIVISOR - 1) / MOTION_THUMB_DIVISOR;
+    if (width * height > MOTION_THUMB_MAX_PIXELS)
+        return true;
+    if (camera.frame->format == PIXFORMAT_RGB565)
+    {
+        downscaleRgb565beToGray(camera.frame->buf, camera.frame->width, camera.frame->height, MOTION_THUMB_DIVISOR, thumbGray);
+        return motionGate.update(thumbGray, width, height);
+    }
+    if (camera.frame->format != PIXFORMAT_JPEG)
+        return true;
+    if (!jpg2rgb565(camera.frame->buf, camera.frame->len, thumbRgb565, MOTION_THUMB_SCALE))
+        return true;
+
+    rgb565beToGray(thumbRgb565, thumbGray, width * height);
+    return motionGate.update(thumbGray, width, height);
+}
+
+// Two-stage esp-dl detection on the ROI window only. Returns the best face
+// above DETECTION_CONFIDENCE in full-frame coordinates.
+// Decode the current frame into roiFrameRgb (buffers allocated on first use),
+// once per frame: an ROI miss falls back to the full frame on the same decode
+bool decodeFrameRgb888()
+{
+    if (roiFrameDecoded)
+        return true;
+    size_t frameBytes = (size_t)camera.frame->width * camera.frame->height * 3;
+    if (frameBytes > roiBufferBytes)
+    {
+        psramFree(roiFrameRgb);
+        psramFree(roiCropRgb);
+        roiFrameRgb = (uint8_t *)psramAlloc(frameBytes);
+        roiCropRgb = (uint8_t *)psramAlloc(frameBytes);
+        roiBufferBytes = roiFrameRgb && roiCropRgb ? frameBytes : 0;
+        if (!roiBufferBytes)
+            return false;
+    }
+    roiFrameDecoded = fmt2rgb888(camera.frame->buf, camera.frame->len, camera.frame->format, roiFrameRgb);
+    return roiFrameDecoded;
+}
+
+bool detectInRoi(const FaceRoi &roi, FaceBox &box)
+{
+    if (!decodeFrameRgb888())
+        return false;
+    cropRgb888(roiFrameRgb, camera.frame->width, roi, roiCropRgb);
+
+    std::vector<int> shape = {roi.height, roi.width, 3};
+    std::list<dl::detect::result_t> &candidates = roiDetector.infer(roiCropRgb, shape);
+    std::list<dl::detect::result_t> &results = roiRefiner.infer(roiCropRgb, shape, candidates);
+
+    const dl::detect::result_t *best = nullptr;
+    for (const dl::detect::result_t &result : results)
+    {
+        if (result.score >= DETECTION_CONFIDENCE && (!best || result.score > best->score))
+            best = &result;
+    }
+    if (!best)
+        return false;
+
+    box = roiBoxToFrame(roi, best->box[0], best->box[1], best->box[2], best->box[3]);
+    primaryLandmarks = best->keypoint; // (x, y) pairs in the window: shift them into the frame
+    for (size_t i = 0; i + 1 < primaryLandmarks.size(); i += 2)
+    {
+        primaryLandmarks[i] += roi.x;
+        primaryLandmarks[i + 1] += roi.y;
+    }
+    return true;
+}
+
+// Full-frame two-stage esp-dl pass, once per frame. The proposal stage
+// doubles as the cascade's presence check: with presenceCheck set, no
+// proposals ends the search before the refinement stage runs. Leaves all
+// faces in frameFaces for processOtherFaces().
+bool detectFullFrame(bool presenceCheck, FaceBox &box)
+{
+    frameFaces = nullptr;
+    if (!decodeFrameRgb888())
+        return false;
+
+    std::vector<int> shape = {(int)camera.frame->height, (int)camera.frame->width, 3};
+    unsigned long stageStart = micros();
+    std::list<dl::detect::result_t> &candidates = roiDetector.infer(roiFrameRgb, shape);
+    if (presenceCheck)
+    {
+        bool present = !candidates.empty();
+        detectorCascade.record(DETECT_STAGE_FAST, present, micros() - stageStart);
+        if (!present)
+            return false;
+        stageStart = micros();
+    }
+    std::list<dl::detect::result_t> &results = roiRefiner.infer(roiFrameRgb, shape, candidates);
+    frameFaces = &results;
+
+    const dl::detect::result_t *best = nullptr;
+    for (const dl::detect::result_t &result : results)
+    {
+        if (result.score >= DETECTION_CONFIDENCE && (!best || result.score > best->score))
+            best = &result;
+    }
+    detectorCascade.record(DETECT_STAGE_ACCURATE, best != nullptr, micros() - stageStart);
+    if (presenceCheck)
+        detectorCascade.handoff(best != nullptr);
+    if (!best)
+        return false;
+
+    FaceRoi frame = {0, 0, (int)camera.frame->width, (int)camera.frame->height};
+    box = roiBoxToFrame(frame, best->box[0], best->box[1], best->box[2], best->box[3]);
+    primaryLandmarks = best->keypoint;
+    return true;
+}
+
+// All faces other than the primary one, from the full-frame pass the primary
+// face came from, then per-track cached matches, so only new or moved faces
+// cost an embedding
+void processOtherFaces(const FaceBox &primary)
+{
+    if (!frameFaces)
+        return;
+
+    std::vector<int> shape = {(int)camera.frame->height, (int)camera.frame->width, 3};
+    FaceRoi frame = {0, 0, (int)camera.frame->width, (int)camera.frame->height};
+
+    otherFaceTracks.beginFrame();
+    for (dl::detect::result_t &result : *frameFaces)
+    {
+        if (result.score < DETECTION_CONFIDENCE)
+            continue;
+        FaceBox box = roiBoxToFrame(frame, result.box[0], result.box[1], result.box[2], result.box[3]);
+        if (faceBoxIoU(box, primary) >= TRACK_MIN_IOU)
+            continue; // The main path owns this one
+
+        int index = otherFaceTracks.assign(box);
+        if (index < 0)
+            continue;
+        FaceTrackSlot &slot = otherFaceTracks.slot(index);
+
+        bool matched;
+        String name;
+        float similarity = 0.0;
+        FaceTrackDecision decision = slot.tracker.update(box, millis(), faceGallery.revision());
+        if (decision == TRACK_REUSE)
+        {
+            matched = slot.tracker.matched();
+            name = slot.tracker.name();
+            similarity = slot.tracker.similarity();
+        }
+        else
+        {
+            const float *embedding = recognition.recognizer.get_face_emb(roiFrameRgb, shape, result.keypoint).get_element_ptr();
+            matched = matchFaceGallery(embedding, name, similarity);
+            slot.tracker.store(matched, name.c_str(), similarity);
+            if (decision == TRACK_NEW)
+                logActivity(matched ? name : String("Unknown"), "FACE_IN_VIEW", matched, similarity);
+        }
+
+        Serial.printf("[FACE #%u] (%d,%d) %dx%d: %s (%.2f)%s\n", slot.id, box.cx, box.cy, box.width, box.height,
+                      matched ? name.c_str() : "unknown", similarity, decision == TRACK_REUSE ? " [cached]" : "");
+        if (!matched && unlockWindowActive())
+            reportTailgating(slot.id);
+    }
+    otherFaceTracks.endFrame();
+}
+
+// Door open, or closed less than TAILGATE_GRACE_MS ago
+bool unlockWindowActive()
+{
+    uint32_t unlockedAt = doorActuator.unlockedAtMs();
+    return unlockedAt != 0 && actuatorClock.nowMs() - unlockedAt < DOOR_UNLOCK_DURATION + TAILGATE_GRACE_MS;
+}
+
+// One event per unlock; trackId 0 = the primary face
+void reportTailgating(uint16_t trackId)
+{
+    uint32_t unlockedAt = doorActuator.unlockedAtMs();
+    if (tailgateAlertedFor == unlockedAt)
+        return;
+    tailgateAlertedFor = unlockedAt;
+    tailgateEvents++;
+    Serial.printf("[ALERT] TAILGATING_SUSPECTED: unknown face (track %u) during unlock for %s\n",
+                  trackId, lastAccessUser.c_str());
+    logActivity(lastAccessUser, "TAILGATING_SUSPECTED", false);
+}
+
 // ========================================
 // LIVENESS DETECTION - Anti-Spoofing (STRICT)
 // ========================================
@@ -1534,97 +2503,77 @@ void resetLivenessTracking()
 // ========================================
 void unlockDoor(const String &userName)
 {
-    digitalWrite(DOOR_RELAY_PIN, HIGH);
-    isDoorUnlocked = true;
-    doorUnlockTime = millis();
+    // Relay on, blink pattern and relock are all timer driven: returns at once
+    doorActuator.unlock(DOOR_UNLOCK_DURATION);
 
     Serial.printf("Door unlocked for: %s\n", userName.c_str());
-
-    // Blink status LED
-    for (int i = 0; i < 3; i++)
-    {
-        digitalWrite(STATUS_LED_PIN, LOW);
-        delay(100);
-        digitalWrite(STATUS_LED_PIN, HIGH);
-        delay(100);
-    }
 }
 
-// Trim SD log file to keep only last MAX_SD_LOGS entries
-void trimSDLogFile()
+// One-time import of the old CSV log (timestamp,username,action,success,confidence)
+void importLegacyLogFile()
 {
-    if (!sdCardReady || !SD_MMC.exists(SD_LOG_FILE))
-        return;
-
     File logFile = SD_MMC.open(SD_LOG_FILE, FILE_READ);
     if (!logFile)
         return;
 
-    // Read all lines
-    std::vector<String> lines;
-    String header = logFile.readStringUntil('\n'); // Keep header
+    int imported = 0;
+    logFile.readStringUntil('\n'); // Skip header
     while (logFile.available())
     {
         String line = logFile.readStringUntil('\n');
         line.trim();
-        if (line.length() > 0)
-        {
-            lines.push_back(line);
-        }
+        int p1 = line.indexOf(',');
+        int p2 = line.indexOf(',', p1 + 1);
+        int p3 = line.indexOf(',', p2 + 1);
+        int p4 = line.indexOf(',', p3 + 1);
+        if (p1 <= 0 || p2 <= 0 || p3 <= 0 || p4 <= 0)
+            continue;
+
+        AccessLogRecord record = {};
+        record.timestamp = line.substring(0, p1).toInt();
+        strncpy(record.user, line.substring(p1 + 1, p2).c_str(), ACCESS_LOG_USER_LEN - 1);
+        record.action = accessActionCode(line.substring(p2 + 1, p3).c_str());
+        record.success = line.substring(p3 + 1, p4) == "1";
+        record.confidence = line.substring(p4 + 1).toFloat();
+        if (accessLog.append(record))
+            imported++;
     }
     logFile.close();
 
-    // If under limit, no need to trim
-    if (lines.size() <= MAX_SD_LOGS)
-        return;
-
-    // Keep only the last MAX_SD_LOGS entries
-    int startIdx = lines.size() - MAX_SD_LOGS;
-
-    // Rewrite file with trimmed data
-    logFile = SD_MMC.open(SD_LOG_FILE, FILE_WRITE);
-    if (logFile)
-    {
-        logFile.println(header); // Write header
-        for (int i = startIdx; i < lines.size(); i++)
-        {
-            logFile.println(lines[i]);
-        }
-        logFile.close();
-        Serial.printf("📝 SD LOG: Trimmed to %d entries (was %d)\n", MAX_SD_LOGS, lines.size());
-    }
+    accessLog.sync();
+    SD_MMC.remove(SD_LOG_FILE);
+    Serial.printf("📝 SD LOG: Imported %d entries from %s\n", imported, SD_LOG_FILE);
 }
 
 void logActivity(const String &userName, const String &action, bool success, float confidence)
 {
     unsigned long timestamp = millis();
 
-    // Write directly to SD card if available (offload RAM)
-    if (sdCardReady)
+    // Queue for the SD writer task if available (offload RAM, never waits on the card)
+    bool storeInRam = true;
+    if (sdCardReady && accessLog.ready())
     {
-        File logFile = SD_MMC.open(SD_LOG_FILE, FILE_APPEND);
-        if (logFile)
+        AccessLogRecord record = {};
+        record.timestamp = timestamp;
+        strncpy(record.user, userName.c_str(), ACCESS_LOG_USER_LEN - 1);
+        record.action = accessActionCode(action.c_str());
+        record.success = success;
+        record.confidence = confidence;
+
+        // Door openings and alerts must survive a power cut: written at once,
+        // everything else rides along with the next group commit
+        bool critical = record.action == ACCESS_ACTION_GRANTED || record.action == ACCESS_ACTION_TAILGATING_SUSPECTED;
+        if (logWriter.push(record, critical))
         {
-            // CSV format: timestamp,username,action,success,confidence
-            logFile.printf("%lu,%s,%s,%d,%.2f\n",
-                           timestamp, userName.c_str(), action.c_str(),
-                           success ? 1 : 0, confidence);
-            logFile.close();
+            storeInRam = false;
             Serial.printf("📝 SD LOG: %s - %s - %s - %.2f\n",
                           userName.c_str(), action.c_str(), success ? "YES" : "NO", confidence);
-
-            // Trim log file if it gets too large
-            trimSDLogFile();
-        }
-        else
-        {
-            // SD write failed, fall back to RAM
-            goto store_in_ram;
         }
     }
-    else
+
+    // No SD card, or the writer queue is full
+    if (storeInRam)
     {
-    store_in_ram:
         // Store in small RAM buffer (circular, overwrites old)
         ramLogBuffer[ramLogIndex].username = userName;
         ramLogBuffer[ramLogIndex].action = action;
@@ -1644,34 +2593,286 @@ void logActivity(const String &userName, const String &action, bool success, flo
 
 void updateSystemStatus()
 {
-    // Count UNIQUE enrolled users by reading names from SPIFFS
-    std::set<String> uniqueNames;
+    // Unique user count is maintained incrementally by the gallery directory
+    systemStatus.totalUsers = faceGallery.userCount();
+    Serial.printf("System status updated - Users: %d\n", systemStatus.totalUsers);
+}
+
+// ========================================
+// QUANTIZED FACE GALLERY
+// ========================================
+void loadFaceGallery()
+{
+    if (!galleryMutex)
+        galleryMutex = xSemaphoreCreateMutex();
+
+    faceGallery.attachIndex(&faceAnnIndex);
+    if (!faceGallery.begin())
+    {
+        Serial.println("[GALLERY] PSRAM allocation failed");
+        return;
+    }
+
+    SPIFFS.begin(true); // No-op when the recognizer already mounted it
+    if (!faceStore.begin(FACE_STORE_PATH))
+    {
+        Serial.println("[GALLERY] Cannot open face journal - falling back to /fr.bin (read-only)");
+        importLegacyGallery();
+    }
+    else if (faceStore.exists())
+    {
+        unsigned long start = millis();
+        faceStore.replay(faceGallery);
+        Serial.printf("[GALLERY] Journal replayed in %lu ms (%u bytes)\n", millis() - start, (unsigned)faceStore.fileBytes());
+
+        // A torn tail must be dropped before anything new is appended
+        if (faceStore.needsCompaction(faceGallery))
+            faceStore.compact(faceGallery);
+        releaseLegacyGallery();
+    }
+    else
+    {
+        // First boot with the journal: migrate /fr.bin into a snapshot
+        importLegacyGallery();
+        if (faceStore.compact(faceGallery))
+            releaseLegacyGallery();
+    }
+
+    // Names/metadata: load the directory and reconcile it with the replayed gallery
+    if (!faceDirectory.load(FACE_DIRECTORY_PATH))
+        Serial.println("[GALLERY] Face directory corrupt - rebuilding names, metadata lost");
+    syncFaceDirectory();
+
+    if (facePartition.open(FACE_PARTITION_LABEL))
+        refreshFacePartition();
+    else
+        Serial.println("[GALLERY] No \"" FACE_PARTITION_LABEL "\" partition - matching from PSRAM only");
+
+    Serial.printf("[GALLERY] Loaded %u embeddings, %u users (%u bytes PSRAM, %s kernel)\n",
+                  (unsigned)faceGallery.recordCount(), (unsigned)faceGallery.userCount(),
+                  (unsigned)faceGallery.memoryUsage(), FACE_EMBEDDING_USE_PIE ? "PIE" : "scalar");
+
+    trainFaceIndexIfNeeded();
+
+    if (!faceStoreTaskHandle)
+        xTaskCreate(faceStoreTask, "faceStore", 4096, nullptr, 1, &faceStoreTaskHandle);
+}
+
+// Mirror gallery users into the name directory and persist it if anything changed.
+// Caller holds galleryMutex (or runs before other tasks start).
+void syncFaceDirectory()
+{
+    if (faceDirectory.syncWithGallery(faceGallery) && !faceDirectory.save(FACE_DIRECTORY_PATH))
+        Serial.println("[GALLERY] WARNING: face directory not saved");
+}
+
+// The journal holds the gallery: drop /fr.bin and the float copies the
+// recognizer loaded from it at begin() (2 KB of RAM per record)
+void releaseLegacyGallery()
+{
+    std::vector<face_info_t> enrolledIds = recognition.recognizer.get_enrolled_ids();
+    for (const face_info_t &info : enrolledIds)
+        recognition.recognizer.delete_id(info.id);
+    if (SPIFFS.exists("/fr.bin") && SPIFFS.remove("/fr.bin"))
+        Serial.printf("[GALLERY] Legacy /fr.bin removed, %u recognizer records released\n", (unsigned)enrolledIds.size());
+}
 
+// Legacy gallery: records written by the recognizer into /fr.bin
+void importLegacyGallery()
+{
     File file = SPIFFS.open("/fr.bin", "rb");
-    if (file)
+    if (!file)
+        return;
+
+    while (file.available())
     {
-        while (file.available())
+        struct
         {
-            struct
-            {
-                int id;
-                char name[17];
-                float embedding[512];
-                uint8_t ctrl[2];
-            } enrolled;
-
-            file.read((uint8_t *)&enrolled, sizeof(enrolled));
-
-            if (enrolled.ctrl[0] != 0x14 || enrolled.ctrl[1] != 0x08)
-                break;
-            if (strlen(enrolled.name) > 0)
-            {
-                uniqueNames.insert(String(enrolled.name));
-            }
+            int id;
+            char name[17];
+            float embedding[512];
+            uint8_t ctrl[2];
+        } enrolled;
+
+        if (file.read((uint8_t *)&enrolled, sizeof(enrolled)) != sizeof(enrolled))
+            break;
+        if (enrolled.ctrl[0] != 0x14 || enrolled.ctrl[1] != 0x08)
+            break;
+        if (strlen(enrolled.name) == 0)
+            continue;
+
+        enrolled.name[sizeof(enrolled.name) - 1] = '\0';
+        faceGallery.addRecord(enrolled.name, enrolled.embedding);
+    }
+    file.close();
+
+    // Migration: galleries enrolled with one record per capture are fused on load
+    if (GALLERY_TEMPLATES_PER_USER > 0)
+    {
+        int fused = faceGallery.fuseAllUsers(GALLERY_TEMPLATES_PER_USER);
+        if (fused > 0)
+            Serial.printf("[GALLERY] Fused %d capture records into per-user templates\n", fused);
+    }
+}
+
+// Rewrite the mapped flash snapshot unless it already holds the live gallery.
+// galleryMutex is held only to copy the gallery into a PSRAM image; the
+// erase + program (up to a second for a full partition) runs without it, so
+// recognition and the API keep matching from PSRAM meanwhile.
+// Caller must not hold galleryMutex.
+void refreshFacePartition()
+{
+    if (!facePartition.isOpen())
+        return;
+
+    size_t size = 0;
+    uint32_t checksum = 0;
+    xSemaphoreTake(galleryMutex, portMAX_DELAY);
+    facePartitionCurrent = false; // Nobody reads the snapshot while it is rewritten
+    uint32_t revision = faceGallery.revision();
+    uint8_t *image = FacePartition::serialize(faceGallery, size, checksum);
+    if (image && facePartition.valid() && facePartition.checksum() == checksum)
+    {
+        facePartitionCurrent = true;
+        psramFree(image);
+        image = nullptr;
+    }
+    xSemaphoreGive(galleryMutex);
+
+    if (!image)
+    {
+        if (!facePartitionCurrent)
+            Serial.println("[GALLERY] Flash snapshot skipped: no PSRAM for the image");
+        return;
+    }
+
+    unsigned long start = millis();
+    bool ok = facePartition.write(image, size);
+    psramFree(image);
+    Serial.printf("[GALLERY] Flash snapshot %s: %u records (%lu ms)\n",
+                  ok ? "written" : "write FAILED", (unsigned)facePartition.recordCount(), millis() - start);
+
+    // A change during the write leaves the snapshot stale; that change
+    // notified faceStoreTask, which comes back for another pass
+    xSemaphoreTake(galleryMutex, portMAX_DELAY);
+    facePartitionCurrent = ok && facePartition.valid() && faceGallery.revision() == revision;
+    xSemaphoreGive(galleryMutex);
+}
+
+// Background gallery upkeep after changes: retrains the IVF index once the
+// gallery doubled, rewrites the journal once tombstones dominate it, and
+// brings the flash snapshot back in sync
+void faceStoreTask(void *param)
+{
+    for (;;)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        trainFaceIndexIfNeeded();
+
+        // Compaction: live records are copied under the lock, the journal
+        // rewrite (fsync included) runs without it so matching never waits
+        xSemaphoreTake(galleryMutex, portMAX_DELAY);
+        uint8_t *image = nullptr;
+        size_t imageSize = 0;
+        size_t before = faceStore.fileBytes();
+        if (faceStore.needsCompaction(faceGallery))
+            image = faceStore.prepareCompaction(faceGallery, imageSize);
+        xSemaphoreGive(galleryMutex);
+
+        if (image)
+        {
+            unsigned long start = millis();
+            bool ok = faceStore.writeCompaction(image, imageSize);
+            psramFree(image);
+
+            xSemaphoreTake(galleryMutex, portMAX_DELAY);
+            ok = ok && faceStore.finishCompaction(); // Carries over what was journaled meanwhile
+            size_t after = faceStore.fileBytes();
+            xSemaphoreGive(galleryMutex);
+            Serial.printf("[GALLERY] Journal compaction %s: %u -> %u bytes (%lu ms)\n",
+                          ok ? "done" : "FAILED", (unsigned)before, (unsigned)after, millis() - start);
         }
-        file.close();
+
+        xSemaphoreTake(galleryMutex, portMAX_DELAY);
+        bool refresh = !facePartitionCurrent;
+        xSemaphoreGive(galleryMutex);
+
+        if (refresh)
+            refreshFacePartition();
     }
+}
 
-    systemStatus.totalUsers = uniqueNames.size();
-    Serial.printf("System status updated - Users: %d\n", systemStatus.totalUsers);
-}
\ No newline at end of file
+// (Re)train the IVF index once the gallery is large enough or has doubled.
+// Runs in faceStoreTask (and at boot) without galleryMutex held: the lock
+// is only taken to sample the gallery and to install the new centroids,
+// k-means runs while matching goes on against the current index.
+void trainFaceIndexIfNeeded()
+{
+    xSemaphoreTake(galleryMutex, portMAX_DELAY);
+    bool sampled = faceAnnIndex.needsTraining(faceGallery.recordCount()) && faceAnnIndex.sampleForTraining(faceGallery);
+    xSemaphoreGive(galleryMutex);
+    if (!sampled)
+        return;
+
+    unsigned long start = millis();
+    bool ok = faceAnnIndex.trainCentroids();
+    unsigned long trainMs = millis() - start;
+
+    xSemaphoreTake(galleryMutex, portMAX_DELAY);
+    start = millis();
+    ok = ok && faceAnnIndex.installTraining(faceGallery);
+    unsigned long installMs = millis() - start;
+    size_t records = faceGallery.recordCount();
+    xSemaphoreGive(galleryMutex);
+
+    if (ok)
+    {
+        Serial.printf("[GALLERY] ANN index trained: %u lists over %u records (k-means %lu ms, %lu ms locked)\n",
+                      (unsigned)faceAnnIndex.lists(), (unsigned)records, trainMs, installMs);
+    }
+}
+
+// Match the embedding of the last recognize() call against the int8 gallery
+// Returns true only when the best candidate reaches RECOGNITION_THRESHOLD and
+// beats the best other user by RECOGNITION_MIN_MARGIN
+bool matchFaceGallery(const float *embedding, String &name, float &similarity)
+{
+    if (faceGallery.recordCount() == 0)
+        return false;
+
+    QuantizedEmbedding probe;
+    quantizeEmbedding(embedding, probe);
+
+    FaceMatchResult result;
+    String candidates[RECOGNITION_TOP_K];
+    xSemaphoreTake(galleryMutex, portMAX_DELAY);
+    bool fromPartition = facePartitionCurrent && !faceAnnIndex.trained();
+    if (fromPartition) // Scan the snapshot in place through the flash cache (IVF search stays on PSRAM)
+        facePartition.matchTopK(probe, RECOGNITION_TOP_K, RECOGNITION_THRESHOLD, RECOGNITION_MIN_MARGIN, result);
+    else
+        faceGallery.matchTopK(probe, RECOGNITION_TOP_K, RECOGNITION_THRESHOLD, RECOGNITION_MIN_MARGIN, result);
+    for (int i = 0; i < result.count; i++)
+        candidates[i] = fromPartition ? facePartition.userName(result.top[i].user) : faceGallery.user(result.top[i].user).name;
+    xSemaphoreGive(galleryMutex);
+
+    if (result.count == 0)
+        return false;
+
+    similarity = result.top[0].similarity;
+    if (similarity < RECOGNITION_THRESHOLD)
+        return false;
+
+    if (result.margin < RECOGNITION_MIN_MARGIN)
+    {
+        // Two enrolled users look alike for this frame - reject instead of guessing
+        Serial.printf("[AMBIGUOUS] %s %.2f vs %s %.2f (margin %.2f < %.2f)\n",
+                      candidates[0].c_str(), similarity,
+                      result.count > 1 ? candidates[1].c_str() : "?", similarity - result.margin,
+                      result.margin, RECOGNITION_MIN_MARGIN);
+        return false;
+    }
+
+    name = candidates[0];
+    return true;
+}
@@ -0,0 +1,161 @@
+/**
+ * Multi-Client MJPEG Fan-Out
+ *
+ * Per client state machine:
+ *   header pending -> frame data pending -> idle (waiting for a newer frame)
+ * A new client starts with the HTTP response header in its header buffer;
+ * each frame then starts with its multipart part header. Partial writes just
+ * leave the offset where the socket stopped, so one slow viewer never holds
+ * up the others (or the task serving them).
+ */
+
+#include "mjpeg_fanout.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <utility>
+
+MjpegFanout::MjpegFanout(const char *boundary)
+    : boundary_(boundary), count_(0), accepted_(0), rejected_(0), framesSent_(0), framesDropped_(0)
+{
+}
+
+MjpegFanout::~MjpegFanout()
+{
+    closeAll();
+}
+
+bool MjpegFanout::add(StreamSink *sink)
+{
+    if (count_ >= MJPEG_MAX_CLIENTS)
+    {
+        rejected_++;
+        sink->close();
+        delete sink;
+        return false;
+    }
+
+    Client &client = clients_[count_++];
+    client.sink = sink;
+    client.frame.reset();
+    client.headerLen = snprintf(client.header, sizeof(client.header),
+                                "HTTP/1.1 200 OK\r\n"
+                                "Content-Type: multipart/x-mixed-replace; boundary=%s\r\n"
+                                "Access-Control-Allow-Origin: *\r\n"
+                                "Cache-Control: no-cache\r\n"
+                                "Connection: close\r\n"
+                                "\r\n",
+                                boundary_);
+    client.offset = 0;
+    client.lastSequence = 0;
+    accepted_++;
+    return true;
+}
+
+void MjpegFanout::pump(const FrameRef &latest)
+{
+    size_t i = 0;
+    while (i < count_)
+    {
+        Client &client = clients_[i];
+        if (!flush(client))
+        {
+            drop(i); // Last slot moved into i
+            continue;
+        }
+
+        // Idle and a newer frame is out: start the next part
+        if (!client.frame && client.headerLen == 0 && latest && latest->sequence != client.lastSequence)
+        {
+            if (client.lastSequence != 0 && latest->sequence > client.lastSequence + 1)
+                framesDropped_ += latest->sequence - client.lastSequence - 1;
+            client.lastSequence = latest->sequence;
+            client.frame = latest;
+            client.headerLen = snprintf(client.header, sizeof(client.header),
+                                        "\r\n--%s\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n",
+                                        boundary_, (unsigned)latest->length);
+            client.offset = 0;
+            if (!flush(client))
+            {
+                drop(i);
+                continue;
+            }
+        }
+        i++;
+    }
+}
+
+bool MjpegFanout::flush(Client &client)
+{
+    // Header first
+    while (client.headerLen > 0 && client.offset < client.headerLen)
+    {
+        int n = client.sink->send(reinterpret_cast<const uint8_t *>(client.header) + client.offset,
+                                  client.headerLen - client.offset);
+        if (n < 0)
+            return false;
+        if (n == 0)
+            return true; // Socket full, try again next pump
+        client.offset += n;
+    }
+    if (client.headerLen > 0)
+    {
+        client.headerLen = 0;
+        client.offset = 0;
+    }
+
+    // Then the frame data
+    if (!client.frame)
+        return true;
+    while (client.offset < client.frame->length)
+    {
+        int n = client.sink->send(client.frame->data + client.offset, client.frame->length - client.offset);
+        if (n < 0)
+            return false;
+        if (n == 0)
+            return true;
+        client.offset += n;
+    }
+
+    framesSent_++;
+    client.frame.reset(); // Buffer back to the pool as soon as the last viewer is done
+    client.offset = 0;
+    return true;
+}
+
+void MjpegFanout::drop(size_t index)
+{
+    Client &client = clients_[index];
+    client.sink->close();
+    delete client.sink;
+    client.frame.reset();
+
+    count_--;
+    if (index != count_)
+    {
+        Client &last = clients_[count_];
+        client.sink = last.sink;
+        client.frame = std::move(last.frame);
+        memcpy(client.header, last.header, last.headerLen);
+        client.headerLen = last.headerLen;
+        client.offset = last.offset;
+        client.lastSequence = last.lastSequence;
+    }
+}
+
+void MjpegFanout::closeAll()
+{
+    while (count_ > 0)
+        drop(count_ - 1);
+}
+
+MjpegStats MjpegFanout::stats() const
+{
+    MjpegStats s;
+    s.clients = count_;
+    s.accepted = accepted_;
+    s.rejected = rejected_;
+    s.framesSent = framesSent_;
+    s.framesDropped = framesDropped_;
+    return s;
+}
@@ -0,0 +1,197 @@
+/**
+ * Adaptive Recognition Scheduler
+ *
+ * Adaptive policy timeline (active = activeIntervalMs, idle = idleIntervalMs):
+ *
+ *   face seen ... last face +lingerMs | 100 ms, 200 ms, 400 ms ... idle
+ *   <---------- active rate --------->|<--- exponential back-off --->
+ *
+ * The first face sighting drops straight back to the active rate, so the
+ * confirmation and liveness frames that follow are taken at full speed.
+ */
+
+#include "recognition_scheduler.h"
+
+#include <string.h>
+
+static const char *const POLICY_NAMES[SCHEDULE_POLICY_COUNT] = {"fixed", "adaptive", "every_frame"};
+
+const char *schedulePolicyName(SchedulePolicy policy)
+{
+    return policy < SCHEDULE_POLICY_COUNT ? POLICY_NAMES[policy] : "unknown";
+}
+
+bool parseSchedulePolicy(const char *name, SchedulePolicy &policy)
+{
+    for (int i = 0; i < SCHEDULE_POLICY_COUNT; i++)
+    {
+        if (strcmp(name, POLICY_NAMES[i]) == 0)
+        {
+            policy = static_cast<SchedulePolicy>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+RecognitionScheduler::RecognitionScheduler(const SchedulerConfig &config)
+{
+    configure(config);
+}
+
+void RecognitionScheduler::configure(const SchedulerConfig &config)
+{
+    config_ = config;
+    interval_ = config.policy == SCHEDULE_EVERY_FRAME ? 0 : config.idleIntervalMs;
+    lastRunMs_ = 0;
+    lastFaceMs_ = 0;
+    hasRun_ = false;
+    seenFace_ = false;
+    stats_.runs = 0;
+    stats_.faceRuns = 0;
+    stats_.skipped = 0;
+}
+
+bool RecognitionScheduler::due(uint32_t nowMs)
+{
+    if (!hasRun_ || nowMs - lastRunMs_ >= interval_)
+        return true;
+    stats_.skipped++;
+    return false;
+}
+
+void RecognitionScheduler::ran(uint32_t nowMs, bool faceFound)
+{
+    stats_.runs++;
+    hasRun_ = true;
+    lastRunMs_ = nowMs;
+    if (faceFound)
+    {
+        stats_.faceRuns++;
+        lastFaceMs_ = nowMs;
+        seenFace_ = true;
+    }
+
+    if (config_.policy != SCHEDULE_ADAPTIVE)
+        return;
+
+    if (faceFound || (seenFace_ && nowMs - lastFaceMs_ < config_.lingerMs))
+    {
+        interval_ = config_.activeIntervalMs;
+    }
+    else if (interval_ < config_.idleIntervalMs)
+    {
+        uint32_t next = interval_ * 2;
+        if (next < SCHEDULER_BACKOFF_START_MS)
+            next = SCHEDULER_BACKOFF_START_MS;
+        interval_ = next < config_.idleIntervalMs ? next : config_.idleIntervalMs;
+    }
+}
+
+// ==================== SIMULATION ====================
+
+struct PhaseResult
+{
+    uint32_t unlockMs;
+    uint64_t busyBefore;
+    uint64_t busyAfter;
+};
+
+static PhaseResult simulatePhase(const SchedulerConfig &config, const SchedulerScenario &scenario, uint32_t arrival)
+{
+    const uint32_t GIVE_UP_MS = 60000; // After arrival: "never unlocks"
+
+    RecognitionScheduler scheduler(config);
+    PhaseResult result = {SCHEDULER_NEVER, 0, 0};
+    uint32_t frameInterval = scenario.frameIntervalMs ? scenario.frameIntervalMs : 1;
+    uint32_t busyUntil = 0;
+    int64_t lastFrame = -1;
+    uint32_t faceRuns = 0;
+
+    for (;;)
+    {
+        // Newest frame once the core is free, or wait for the next one
+        uint32_t now = busyUntil;
+        int64_t frame = now / frameInterval;
+        if (frame <= lastFrame)
+        {
+            frame = lastFrame + 1;
+            now = (uint32_t)(frame * frameInterval);
+        }
+        lastFrame = frame;
+        if (now > arrival + GIVE_UP_MS)
+            break;
+
+        if (!scheduler.due(now))
+        {
+            busyUntil = now;
+            continue;
+        }
+
+        bool face = frame * frameInterval >= arrival;
+        uint32_t cost = scenario.detectMs + (face ? scenario.recognizeMs : 0);
+        if (now < arrival)
+        {
+            uint32_t before = arrival - now < cost ? arrival - now : cost;
+            result.busyBefore += before;
+            result.busyAfter += cost - before;
+        }
+        else
+        {
+            result.busyAfter += cost;
+        }
+        scheduler.ran(now, face);
+        busyUntil = now + cost;
+
+        if (face && ++faceRuns >= scenario.runsToUnlock)
+        {
+            result.unlockMs = busyUntil - arrival;
+            break;
+        }
+    }
+    return result;
+}
+
+SchedulerSimResult simulateScheduler(const SchedulerConfig &config, const SchedulerScenario &scenario)
+{
+    // Spread the arrival over one idle period, the schedule phase is random in practice
+    uint32_t period = config.idleIntervalMs > scenario.frameIntervalMs ? config.idleIntervalMs : scenario.frameIntervalMs;
+
+    SchedulerSimResult sim = {0, 0, 0.0f, 0.0f};
+    uint64_t unlockSum = 0;
+    uint64_t busyBefore = 0, idleTime = 0;
+    uint64_t busyAfter = 0, activeTime = 0;
+    bool never = false;
+
+    for (int p = 0; p < SCHEDULER_SIM_PHASES; p++)
+    {
+        uint32_t arrival = scenario.arrivalMs + p * period / SCHEDULER_SIM_PHASES;
+        PhaseResult phase = simulatePhase(config, scenario, arrival);
+
+        busyBefore += phase.busyBefore;
+        idleTime += arrival;
+        if (phase.unlockMs == SCHEDULER_NEVER)
+        {
+            never = true;
+            continue;
+        }
+        unlockSum += phase.unlockMs;
+        if (phase.unlockMs > sim.worstUnlockMs)
+            sim.worstUnlockMs = phase.unlockMs;
+        busyAfter += phase.busyAfter;
+        activeTime += phase.unlockMs;
+    }
+
+    if (never)
+    {
+        sim.meanUnlockMs = SCHEDULER_NEVER;
+        sim.worstUnlockMs = SCHEDULER_NEVER;
+    }
+    else
+    {
+        sim.meanUnlockMs = (uint32_t)(unlockSum / SCHEDULER_SIM_PHASES);
+    }
+    sim.idleDutyCycle = idleTime ? (float)busyBefore / idleTime : 0.0f;
+    sim.activeDutyCycle = activeTime ? (float)busyAfter / activeTime : 0.0f;
+    return sim;
+}
@@ -0,0 +1,185 @@
+/**
+ * IVF index benchmark: recall@1 and latency at 20 / 200 / 2 000 / 10 000 ids
+ *
+ * Every synthetic identity is enrolled from three noisy captures fused to
+ * one template (GALLERY_TEMPLATES_PER_USER = 1, as on the device); every
+ * TWIN_EVERY-th identity is a near-twin of the one before (cosine ~0.95),
+ * so the margin check has ambiguous probes to reject. Probes are fresh
+ * captures of random enrolled identities. Per gallery size:
+ *   exact      brute-force int8 scan (the reference)
+ *   ivf        FaceGallery::match() through the trained index (probed lists only)
+ *   topk       FaceGallery::matchTopK() as the firmware calls it: probed
+ *              lists, then, once the best candidate reaches the threshold,
+ *              the closer lists whose centroid bound can still hold a
+ *              runner-up within the margin
+ * recall@1 = top-1 user equal to the exact scan's; "correct" = top-1 is the
+ * probe's true identity; "disagree" = topk accepts where exact top-k over
+ * every record rejects (threshold or margin), or the other way round.
+ * Isotropic random identities have no cluster structure, the hard case for
+ * an IVF index; real embeddings cluster.
+ * Latencies are host numbers (scalar kernel), useful as ratios only.
+ */
+
+#include "face_ann.h"
+#include "face_gallery.h"
+#include "test_support.h"
+
+#include <chrono>
+#include <string.h>
+
+#define PROBES 500
+#define CAPTURE_NOISE 0.3f
+#define THRESHOLD 0.92f // RECOGNITION_THRESHOLD in main.cpp
+#define MIN_MARGIN 0.05f
+#define TOP_K 3
+#define TWIN_EVERY 10
+#define TWIN_NOISE 0.33f // Twin identity = identity + this much noise (cosine ~0.95)
+
+static float identity[FACE_EMBEDDING_DIM];
+static float capture[FACE_EMBEDDING_DIM];
+
+static double elapsedUs(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - since).count();
+}
+
+static void identityOf(int u, float *out)
+{
+    if (u % TWIN_EVERY != TWIN_EVERY - 1)
+    {
+        testIdentity(u, out);
+        return;
+    }
+    float base[FACE_EMBEDDING_DIM];
+    testIdentity(u - 1, base);
+    testCapture(base, 20000000 + u, TWIN_NOISE, out);
+}
+
+static bool acceptedMatch(const FaceMatchResult &result)
+{
+    return result.count > 0 && result.top[0].similarity >= THRESHOLD && result.margin >= MIN_MARGIN;
+}
+
+static void run(int ids)
+{
+    FaceAnnIndex index;
+    FaceGallery gallery;
+    gallery.attachIndex(&index);
+    if (!gallery.begin(ids * 3, ids))
+        return;
+
+    char name[FACE_NAME_LEN];
+    for (int u = 0; u < ids; u++)
+    {
+        snprintf(name, sizeof(name), "id%05d", u);
+        identityOf(u, identity);
+        for (int c = 0; c < 3; c++)
+        {
+            testCapture(identity, u * 3 + c, CAPTURE_NOISE, capture);
+            gallery.addRecord(name, capture);
+        }
+    }
+    gallery.fuseAllUsers(1);
+
+    auto trainStart = std::chrono::steady_clock::now();
+    bool trained = index.needsTraining(gallery.recordCount()) && index.train(gallery);
+    double trainMs = elapsedUs(trainStart) / 1000.0;
+
+    // Probes and their true identities
+    static QuantizedEmbedding probes[PROBES];
+    static int truth[PROBES];
+    uint32_t state = 12345;
+    for (int p = 0; p < PROBES; p++)
+    {
+        int u = testRandom(state) % ids;
+        identityOf(u, identity);
+        testCapture(identity, 10000000 + p, CAPTURE_NOISE, capture);
+        quantizeEmbedding(capture, probes[p]);
+        snprintf(name, sizeof(name), "id%05d", u);
+        truth[p] = gallery.findUser(name);
+    }
+
+    // Exact reference
+    static int exact[PROBES];
+    int exactCorrect = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int p = 0; p < PROBES; p++)
+    {
+        float similarity;
+        int record = bestMatchQ8(probes[p], &gallery.embedding(0), gallery.recordCount(), similarity);
+        exact[p] = record < 0 ? -1 : gallery.recordUser(record);
+    }
+    double exactUs = elapsedUs(start) / PROBES;
+    for (int p = 0; p < PROBES; p++)
+        exactCorrect += exact[p] == truth[p];
+
+    // IVF (probed lists only)
+    int ivfRecall = 0, ivfCorrect = 0;
+    start = std::chrono::steady_clock::now();
+    static int ivf[PROBES];
+    for (int p = 0; p < PROBES; p++)
+    {
+        float similarity;
+        ivf[p] = gallery.match(probes[p], similarity);
+    }
+    double ivfUs = elapsedUs(start) / PROBES;
+    for (int p = 0; p < PROBES; p++)
+    {
+        ivfRecall += ivf[p] == exact[p];
+        ivfCorrect += ivf[p] == truth[p];
+    }
+
+    // Exact accept/reject decision: top-k over every record, no pruning
+    static bool exactAccept[PROBES];
+    int exactAccepted = 0;
+    for (int p = 0; p < PROBES; p++)
+    {
+        FaceTopK reference(probes[p], TOP_K, THRESHOLD, MIN_MARGIN);
+        for (size_t r = 0; r < gallery.recordCount(); r++)
+            reference.offer((int)r, gallery.recordUser(r), gallery.embedding(r), nullptr);
+        FaceMatchResult result;
+        reference.finish(result);
+        exactAccept[p] = acceptedMatch(result);
+        exactAccepted += exactAccept[p];
+    }
+
+    // Production path
+    int topkRecall = 0, accepted = 0, wrongAccepts = 0, disagree = 0;
+    static FaceMatchResult results[PROBES];
+    start = std::chrono::steady_clock::now();
+    for (int p = 0; p < PROBES; p++)
+        gallery.matchTopK(probes[p], TOP_K, THRESHOLD, MIN_MARGIN, results[p]);
+    double topkUs = elapsedUs(start) / PROBES;
+    for (int p = 0; p < PROBES; p++)
+    {
+        const FaceMatchResult &r = results[p];
+        int best = r.count > 0 ? r.top[0].user : -1;
+        topkRecall += best == exact[p];
+        bool accept = acceptedMatch(r);
+        disagree += accept != exactAccept[p];
+        if (accept)
+        {
+            accepted++;
+            wrongAccepts += best != truth[p];
+        }
+    }
+
+    printf("%6d ids | %4zu lists (train %7.1f ms) | exact %8.1f us  correct %5.1f%% | "
+           "ivf %7.1f us  recall@1 %5.1f%%  correct %5.1f%% | topk %8.1f us  recall@1 %5.1f%% | "
+           "accepted exact %5.1f%%  topk %5.1f%%  disagree %d  wrong %d\n",
+           ids, trained ? index.lists() : (size_t)0, trainMs,
+           exactUs, 100.0 * exactCorrect / PROBES,
+           ivfUs, 100.0 * ivfRecall / PROBES, 100.0 * ivfCorrect / PROBES,
+           topkUs, 100.0 * topkRecall / PROBES,
+           100.0 * exactAccepted / PROBES, 100.0 * accepted / PROBES, disagree, wrongAccepts);
+}
+
+int main()
+{
+    printf("%d probes per size, capture noise %.2f, %d IVF probes, threshold %.2f (lists 0 = below ANN_MIN_RECORDS, brute force)\n",
+           PROBES, CAPTURE_NOISE, ANN_DEFAULT_PROBES, THRESHOLD);
+    const int sizes[] = {20, 200, 2000, 10000};
+    for (int ids : sizes)
+        run(ids);
+    return 0;
+}
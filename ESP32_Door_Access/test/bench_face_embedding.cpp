@@ -0,0 +1,157 @@
+/**
+ * int8 vs float cosine similarity: score error and time per comparison
+ *
+ * Scores pairs of synthetic 512-d embeddings with cosineSimilarity() (float
+ * reference, norms computed per call) and cosineSimilarityQ8() (int8 data,
+ * per-vector scale, stored norms) and reports, per pair kind:
+ *   mean/max err   |Q8 - float| over all pairs
+ *   flips          pairs on different sides of THRESHOLD in the two paths
+ * Pair kinds: two captures of one identity (the accept case, scores near the
+ * threshold), an identity and its near-twin (cosine ~0.95), and two
+ * different identities (~0).
+ * Then both kernels scan a GALLERY-record gallery for one probe, repeated;
+ * ns per comparison are host numbers (scalar int8 kernel; the float
+ * reductions stay sequential without -ffast-math), so the ratio matters
+ * more than the values. On the S3 the int8 path runs on the PIE unit and
+ * reads 528 instead of 2048 bytes of PSRAM per record.
+ */
+
+#include "face_embedding.h"
+#include "test_support.h"
+
+#include <chrono>
+#include <vector>
+
+#define PAIRS 20000
+#define GALLERY 1024
+#define SCANS 200
+#define CAPTURE_NOISE 0.3f
+#define TWIN_NOISE 0.33f
+#define THRESHOLD 0.92f // RECOGNITION_THRESHOLD in main.cpp
+
+enum PairKind
+{
+    PAIR_SAME,
+    PAIR_TWIN,
+    PAIR_DIFFERENT
+};
+
+struct ErrorStats
+{
+    double sum;
+    float max;
+    float meanScore;
+    uint32_t flips;
+};
+
+static void makePair(PairKind kind, uint32_t i, float *a, float *b)
+{
+    float identity[FACE_EMBEDDING_DIM];
+    testIdentity(i, identity);
+    if (kind == PAIR_SAME)
+    {
+        testCapture(identity, 2 * i, CAPTURE_NOISE, a);
+        testCapture(identity, 2 * i + 1, CAPTURE_NOISE, b);
+    }
+    else if (kind == PAIR_TWIN)
+    {
+        for (int d = 0; d < FACE_EMBEDDING_DIM; d++)
+            a[d] = identity[d];
+        testCapture(identity, 3 * i + 1, TWIN_NOISE, b);
+    }
+    else
+    {
+        testIdentity(i, a);
+        testIdentity(i + PAIRS, b);
+    }
+}
+
+static ErrorStats measureError(PairKind kind)
+{
+    ErrorStats stats = {0.0, 0.0f, 0.0f, 0};
+    float a[FACE_EMBEDDING_DIM], b[FACE_EMBEDDING_DIM];
+    QuantizedEmbedding qa, qb;
+    double scoreSum = 0.0;
+    for (uint32_t i = 0; i < PAIRS; i++)
+    {
+        makePair(kind, i + 1, a, b);
+        quantizeEmbedding(a, qa);
+        quantizeEmbedding(b, qb);
+        float exact = cosineSimilarity(a, b, FACE_EMBEDDING_DIM);
+        float q8 = cosineSimilarityQ8(qa, qb);
+        float err = fabsf(q8 - exact);
+        stats.sum += err;
+        if (err > stats.max)
+            stats.max = err;
+        if ((exact >= THRESHOLD) != (q8 >= THRESHOLD))
+            stats.flips++;
+        scoreSum += exact;
+    }
+    stats.meanScore = (float)(scoreSum / PAIRS);
+    return stats;
+}
+
+static double elapsedNs(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - since).count();
+}
+
+int main()
+{
+    static const char *names[] = {"same", "twin", "different"};
+    printf("%d pairs per kind, threshold %.2f\n\n", PAIRS, THRESHOLD);
+    printf("%-10s %7s %12s %12s %7s\n", "pairs", "score", "mean err", "max err", "flips");
+    for (int k = PAIR_SAME; k <= PAIR_DIFFERENT; k++)
+    {
+        ErrorStats stats = measureError((PairKind)k);
+        printf("%-10s %7.3f %12.2e %12.2e %7u\n", names[k], stats.meanScore, stats.sum / PAIRS, stats.max,
+               (unsigned)stats.flips);
+    }
+
+    std::vector<float> gallery((size_t)GALLERY * FACE_EMBEDDING_DIM);
+    std::vector<QuantizedEmbedding> galleryQ8(GALLERY);
+    for (int i = 0; i < GALLERY; i++)
+    {
+        testIdentity(i + 1, &gallery[(size_t)i * FACE_EMBEDDING_DIM]);
+        quantizeEmbedding(&gallery[(size_t)i * FACE_EMBEDDING_DIM], galleryQ8[i]);
+    }
+    float probe[FACE_EMBEDDING_DIM];
+    QuantizedEmbedding probeQ8;
+    testCapture(&gallery[0], 7, CAPTURE_NOISE, probe);
+    quantizeEmbedding(probe, probeQ8);
+
+    volatile float sink = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < SCANS; s++)
+    {
+        float best = -1.0f;
+        for (int i = 0; i < GALLERY; i++)
+        {
+            float score = cosineSimilarity(probe, &gallery[(size_t)i * FACE_EMBEDDING_DIM], FACE_EMBEDDING_DIM);
+            if (score > best)
+                best = score;
+        }
+        sink = sink + best;
+    }
+    double floatNs = elapsedNs(start) / ((double)SCANS * GALLERY);
+
+    start = std::chrono::steady_clock::now();
+    for (int s = 0; s < SCANS; s++)
+    {
+        float best = -1.0f;
+        for (int i = 0; i < GALLERY; i++)
+        {
+            float score = cosineSimilarityQ8(probeQ8, galleryQ8[i]);
+            if (score > best)
+                best = score;
+        }
+        sink = sink + best;
+    }
+    double q8Ns = elapsedNs(start) / ((double)SCANS * GALLERY);
+
+    printf("\n%d records x %d scans\n", GALLERY, SCANS);
+    printf("%-10s %9s %15s\n", "kernel", "ns/cmp", "bytes/record");
+    printf("%-10s %9.1f %15zu\n", "float", floatNs, FACE_EMBEDDING_DIM * sizeof(float));
+    printf("%-10s %9.1f %15zu\n", "int8", q8Ns, sizeof(QuantizedEmbedding));
+    return 0;
+}
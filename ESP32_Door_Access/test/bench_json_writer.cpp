@@ -0,0 +1,111 @@
+/**
+ * JsonWriter vs String concatenation
+ *
+ * Serializes the same /api/status-shaped reply (a few dozen fields, one
+ * user name that needs escaping) both ways and reports time and heap
+ * allocations per reply. std::string stands in for Arduino's String: same
+ * "status += \"...\" + String(x) + \",\"" pattern, one heap temporary per
+ * String(x) and per concatenation, growth by reallocation. Exact counts
+ * depend on each library's growth policy; the order of magnitude is the
+ * point. Allocations are counted by replacing global operator new.
+ */
+
+#include "json_writer.h"
+
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#define REPLIES 200000
+#define COUNTER_FIELDS 36
+
+static size_t allocations = 0;
+
+void *operator new(size_t n)
+{
+    allocations++;
+    void *p = malloc(n ? n : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static std::string String(unsigned long v) { return std::to_string(v); }
+static std::string String(const char *s) { return s; }
+static std::string String(float v)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%.2f", v);
+    return text;
+}
+
+// The pattern the handlers used before: unescaped name, temporaries everywhere
+static size_t stringReply(std::string &out, const char *user)
+{
+    std::string status = "{";
+    status += "\"camera_ready\":" + String("true") + ",";
+    status += "\"recognition_ready\":" + String("true") + ",";
+    status += "\"total_users\":" + String(12ul) + ",";
+    status += "\"last_user\":\"" + String(user) + "\",";
+    status += "\"last_confidence\":" + String(0.87f) + ",";
+    for (int i = 0; i < COUNTER_FIELDS; i++)
+        status += "\"counter_field_name\":" + String((unsigned long)(123456u + i)) + ",";
+    status += "\"free_psram\":" + String(4000000ul);
+    status += "}";
+    out.swap(status);
+    return out.size();
+}
+
+static size_t writerReply(char *buffer, size_t capacity, const char *user)
+{
+    JsonWriter json(buffer, capacity);
+    json.beginObject()
+        .field("camera_ready", true)
+        .field("recognition_ready", true)
+        .field("total_users", 12)
+        .field("last_user", user)
+        .field("last_confidence", 0.87f);
+    for (int i = 0; i < COUNTER_FIELDS; i++)
+        json.field("counter_field_name", 123456u + i);
+    json.field("free_psram", 4000000ul).endObject();
+    return json.ok() ? json.length() : 0;
+}
+
+int main()
+{
+    const char *user = "Budi \"Santoso\"";
+    char buffer[2048];
+    std::string reply;
+    size_t sink = 0;
+
+    printf("Reply: %zu bytes (String), %zu bytes (JsonWriter, name escaped)\n",
+           stringReply(reply, user), writerReply(buffer, sizeof(buffer), user));
+
+    size_t before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < REPLIES; i++)
+        sink += stringReply(reply, user);
+    auto middle = std::chrono::steady_clock::now();
+    size_t stringAllocations = allocations - before;
+
+    before = allocations;
+    for (int i = 0; i < REPLIES; i++)
+        sink += writerReply(buffer, sizeof(buffer), user);
+    auto end = std::chrono::steady_clock::now();
+    size_t writerAllocations = allocations - before;
+
+    printf("%-12s %10s %14s\n", "method", "us/reply", "allocs/reply");
+    printf("%-12s %10.2f %14.1f\n", "String",
+           std::chrono::duration<double, std::micro>(middle - start).count() / REPLIES,
+           (double)stringAllocations / REPLIES);
+    printf("%-12s %10.2f %14.1f\n", "JsonWriter",
+           std::chrono::duration<double, std::micro>(end - middle).count() / REPLIES,
+           (double)writerAllocations / REPLIES);
+    printf("(checksum %zu)\n", sink);
+    return 0;
+}
@@ -0,0 +1,217 @@
+/**
+ * Motion gate replay: skip rate and missed-arrival rate on synthetic sequences
+ *
+ * Sequences are 30x30 gray thumbnails (240x240 frame, MOTION_THUMB_DIVISOR
+ * 8) at 25 fps, rendered with a labelled ground truth and replayed through
+ * replayMotionGate():
+ *   empty          corridor with sensor noise only
+ *   drift          empty corridor, daylight ramping by 60 gray levels
+ *   exposure       empty corridor, auto-exposure steps of 8% every 20 s
+ *   walk-in        people crossing in from the side, stopping at the door
+ *   approach       people walking straight at the camera (blob grows slowly)
+ *   approach-low   the same with clothing close to the background (30 levels)
+ *   mixed          walk-ins and approaches on top of the daylight drift
+ * An arrival is missed when the gate does not fire within
+ * MOTION_ARRIVAL_WINDOW frames of the person first being in view; "delay"
+ * is the mean number of frames until the gate fires at all while the
+ * person is still in view (arrivals it never fires for are left out).
+ */
+
+#include "motion_gate.h"
+#include "test_support.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#define THUMB_SIZE 30
+#define THUMB_PIXELS (THUMB_SIZE * THUMB_SIZE)
+#define SEQUENCE_FRAMES 6000 // 4 minutes at 25 fps
+#define NOISE_SIGMA 3.0f     // Sensor noise in gray levels at thumbnail scale
+#define ARRIVAL_SPACING 600  // Frames between arrivals (24 s)
+#define DWELL_FRAMES 75      // Time spent at the door before leaving
+
+enum ArrivalKind
+{
+    ARRIVAL_NONE,
+    ARRIVAL_WALK_IN,
+    ARRIVAL_APPROACH,
+    ARRIVAL_MIXED
+};
+
+struct SceneSpec
+{
+    const char *name;
+    ArrivalKind arrivals;
+    float contrast;      // Person luma minus background
+    float driftLevels;   // Daylight ramp over the sequence
+    float exposureStep;  // Relative brightness step every 500 frames
+};
+
+struct Person
+{
+    float cx, cy, rx, ry;
+    bool visible;
+};
+
+static float background(int x, int y)
+{
+    // Corridor: floor-to-ceiling gradient plus a door frame
+    float value = 80.0f + 3.0f * y;
+    if (x == 8 || x == 21)
+        value -= 30.0f;
+    return value;
+}
+
+// Person position `t` frames after the arrival started
+static Person personAt(ArrivalKind kind, int t)
+{
+    Person person = {0, 0, 0, 0, false};
+    int enterFrames = kind == ARRIVAL_WALK_IN ? 20 : 50;
+    int total = enterFrames + DWELL_FRAMES + enterFrames;
+    if (t < 0 || t >= total)
+        return person;
+
+    // Progress toward the door: 0 -> 1 while entering, 1 while dwelling, back to 0 leaving
+    float progress = 1.0f;
+    if (t < enterFrames)
+        progress = (float)t / enterFrames;
+    else if (t >= enterFrames + DWELL_FRAMES)
+        progress = 1.0f - (float)(t - enterFrames - DWELL_FRAMES) / enterFrames;
+
+    if (kind == ARRIVAL_WALK_IN)
+    {
+        // Enters from the left edge at ~1 thumbnail pixel per frame
+        person.rx = 5.0f;
+        person.ry = 11.0f;
+        person.cx = -person.rx + progress * (15.0f + person.rx);
+        person.cy = 16.0f;
+    }
+    else
+    {
+        // Starts as a distant figure in the middle of the corridor and grows
+        person.rx = 1.0f + progress * 5.0f;
+        person.ry = 2.0f + progress * 11.0f;
+        person.cx = 15.0f;
+        person.cy = 12.0f + progress * 4.0f;
+    }
+    person.visible = person.cx + person.rx > 0.0f;
+    return person;
+}
+
+static bool insidePerson(const Person &person, int x, int y)
+{
+    if (!person.visible)
+        return false;
+    float dx = (x + 0.5f - person.cx) / person.rx;
+    float dy = (y + 0.5f - person.cy) / person.ry;
+    return dx * dx + dy * dy <= 1.0f;
+}
+
+static void render(const SceneSpec &scene, std::vector<uint8_t> &frames, bool *occupied)
+{
+    uint32_t rng = 0x5eed1234u;
+    frames.resize((size_t)SEQUENCE_FRAMES * THUMB_PIXELS);
+
+    for (int i = 0; i < SEQUENCE_FRAMES; i++)
+    {
+        float light = scene.driftLevels * i / SEQUENCE_FRAMES;
+        float exposure = 1.0f + scene.exposureStep * (i / 500 % 2);
+
+        Person person = {0, 0, 0, 0, false};
+        if (scene.arrivals != ARRIVAL_NONE)
+        {
+            int index = i / ARRIVAL_SPACING;
+            ArrivalKind kind = scene.arrivals;
+            if (kind == ARRIVAL_MIXED)
+                kind = index % 2 ? ARRIVAL_APPROACH : ARRIVAL_WALK_IN;
+            // First arrival after 4 s, so the gate has a reference of the empty scene
+            person = personAt(kind, i % ARRIVAL_SPACING - 100);
+        }
+
+        bool inView = false;
+        uint8_t *frame = &frames[(size_t)i * THUMB_PIXELS];
+        for (int y = 0; y < THUMB_SIZE; y++)
+        {
+            for (int x = 0; x < THUMB_SIZE; x++)
+            {
+                float value = background(x, y);
+                if (insidePerson(person, x, y))
+                {
+                    value += scene.contrast;
+                    inView = true;
+                }
+                value = (value + light) * exposure + testGaussian(rng) * NOISE_SIGMA;
+                frame[y * THUMB_SIZE + x] = (uint8_t)(value < 0.0f ? 0.0f : value > 255.0f ? 255.0f : lroundf(value));
+            }
+        }
+        occupied[i] = inView;
+    }
+}
+
+// Mean frames from an arrival to the first motion frame while occupied,
+// negative when the gate never fired for any arrival
+static float meanFireDelay(const MotionGateConfig &config, const std::vector<uint8_t> &frames, const bool *occupied)
+{
+    MotionGate gate(config);
+    int since = -1;
+    uint32_t fired = 0, total = 0;
+    for (int i = 0; i < SEQUENCE_FRAMES; i++)
+    {
+        bool motion = gate.update(&frames[(size_t)i * THUMB_PIXELS], THUMB_SIZE, THUMB_SIZE);
+        if (occupied[i] && (i == 0 || !occupied[i - 1]))
+            since = 0;
+        else if (!occupied[i])
+            since = -1;
+        else if (since >= 0)
+            since++;
+
+        if (since >= 0 && motion)
+        {
+            total += since;
+            fired++;
+            since = -1;
+        }
+    }
+    return fired ? (float)total / fired : -1.0f;
+}
+
+int main()
+{
+    static const SceneSpec scenes[] = {
+        {"empty", ARRIVAL_NONE, 0.0f, 0.0f, 0.0f},
+        {"drift", ARRIVAL_NONE, 0.0f, 60.0f, 0.0f},
+        {"exposure", ARRIVAL_NONE, 0.0f, 0.0f, 0.08f},
+        {"walk-in", ARRIVAL_WALK_IN, -50.0f, 0.0f, 0.0f},
+        {"approach", ARRIVAL_APPROACH, -50.0f, 0.0f, 0.0f},
+        {"approach-low", ARRIVAL_APPROACH, -30.0f, 0.0f, 0.0f},
+        {"mixed", ARRIVAL_MIXED, -50.0f, 60.0f, 0.0f},
+    };
+    static const uint8_t pixelDeltas[] = {16, MOTION_PIXEL_DELTA, 32};
+
+    printf("%d frames of %dx%d per sequence, noise sigma %.1f, changed fraction %.2f\n\n",
+           SEQUENCE_FRAMES, THUMB_SIZE, THUMB_SIZE, NOISE_SIGMA, MOTION_CHANGED_FRACTION);
+    printf("%-13s %5s %9s %8s %7s %12s %6s\n", "sequence", "delta", "skip rate", "arrivals", "missed", "missed rate", "delay");
+
+    std::vector<uint8_t> frames;
+    static bool occupied[SEQUENCE_FRAMES];
+    for (const SceneSpec &scene : scenes)
+    {
+        render(scene, frames, occupied);
+
+        for (uint8_t delta : pixelDeltas)
+        {
+            MotionGateConfig config = {delta, MOTION_CHANGED_FRACTION};
+            MotionReplayResult result;
+            replayMotionGate(config, frames.data(), occupied, SEQUENCE_FRAMES, THUMB_SIZE, THUMB_SIZE, result);
+            printf("%-13s %5u %8.1f%% %8u %7u %11.1f%%", scene.name, delta, result.skipRate * 100.0f,
+                   (unsigned)result.arrivals, (unsigned)result.missedArrivals, result.missedArrivalRate * 100.0f);
+            float delay = result.arrivals ? meanFireDelay(config, frames, occupied) : -1.0f;
+            if (delay < 0.0f)
+                printf(" %6s\n", "-");
+            else
+                printf(" %6.1f\n", delay);
+        }
+    }
+    return 0;
+}
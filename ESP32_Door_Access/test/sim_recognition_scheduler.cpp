@@ -0,0 +1,69 @@
+/**
+ * Recognition scheduler simulation: time-to-unlock and duty cycle per policy
+ *
+ * Replays a person walking up to the door through simulateScheduler() for
+ * every policy, the way /api/scheduler does on the device, with the
+ * firmware defaults (RECOGNITION_IDLE_INTERVAL / RECOGNITION_LINGER_MS,
+ * 25 fps camera, max(RECOGNITION_CONFIRM_COUNT, LIVENESS_CHECK_COUNT) runs
+ * to unlock) and a sweep over the idle interval and the detector cost.
+ *   unlock     arrival -> door opens, mean and worst over the arrival phases
+ *   idle duty  inference core busy fraction with an empty scene
+ *   active     busy fraction between arrival and unlock
+ */
+
+#include "recognition_scheduler.h"
+#include "test_support.h"
+
+#define FRAME_INTERVAL_MS 40 // CameraFrameSource default
+#define RECOGNIZE_MS 180
+#define RUNS_TO_UNLOCK 4     // max(RECOGNITION_CONFIRM_COUNT, LIVENESS_CHECK_COUNT)
+#define ARRIVAL_MS 10000
+#define ACTIVE_INTERVAL_MS 0 // RECOGNITION_ACTIVE_INTERVAL
+#define LINGER_MS 2000       // RECOGNITION_LINGER_MS
+
+static void printMs(uint32_t ms)
+{
+    if (ms == SCHEDULER_NEVER)
+        printf(" %8s", "never");
+    else
+        printf(" %8u", (unsigned)ms);
+}
+
+static void run(uint32_t idleIntervalMs, uint32_t detectMs)
+{
+    SchedulerScenario scenario;
+    scenario.frameIntervalMs = FRAME_INTERVAL_MS;
+    scenario.detectMs = detectMs;
+    scenario.recognizeMs = RECOGNIZE_MS;
+    scenario.runsToUnlock = RUNS_TO_UNLOCK;
+    scenario.arrivalMs = ARRIVAL_MS;
+
+    for (int p = 0; p < SCHEDULE_POLICY_COUNT; p++)
+    {
+        SchedulerConfig config;
+        config.policy = static_cast<SchedulePolicy>(p);
+        config.activeIntervalMs = ACTIVE_INTERVAL_MS;
+        config.idleIntervalMs = idleIntervalMs;
+        config.lingerMs = LINGER_MS;
+
+        SchedulerSimResult sim = simulateScheduler(config, scenario);
+        printf("%7u %9u  %-12s", (unsigned)idleIntervalMs, (unsigned)detectMs, schedulePolicyName(config.policy));
+        printMs(sim.meanUnlockMs);
+        printMs(sim.worstUnlockMs);
+        printf(" %9.1f%% %7.1f%%\n", sim.idleDutyCycle * 100.0f, sim.activeDutyCycle * 100.0f);
+    }
+}
+
+int main()
+{
+    printf("frame %u ms, recognize %u ms, %u runs to unlock, linger %u ms\n\n",
+           FRAME_INTERVAL_MS, RECOGNIZE_MS, RUNS_TO_UNLOCK, LINGER_MS);
+    printf("%7s %9s  %-12s %8s %8s %10s %8s\n", "idle ms", "detect ms", "policy", "mean ms", "worst ms", "idle duty", "active");
+
+    static const uint32_t idleIntervals[] = {500, 1000, 2000};
+    static const uint32_t detectCosts[] = {60, 120};
+    for (uint32_t detectMs : detectCosts)
+        for (uint32_t idleMs : idleIntervals)
+            run(idleMs, detectMs);
+    return 0;
+}
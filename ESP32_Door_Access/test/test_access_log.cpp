@@ -0,0 +1,214 @@
+/**
+ * AccessLog unit test
+ *
+ * Ring wrap (oldest events overwritten, retained ones intact), header
+ * roll-forward after a simulated power cut (the file is copied while the
+ * log is open, so the header lags the records), a torn header copy,
+ * per-record CRC, clear() and readRange().
+ */
+
+#include "access_log.h"
+#include "test_support.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#define LOG_PATH "test_access_log.bin"
+#define CRASH_PATH "test_access_log_crash.bin"
+#define CAPACITY 100
+#define HEADERS_BYTES 64 // Two 32-byte header copies
+#define SLOT_SIZE 64
+
+static void appendEvents(AccessLog &log, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        AccessLogRecord record = {};
+        record.timestamp = log.nextSequence() * 10;
+        record.confidence = 0.5f;
+        record.success = record.timestamp % 20 == 0;
+        record.action = record.success ? ACCESS_ACTION_GRANTED : ACCESS_ACTION_DENIED_NOT_ENROLLED;
+        snprintf(record.user, sizeof(record.user), "user%u", (unsigned)log.nextSequence());
+        CHECK(log.append(record));
+    }
+}
+
+// Every retained event decodes to what appendEvents() wrote for its sequence
+static int badRecords(AccessLog &log)
+{
+    int bad = 0;
+    char expected[ACCESS_LOG_USER_LEN];
+    for (uint32_t s = log.firstSequence(); s != log.nextSequence(); s++)
+    {
+        AccessLogRecord record;
+        snprintf(expected, sizeof(expected), "user%u", (unsigned)s);
+        if (!log.read(s, record) || record.sequence != s || record.timestamp != s * 10 || strcmp(record.user, expected) != 0)
+            bad++;
+    }
+    return bad;
+}
+
+static void copyFile(const char *from, const char *to)
+{
+    FILE *in = fopen(from, "rb");
+    FILE *out = fopen(to, "wb");
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+        fwrite(buffer, 1, n, out);
+    fclose(in);
+    fclose(out);
+}
+
+static void patchByte(const char *path, long offset, uint8_t value)
+{
+    FILE *f = fopen(path, "r+b");
+    fseek(f, offset, SEEK_SET);
+    fputc(value, f);
+    fclose(f);
+}
+
+static void testWrap()
+{
+    unlink(LOG_PATH);
+    AccessLog log(CAPACITY);
+    CHECK(log.begin(LOG_PATH));
+    appendEvents(log, 250);
+    CHECK_EQ(log.nextSequence(), 251);
+    CHECK_EQ(log.firstSequence(), 151);
+    CHECK_EQ(log.count(), CAPACITY);
+    CHECK_EQ(badRecords(log), 0);
+
+    AccessLogRecord record;
+    CHECK(!log.read(150, record)); // Overwritten by 250
+    CHECK(!log.read(251, record)); // Not written yet
+
+    // readRange: one run of slots, unwritten ones come back with sequence 0
+    AccessLogRecord range[10];
+    CHECK_EQ(log.readRange(241, 10, range), 10);
+    CHECK_EQ(range[0].sequence, 241);
+    CHECK_EQ(range[9].sequence, 250);
+
+    // A reopened ring keeps its own capacity and every retained event
+    log.end();
+    AccessLog reopened(5000);
+    CHECK(reopened.begin(LOG_PATH));
+    CHECK_EQ(reopened.capacity(), CAPACITY);
+    CHECK_EQ(reopened.nextSequence(), 251);
+    CHECK_EQ(badRecords(reopened), 0);
+}
+
+static void testRollForward()
+{
+    unlink(LOG_PATH);
+    AccessLog log(CAPACITY);
+    CHECK(log.begin(LOG_PATH));
+
+    // 130 events: the header was last written at 128 (every
+    // ACCESS_LOG_HEADER_INTERVAL appends) and says next = 129
+    appendEvents(log, 130);
+    copyFile(LOG_PATH, CRASH_PATH); // Power cut: no end(), no header update
+    {
+        AccessLog recovered(CAPACITY);
+        CHECK(recovered.begin(CRASH_PATH));
+        // Rolled forward over 129 and 130; the slot of 131 still holds 31 from the previous lap
+        CHECK_EQ(recovered.nextSequence(), 131);
+        CHECK_EQ(recovered.firstSequence(), 31);
+        CHECK_EQ(badRecords(recovered), 0);
+        recovered.end();
+    }
+
+    // Torn header write: copy 0 (the newest, next = 129) fails its CRC, so
+    // copy 1 (next = 65) is used and the roll-forward covers 65..130
+    copyFile(LOG_PATH, CRASH_PATH);
+    patchByte(CRASH_PATH, 17, 0x5A);
+    {
+        AccessLog recovered(CAPACITY);
+        CHECK(recovered.begin(CRASH_PATH));
+        CHECK_EQ(recovered.nextSequence(), 131);
+        CHECK_EQ(badRecords(recovered), 0);
+    }
+
+    // After the ring wrapped again: the header says 193, events 193..250 are rolled forward
+    appendEvents(log, 120); // next = 251
+    copyFile(LOG_PATH, CRASH_PATH);
+    {
+        AccessLog recovered(CAPACITY);
+        CHECK(recovered.begin(CRASH_PATH));
+        CHECK_EQ(recovered.nextSequence(), 251);
+        CHECK_EQ(badRecords(recovered), 0);
+
+        // Appending after recovery continues the sequence
+        appendEvents(recovered, 5);
+        CHECK_EQ(recovered.nextSequence(), 256);
+        CHECK_EQ(badRecords(recovered), 0);
+    }
+
+    // Both header copies unreadable: a new, empty ring
+    copyFile(LOG_PATH, CRASH_PATH);
+    patchByte(CRASH_PATH, 0, 0x00);
+    patchByte(CRASH_PATH, 32, 0x00);
+    {
+        AccessLog unreadable(CAPACITY);
+        CHECK(unreadable.begin(CRASH_PATH));
+        CHECK_EQ(unreadable.nextSequence(), 1);
+        CHECK_EQ(unreadable.count(), 0);
+    }
+    log.end();
+    unlink(CRASH_PATH);
+}
+
+static void testRecordCrc()
+{
+    unlink(LOG_PATH);
+    {
+        AccessLog log(CAPACITY);
+        CHECK(log.begin(LOG_PATH));
+        appendEvents(log, 20);
+    }
+    // Damage the user name of event 7 (slot 6)
+    patchByte(LOG_PATH, HEADERS_BYTES + 6 * SLOT_SIZE + 20, '#');
+
+    AccessLog log(CAPACITY);
+    CHECK(log.begin(LOG_PATH));
+    AccessLogRecord record;
+    CHECK(!log.read(7, record));
+    CHECK_EQ(log.corruptRecords(), 1);
+    CHECK(log.read(6, record));
+    CHECK(log.read(8, record));
+    CHECK_EQ(log.nextSequence(), 21);
+}
+
+static void testClear()
+{
+    unlink(LOG_PATH);
+    {
+        AccessLog log(CAPACITY);
+        CHECK(log.begin(LOG_PATH));
+        appendEvents(log, 40);
+        CHECK(log.clear());
+        CHECK_EQ(log.count(), 0);
+        CHECK_EQ(log.nextSequence(), 41); // Sequences keep counting up
+        AccessLogRecord record;
+        CHECK(!log.read(40, record));
+        appendEvents(log, 3);
+    }
+
+    // The clear survives a reopen
+    AccessLog log(CAPACITY);
+    CHECK(log.begin(LOG_PATH));
+    CHECK_EQ(log.firstSequence(), 41);
+    CHECK_EQ(log.count(), 3);
+    CHECK_EQ(badRecords(log), 0);
+    log.end();
+    unlink(LOG_PATH);
+}
+
+int main()
+{
+    testWrap();
+    testRollForward();
+    testRecordCrc();
+    testClear();
+    return testResult("test_access_log");
+}
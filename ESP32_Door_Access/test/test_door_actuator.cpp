@@ -0,0 +1,199 @@
+/**
+ * DoorActuator unit test
+ *
+ * Runs the state machine on VirtualClock and records every output change
+ * with the virtual time it happened at: relock at the exact millisecond of
+ * the deadline (also across a repeat unlock, a late timer and the 32-bit
+ * rollover), the LED blink edges, and the enrollment pause.
+ */
+
+#include "door_actuator.h"
+#include "test_support.h"
+
+#define MAX_CHANGES 64
+
+struct Change
+{
+    char what; // 'R' relay, 'L' LED, 'E' event
+    int value;
+    uint32_t atMs;
+};
+
+struct Recorder
+{
+    VirtualClock *clock;
+    Change changes[MAX_CHANGES];
+    int count;
+
+    void add(char what, int value)
+    {
+        if (count < MAX_CHANGES)
+            changes[count++] = {what, value, clock->nowMs()};
+    }
+
+    // Time of the n-th (0-based) change of a kind with that value, or ACTUATOR_NO_DEADLINE
+    uint32_t at(char what, int value, int n = 0) const
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (changes[i].what == what && changes[i].value == value && n-- == 0)
+                return changes[i].atMs;
+        }
+        return ACTUATOR_NO_DEADLINE;
+    }
+
+    int last(char what) const
+    {
+        for (int i = count - 1; i >= 0; i--)
+        {
+            if (changes[i].what == what)
+                return changes[i].value;
+        }
+        return -1;
+    }
+
+    int countOf(char what) const
+    {
+        int n = 0;
+        for (int i = 0; i < count; i++)
+            n += changes[i].what == what;
+        return n;
+    }
+};
+
+static void onRelay(bool on, void *context) { ((Recorder *)context)->add('R', on); }
+static void onLed(bool on, void *context) { ((Recorder *)context)->add('L', on); }
+static void onEvent(ActuatorEvent event, void *context) { ((Recorder *)context)->add('E', event); }
+
+static void testExactRelock(uint32_t startMs)
+{
+    VirtualClock clock(startMs);
+    Recorder rec = {&clock, {}, 0};
+    DoorActuator door(clock, {onRelay, onLed, onEvent, &rec});
+    CHECK(door.begin(false));
+    rec.count = 0;
+
+    clock.advance(1000);
+    uint32_t unlockAt = clock.nowMs();
+    door.unlock(5000);
+    CHECK(door.doorUnlocked());
+    CHECK_EQ(rec.at('R', 1), unlockAt);
+
+    // One millisecond before the deadline: still open
+    clock.advanceTo(unlockAt + 4999);
+    CHECK(door.doorUnlocked());
+    CHECK_EQ(door.relockInMs(), 1);
+
+    // At the deadline: relocked, with the event, exactly then
+    clock.advance(1);
+    CHECK(!door.doorUnlocked());
+    CHECK_EQ(rec.at('R', 0), unlockAt + 5000);
+    CHECK_EQ(rec.at('E', ACTUATOR_DOOR_LOCKED), unlockAt + 5000);
+    CHECK_EQ(rec.countOf('E'), 1);
+    CHECK_EQ(door.relockInMs(), 0);
+    CHECK_EQ(door.unlockedAtMs(), unlockAt ? unlockAt : 1);
+
+    // Unlock blinks: 3 on/off pairs, ACTUATOR_BLINK_MS apart, starting at the unlock
+    CHECK_EQ(rec.countOf('L'), ACTUATOR_UNLOCK_BLINKS * 2);
+    for (int i = 0; i < ACTUATOR_UNLOCK_BLINKS; i++)
+    {
+        CHECK_EQ(rec.at('L', 1, i), unlockAt + 2 * i * ACTUATOR_BLINK_MS);
+        CHECK_EQ(rec.at('L', 0, i), unlockAt + (2 * i + 1) * ACTUATOR_BLINK_MS);
+    }
+    CHECK(!clock.pending());
+}
+
+static void testRepeatUnlockExtends()
+{
+    VirtualClock clock(100);
+    Recorder rec = {&clock, {}, 0};
+    DoorActuator door(clock, {onRelay, onLed, onEvent, &rec});
+    CHECK(door.begin(false));
+    rec.count = 0;
+
+    door.unlock(5000);  // Deadline 5100
+    clock.advance(2000);
+    door.unlock(5000);  // Extended to 7100, relay not toggled again
+    clock.advanceTo(5100);
+    CHECK(door.doorUnlocked());
+    CHECK_EQ(rec.countOf('R'), 1);
+    clock.advanceTo(7099);
+    CHECK(door.doorUnlocked());
+    clock.advanceTo(7100);
+    CHECK(!door.doorUnlocked());
+    CHECK_EQ(rec.at('R', 0), 7100);
+    CHECK_EQ(rec.countOf('E'), 1);
+}
+
+static void testLateTimer()
+{
+    // The timer task was busy: one big step still applies each transition at its own deadline
+    VirtualClock clock(0);
+    Recorder rec = {&clock, {}, 0};
+    DoorActuator door(clock, {onRelay, onLed, onEvent, &rec});
+    CHECK(door.begin(true));
+    rec.count = 0;
+
+    door.unlock(3000);
+    door.holdEnrollment(2000);
+    clock.advanceTo(60000);
+    CHECK_EQ(rec.at('E', ACTUATOR_ENROLLMENT_READY), 2000);
+    CHECK_EQ(rec.at('R', 0), 3000);
+    CHECK(!door.enrollmentHeld());
+    CHECK(!door.doorUnlocked());
+    CHECK_EQ(rec.last('L'), 1); // Back to the idle level
+}
+
+static void testEnrollmentPause()
+{
+    VirtualClock clock(500);
+    Recorder rec = {&clock, {}, 0};
+    DoorActuator door(clock, {onRelay, onLed, onEvent, &rec});
+    CHECK(door.begin(false));
+    rec.count = 0;
+
+    door.holdEnrollment(2000);
+    CHECK(door.enrollmentHeld());
+    clock.advanceTo(2499);
+    CHECK(door.enrollmentHeld());
+    clock.advanceTo(2500);
+    CHECK(!door.enrollmentHeld());
+    CHECK_EQ(rec.at('E', ACTUATOR_ENROLLMENT_READY), 2500);
+    CHECK_EQ(rec.at('L', 1), 2500); // Cue blink starts with the release
+
+    // Released early: no event later
+    door.holdEnrollment(2000);
+    door.releaseEnrollment();
+    CHECK(!door.enrollmentHeld());
+    clock.advance(10000);
+    CHECK_EQ(rec.countOf('E'), 1);
+}
+
+static void testManualLock()
+{
+    VirtualClock clock(0);
+    Recorder rec = {&clock, {}, 0};
+    DoorActuator door(clock, {onRelay, onLed, onEvent, &rec});
+    CHECK(door.begin(false));
+    rec.count = 0;
+
+    door.unlock(5000);
+    clock.advance(1234);
+    door.lock();
+    CHECK(!door.doorUnlocked());
+    CHECK_EQ(rec.at('R', 0), 1234);
+    clock.advance(10000);
+    CHECK_EQ(rec.countOf('E'), 0); // lock() is silent
+    CHECK_EQ(rec.countOf('R'), 2);
+}
+
+int main()
+{
+    testExactRelock(0);
+    testExactRelock(0xFFFFFFFFu - 3000); // Deadline lands after the 32-bit rollover
+    testRepeatUnlockExtends();
+    testLateTimer();
+    testEnrollmentPause();
+    testManualLock();
+    return testResult("test_door_actuator");
+}
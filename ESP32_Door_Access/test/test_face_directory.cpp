@@ -0,0 +1,144 @@
+/**
+ * FaceDirectory unit test
+ *
+ * Writer/reader round trip (metadata, template counts past 255), CRC and
+ * truncation rejection, and syncWithGallery() over a gallery of several
+ * thousand users.
+ */
+
+#include "face_directory.h"
+#include "test_support.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#define DIRECTORY_PATH "test_face_directory.dir"
+#define SYNC_USERS 3000
+
+static float embedding[FACE_EMBEDDING_DIM];
+
+static long fileSize(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+static void testRoundTrip()
+{
+    FaceGallery gallery;
+    CHECK(gallery.begin());
+    for (int i = 0; i < 300; i++)
+        gallery.addRecord("bob", embedding); // Wrapped to 44 with the 8-bit count
+    gallery.addRecord("alice", embedding);
+
+    FaceDirectory directory;
+    CHECK(directory.syncWithGallery(gallery));
+    CHECK(!directory.syncWithGallery(gallery)); // Nothing changed the second time
+    CHECK(directory.setMetadata("alice", "Guru", "Matematika \"A\"", "2027-06-30"));
+    CHECK(directory.setMetadata("carol", "Staf", nullptr, nullptr)); // Metadata before enrollment
+    CHECK(directory.save(DIRECTORY_PATH));
+
+    FaceDirectory loaded;
+    CHECK(loaded.load(DIRECTORY_PATH));
+    CHECK_EQ(loaded.count(), 3);
+    int bob = loaded.find("bob");
+    int alice = loaded.find("alice");
+    int carol = loaded.find("carol");
+    CHECK(bob >= 0 && alice >= 0 && carol >= 0);
+    if (bob < 0 || alice < 0 || carol < 0)
+        return;
+    CHECK_EQ(loaded.entry(bob).templates, 300);
+    CHECK_EQ(loaded.entry(alice).templates, 1);
+    CHECK_EQ(loaded.entry(carol).templates, 0);
+    CHECK(strcmp(loaded.entry(alice).departemen, "Matematika \"A\"") == 0);
+    CHECK(strcmp(loaded.entry(alice).masaBerlaku, "2027-06-30") == 0);
+    CHECK(strcmp(loaded.entry(carol).jabatan, "Staf") == 0);
+
+    // A removed user is gone after the next save/load
+    CHECK(loaded.remove("carol"));
+    CHECK(!loaded.remove("carol"));
+    CHECK(loaded.save(DIRECTORY_PATH));
+    FaceDirectory again;
+    CHECK(again.load(DIRECTORY_PATH));
+    CHECK_EQ(again.count(), 2);
+    CHECK_EQ(again.find("carol"), -1);
+}
+
+static void testCorruption()
+{
+    long size = fileSize(DIRECTORY_PATH);
+
+    // Flipped entry byte: the CRC rejects the file, the directory comes up empty
+    FILE *f = fopen(DIRECTORY_PATH, "r+b");
+    fseek(f, size - 5, SEEK_SET);
+    fputc('#', f);
+    fclose(f);
+    FaceDirectory corrupt;
+    CHECK(!corrupt.load(DIRECTORY_PATH));
+    CHECK_EQ(corrupt.count(), 0);
+
+    // Truncated file
+    CHECK(truncate(DIRECTORY_PATH, size - 40) == 0);
+    FaceDirectory truncated;
+    CHECK(!truncated.load(DIRECTORY_PATH));
+    CHECK_EQ(truncated.count(), 0);
+
+    // Missing file = empty directory, not an error
+    unlink(DIRECTORY_PATH);
+    FaceDirectory missing;
+    CHECK(missing.load(DIRECTORY_PATH));
+    CHECK_EQ(missing.count(), 0);
+}
+
+static void testSyncAtScale()
+{
+    FaceGallery gallery;
+    CHECK(gallery.begin());
+    char name[FACE_NAME_LEN];
+    for (int u = 0; u < SYNC_USERS; u++)
+    {
+        snprintf(name, sizeof(name), "user%05d", u);
+        for (int c = 0; c <= u % 3; c++)
+            gallery.addRecord(name, embedding);
+    }
+
+    FaceDirectory directory;
+    CHECK(directory.setMetadata("ghost", "Metadata only", nullptr, nullptr));
+    CHECK(directory.syncWithGallery(gallery));
+    CHECK_EQ(directory.count(), SYNC_USERS + 1);
+
+    int wrong = 0;
+    for (int u = 0; u < SYNC_USERS; u++)
+    {
+        snprintf(name, sizeof(name), "user%05d", u);
+        int i = directory.find(name);
+        if (i < 0 || directory.entry(i).templates != u % 3 + 1)
+            wrong++;
+    }
+    CHECK_EQ(wrong, 0);
+    CHECK_EQ(directory.entry(directory.find("ghost")).templates, 0);
+
+    // Removing users from the gallery zeroes their counts, metadata stays
+    gallery.removeUser("user00002");
+    CHECK(directory.syncWithGallery(gallery));
+    CHECK_EQ(directory.entry(directory.find("user00002")).templates, 0);
+    CHECK_EQ(directory.count(), SYNC_USERS + 1);
+}
+
+int main()
+{
+    for (int i = 0; i < FACE_EMBEDDING_DIM; i++)
+        embedding[i] = (float)(i % 7) - 3.0f;
+
+    unlink(DIRECTORY_PATH);
+    testRoundTrip();
+    testCorruption();
+    testSyncAtScale();
+    unlink(DIRECTORY_PATH);
+    return testResult("test_face_directory");
+}
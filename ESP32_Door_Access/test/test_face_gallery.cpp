@@ -0,0 +1,214 @@
+/**
+ * FaceGallery unit test
+ *
+ * Synthetic gallery of 1 000 users x 4 captures: record/user counts, the
+ * name directory through growth and removals, top-k matching against a
+ * brute-force reference, and template fusion. With the IVF index attached:
+ * the per-list centroid bounds never underestimate a member, and accepted
+ * matches agree with exact top-k when near-twins make the margin decide.
+ */
+
+#include "face_ann.h"
+#include "face_gallery.h"
+#include "test_support.h"
+
+#include <string.h>
+
+#define USERS 1000
+#define CAPTURES 4
+
+static void userName(int user, char *name)
+{
+    snprintf(name, FACE_NAME_LEN, "user%04d", user);
+}
+
+// Reference: best user by exhaustive int8 cosine over every record
+static int bruteForceBest(const FaceGallery &gallery, const QuantizedEmbedding &probe, float &best)
+{
+    int bestUser = -1;
+    best = -2.0f;
+    for (size_t r = 0; r < gallery.recordCount(); r++)
+    {
+        float s = cosineSimilarityQ8(probe, gallery.embedding(r));
+        if (s > best)
+        {
+            best = s;
+            bestUser = gallery.recordUser(r);
+        }
+    }
+    return bestUser;
+}
+
+int main()
+{
+    static float identity[FACE_EMBEDDING_DIM];
+    static float capture[FACE_EMBEDDING_DIM];
+    char name[FACE_NAME_LEN];
+
+    // Small initial capacities: the directory and record arrays must grow
+    FaceGallery gallery;
+    CHECK(gallery.begin(16, 16));
+
+    for (int u = 0; u < USERS; u++)
+    {
+        userName(u, name);
+        testIdentity(u, identity);
+        for (int c = 0; c < CAPTURES; c++)
+        {
+            testCapture(identity, u * CAPTURES + c, 0.3f, capture);
+            CHECK(gallery.addRecord(name, capture) >= 0);
+        }
+    }
+    CHECK_EQ(gallery.userCount(), USERS);
+    CHECK_EQ(gallery.recordCount(), USERS * CAPTURES);
+
+    // Directory: every user found, with the right count; unknown names are not
+    int misses = 0;
+    for (int u = 0; u < USERS; u++)
+    {
+        userName(u, name);
+        int index = gallery.findUser(name);
+        if (index < 0 || strcmp(gallery.user(index).name, name) != 0 || gallery.user(index).records != CAPTURES)
+            misses++;
+    }
+    CHECK_EQ(misses, 0);
+    CHECK_EQ(gallery.findUser("nobody"), -1);
+    CHECK_EQ(gallery.addRecord("", capture), -1);
+
+    // Remove every third user: counts, directory and record ownership stay consistent
+    int removedRecords = 0;
+    for (int u = 0; u < USERS; u += 3)
+    {
+        userName(u, name);
+        removedRecords += gallery.removeUser(name);
+    }
+    int removedUsers = (USERS + 2) / 3;
+    CHECK_EQ(removedRecords, removedUsers * CAPTURES);
+    CHECK_EQ(gallery.userCount(), USERS - removedUsers);
+    CHECK_EQ(gallery.recordCount(), (USERS - removedUsers) * CAPTURES);
+    CHECK_EQ(gallery.removeUser("user0000"), 0);
+
+    int wrong = 0;
+    for (int u = 0; u < USERS; u++)
+    {
+        userName(u, name);
+        bool present = gallery.findUser(name) >= 0;
+        if (present != (u % 3 != 0))
+            wrong++;
+    }
+    CHECK_EQ(wrong, 0);
+
+    size_t owned = 0;
+    gallery.forEachUser([&](int index, const GalleryUser &user) {
+        size_t n = 0;
+        for (size_t r = 0; r < gallery.recordCount(); r++)
+            n += gallery.recordUser(r) == index;
+        CHECK_EQ(n, user.records);
+        owned += n;
+    });
+    CHECK_EQ(owned, gallery.recordCount());
+
+    // A freed slot is reused and found again
+    testIdentity(0, identity);
+    CHECK(gallery.addRecord("user0000", identity) >= 0);
+    CHECK(gallery.findUser("user0000") >= 0);
+    CHECK_EQ(gallery.userCount(), USERS - removedUsers + 1);
+
+    // Matching: a fresh capture of an enrolled user finds that user, and
+    // top-k agrees with the brute-force reference
+    int matched = 0, agreed = 0, probes = 0;
+    for (int u = 1; u < USERS; u += 7)
+    {
+        if (u % 3 == 0)
+            continue;
+        probes++;
+        userName(u, name);
+        testIdentity(u, identity);
+        testCapture(identity, 1000000 + u, 0.3f, capture);
+        QuantizedEmbedding probe;
+        quantizeEmbedding(capture, probe);
+
+        FaceMatchResult result;
+        gallery.matchTopK(probe, 3, 0.5f, 0.05f, result);
+        if (result.count > 0 && strcmp(gallery.user(result.top[0].user).name, name) == 0)
+            matched++;
+
+        float best;
+        int reference = bruteForceBest(gallery, probe, best);
+        if (result.count > 0 && result.top[0].user == reference && fabsf(result.top[0].similarity - best) < 1e-5f)
+            agreed++;
+    }
+    CHECK_EQ(matched, probes);
+    CHECK_EQ(agreed, probes);
+
+    // Fusion: at most maxTemplates records remain, and they still match
+    userName(1, name);
+    int kept = gallery.fuseUser(name, 2);
+    CHECK(kept >= 1 && kept <= 2);
+    CHECK_EQ(gallery.user(gallery.findUser(name)).records, kept);
+    testIdentity(1, identity);
+    QuantizedEmbedding probe;
+    quantizeEmbedding(identity, probe);
+    float similarity;
+    int user = gallery.match(probe, similarity);
+    CHECK(user >= 0 && strcmp(gallery.user(user).name, name) == 0);
+
+    gallery.clear();
+    CHECK_EQ(gallery.userCount(), 0);
+    CHECK_EQ(gallery.recordCount(), 0);
+    CHECK_EQ(gallery.findUser(name), -1);
+
+    // IVF: every odd user is a near-twin of the one before it
+    FaceAnnIndex index;
+    gallery.attachIndex(&index);
+    for (int u = 0; u < USERS; u++)
+    {
+        userName(u, name);
+        testIdentity(u & ~1, identity);
+        if (u & 1)
+            testCapture(identity, 2000000 + u, 0.33f, identity);
+        testCapture(identity, 3000000 + u, 0.2f, capture);
+        CHECK(gallery.addRecord(name, capture) >= 0);
+    }
+    CHECK(index.train(gallery));
+
+    int boundViolations = 0, disagreements = 0, ambiguous = 0;
+    for (int u = 0; u < USERS; u += 5)
+    {
+        testIdentity(u & ~1, identity);
+        if (u & 1)
+            testCapture(identity, 2000000 + u, 0.33f, identity);
+        testCapture(identity, 4000000 + u, 0.3f, capture);
+        QuantizedEmbedding probe;
+        quantizeEmbedding(capture, probe);
+
+        int lists[ANN_MAX_PROBES];
+        float centroidSimilarity[ANN_MAX_PROBES];
+        size_t listCount = index.closestLists(gallery, probe, lists, ANN_MAX_PROBES, centroidSimilarity);
+        CHECK(listCount > 0);
+        for (size_t l = 0; l < listCount; l++)
+        {
+            size_t count;
+            const uint32_t *members = index.listMembers(lists[l], count);
+            float bound = index.listBound(lists[l], centroidSimilarity[l]);
+            for (size_t m = 0; m < count; m++)
+                boundViolations += cosineSimilarityQ8(probe, gallery.embedding(members[m])) > bound;
+        }
+
+        FaceMatchResult result, reference;
+        gallery.matchTopK(probe, 3, 0.9f, 0.05f, result);
+        FaceTopK exact(probe, 3, 0.9f, 0.05f);
+        for (size_t r = 0; r < gallery.recordCount(); r++)
+            exact.offer((int)r, gallery.recordUser(r), gallery.embedding(r), nullptr);
+        exact.finish(reference);
+        bool accepted = result.count > 0 && result.top[0].similarity >= 0.9f && result.margin >= 0.05f;
+        bool exactAccepted = reference.count > 0 && reference.top[0].similarity >= 0.9f && reference.margin >= 0.05f;
+        disagreements += accepted != exactAccepted;
+        ambiguous += reference.count > 0 && reference.top[0].similarity >= 0.9f && !exactAccepted;
+    }
+    CHECK_EQ(boundViolations, 0);
+    CHECK_EQ(disagreements, 0);
+    CHECK(ambiguous > 0); // The twins do exercise the margin check
+
+    return testResult("test_face_gallery");
+}
@@ -0,0 +1,230 @@
+/**
+ * FacePartition unit test (host stand-in: a fixed-size file mapped with mmap)
+ *
+ * open() on a missing or empty backing file, write -> reopen -> parse, match()
+ * and matchTopK() on the mapped snapshot against the live gallery, images
+ * larger than the partition, and rejection of a corrupt body, a header of
+ * another version, a torn write (header never landed) and a stale snapshot
+ * (checksum() no longer matching the gallery).
+ */
+
+#include "face_partition.h"
+#include "test_support.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#define PARTITION_PATH "test_face_partition.bin"
+#define PARTITION_SIZE (1024 * 1024)
+#define PARTITION_USERS 300
+#define PARTITION_PROBES 200
+#define TOPK_THRESHOLD 0.6f
+#define TOPK_MARGIN 0.05f
+
+static bool createBackingFile(const char *path, long size)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return false;
+    bool ok = size == 0 || (fseek(f, size - 1, SEEK_SET) == 0 && fputc(0, f) == 0);
+    return fclose(f) == 0 && ok;
+}
+
+static void patchFile(const char *path, long offset, const void *data, size_t len)
+{
+    FILE *f = fopen(path, "r+b");
+    CHECK(f != nullptr);
+    if (!f)
+        return;
+    fseek(f, offset, SEEK_SET);
+    CHECK_EQ(fwrite(data, 1, len, f), len);
+    fclose(f);
+}
+
+// Two captures per user, one user removed so the gallery has a free slot
+static void buildGallery(FaceGallery &gallery)
+{
+    CHECK(gallery.begin());
+    float identity[FACE_EMBEDDING_DIM];
+    float capture[FACE_EMBEDDING_DIM];
+    char name[FACE_NAME_LEN];
+    for (int u = 0; u < PARTITION_USERS; u++)
+    {
+        snprintf(name, sizeof(name), "user%04d", u);
+        testIdentity(u, identity);
+        for (int c = 0; c < 2; c++)
+        {
+            testCapture(identity, u * 4 + c, 0.3f, capture);
+            CHECK(gallery.addRecord(name, capture) >= 0);
+        }
+    }
+    CHECK_EQ(gallery.removeUser("user0007"), 2);
+}
+
+static void testOpen()
+{
+    unlink(PARTITION_PATH);
+    FacePartition partition;
+    CHECK(!partition.open(PARTITION_PATH)); // No partition, nothing created
+    CHECK(!partition.isOpen());
+    CHECK(access(PARTITION_PATH, F_OK) != 0);
+
+    CHECK(createBackingFile(PARTITION_PATH, 0));
+    CHECK(!partition.open(PARTITION_PATH)); // Zero-size partition
+    CHECK(!partition.isOpen());
+
+    // Blank partition: opens, but holds no snapshot yet
+    CHECK(createBackingFile(PARTITION_PATH, PARTITION_SIZE));
+    CHECK(partition.open(PARTITION_PATH));
+    CHECK(partition.isOpen());
+    CHECK(!partition.valid());
+    CHECK_EQ(partition.capacity(), PARTITION_SIZE);
+    CHECK_EQ(partition.recordCount(), 0);
+}
+
+static void testWriteAndMatch(const FaceGallery &gallery)
+{
+    {
+        FacePartition partition;
+        CHECK(partition.open(PARTITION_PATH));
+        CHECK(partition.write(gallery));
+        CHECK(partition.valid());
+        CHECK_EQ(partition.capacity(), PARTITION_SIZE); // Written in place, size unchanged
+    }
+
+    // A fresh open parses what the previous one wrote
+    FacePartition partition;
+    CHECK(partition.open(PARTITION_PATH));
+    CHECK(partition.valid());
+    CHECK_EQ(partition.recordCount(), gallery.recordCount());
+    CHECK_EQ(partition.userCount(), gallery.userCount());
+    CHECK_EQ(partition.checksum(), FacePartition::galleryChecksum(gallery));
+
+    int wrongName = 0, wrongTopK = 0;
+    for (size_t r = 0; r < gallery.recordCount(); r++)
+    {
+        if (strcmp(partition.recordName(r), gallery.user(gallery.recordUser(r)).name) != 0 ||
+            memcmp(partition.embedding(r).data, gallery.embedding(r).data, FACE_EMBEDDING_DIM) != 0)
+            wrongName++;
+    }
+
+    float identity[FACE_EMBEDDING_DIM];
+    float capture[FACE_EMBEDDING_DIM];
+    QuantizedEmbedding probe;
+    for (int p = 0; p < PARTITION_PROBES; p++)
+    {
+        testIdentity(p % PARTITION_USERS, identity);
+        testCapture(identity, 100000 + p, 0.3f, capture);
+        quantizeEmbedding(capture, probe);
+
+        float galleryScore, partitionScore;
+        int user = gallery.match(probe, galleryScore);
+        int record = partition.match(probe, partitionScore);
+        if (user < 0 || record < 0 || strcmp(partition.recordName(record), gallery.user(user).name) != 0 ||
+            galleryScore != partitionScore)
+            wrongName++;
+
+        FaceMatchResult expected, actual;
+        gallery.matchTopK(probe, 2, TOPK_THRESHOLD, TOPK_MARGIN, expected);
+        partition.matchTopK(probe, 2, TOPK_THRESHOLD, TOPK_MARGIN, actual);
+        if (expected.count != actual.count || expected.margin != actual.margin)
+        {
+            wrongTopK++;
+            continue;
+        }
+        for (int i = 0; i < actual.count; i++)
+        {
+            if (strcmp(partition.userName(actual.top[i].user), gallery.user(expected.top[i].user).name) != 0 ||
+                actual.top[i].similarity != expected.top[i].similarity)
+                wrongTopK++;
+        }
+    }
+    CHECK_EQ(wrongName, 0);
+    CHECK_EQ(wrongTopK, 0);
+}
+
+static void testTooLarge(const FaceGallery &gallery)
+{
+    // An image that does not fit is refused before anything is touched
+    FaceGallery big;
+    CHECK(big.begin());
+    float embedding[FACE_EMBEDDING_DIM];
+    char name[FACE_NAME_LEN];
+    for (int i = 0; i < 2200; i++)
+    {
+        snprintf(name, sizeof(name), "big%05d", i);
+        testIdentity(i, embedding);
+        big.addRecord(name, embedding);
+    }
+
+    FacePartition partition;
+    CHECK(partition.open(PARTITION_PATH));
+    CHECK(!partition.write(big));
+    CHECK(partition.valid());
+    CHECK_EQ(partition.checksum(), FacePartition::galleryChecksum(gallery));
+    CHECK_EQ(partition.capacity(), PARTITION_SIZE);
+}
+
+static void testInvalidSnapshots(FaceGallery &gallery)
+{
+    FacePartition partition;
+
+    // Corrupt body byte: the CRC check at open rejects the snapshot
+    uint8_t flip = 0x5A;
+    patchFile(PARTITION_PATH, 32 + 3, &flip, 1);
+    CHECK(partition.open(PARTITION_PATH));
+    CHECK(!partition.valid());
+    CHECK_EQ(partition.recordCount(), 0);
+    partition.close();
+
+    // Header of another format version
+    CHECK(createBackingFile(PARTITION_PATH, PARTITION_SIZE));
+    CHECK(partition.open(PARTITION_PATH));
+    CHECK(partition.write(gallery));
+    CHECK(partition.valid());
+    partition.close();
+    uint16_t version = FACE_PARTITION_VERSION - 1;
+    patchFile(PARTITION_PATH, 4, &version, sizeof(version));
+    CHECK(partition.open(PARTITION_PATH));
+    CHECK(!partition.valid());
+
+    // Torn write: body programmed, header never landed
+    CHECK(partition.write(gallery));
+    partition.close();
+    uint8_t blank[32] = {0};
+    patchFile(PARTITION_PATH, 0, blank, sizeof(blank));
+    CHECK(partition.open(PARTITION_PATH));
+    CHECK(!partition.valid());
+
+    // Record count pointing past the end of the partition
+    CHECK(partition.write(gallery));
+    partition.close();
+    uint32_t records = PARTITION_SIZE / sizeof(QuantizedEmbedding);
+    patchFile(PARTITION_PATH, 8, &records, sizeof(records));
+    CHECK(partition.open(PARTITION_PATH));
+    CHECK(!partition.valid());
+
+    // Stale snapshot: still valid, but the checksum tells it is out of date
+    CHECK(partition.write(gallery));
+    CHECK(partition.valid());
+    float embedding[FACE_EMBEDDING_DIM];
+    testIdentity(9999, embedding);
+    gallery.addRecord("late", embedding);
+    CHECK(partition.checksum() != FacePartition::galleryChecksum(gallery));
+    CHECK(partition.write(gallery));
+    CHECK_EQ(partition.checksum(), FacePartition::galleryChecksum(gallery));
+    CHECK_EQ(partition.recordCount(), gallery.recordCount());
+}
+
+int main()
+{
+    FaceGallery gallery;
+    buildGallery(gallery);
+
+    testOpen();
+    testWriteAndMatch(gallery);
+    testTooLarge(gallery);
+    testInvalidSnapshots(gallery);
+    unlink(PARTITION_PATH);
+    return testResult("test_face_partition");
+}
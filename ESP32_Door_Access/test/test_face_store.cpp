@@ -0,0 +1,232 @@
+/**
+ * FaceStore unit test
+ *
+ * Journal round trip (enrollments, tombstones, replay), per-record CRC
+ * (a flipped payload byte or a torn tail is dropped and flagged, earlier
+ * records survive), and compaction back to the live gallery only -
+ * including the staged form, where enrollments and deletions journaled
+ * while the image is written survive the swap - the CLEAR record, and a
+ * journal without a valid file header, which is refused and left untouched.
+ */
+
+#include "face_store.h"
+#include "psram_alloc.h"
+#include "test_support.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#define STORE_PATH "test_face_store.bin"
+
+static void enroll(FaceStore &store, FaceGallery &gallery, const char *name, uint32_t seed, int captures)
+{
+    static float identity[FACE_EMBEDDING_DIM];
+    static float capture[FACE_EMBEDDING_DIM];
+    testIdentity(seed, identity);
+    for (int c = 0; c < captures; c++)
+    {
+        testCapture(identity, seed * 16 + c, 0.3f, capture);
+        gallery.addRecord(name, capture);
+    }
+    CHECK(store.appendUser(gallery, name));
+}
+
+static long fileSize(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return -1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+static void flipByte(const char *path, long offset)
+{
+    FILE *f = fopen(path, "r+b");
+    fseek(f, offset, SEEK_SET);
+    int c = fgetc(f);
+    fseek(f, offset, SEEK_SET);
+    fputc(c ^ 0x40, f);
+    fclose(f);
+}
+
+// Replays the journal into a fresh gallery
+static void replay(FaceGallery &gallery, uint32_t &corrupt)
+{
+    FaceStore store;
+    CHECK(store.begin(STORE_PATH));
+    gallery.clear();
+    CHECK(store.replay(gallery));
+    corrupt = store.corruptRecords();
+}
+
+static bool sameRecords(const FaceGallery &a, const FaceGallery &b, const char *name)
+{
+    int ua = a.findUser(name), ub = b.findUser(name);
+    if (ua < 0 || ub < 0 || a.user(ua).records != b.user(ub).records)
+        return false;
+    // Records are bit-identical (order kept within a user)
+    size_t ra = 0, rb = 0;
+    for (;;)
+    {
+        while (ra < a.recordCount() && a.recordUser(ra) != ua)
+            ra++;
+        while (rb < b.recordCount() && b.recordUser(rb) != ub)
+            rb++;
+        if (ra == a.recordCount() || rb == b.recordCount())
+            return ra == a.recordCount() && rb == b.recordCount();
+        if (memcmp(&a.embedding(ra), &b.embedding(rb), FACE_EMBEDDING_DIM + 2 * sizeof(float)) != 0)
+            return false;
+        ra++;
+        rb++;
+    }
+}
+
+int main()
+{
+    unlink(STORE_PATH);
+    uint32_t corrupt = 0;
+
+    FaceGallery live;
+    CHECK(live.begin());
+    {
+        FaceStore store;
+        CHECK(store.begin(STORE_PATH));
+        enroll(store, live, "alice", 1, 3);
+        enroll(store, live, "bob", 2, 3);
+        enroll(store, live, "carol", 3, 2);
+
+        // Delete bob, then re-enroll carol: tombstone first, as main.cpp does
+        live.removeUser("bob");
+        CHECK(store.appendTombstone("bob"));
+        live.removeUser("carol");
+        CHECK(store.appendTombstone("carol"));
+        enroll(store, live, "carol", 4, 1);
+        CHECK_EQ(store.version(), FACE_STORE_VERSION);
+    }
+
+    // Round trip: replay rebuilds exactly the live gallery
+    FaceGallery replayed;
+    CHECK(replayed.begin());
+    replay(replayed, corrupt);
+    CHECK_EQ(corrupt, 0);
+    CHECK_EQ(replayed.userCount(), 2);
+    CHECK_EQ(replayed.recordCount(), 4);
+    CHECK_EQ(replayed.findUser("bob"), -1);
+    CHECK(sameRecords(live, replayed, "alice"));
+    CHECK(sameRecords(live, replayed, "carol"));
+
+    // Torn tail: half a record at the end is ignored, everything before survives
+    long intact = fileSize(STORE_PATH);
+    {
+        FaceStore store;
+        CHECK(store.begin(STORE_PATH));
+        FaceGallery scratch;
+        scratch.begin();
+        CHECK(store.replay(scratch));
+        enroll(store, scratch, "dave", 5, 1);
+    }
+    long withDave = fileSize(STORE_PATH);
+    CHECK(truncate(STORE_PATH, intact + (withDave - intact) / 2) == 0);
+    replay(replayed, corrupt);
+    CHECK_EQ(corrupt, 1);
+    CHECK_EQ(replayed.findUser("dave"), -1);
+    CHECK(sameRecords(live, replayed, "alice"));
+    CHECK(sameRecords(live, replayed, "carol"));
+
+    // CRC: a flipped byte inside the last record's payload rejects that record
+    CHECK(truncate(STORE_PATH, intact) == 0);
+    flipByte(STORE_PATH, intact - 100);
+    replay(replayed, corrupt);
+    CHECK_EQ(corrupt, 1);
+    CHECK(sameRecords(live, replayed, "alice"));
+    CHECK_EQ(replayed.findUser("carol"), -1); // Its tombstone replayed, the re-enrollment did not
+
+    // Compaction rewrites the live gallery only; the replay matches it again
+    {
+        FaceStore store;
+        CHECK(store.begin(STORE_PATH));
+        FaceGallery scratch;
+        scratch.begin();
+        CHECK(store.replay(scratch));
+        CHECK(store.compact(live));
+        CHECK_EQ((long)store.fileBytes(), fileSize(STORE_PATH));
+        CHECK(store.fileBytes() <= (size_t)intact);
+    }
+    replay(replayed, corrupt);
+    CHECK_EQ(corrupt, 0);
+    CHECK_EQ(replayed.userCount(), live.userCount());
+    CHECK_EQ(replayed.recordCount(), live.recordCount());
+    CHECK(sameRecords(live, replayed, "alice"));
+    CHECK(sameRecords(live, replayed, "carol"));
+
+    // Staged compaction: the image is taken, then erin enrolls and alice is
+    // deleted before the swap (as while faceStoreTask writes without the lock)
+    {
+        FaceStore store;
+        CHECK(store.begin(STORE_PATH));
+        FaceGallery scratch;
+        scratch.begin();
+        CHECK(store.replay(scratch));
+
+        size_t size;
+        uint8_t *image = store.prepareCompaction(live, size);
+        CHECK(image != nullptr);
+        enroll(store, live, "erin", 6, 2);
+        CHECK(store.writeCompaction(image, size));
+        psramFree(image);
+        live.removeUser("alice");
+        CHECK(store.appendTombstone("alice"));
+        CHECK(store.finishCompaction());
+        CHECK_EQ((long)store.fileBytes(), fileSize(STORE_PATH));
+
+        // The store keeps appending to the swapped log
+        enroll(store, live, "frank", 7, 1);
+        CHECK_EQ((long)store.fileBytes(), fileSize(STORE_PATH));
+        CHECK(!store.finishCompaction()); // Nothing prepared
+    }
+    replay(replayed, corrupt);
+    CHECK_EQ(corrupt, 0);
+    CHECK_EQ(replayed.userCount(), 3);
+    CHECK_EQ(replayed.recordCount(), live.recordCount());
+    CHECK_EQ(replayed.findUser("alice"), -1);
+    CHECK(sameRecords(live, replayed, "carol"));
+    CHECK(sameRecords(live, replayed, "erin"));
+    CHECK(sameRecords(live, replayed, "frank"));
+
+    // CLEAR drops everything journaled before it, later enrollments count
+    {
+        FaceStore store;
+        CHECK(store.begin(STORE_PATH));
+        FaceGallery scratch;
+        scratch.begin();
+        CHECK(store.replay(scratch));
+        live.clear();
+        CHECK(store.appendClear());
+        enroll(store, live, "gina", 8, 1);
+    }
+    replay(replayed, corrupt);
+    CHECK_EQ(corrupt, 0);
+    CHECK_EQ(replayed.userCount(), 1);
+    CHECK(sameRecords(live, replayed, "gina"));
+
+    // Corrupt file header: nothing is replayed, appended or compacted
+    flipByte(STORE_PATH, 2);
+    long size = fileSize(STORE_PATH);
+    {
+        FaceStore store;
+        CHECK(store.begin(STORE_PATH));
+        FaceGallery scratch;
+        scratch.begin();
+        CHECK(!store.replay(scratch));
+        CHECK(!store.appendTombstone("gina"));
+        CHECK(!store.needsCompaction(scratch));
+        CHECK(!store.compact(scratch));
+    }
+    CHECK_EQ(fileSize(STORE_PATH), size);
+
+    unlink(STORE_PATH);
+    return testResult("test_face_store");
+}
@@ -0,0 +1,256 @@
+/**
+ * FaceExporter / FaceImporter unit test
+ *
+ * Round trip of a gallery whose records are not grouped by user (templates,
+ * metadata, odd chunk sizes on both sides), an export aborted by a gallery
+ * change, and rejection of a corrupt frame CRC (users before it stay
+ * committed, the broken user is not half imported), a bad END CRC and a
+ * truncated stream.
+ */
+
+#include "face_transfer.h"
+#include "crc32.h"
+#include "test_support.h"
+
+#include <string.h>
+#include <vector>
+
+#define TRANSFER_USERS 40
+#define EXPORT_CHUNK 37  // Never a multiple of a frame size
+#define IMPORT_CHUNK 101
+
+#define USER_FRAME (TRANSFER_FRAME_OVERHEAD + TRANSFER_USER_PAYLOAD)
+#define FACE_FRAME (TRANSFER_FRAME_OVERHEAD + TRANSFER_FACE_PAYLOAD)
+#define END_FRAME (TRANSFER_FRAME_OVERHEAD + TRANSFER_END_PAYLOAD)
+
+static void userName(int u, char *name)
+{
+    snprintf(name, FACE_NAME_LEN, "user%03d", u);
+}
+
+static int templatesOf(int u)
+{
+    return u % 3 + 1;
+}
+
+// Records are added round by round, so every user's records are spread
+// over the gallery; removing a user then moves the tail into the hole
+static void buildGallery(FaceGallery &gallery, FaceDirectory &directory)
+{
+    CHECK(gallery.begin());
+    float identity[FACE_EMBEDDING_DIM];
+    float capture[FACE_EMBEDDING_DIM];
+    char name[FACE_NAME_LEN];
+    for (int round = 0; round < 3; round++)
+    {
+        for (int u = 0; u < TRANSFER_USERS; u++)
+        {
+            if (round >= templatesOf(u))
+                continue;
+            userName(u, name);
+            testIdentity(u, identity);
+            testCapture(identity, u * 8 + round, 0.3f, capture);
+            CHECK(gallery.addRecord(name, capture) >= 0);
+        }
+    }
+    CHECK_EQ(gallery.removeUser("user000"), 1);
+
+    CHECK(directory.syncWithGallery(gallery));
+    CHECK(directory.setMetadata("user005", "Guru", "Matematika", "2027-06-30"));
+    CHECK(directory.setMetadata("user017", "Staf", nullptr, nullptr));
+}
+
+static std::vector<uint8_t> exportGallery(const FaceGallery &gallery, const FaceDirectory *directory)
+{
+    FaceExporter exporter;
+    CHECK(exporter.begin(gallery, directory));
+    std::vector<uint8_t> stream;
+    uint8_t chunk[EXPORT_CHUNK];
+    size_t n;
+    while ((n = exporter.read(chunk, sizeof(chunk))) > 0)
+        stream.insert(stream.end(), chunk, chunk + n);
+    CHECK(!exporter.aborted());
+    CHECK_EQ(exporter.users(), gallery.userCount());
+    CHECK_EQ(exporter.faces(), gallery.recordCount());
+    return stream;
+}
+
+// Feeds the stream in IMPORT_CHUNK pieces; false once the importer rejects it
+static bool importStream(FaceImporter &importer, const std::vector<uint8_t> &stream)
+{
+    for (size_t pos = 0; pos < stream.size(); pos += IMPORT_CHUNK)
+    {
+        size_t n = stream.size() - pos < IMPORT_CHUNK ? stream.size() - pos : IMPORT_CHUNK;
+        if (!importer.feed(&stream[pos], n))
+            return false;
+    }
+    return true;
+}
+
+// Every record of name in a matches one record of the same user in b (in order)
+static bool sameTemplates(const FaceGallery &a, const FaceGallery &b, const char *name)
+{
+    int ua = a.findUser(name);
+    int ub = b.findUser(name);
+    if (ua < 0 || ub < 0 || a.user(ua).records != b.user(ub).records)
+        return false;
+
+    size_t rb = 0;
+    for (size_t ra = 0; ra < a.recordCount(); ra++)
+    {
+        if (a.recordUser(ra) != ua)
+            continue;
+        while (rb < b.recordCount() && b.recordUser(rb) != ub)
+            rb++;
+        if (rb == b.recordCount())
+            return false;
+        const QuantizedEmbedding &ea = a.embedding(ra);
+        const QuantizedEmbedding &eb = b.embedding(rb);
+        if (memcmp(ea.data, eb.data, FACE_EMBEDDING_DIM) != 0 || ea.scale != eb.scale ||
+            fabsf(ea.norm - eb.norm) > 1e-4f * ea.norm)
+            return false;
+        rb++;
+    }
+    return true;
+}
+
+// Rewrites the CRC of the frame at offset, so only the stream checksum is wrong
+static void resealFrame(std::vector<uint8_t> &stream, size_t offset, uint16_t payload)
+{
+    uint32_t crc = crc32Update(0, &stream[offset], 4 + payload);
+    for (int i = 0; i < 4; i++)
+        stream[offset + 4 + payload + i] = (crc >> (8 * i)) & 0xFF;
+}
+
+static void testRoundTrip(const FaceGallery &gallery, const std::vector<uint8_t> &stream)
+{
+    CHECK_EQ(stream.size(), TRANSFER_HEADER_SIZE + gallery.userCount() * USER_FRAME + gallery.recordCount() * FACE_FRAME +
+                                END_FRAME);
+
+    FaceGallery imported;
+    FaceDirectory importedDirectory;
+    CHECK(imported.begin());
+    // An existing user with the same name is replaced, not merged
+    float stale[FACE_EMBEDDING_DIM];
+    testIdentity(999, stale);
+    imported.addRecord("user001", stale);
+
+    FaceImporter importer;
+    CHECK(importer.begin(imported, &importedDirectory, nullptr));
+    CHECK(importStream(importer, stream));
+    CHECK(importer.finished());
+    CHECK(importer.error() == nullptr);
+    CHECK_EQ(importer.users(), gallery.userCount());
+    CHECK_EQ(importer.faces(), gallery.recordCount());
+    importer.end();
+
+    CHECK_EQ(imported.userCount(), gallery.userCount());
+    CHECK_EQ(imported.recordCount(), gallery.recordCount());
+    int wrong = 0;
+    gallery.forEachUser([&](int, const GalleryUser &user) {
+        if (!sameTemplates(gallery, imported, user.name))
+            wrong++;
+    });
+    CHECK_EQ(wrong, 0);
+    CHECK_EQ(imported.findUser("user000"), -1);
+
+    int entry = importedDirectory.find("user005");
+    CHECK(entry >= 0);
+    if (entry >= 0)
+    {
+        CHECK(strcmp(importedDirectory.entry(entry).jabatan, "Guru") == 0);
+        CHECK(strcmp(importedDirectory.entry(entry).departemen, "Matematika") == 0);
+        CHECK(strcmp(importedDirectory.entry(entry).masaBerlaku, "2027-06-30") == 0);
+    }
+    entry = importedDirectory.find("user017");
+    CHECK(entry >= 0 && strcmp(importedDirectory.entry(entry).jabatan, "Staf") == 0);
+}
+
+static void testAbortedExport(FaceGallery &gallery)
+{
+    FaceExporter exporter;
+    CHECK(exporter.begin(gallery, nullptr));
+    uint8_t chunk[EXPORT_CHUNK];
+    CHECK(exporter.read(chunk, sizeof(chunk)) > 0);
+
+    float extra[FACE_EMBEDDING_DIM];
+    testIdentity(500, extra);
+    gallery.addRecord("late", extra);
+
+    size_t total = 0, n;
+    while ((n = exporter.read(chunk, sizeof(chunk))) > 0)
+        total += n;
+    CHECK(exporter.aborted());
+    CHECK(total < FACE_FRAME); // At most the frame already in flight
+    gallery.removeUser("late");
+}
+
+static void testCorruptFrame(const FaceGallery &gallery, const std::vector<uint8_t> &stream)
+{
+    // First FACE frame of the third user: the first two users are complete
+    // by then. Users are exported in slot order, user000 was removed.
+    size_t offset = TRANSFER_HEADER_SIZE;
+    for (int u = 1; u < 3; u++)
+        offset += USER_FRAME + templatesOf(u) * FACE_FRAME;
+    offset += USER_FRAME;
+
+    std::vector<uint8_t> corrupt = stream;
+    corrupt[offset + 4 + 100] ^= 0x40;
+
+    FaceGallery imported;
+    CHECK(imported.begin());
+    FaceImporter importer;
+    CHECK(importer.begin(imported, nullptr, nullptr));
+    CHECK(!importStream(importer, corrupt));
+    CHECK(!importer.finished());
+    CHECK(importer.error() && strcmp(importer.error(), "frame checksum mismatch") == 0);
+    CHECK(!importer.feed(&stream[0], 1)); // Stays failed
+    importer.end();
+
+    CHECK_EQ(imported.userCount(), 2);
+    CHECK(sameTemplates(gallery, imported, "user001"));
+    CHECK(sameTemplates(gallery, imported, "user002"));
+    CHECK_EQ(imported.findUser("user003"), -1);
+}
+
+static void testBadEnd(const std::vector<uint8_t> &stream)
+{
+    // END payload: users | faces | crc. A wrong stream CRC behind a valid frame CRC
+    std::vector<uint8_t> badEnd = stream;
+    size_t end = badEnd.size() - END_FRAME;
+    CHECK_EQ(badEnd[end], TRANSFER_RECORD_END);
+    badEnd[end + 4 + 8] ^= 0x01;
+    resealFrame(badEnd, end, TRANSFER_END_PAYLOAD);
+
+    FaceGallery imported;
+    CHECK(imported.begin());
+    FaceImporter importer;
+    CHECK(importer.begin(imported, nullptr, nullptr));
+    CHECK(!importStream(importer, badEnd));
+    CHECK(!importer.finished());
+    CHECK(importer.error() && strcmp(importer.error(), "stream checksum mismatch") == 0);
+    importer.end();
+
+    // A stream cut before END never finishes
+    std::vector<uint8_t> truncated(stream.begin(), stream.end() - END_FRAME);
+    FaceGallery partial;
+    CHECK(partial.begin());
+    CHECK(importer.begin(partial, nullptr, nullptr));
+    CHECK(importStream(importer, truncated));
+    CHECK(!importer.finished());
+    importer.end();
+}
+
+int main()
+{
+    FaceGallery gallery;
+    FaceDirectory directory;
+    buildGallery(gallery, directory);
+    std::vector<uint8_t> stream = exportGallery(gallery, &directory);
+
+    testRoundTrip(gallery, stream);
+    testAbortedExport(gallery);
+    testCorruptFrame(gallery, stream);
+    testBadEnd(stream);
+    return testResult("test_face_transfer");
+}
@@ -0,0 +1,294 @@
+/**
+ * FramePipeline unit test with a fake camera and a fake detector
+ *
+ * Built twice: against the firmware queue (PIPELINE_QUEUE_DEPTH 1) and, as
+ * test_frame_pipeline_deep, against a 3-deep queue so the newest-frame-wins
+ * drop path can be driven step by step.
+ *   steps         captureStep()/inferenceStep() by hand: the processor gets
+ *                 the newest queued frame, older ones go back to the source
+ *   overlap       threaded: frames are acquired while another one is being
+ *                 processed, throughput follows the slower stage alone
+ *   freshness     threaded: every processed frame was captured after the
+ *                 previous one started processing, in capture order
+ *   control       pause() leaves the camera untouched with every buffer
+ *                 released, resume() restarts, stop() joins and releases
+ */
+
+#include "frame_pipeline.h"
+#include "test_support.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define OVERLAP_CAPTURE_MS 10
+#define OVERLAP_PROCESS_MS 30
+#define OVERLAP_RUN_MS 600
+#define FRESH_CAPTURE_MS 2
+#define FRESH_PROCESS_MS 15
+
+static void sleepMs(uint32_t ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+class FakeProcessor;
+
+// Camera stand-in: each acquire() takes captureMs and hands out a numbered
+// buffer; release() checks that every buffer comes back exactly once
+class FakeSource : public FrameSource
+{
+public:
+    explicit FakeSource(uint32_t captureMs)
+        : captureMs_(captureMs), processor_(nullptr), epoch_(std::chrono::steady_clock::now()),
+          acquired_(0), overlapped_(0), badReleases_(0)
+    {
+    }
+
+    void watch(const FakeProcessor *processor) { processor_ = processor; }
+
+    bool acquire(PipelineFrame &frame) override;
+
+    void release(PipelineFrame &frame) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t id = (size_t)(uintptr_t)frame.handle;
+        if (id == 0 || id > outstanding_.size() || !outstanding_[id - 1])
+            badReleases_++;
+        else
+            outstanding_[id - 1] = false;
+        releasedOrder_.push_back((uint32_t)id);
+    }
+
+    uint32_t nowMs() override
+    {
+        return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch_).count();
+    }
+
+    uint32_t acquired() const { return acquired_.load(); }
+    uint32_t overlapped() const { return overlapped_.load(); }
+    uint32_t badReleases() const { return badReleases_.load(); }
+
+    size_t outstanding()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t n = 0;
+        for (bool held : outstanding_)
+            n += held;
+        return n;
+    }
+
+    std::vector<uint32_t> releasedOrder()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return releasedOrder_;
+    }
+
+private:
+    uint32_t captureMs_;
+    const FakeProcessor *processor_;
+    std::chrono::steady_clock::time_point epoch_;
+    std::mutex mutex_;
+    std::vector<bool> outstanding_; // Per buffer id - 1: handed out, not yet released
+    std::vector<uint32_t> releasedOrder_;
+    std::atomic<uint32_t> acquired_;
+    std::atomic<uint32_t> overlapped_; // Acquires that ran while a frame was being processed
+    std::atomic<uint32_t> badReleases_;
+};
+
+// Detector stand-in: takes processMs per frame and logs what it saw
+class FakeProcessor : public FrameProcessor
+{
+public:
+    FakeProcessor(FakeSource &source, uint32_t processMs) : source_(source), processMs_(processMs), busy_(false) {}
+
+    void process(const PipelineFrame &frame) override
+    {
+        uint32_t start = source_.nowMs();
+        busy_.store(true);
+        if (processMs_)
+            sleepMs(processMs_);
+        busy_.store(false);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        seen_.push_back(frame);
+        startMs_.push_back(start);
+    }
+
+    bool busy() const { return busy_.load(); }
+
+    std::vector<PipelineFrame> seen()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return seen_;
+    }
+
+    std::vector<uint32_t> startMs()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return startMs_;
+    }
+
+private:
+    FakeSource &source_;
+    uint32_t processMs_;
+    std::atomic<bool> busy_;
+    std::mutex mutex_;
+    std::vector<PipelineFrame> seen_;
+    std::vector<uint32_t> startMs_;
+};
+
+bool FakeSource::acquire(PipelineFrame &frame)
+{
+    bool overlap = processor_ && processor_->busy();
+    if (captureMs_)
+        sleepMs(captureMs_);
+    overlap = overlap || (processor_ && processor_->busy());
+    if (overlap)
+        overlapped_++;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    outstanding_.push_back(true);
+    frame.handle = (void *)(uintptr_t)outstanding_.size();
+    acquired_++;
+    return true;
+}
+
+static void testSteps()
+{
+    FakeSource source(0);
+    FakeProcessor processor(source, 0);
+    FramePipeline pipeline(source, processor);
+
+    // Fill the queue; a full queue does not touch the camera
+    for (int i = 0; i < PIPELINE_QUEUE_DEPTH; i++)
+        CHECK(pipeline.captureStep());
+    CHECK(!pipeline.captureStep());
+    CHECK_EQ(source.acquired(), PIPELINE_QUEUE_DEPTH);
+
+    // The newest frame is processed, the older ones are released unprocessed
+    CHECK(pipeline.inferenceStep());
+    std::vector<PipelineFrame> seen = processor.seen();
+    CHECK_EQ(seen.size(), 1);
+    if (seen.size() == 1)
+        CHECK_EQ(seen[0].sequence, PIPELINE_QUEUE_DEPTH);
+    std::vector<uint32_t> released = source.releasedOrder();
+    CHECK_EQ(released.size(), PIPELINE_QUEUE_DEPTH);
+    for (size_t i = 0; i < released.size(); i++)
+        CHECK_EQ(released[i], i + 1); // Dropped oldest first, processed one last
+
+    PipelineStats stats = pipeline.stats();
+    CHECK_EQ(stats.captured, PIPELINE_QUEUE_DEPTH);
+    CHECK_EQ(stats.processed, 1);
+    CHECK_EQ(stats.dropped, PIPELINE_QUEUE_DEPTH - 1);
+    CHECK(!pipeline.inferenceStep()); // Nothing left
+    CHECK_EQ(source.outstanding(), 0);
+    CHECK_EQ(source.badReleases(), 0);
+}
+
+static void testOverlap()
+{
+    FakeSource source(OVERLAP_CAPTURE_MS);
+    FakeProcessor processor(source, OVERLAP_PROCESS_MS);
+    source.watch(&processor);
+    FramePipeline pipeline(source, processor);
+
+    CHECK(pipeline.start(0, 1));
+    sleepMs(OVERLAP_RUN_MS);
+    pipeline.stop();
+
+    PipelineStats stats = pipeline.stats();
+    uint32_t sequential = OVERLAP_RUN_MS / (OVERLAP_CAPTURE_MS + OVERLAP_PROCESS_MS);
+    uint32_t pipelined = OVERLAP_RUN_MS / OVERLAP_PROCESS_MS;
+    printf("overlap: %u processed in %u ms (sequential %u, pipelined %u), %u of %u acquires overlapped\n",
+           stats.processed, OVERLAP_RUN_MS, sequential, pipelined, source.overlapped(), source.acquired());
+
+    // Capture hides behind processing: nearly every acquire overlaps one
+    CHECK(source.overlapped() * 4 >= source.acquired() * 3);
+    CHECK(stats.processed > sequential);
+    CHECK(stats.processed <= pipelined + 1);
+    CHECK_EQ(source.outstanding(), 0);
+    CHECK_EQ(source.badReleases(), 0);
+}
+
+static void testFreshness()
+{
+    // Camera much faster than the detector: frames are dropped or never
+    // captured, and whatever is processed must be the newest one available
+    FakeSource source(FRESH_CAPTURE_MS);
+    FakeProcessor processor(source, FRESH_PROCESS_MS);
+    FramePipeline pipeline(source, processor);
+
+    CHECK(pipeline.start(0, 1));
+    sleepMs(300);
+    pipeline.stop();
+
+    std::vector<PipelineFrame> seen = processor.seen();
+    std::vector<uint32_t> startMs = processor.startMs();
+    CHECK(seen.size() >= 5);
+    int stale = 0;
+    for (size_t i = 1; i < seen.size(); i++)
+    {
+        if (seen[i].sequence <= seen[i - 1].sequence || seen[i].capturedMs < startMs[i - 1])
+            stale++;
+    }
+    CHECK_EQ(stale, 0);
+    PipelineStats stats = pipeline.stats();
+    CHECK(stats.lastLatencyMs <= 2 * FRESH_PROCESS_MS + 20);
+    CHECK_EQ(source.outstanding(), 0);
+    CHECK_EQ(source.badReleases(), 0);
+}
+
+static void testControl()
+{
+    FakeSource source(5);
+    FakeProcessor processor(source, 10);
+    FramePipeline pipeline(source, processor);
+
+    CHECK(pipeline.start(0, 1));
+    CHECK(pipeline.start(0, 1)); // Already running
+    sleepMs(100);
+
+    // Paused: both stages idle, every buffer back with the source, camera untouched
+    pipeline.pause();
+    CHECK(pipeline.paused());
+    CHECK_EQ(source.outstanding(), 0);
+    uint32_t acquired = source.acquired();
+    size_t processed = processor.seen().size();
+    CHECK(processed > 0);
+    sleepMs(100);
+    CHECK_EQ(source.acquired(), acquired);
+    CHECK_EQ(processor.seen().size(), processed);
+
+    pipeline.resume();
+    CHECK(!pipeline.paused());
+    sleepMs(100);
+    CHECK(processor.seen().size() > processed);
+
+    // stop() joins both stages and returns queued frames; it is idempotent,
+    // also after a pause
+    pipeline.stop();
+    acquired = source.acquired();
+    sleepMs(50);
+    CHECK_EQ(source.acquired(), acquired);
+    CHECK_EQ(source.outstanding(), 0);
+    pipeline.stop();
+
+    CHECK(pipeline.start(0, 1));
+    sleepMs(50);
+    pipeline.pause();
+    pipeline.stop();
+    CHECK_EQ(source.outstanding(), 0);
+    CHECK_EQ(source.badReleases(), 0);
+}
+
+int main()
+{
+    printf("queue depth %d\n", PIPELINE_QUEUE_DEPTH);
+    testSteps();
+    testOverlap();
+    testFreshness();
+    testControl();
+    return testResult(PIPELINE_QUEUE_DEPTH > 1 ? "test_frame_pipeline_deep" : "test_frame_pipeline");
+}
@@ -0,0 +1,147 @@
+/**
+ * JsonWriter unit test
+ *
+ * RFC 8259 escaping (quote, backslash, control characters; UTF-8 passes
+ * through), number formatting at the integer limits, commas across nested
+ * containers, string pieces, and overflow: the writer stops, reports it and
+ * keeps the buffer NUL-terminated inside its capacity.
+ */
+
+#include "json_writer.h"
+#include "test_support.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CHECK_JSON(writer, expected)                                                    \
+    do                                                                                  \
+    {                                                                                   \
+        CHECK((writer).ok());                                                           \
+        if (strcmp((writer).c_str(), expected) != 0)                                    \
+        {                                                                               \
+            fprintf(stderr, "%s:%d: got %s\n  expected %s\n", __FILE__, __LINE__,       \
+                    (writer).c_str(), expected);                                        \
+            testFailures++;                                                             \
+        }                                                                               \
+        CHECK_EQ((writer).length(), strlen(expected));                                  \
+    } while (0)
+
+static void testEscaping()
+{
+    char buffer[256];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject()
+        .field("quote", "Budi \"Santoso\"")
+        .field("path", "C:\\logs")
+        .field("ws", "a\nb\rc\td")
+        .field("ctl", "\x01\x1f")
+        .field("utf8", "Jos\xc3\xa9 \xe2\x82\xac")
+        .field("slash", "a/b")
+        .endObject();
+    CHECK_JSON(json, "{\"quote\":\"Budi \\\"Santoso\\\"\",\"path\":\"C:\\\\logs\",\"ws\":\"a\\nb\\rc\\td\","
+                     "\"ctl\":\"\\u0001\\u001f\",\"utf8\":\"Jos\xc3\xa9 \xe2\x82\xac\",\"slash\":\"a/b\"}");
+
+    // Escaping applies to string pieces and arrays too; nullptr is null
+    JsonWriter pieces(buffer, sizeof(buffer));
+    pieces.beginArray().value("\"").value((const char *)nullptr).endArray();
+    CHECK_JSON(pieces, "[\"\\\"\",null]");
+
+    JsonWriter assembled(buffer, sizeof(buffer));
+    assembled.beginObject().beginString("msg").append("Enrolling ").append("\"x\"").append(2).append("/").append(5).append("abc", 2).endString().endObject();
+    CHECK_JSON(assembled, "{\"msg\":\"Enrolling \\\"x\\\"2/5ab\"}");
+}
+
+static void testNumbers()
+{
+    char buffer[512];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginArray()
+        .value(0)
+        .value(-42)
+        .value(INT_MIN)
+        .value(LLONG_MIN)
+        .value(LLONG_MAX)
+        .value(ULLONG_MAX)
+        .value((unsigned)UINT_MAX)
+        .value((uint16_t)65535)
+        .value((int8_t)-128)
+        .value(true)
+        .value(false)
+        .value(1.5)
+        .value(0.1234, 3)
+        .value(-0.5f)
+        .value(NAN)
+        .value(INFINITY)
+        .null()
+        .endArray();
+    CHECK_JSON(json, "[0,-42,-2147483648,-9223372036854775808,9223372036854775807,18446744073709551615,"
+                     "4294967295,65535,-128,true,false,1.50,0.123,-0.50,null,null,null]");
+}
+
+static void testNesting()
+{
+    char buffer[256];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject()
+        .field("a", 1)
+        .beginArray("list")
+        .beginObject().field("k", 1).endObject()
+        .beginObject().endObject()
+        .beginArray().endArray()
+        .value("x")
+        .endArray()
+        .beginObject("inner").fieldNull("n").field("d", 2.0, 1).endObject()
+        .field("z", false)
+        .endObject();
+    CHECK_JSON(json, "{\"a\":1,\"list\":[{\"k\":1},{},[],\"x\"],\"inner\":{\"n\":null,\"d\":2.0},\"z\":false}");
+
+    JsonWriter empty(buffer, sizeof(buffer));
+    empty.beginObject().endObject();
+    CHECK_JSON(empty, "{}");
+
+    // Deeper than JSON_WRITER_MAX_DEPTH is refused, not corrupted
+    JsonWriter deep(buffer, sizeof(buffer));
+    for (int i = 0; i < JSON_WRITER_MAX_DEPTH + 2; i++)
+        deep.beginArray();
+    CHECK(!deep.ok());
+}
+
+static void testOverflow()
+{
+    // Every capacity up to the full reply: ok() only when it fits, the buffer
+    // always terminated inside its capacity, the prefix always the real output
+    const char *expected = "{\"name\":\"abc\\\"def\",\"n\":12345}";
+    size_t full = strlen(expected);
+    int wrong = 0;
+    for (size_t capacity = 0; capacity <= full + 2; capacity++)
+    {
+        char buffer[64];
+        memset(buffer, 'X', sizeof(buffer));
+        JsonWriter json(buffer, capacity);
+        json.beginObject().field("name", "abc\"def").field("n", 12345).endObject();
+
+        bool fits = capacity > full;
+        if (json.ok() != fits)
+            wrong++;
+        if (capacity > 0)
+        {
+            if (json.length() >= capacity || buffer[json.length()] != '\0' ||
+                strncmp(buffer, expected, json.length()) != 0)
+                wrong++;
+        }
+        if (buffer[capacity] != 'X') // Nothing written past the capacity
+            wrong++;
+    }
+    CHECK_EQ(wrong, 0);
+}
+
+int main()
+{
+    testEscaping();
+    testNumbers();
+    testNesting();
+    testOverflow();
+    return testResult("test_json_writer");
+}
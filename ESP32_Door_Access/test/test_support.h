@@ -0,0 +1,92 @@
+// Host Test Support
+// CHECK macros for the unit tests (a failure prints the expression and
+// location, the test keeps going; main() returns testResult()) plus
+// deterministic synthetic embeddings, so every run sees the same data.
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "face_embedding.h"
+
+static int testFailures = 0;
+
+#define CHECK(cond)                                                                 \
+    do                                                                              \
+    {                                                                               \
+        if (!(cond))                                                                \
+        {                                                                           \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            testFailures++;                                                         \
+        }                                                                           \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                        \
+    do                                                                                        \
+    {                                                                                         \
+        long long a_ = (long long)(a), b_ = (long long)(b);                                   \
+        if (a_ != b_)                                                                         \
+        {                                                                                     \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, \
+                    #a, #b, a_, b_);                                                          \
+            testFailures++;                                                                   \
+        }                                                                                     \
+    } while (0)
+
+inline int testResult(const char *name)
+{
+    printf("%s: %s (%d failed checks)\n", name, testFailures ? "FAILED" : "passed", testFailures);
+    return testFailures ? 1 : 0;
+}
+
+// xorshift32: fast, seedable, identical on every host
+inline uint32_t testRandom(uint32_t &state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Roughly Gaussian component (sum of four uniforms), centered on 0
+inline float testGaussian(uint32_t &state)
+{
+    float sum = 0.0f;
+    for (int i = 0; i < 4; i++)
+        sum += (float)(testRandom(state) & 0xFFFFFF) / (float)0x1000000;
+    return (sum - 2.0f) * 1.7320508f;
+}
+
+// Unit-length identity vector for seed (seed 0 is remapped, xorshift needs a non-zero state)
+inline void testIdentity(uint32_t seed, float *out)
+{
+    uint32_t state = seed * 2654435761u + 1;
+    float norm = 0.0f;
+    for (int i = 0; i < FACE_EMBEDDING_DIM; i++)
+    {
+        out[i] = testGaussian(state);
+        norm += out[i] * out[i];
+    }
+    norm = sqrtf(norm);
+    for (int i = 0; i < FACE_EMBEDDING_DIM; i++)
+        out[i] /= norm;
+}
+
+// A capture of an identity: the identity vector plus noise of the given
+// strength (0.3 keeps same-identity cosine around 0.95, different ~0)
+inline void testCapture(const float *identity, uint32_t seed, float noise, float *out)
+{
+    uint32_t state = seed * 2246822519u + 7;
+    float norm = 0.0f;
+    for (int i = 0; i < FACE_EMBEDDING_DIM; i++)
+    {
+        out[i] = identity[i] + noise * testGaussian(state) / sqrtf((float)FACE_EMBEDDING_DIM);
+        norm += out[i] * out[i];
+    }
+    norm = sqrtf(norm);
+    for (int i = 0; i < FACE_EMBEDDING_DIM; i++)
+        out[i] /= norm;
+}
+
+#endif // TEST_SUPPORT_H
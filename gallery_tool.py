@@ -0,0 +1,196 @@
+import argparse
+import struct
+import sys
+import urllib.error
+import urllib.request
+import uuid
+import zlib
+
+# Gallery transfer stream (see ESP32_Door_Access/include/face_transfer.h)
+MAGIC = 0x58454746  # "FGEX"
+VERSION = 1
+EMBEDDING_DIM = 512
+
+RECORD_USER = 1
+RECORD_FACE = 2
+RECORD_END = 3
+
+NAME_LEN = 17
+FIELD_LEN = 32
+DATE_LEN = 11
+USER_PAYLOAD = NAME_LEN + 2 * FIELD_LEN + DATE_LEN + 2
+FACE_PAYLOAD = EMBEDDING_DIM + 8
+
+
+def crc32(data, crc=0):
+    return zlib.crc32(data, crc) & 0xFFFFFFFF
+
+
+def field(raw):
+    return raw.split(b'\0', 1)[0].decode('utf-8', errors='replace')
+
+
+def pack_field(text, size):
+    return text.encode('utf-8')[:size - 1].ljust(size, b'\0')
+
+
+def read_stream(data):
+    """Parse and verify an export. Returns a list of users:
+    {name, jabatan, departemen, masaBerlaku, faces: [raw 520-byte templates]}"""
+    if len(data) < 16:
+        raise ValueError("file too short")
+    magic, version, dim, _ = struct.unpack_from('<IHHI', data, 0)
+    if magic != MAGIC or struct.unpack_from('<I', data, 12)[0] != crc32(data[:12]):
+        raise ValueError("not a gallery export")
+    if version != VERSION or dim != EMBEDDING_DIM:
+        raise ValueError(f"unsupported stream (version {version}, dim {dim})")
+
+    users = []
+    pos = 16
+    expected = 0
+    while True:
+        if pos + 4 > len(data):
+            raise ValueError("truncated stream (no END frame)")
+        rtype, _, length = struct.unpack_from('<BBH', data, pos)
+        end = pos + 4 + length
+        if end + 4 > len(data):
+            raise ValueError("truncated frame")
+        if struct.unpack_from('<I', data, end)[0] != crc32(data[pos:end]):
+            raise ValueError(f"frame checksum mismatch at offset {pos}")
+        payload = data[pos + 4:end]
+
+        if rtype == RECORD_USER:
+            if expected:
+                raise ValueError(f"user {users[-1]['name']} is missing {expected} templates")
+            expected = struct.unpack_from('<H', payload, USER_PAYLOAD - 2)[0]
+            users.append({
+                'name': field(payload[:NAME_LEN]),
+                'jabatan': field(payload[NAME_LEN:NAME_LEN + FIELD_LEN]),
+                'departemen': field(payload[NAME_LEN + FIELD_LEN:NAME_LEN + 2 * FIELD_LEN]),
+                'masaBerlaku': field(payload[NAME_LEN + 2 * FIELD_LEN:USER_PAYLOAD - 2]),
+                'faces': [],
+            })
+        elif rtype == RECORD_FACE:
+            if not expected or length != FACE_PAYLOAD:
+                raise ValueError(f"unexpected face frame at offset {pos}")
+            users[-1]['faces'].append(bytes(payload))
+            expected -= 1
+        elif rtype == RECORD_END:
+            n_users, n_faces, stream_crc = struct.unpack('<III', payload)
+            if stream_crc != crc32(data[:pos]):
+                raise ValueError("stream checksum mismatch")
+            if n_users != len(users) or n_faces != sum(len(u['faces']) for u in users):
+                raise ValueError("record count mismatch")
+            return users
+        pos = end + 4
+
+
+def write_stream(users):
+    def frame(rtype, payload):
+        head = struct.pack('<BBH', rtype, 0, len(payload))
+        return head + payload + struct.pack('<I', crc32(head + payload))
+
+    header = struct.pack('<IHHI', MAGIC, VERSION, EMBEDDING_DIM, 0)
+    out = bytearray(header + struct.pack('<I', crc32(header)))
+    faces = 0
+    for user in users:
+        payload = (pack_field(user['name'], NAME_LEN) +
+                   pack_field(user['jabatan'], FIELD_LEN) +
+                   pack_field(user['departemen'], FIELD_LEN) +
+                   pack_field(user['masaBerlaku'], DATE_LEN) +
+                   struct.pack('<H', len(user['faces'])))
+        out += frame(RECORD_USER, payload)
+        for face in user['faces']:
+            out += frame(RECORD_FACE, face)
+            faces += 1
+    out += frame(RECORD_END, struct.pack('<III', len(users), faces, crc32(bytes(out))))
+    return bytes(out)
+
+
+def load(path):
+    with open(path, 'rb') as f:
+        return read_stream(f.read())
+
+
+def cmd_export(args):
+    url = f"http://{args.host}/api/gallery/export"
+    print(f"Downloading {url} ...")
+    with urllib.request.urlopen(url, timeout=args.timeout) as response:
+        data = response.read()
+    users = read_stream(data)  # Refuse to save an aborted/corrupt export
+    with open(args.output, 'wb') as f:
+        f.write(data)
+    print(f"Saved {len(users)} users, {sum(len(u['faces']) for u in users)} templates "
+          f"({len(data)} bytes) to {args.output}")
+
+
+def cmd_import(args):
+    with open(args.file, 'rb') as f:
+        data = f.read()
+    users = read_stream(data)
+
+    boundary = uuid.uuid4().hex
+    body = (f"--{boundary}\r\n"
+            f"Content-Disposition: form-data; name=\"file\"; filename=\"gallery.fgex\"\r\n"
+            f"Content-Type: application/octet-stream\r\n\r\n").encode() + data + f"\r\n--{boundary}--\r\n".encode()
+    request = urllib.request.Request(f"http://{args.host}/api/gallery/import", data=body, method='POST',
+                                     headers={'Content-Type': f"multipart/form-data; boundary={boundary}"})
+    print(f"Uploading {len(users)} users ({len(data)} bytes) to {args.host} ...")
+    try:
+        with urllib.request.urlopen(request, timeout=args.timeout) as response:
+            print(response.read().decode())
+    except urllib.error.HTTPError as e:
+        print(f"Import failed ({e.code}): {e.read().decode()}")
+        sys.exit(1)
+
+
+def cmd_info(args):
+    users = load(args.file)
+    for user in users:
+        print(f"{user['name']:<17} {len(user['faces'])} template(s)  "
+              f"{user['jabatan']} / {user['departemen']} / {user['masaBerlaku'] or '-'}")
+    print(f"{len(users)} users, {sum(len(u['faces']) for u in users)} templates - checksums OK")
+
+
+def cmd_merge(args):
+    merged = {}
+    for path in args.files:
+        for user in load(path):
+            merged[user['name']] = user  # Later files win, like an import on the door
+    data = write_stream(list(merged.values()))
+    with open(args.output, 'wb') as f:
+        f.write(data)
+    print(f"Wrote {len(merged)} users ({len(data)} bytes) to {args.output}")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Export, import and inspect door face galleries.")
+    sub = parser.add_subparsers(dest='command', required=True)
+
+    p = sub.add_parser('export', help="Download the gallery of a door")
+    p.add_argument('host', help="Door IP address, e.g. 192.168.4.1")
+    p.add_argument('-o', '--output', default='gallery.fgex', help="Output file (default: gallery.fgex)")
+    p.add_argument('--timeout', type=float, default=60)
+    p.set_defaults(func=cmd_export)
+
+    p = sub.add_parser('import', help="Upload a gallery to a door")
+    p.add_argument('host', help="Door IP address")
+    p.add_argument('file', help="Export file")
+    p.add_argument('--timeout', type=float, default=60)
+    p.set_defaults(func=cmd_import)
+
+    p = sub.add_parser('info', help="Verify an export and list its users")
+    p.add_argument('file')
+    p.set_defaults(func=cmd_info)
+
+    p = sub.add_parser('merge', help="Combine exports into one (later files win)")
+    p.add_argument('files', nargs='+')
+    p.add_argument('-o', '--output', required=True)
+    p.set_defaults(func=cmd_merge)
+
+    args = parser.parse_args()
+    try:
+        args.func(args)
+    except (OSError, ValueError) as e:
+        print(f"Error: {e}")
+        sys.exit(1)